@@ -8,4 +8,4 @@ FOUNDATION_EXPORT const unsigned char AlicerceVersionString[];
 
 // In this header, you should import all the public headers of your framework using statements like #import <Alicerce/PublicHeader.h>
 
-
+#import <Alicerce/CDumpASN1.h>
@@ -16,6 +16,7 @@ let package = Package(
             name: "Alicerce",
             targets: [
                 "AlicerceAnalytics",
+                "AlicerceASN1",
                 "AlicerceAutoLayout",
                 "AlicerceCore",
                 "AlicerceDeepLinking",
@@ -30,6 +31,7 @@ let package = Package(
             ]
         ),
         .library(name: "AlicerceAnalytics", targets: ["AlicerceAnalytics"]),
+        .library(name: "AlicerceASN1", targets: ["AlicerceASN1"]),
         .library(name: "AlicerceAutoLayout", targets: ["AlicerceAutoLayout"]),
         .library(name: "AlicerceCore", targets: ["AlicerceCore"]),
         .library(name: "AlicerceDeepLinking", targets: ["AlicerceDeepLinking"]),
@@ -49,10 +51,23 @@ let package = Package(
         // single module target, mutually exclusive with *all* other targets (which define sub-modules)!
         // SingleModuleSources is a symlink to Sources, to trick SPM into not failing with overlapping sources error 👻
         // https://forums.swift.org/t/spm-shared-targets-files-use-case-whats-the-alternative/38888/4
-        .target(name: "Alicerce", path: "SingleModuleSources"),
+        // the dumpasn1 C core can't be mixed with Swift sources, so it's always a separate target
+        .target(
+            name: "Alicerce",
+            dependencies: ["CDumpASN1"],
+            path: "SingleModuleSources",
+            exclude: ["ASN1/CDumpASN1"]
+        ),
+        .target(name: "CDumpASN1", path: "Sources/ASN1/CDumpASN1"),
 
         // multi module targets
         .target(name: "AlicerceAnalytics", dependencies: ["AlicerceCore"], path: "Sources/Analytics"),
+        .target(
+            name: "AlicerceASN1",
+            dependencies: ["CDumpASN1"],
+            path: "Sources/ASN1",
+            exclude: ["CDumpASN1"]
+        ),
         .target(name: "AlicerceAutoLayout", dependencies: ["AlicerceExtensions"], path: "Sources/AutoLayout"),
         .target(
             name: "AlicerceCore",
@@ -60,6 +75,7 @@ let package = Package(
             path: "Sources",
             exclude: [
                 "Analytics",
+                "ASN1",
                 "AutoLayout",
                 "DeepLinking",
                 "Extensions",
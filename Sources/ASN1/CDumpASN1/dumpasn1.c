@@ -0,0 +1,235 @@
+/* In-memory ASN.1 parsing core taken from dumpasn1.  See CDumpASN1.h for
+   details.
+
+   dumpasn1 itself is a single-file program that's built with
+   'cc dumpasn1.c' and kept with the test certificates, so neither the
+   package nor the framework or pod (which only ship what's under Sources)
+   can compile it, and it can't include this file without losing its
+   single-file build.  Its stream-based parser also keeps its state in
+   globals and exits via longjmp(), so only the memory-based item parsing
+   is suitable for a library.  That code, getMemItem(), getNextMemItem() and
+   getMemField(), is copied here with the last two merged and the names and
+   types changed, and any changes to it need to be made in both places */
+
+#include <string.h>
+#include "CDumpASN1.h"
+
+/* Tag classes and universal tags, from dumpasn1 */
+
+#define UNIVERSAL		0x00	/* 0 = Universal (defined by ITU X.680) */
+#define CONTEXT			0x80	/* 10 = Context-specific */
+#define CONSTRUCTED		0x20	/* 1 = constructed */
+#define TAG_MASK		0x1F	/* Bits 5 - 1 */
+
+#define INTEGER			0x02
+#define SEQUENCE		0x10
+
+#define LEN_XTND		0x80	/* Indefinite or long form */
+#define LEN_MASK		0x7F	/* Bits 7 - 1 */
+
+#ifndef TRUE
+  #define FALSE			0
+  #define TRUE			!FALSE
+#endif /* TRUE */
+
+typedef unsigned char BYTE;
+
+/****************************************************************************
+*																			*
+*								ASN.1 Parsing Routines						*
+*																			*
+****************************************************************************/
+
+/* Get an ASN.1 object's tag and length from a block of memory.  This is
+   dumpasn1's getMemItem() */
+
+int dumpasn1GetItem( const BYTE *data, const long dataLength,
+					 DUMPASN1_ITEM *item )
+	{
+	int tag, length, index = 0;
+
+	memset( item, 0, sizeof( DUMPASN1_ITEM ) );
+	if( dataLength < 1 )
+		return( FALSE );
+	tag = data[ index ];
+	item->header[ index++ ] = tag;
+	item->id = tag & ~TAG_MASK;
+	tag &= TAG_MASK;
+	if( tag == TAG_MASK )
+		{
+		int value;
+
+		/* Long tag encoded as sequence of 7-bit values.  This doesn't try to
+		   handle tags > INT_MAX, it'd be pretty peculiar ASN.1 if it had to
+		   use tags this large */
+		tag = 0;
+		do
+			{
+			if( index >= dataLength )
+				return( FALSE );
+			value = data[ index ];
+			tag = ( tag << 7 ) | ( value & 0x7F );
+			item->header[ index++ ] = value;
+			}
+		while( value & LEN_XTND && index < 5 );
+		if( index >= 5 )
+			return( FALSE );
+		}
+	item->tag = tag;
+	if( index >= dataLength )
+		return( FALSE );
+	length = data[ index ];
+	item->header[ index++ ] = length;
+	item->headerSize = index;
+	if( length & LEN_XTND )
+		{
+		const int lengthStart = index;
+		int i;
+
+		length &= LEN_MASK;
+		if( length > 4 )
+			{
+			/* Impossible length value, probably because we've run into
+			   the weeds */
+			return( -1 );
+			}
+		item->headerSize += length;
+		if( !length )
+			item->indefinite = TRUE;
+		if( index + length > dataLength )
+			return( FALSE );
+		for( i = 0; i < length; i++ )
+			{
+			const int ch = data[ index + i ];
+
+			item->length = ( item->length << 8 ) | ch;
+			item->header[ i + index ] = ch;
+			}
+
+		/* Check for the length being less then 128, which means it
+		   shouldn't be encoded as a long length */
+		if( !item->indefinite && item->length < 128 )
+			item->nonCanonical = lengthStart;
+
+		/* Check for the first 9 bits of the length being identical and
+		   if they are, remember where the encoded non-canonical length
+		   starts */
+		if( item->headerSize - lengthStart > 1 )
+			{
+			if( ( item->header[ lengthStart ] == 0x00 ) && \
+				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x00 ) )
+				item->nonCanonical = lengthStart - 1;
+			if( ( item->header[ lengthStart ] == 0xFF ) && \
+				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x80 ) )
+				item->nonCanonical = lengthStart - 1;
+			}
+		}
+	else
+		item->length = length;
+
+	return( TRUE );
+	}
+
+/* Get the next definite-length item from a block of memory if it has the
+   given tag, returning a pointer to its contents and moving the data
+   pointer past it, or leaving the data pointer unchanged if it doesn't.
+   This is dumpasn1's getNextMemItem() and getMemField() combined */
+
+static const BYTE *getMemField( const BYTE **dataPtr, long *dataLeft,
+								DUMPASN1_ITEM *item, const int id,
+								const int tag )
+	{
+	const BYTE *content;
+
+	if( dumpasn1GetItem( *dataPtr, *dataLeft, item ) <= 0 || \
+		item->indefinite || item->length < 0 || \
+		item->length > *dataLeft - item->headerSize || \
+		item->id != id || item->tag != tag )
+		return( NULL );
+	content = *dataPtr + item->headerSize;
+	*dataPtr = content + item->length;
+	*dataLeft -= item->headerSize + item->length;
+
+	return( content );
+	}
+
+/****************************************************************************
+*																			*
+*							Certificate Parsing Routines					*
+*																			*
+****************************************************************************/
+
+/* Find the SubjectPublicKeyInfo in a certificate:
+
+	Certificate ::= SEQUENCE {
+		tbsCertificate		SEQUENCE {
+			version		[ 0 ]	EXPLICIT INTEGER DEFAULT v1,
+			serialNumber		INTEGER,
+			signature			AlgorithmIdentifier,
+			issuer				Name,
+			validity			Validity,
+			subject				Name,
+			subjectPublicKeyInfo SubjectPublicKeyInfo,
+			...
+			},
+		...
+		}
+
+   We only look at as much of the certificate as we need to get to the
+   SubjectPublicKeyInfo, skipping everything else using its length */
+
+long dumpasn1GetSPKI( const BYTE *data, const long dataLength,
+					  long *spkiOffset, long *spkiLength )
+	{
+	const BYTE *dataPtr = data, *content, *spki;
+	DUMPASN1_ITEM item;
+	long certLength, length = dataLength;
+	int status, i;
+
+	*spkiOffset = *spkiLength = 0;
+
+	/* Get the outer wrapper, distinguishing between a truncated
+	   certificate and something that isn't a certificate at all */
+	status = dumpasn1GetItem( data, dataLength, &item );
+	if( status == FALSE )
+		return( DUMPASN1_ERROR_UNDERFLOW );
+	if( status < 0 || item.indefinite || item.length < 0 || \
+		item.id != ( UNIVERSAL | CONSTRUCTED ) || item.tag != SEQUENCE )
+		return( DUMPASN1_ERROR_BADDATA );
+	if( item.length > dataLength - item.headerSize )
+		return( DUMPASN1_ERROR_UNDERFLOW );
+	certLength = item.headerSize + item.length;
+	if( ( content = getMemField( &dataPtr, &length, &item,
+								 UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( DUMPASN1_ERROR_BADDATA );
+
+	/* Get the tbsCertificate and skip the fields before the
+	   SubjectPublicKeyInfo */
+	dataPtr = content;
+	length = item.length;
+	if( ( content = getMemField( &dataPtr, &length, &item,
+								 UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( DUMPASN1_ERROR_BADDATA );
+	dataPtr = content;
+	length = item.length;
+	getMemField( &dataPtr, &length, &item, CONTEXT | CONSTRUCTED, 0 );
+	if( getMemField( &dataPtr, &length, &item, UNIVERSAL,
+					 INTEGER ) == NULL )
+		return( DUMPASN1_ERROR_BADDATA );
+	for( i = 0; i < 4; i++ )
+		{
+		if( getMemField( &dataPtr, &length, &item, UNIVERSAL | CONSTRUCTED,
+						 SEQUENCE ) == NULL )
+			return( DUMPASN1_ERROR_BADDATA );
+		}
+
+	/* Get the SubjectPublicKeyInfo */
+	spki = dataPtr;
+	if( getMemField( &dataPtr, &length, &item, UNIVERSAL | CONSTRUCTED,
+					 SEQUENCE ) == NULL )
+		return( DUMPASN1_ERROR_BADDATA );
+	*spkiOffset = spki - data;
+	*spkiLength = dataPtr - spki;
+
+	return( certLength );
+	}
@@ -0,0 +1,42 @@
+/* In-memory ASN.1 parsing core taken from dumpasn1 (see
+   Tests/AlicerceTests/Network/Pinning/Certificates/dumpasn1.c).  Unlike the
+   program, which reads from a stream and keeps its state in globals, this
+   works on a block of memory and is reentrant, so it can be called from any
+   number of threads at once */
+
+#ifndef CDUMPASN1_H
+#define CDUMPASN1_H
+
+/* Error codes returned by dumpasn1GetSPKI() */
+
+#define DUMPASN1_ERROR_UNDERFLOW	-1	/* Data is truncated */
+#define DUMPASN1_ERROR_BADDATA		-2	/* Data isn't a certificate */
+
+/* Structure to hold info on an ASN.1 item */
+
+typedef struct {
+	int id;						/* Tag class + primitive/constructed */
+	int tag;					/* Tag */
+	long length;				/* Data length */
+	int indefinite;				/* Item has indefinite length */
+	int nonCanonical;			/* Non-canonical length encoding used */
+	unsigned char header[ 16 ];	/* Tag+length data */
+	int headerSize;				/* Size of tag+length */
+	} DUMPASN1_ITEM;
+
+/* Get an ASN.1 object's tag and length from a block of memory.  Returns 1
+   for an item available, 0 for end-of-data, and a negative value for
+   invalid data */
+
+int dumpasn1GetItem( const unsigned char *data, const long dataLength,
+					 DUMPASN1_ITEM *item );
+
+/* Find the SubjectPublicKeyInfo in the DER-encoded certificate at the start
+   of a block of memory, returning its position and the certificate's total
+   length so that the caller can move on to the next certificate, or one of
+   the DUMPASN1_ERROR_xxx values on error */
+
+long dumpasn1GetSPKI( const unsigned char *data, const long dataLength,
+					  long *spkiOffset, long *spkiLength );
+
+#endif /* CDUMPASN1_H */
@@ -0,0 +1,89 @@
+import Foundation
+#if canImport(CryptoKit)
+import CryptoKit
+#endif
+// SPM builds the C core as a separate `CDumpASN1` module, while the Xcode project and CocoaPods build it into the
+// framework itself, where it's exposed to Swift through the umbrella header (`Alicerce.h` imports `CDumpASN1.h`).
+#if canImport(CDumpASN1)
+import CDumpASN1
+#endif
+
+// Extracts the subject public key info (SPKI) from DER encoded certificates in-process, using the dumpasn1 parsing
+// core. Unlike `SecCertificate.publicKey` + `Data.spkiHash(for:)`, this doesn't rely on the Security framework nor
+// require knowing the key's algorithm, and works on Linux, e.g. to generate pins for whole certificate stores:
+//
+//      let store = try Data(contentsOf: storeURL) // concatenated DER certificates
+//      let pins = try store.certificateSPKIHashes()
+//
+// Where CryptoKit isn't available, hash each `store[range]` from `certificateSPKIRanges()` instead.
+
+public enum CertificateSPKIError: Error {
+    case truncatedData(offset: Int)
+    case invalidCertificate(offset: Int)
+}
+
+extension Data {
+
+    /// The range of the subject public key info (SPKI) of the DER encoded certificate contained in the data.
+    ///
+    /// Slicing the data with the returned range gives the SPKI bytes without any copying.
+    public func certificateSPKIRange() throws -> Range<Index> {
+
+        guard let range = try certificateSPKIRanges(limit: 1).first else {
+            throw CertificateSPKIError.truncatedData(offset: 0)
+        }
+
+        return range
+    }
+
+    /// The ranges of the subject public key infos (SPKI) of the concatenated DER encoded certificates contained in the
+    /// data (e.g. a certificate store), in order.
+    ///
+    /// Slicing the data with the returned ranges gives the SPKI bytes without any copying.
+    public func certificateSPKIRanges() throws -> [Range<Index>] { try certificateSPKIRanges(limit: .max) }
+
+    #if canImport(CryptoKit)
+    /// The SPKI SHA256 Base64 encoded hashes of the concatenated DER encoded certificates contained in the data, in
+    /// order, as used by `ServerTrustEvaluator`.
+    public func certificateSPKIHashes() throws -> [String] {
+
+        try certificateSPKIRanges().map { Data(SHA256.hash(data: self[$0])).base64EncodedString() }
+    }
+    #endif
+
+    private func certificateSPKIRanges(limit: Int) throws -> [Range<Index>] {
+
+        try withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> [Range<Index>] in
+
+            guard let baseAddress = buffer.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return [] }
+
+            var ranges = [Range<Index>]()
+            var offset = 0
+
+            while offset < buffer.count, ranges.count < limit {
+                var spkiOffset = 0
+                var spkiLength = 0
+
+                let certificateLength = dumpasn1GetSPKI(
+                    baseAddress + offset,
+                    buffer.count - offset,
+                    &spkiOffset,
+                    &spkiLength
+                )
+
+                switch certificateLength {
+                case Int(DUMPASN1_ERROR_UNDERFLOW):
+                    throw CertificateSPKIError.truncatedData(offset: offset)
+                case ..<0:
+                    throw CertificateSPKIError.invalidCertificate(offset: offset)
+                default:
+                    let spkiStart = startIndex + offset + spkiOffset
+                    ranges.append(spkiStart ..< spkiStart + spkiLength)
+                    offset += certificateLength
+                }
+            }
+
+            return ranges
+        }
+    }
+}
@@ -0,0 +1,113 @@
+import XCTest
+@testable import Alicerce
+
+class Data_CertificateSPKITestCase: XCTestCase {
+
+    // MARK: certificateSPKIRange
+
+    // success
+
+    func testCertificateSPKIRange_WithRSACertificate_ShouldReturnSPKIRange() throws {
+        let certificateData = dataFromFile(withName: "DigiCertGlobalRootG2", type: "cer")
+        let spkiData = dataFromFile(withName: "DigiCertGlobalRootG2", type: "pub")
+
+        let range = try certificateData.certificateSPKIRange()
+
+        XCTAssertEqual(range, 276 ..< 570)
+        XCTAssertEqual(certificateData[range], spkiData)
+    }
+
+    func testCertificateSPKIRange_WithECDSACertificate_ShouldReturnSPKIRange() throws {
+        let certificateData = dataFromFile(withName: "MinderaAlicerceRootCA", type: "cer")
+        let spkiData = dataFromFile(withName: "MinderaAlicerceRootCA", type: "pub")
+
+        let range = try certificateData.certificateSPKIRange()
+
+        XCTAssertEqual(certificateData[range], spkiData)
+    }
+
+    func testCertificateSPKIRange_WithDataSlice_ShouldReturnRangeInSliceIndices() throws {
+        let certificateData = dataFromFile(withName: "GeoTrust_Universal_CA", type: "cer")
+        let spkiData = dataFromFile(withName: "GeoTrust_Universal_CA", type: "pub")
+        let slice = (Data([0x00, 0x01, 0x02]) + certificateData).dropFirst(3)
+
+        let range = try slice.certificateSPKIRange()
+
+        XCTAssertEqual(range.lowerBound, slice.startIndex + 205)
+        XCTAssertEqual(slice[range], spkiData)
+    }
+
+    // failure
+
+    func testCertificateSPKIRange_WithEmptyData_ShouldThrowTruncatedData() {
+        XCTAssertThrowsError(try Data().certificateSPKIRange()) {
+            guard case CertificateSPKIError.truncatedData(offset: 0) = $0 else {
+                return XCTFail("unexpected error: \($0)")
+            }
+        }
+    }
+
+    func testCertificateSPKIRange_WithTruncatedCertificate_ShouldThrowTruncatedData() {
+        let certificateData = dataFromFile(withName: "DigiCertGlobalRootG2", type: "cer")
+
+        XCTAssertThrowsError(try certificateData.prefix(500).certificateSPKIRange()) {
+            guard case CertificateSPKIError.truncatedData(offset: 0) = $0 else {
+                return XCTFail("unexpected error: \($0)")
+            }
+        }
+    }
+
+    func testCertificateSPKIRange_WithPublicKey_ShouldThrowInvalidCertificate() {
+        let spkiData = dataFromFile(withName: "DigiCertGlobalRootG2", type: "pub")
+
+        XCTAssertThrowsError(try spkiData.certificateSPKIRange()) {
+            guard case CertificateSPKIError.invalidCertificate(offset: 0) = $0 else {
+                return XCTFail("unexpected error: \($0)")
+            }
+        }
+    }
+
+    // MARK: certificateSPKIRanges
+
+    func testCertificateSPKIRanges_WithCertificateStore_ShouldReturnAllSPKIRanges() throws {
+        let names = [
+            "DigiCertGlobalRootG2",
+            "GeoTrust_Universal_CA",
+            "AmazonRootCA3",
+            "AmazonRootCA4",
+            "MinderaAlicerceRootCA"
+        ]
+        let storeData = names.reduce(Data()) { $0 + dataFromFile(withName: $1, type: "cer") }
+
+        let ranges = try storeData.certificateSPKIRanges()
+
+        XCTAssertEqual(ranges.map { storeData[$0] }, names.map { dataFromFile(withName: $0, type: "pub") })
+    }
+
+    func testCertificateSPKIRanges_WithTrailingGarbage_ShouldThrowInvalidCertificateAtItsOffset() {
+        let certificateData = dataFromFile(withName: "AmazonRootCA4", type: "cer")
+
+        XCTAssertThrowsError(try (certificateData + Data([0x04, 0x00])).certificateSPKIRanges()) {
+            guard case CertificateSPKIError.invalidCertificate(offset: 502) = $0 else {
+                return XCTFail("unexpected error: \($0)")
+            }
+        }
+    }
+
+    // MARK: certificateSPKIHashes
+
+    func testCertificateSPKIHashes_WithCertificateStore_ShouldReturnSameHashesAsSPKIHash() throws {
+        let names = ["DigiCertGlobalRootG2", "GeoTrust_Universal_CA", "AmazonRootCA3", "AmazonRootCA4"]
+        let storeData = names.reduce(Data()) { $0 + dataFromFile(withName: $1, type: "cer") }
+
+        XCTAssertEqual(
+            try storeData.certificateSPKIHashes(),
+            [
+                "i7WTqTvh0OioIruIfFR4kMPnBqrS2rdiVPl/s2uC/CY=",
+                "lpkiXF3lLlbN0y3y6W0c/qWqPKC7Us2JM8I7XCdEOCA=",
+                "NqvDJlas/GRcYbcWE8S/IceH9cq77kg0jVhZeAPXq8k=",
+                "9+ze1cZgR9KO1kZrVDxA4HQ6voHRCSVNz4RdTCx4U8U="
+            ]
+        )
+    }
+}
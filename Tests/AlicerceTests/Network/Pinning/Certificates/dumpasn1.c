@@ -11,7 +11,15 @@
    updated 22 April 2021 (version 20210422, if you prefer it that way,
    see also UPDATE_STRING below).  To build under Windows, use 
    'cl /MD dumpasn1.c'.  To build on OS390 or z/OS, use 
-   '/bin/c89 -D OS390 -o dumpasn1 dumpasn1.c'.
+   '/bin/c89 -D OS390 -o dumpasn1 dumpasn1.c'.  Under Unix the parallel-
+   decoding support requires pthreads, so if your system doesn't link this
+   in by default use 'cc -pthread dumpasn1.c', or build with -D NO_THREADS
+   to disable it.  To decode gzip- or zstd-compressed input or compress
+   the output, build with -D USE_ZLIB and/or -D USE_ZSTD and link with -lz
+   and/or -lzstd.  To read collections of files via io_uring under Linux,
+   build with -D USE_IO_URING.  To build the libFuzzer fuzz target instead
+   of the program, use 'clang -fsanitize=fuzzer,address -D FUZZER
+   dumpasn1.c'.
 
    This code grew slowly over time without much design or planning, and with
    extra features being tacked on as required.  It's not representative of my
@@ -57,12 +65,21 @@
    Richard Miara, Joyce Musselman, Juan Navarro, and Ben Shneiderman,
    Communications of the ACM, Vol.26, No.11 (November 1983), p.861) */
 
+/* Under Linux we need the GNU extensions for the custom stdio streams used
+   in server mode */
+
+#if ( defined( linux ) || defined( __linux__ ) ) && !defined( _GNU_SOURCE )
+  #define _GNU_SOURCE
+#endif /* Linux */
+
 #include <ctype.h>
 #include <limits.h>
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #ifdef OS390
   #include <unistd.h>
 #endif /* OS390 */
@@ -81,6 +98,12 @@
 #ifndef BYTE
   typedef unsigned char		BYTE;
 #endif /* BYTE */
+#if UINT_MAX >= 0xFFFFFFFFUL
+  typedef unsigned int		UINT32;
+#else
+  typedef unsigned long		UINT32;
+#endif /* 32-bit int */
+#define MASK32( x )		( ( x ) & 0xFFFFFFFFUL )
 
 /* Tandem Guardian NonStop Kernel options */
 
@@ -115,6 +138,15 @@
   #endif /* FILENAME_MAX < 128 */
 #endif /* FILENAME_MAX */
 
+/* The null device, used to discard output that we don't want to display */
+
+#if defined( _WINDOWS ) || defined( WIN32 ) || defined( _WIN32 ) || \
+	defined( __WIN32__ )
+  #define NULL_DEVICE		"nul"
+#else
+  #define NULL_DEVICE		"/dev/null"
+#endif /* OS-specific null device */
+
 /* Under Windows we can do special-case handling for paths and Unicode
    strings (although in practice it can't really handle much except
    latin-1) */
@@ -149,6 +181,93 @@
   #include <wchar.h>
 #endif /* Linux */
 
+/* Under Unix we can memory-map the input and decode very large objects
+   like CRLs with millions of entries using multiple threads.  Since the
+   parsing state is kept in global variables, the parts of it that change
+   during the parse are made thread-local */
+
+#if defined( __UNIX__ ) && !defined( __TANDEM ) && !defined( NO_THREADS )
+  #define USE_THREADS
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <pthread.h>
+  #include <errno.h>
+  #include <signal.h>
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/time.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+  #define THREAD_LOCAL	__thread
+#else
+  #define THREAD_LOCAL
+#endif /* __UNIX__ && !NO_THREADS */
+
+/* Compressed input can be decoded if we're built with -D USE_ZLIB and/or
+   -D USE_ZSTD and linked with -lz and/or -lzstd.  The decompressed data is
+   read through a custom stdio stream, which is only possible under Linux
+   and the BSDs */
+
+#if ( defined( USE_ZLIB ) || defined( USE_ZSTD ) ) && \
+	( defined( __linux__ ) || defined( __APPLE__ ) || \
+	  defined( __FreeBSD__ ) || defined( __NetBSD__ ) || \
+	  defined( __OpenBSD__ ) )
+  #define USE_COMPRESSION
+  #ifdef USE_ZLIB
+	#include <zlib.h>
+  #endif /* USE_ZLIB */
+  #ifdef USE_ZSTD
+	#include <zstd.h>
+  #endif /* USE_ZSTD */
+#else
+  #undef USE_ZLIB
+  #undef USE_ZSTD
+#endif /* ( USE_ZLIB || USE_ZSTD ) && ( Linux || BSD ) */
+
+/* Output can be compressed in the same way, which is done in a separate
+   thread so that it runs in parallel with the decoding */
+
+#if defined( USE_COMPRESSION ) && defined( USE_THREADS )
+  #define USE_COMPRESSED_OUTPUT
+#endif /* USE_COMPRESSION && USE_THREADS */
+
+/* Collections of files can be read via io_uring under Linux if we're built
+   with -D USE_IO_URING.  We use the system calls directly rather than
+   requiring liburing */
+
+#if defined( USE_IO_URING ) && defined( __linux__ )
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <linux/io_uring.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#else
+  #undef USE_IO_URING
+#endif /* USE_IO_URING && Linux */
+
+/* A growing file can be followed using change notifications under Linux,
+   on other systems we poll for changes */
+
+#if defined( USE_THREADS ) && defined( __linux__ )
+  #include <poll.h>
+  #include <sys/inotify.h>
+  #define USE_INOTIFY
+#endif /* USE_THREADS && Linux */
+
+/* Long strings are checked for invalid characters using SIMD operations
+   where they're available */
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || \
+	( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+  #include <emmintrin.h>
+  #define USE_SSE2
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+  #include <arm_neon.h>
+  #define USE_NEON
+#endif /* SIMD support */
+
 /* For IBM mainframe OSes we use the Posix environment, so it looks like
    Unix */
 
@@ -167,6 +286,14 @@
   #endif /* _GUARDIAN_TARGET */
 #endif /* __TANDEM */
 
+/* Under Unix we can walk directory trees when producing a certificate
+   inventory */
+
+#ifdef __UNIX__
+  #include <dirent.h>
+  #include <sys/stat.h>
+#endif /* __UNIX__ */
+
 /* Some OSes don't define the min() macro */
 
 #ifndef min
@@ -248,6 +375,10 @@
 
 #define MAX_NESTING_LEVEL	80
 
+/* The maximum number of threads that we use for parallel decoding */
+
+#define MAX_THREADS			64
+
 /* Various special-case operations to perform on strings */
 
 typedef enum {
@@ -262,6 +393,22 @@ typedef enum {
 	STR_BMP_REVERSED		/* STR_BMP with incorrect endianness */
 	} STR_OPTION;
 
+/* The output format when producing a certificate inventory */
+
+typedef enum {
+	INVENTORY_NONE,			/* Dump the data rather than an inventory */
+	INVENTORY_CSV,			/* Comma-separated values */
+	INVENTORY_JSON			/* Newline-delimited JSON objects */
+	} INVENTORY_FORMAT;
+
+/* Operations on the compiled-in OID table */
+
+typedef enum {
+	OIDTABLE_NONE,			/* No OID table operation */
+	OIDTABLE_MAKE,			/* Generate the table from the config file */
+	OIDTABLE_CHECK			/* Check the table against the config file */
+	} OIDTABLE_MODE;
+
 /* Structure to hold info on an ASN.1 item */
 
 typedef struct {
@@ -276,33 +423,87 @@ typedef struct {
 
 /* Configuration options */
 
-static int printDots = FALSE;		/* Whether to print dots to align columns */
-static int doPure = FALSE;			/* Print data without LHS info column */
-static int doDumpHeader = FALSE;	/* Dump tag+len in hex (level = 0, 1, 2) */
-static int extraOIDinfo = FALSE;	/* Print extra information about OIDs */
-static int doHexValues = FALSE;		/* Display size, offset in hex not dec.*/
-static int useStdin = FALSE;		/* Take input from stdin */
+static THREAD_LOCAL int printDots = FALSE;	/* Whether to print dots to align columns */
+static THREAD_LOCAL int doPure = FALSE;	/* Print data without LHS info column */
+static THREAD_LOCAL int doDumpHeader = FALSE;	/* Dump tag+len in hex (level = 0, 1, 2) */
+static THREAD_LOCAL int extraOIDinfo = FALSE;	/* Print extra information about OIDs */
+static THREAD_LOCAL int doHexValues = FALSE;	/* Display size, offset in hex not dec.*/
+static THREAD_LOCAL int useStdin = FALSE;	/* Take input from stdin */
 static int noWarnStdin = FALSE;		/* Don't warn about stdin disabling display options */
-static int zeroLengthAllowed = FALSE;/* Zero-length items allowed */
-static int dumpText = FALSE;		/* Dump text alongside hex data */
-static int printAllData = FALSE;	/* Whether to print all data in long blocks */
-static int checkEncaps = TRUE;		/* Print encaps.data in BIT/OCTET STRINGs */
-static int checkCharset = TRUE;		/* Check val.of char strs.hidden in OCTET STRs */
+static THREAD_LOCAL int zeroLengthAllowed = FALSE;/* Zero-length items allowed */
+static THREAD_LOCAL int dumpText = FALSE;	/* Dump text alongside hex data */
+static THREAD_LOCAL int printAllData = FALSE;	/* Whether to print all data in long blocks */
+static THREAD_LOCAL int checkEncaps = TRUE;	/* Print encaps.data in BIT/OCTET STRINGs */
+static THREAD_LOCAL int checkCharset = TRUE;	/* Check val.of char strs.hidden in OCTET STRs */
 #ifndef __OS390__
-static int reverseBitString = TRUE;	/* Print BIT STRINGs in natural order */
+static THREAD_LOCAL int reverseBitString = TRUE;	/* Print BIT STRINGs in natural order */
 #else
-static int reverseBitString = FALSE;/* Natural order on OS390 is the same as ASN.1 */
+static THREAD_LOCAL int reverseBitString = FALSE;/* Natural order on OS390 is the same as ASN.1 */
 #endif /* __OS390__ */
-static int rawTimeString = FALSE;	/* Print raw time strings */
-static int shallowIndent = FALSE;	/* Perform shallow indenting */
-static int outputWidth = 80;		/* 80-column display */
-static int maxNestLevel = MAX_NESTING_LEVEL;/* Maximum nesting level for which to display output */
-static int doOutlineOnly = FALSE;	/* Only display constructed-object outline */
+static THREAD_LOCAL int rawTimeString = FALSE;	/* Print raw time strings */
+static THREAD_LOCAL int shallowIndent = FALSE;	/* Perform shallow indenting */
+static THREAD_LOCAL int outputWidth = 80;	/* 80-column display */
+static THREAD_LOCAL int maxNestLevel = MAX_NESTING_LEVEL;/* Maximum nesting level for which to display output */
+static THREAD_LOCAL int doOutlineOnly = FALSE;	/* Only display constructed-object outline */
+static int parallelThreads = 1;		/* Number of threads for parallel decode */
+static THREAD_LOCAL long maxItems = 0;	/* Max.no.items to display per object */
+static THREAD_LOCAL int validateSkipped = FALSE;	/* Check items skipped via maxItems */
+static INVENTORY_FORMAT inventoryFormat = INVENTORY_NONE;/* Inventory output format */
+static int filterExpiry = FALSE;	/* Only inventory certs expiring before */
+static long long expiryTime = 0;	/*	this time */
+static int filterValidAt = FALSE;	/* Only inventory certs valid at */
+static long long validAtTime = 0;	/*	this time */
+static OIDTABLE_MODE oidTableMode = OIDTABLE_NONE;/* OID table operation */
+static int diffMode = FALSE;		/* Compare two objects */
+static const char *corpusDirName = NULL;/* Directory for fuzzer corpus */
+static int doBenchmarkMode = FALSE;	/* Run benchmark */
+static const char *extractManifest = NULL;/* Manifest of objects to extract */
+static int maxErrors = -1;			/* Stop decoding after this many errors */
+static int jsonDiagnostics = FALSE;	/* Report diagnostics as JSON */
+static int derCheckMode = FALSE;	/* Check DER encoding */
+static int schemaRoot = 0;			/* Schema type for field labels */
+static int decimalIntegers = FALSE;	/* Display large integers in decimal */
+#ifdef USE_COMPRESSED_OUTPUT
+static int outputCompression = 0;	/* Compression type for output */
+#endif /* USE_COMPRESSED_OUTPUT */
+static const char *makeIndexName = NULL;/* OID index to create or update */
+static const char *searchIndexName = NULL;/* OID index to search */
+static const char *findQuery = NULL;	/* Query for items to find */
+#ifdef USE_THREADS
+static const char *serverSocketName = NULL;/* Socket to listen on in server mode */
+static int followMode = FALSE;		/* Follow a growing file */
+static const char *followStateFileName = NULL;/* Saved follow position */
+static int batchMode = FALSE;		/* Dump a collection of files */
+#endif /* USE_THREADS */
+
+/* The display options are thread-local so that each request handled in
+   server mode can have its own set of options.  When we need to pass the
+   options to another thread, we take a snapshot of them */
+
+#ifdef USE_THREADS
+
+typedef struct {
+	int printDots, doPure, doDumpHeader, extraOIDinfo, doHexValues;
+	int zeroLengthAllowed, dumpText, printAllData, checkEncaps;
+	int checkCharset, reverseBitString, rawTimeString, shallowIndent;
+	int outputWidth, maxNestLevel, doOutlineOnly;
+	long maxItems;
+	int validateSkipped;
+	} DUMP_OPTIONS;
+
+#endif /* USE_THREADS */
+
+/* The names of the fields in a certificate inventory */
+
+static const char *inventoryFieldNames[] = {
+	"file", "subject", "issuer", "notBefore", "notAfter",
+	"keyAlgorithm", "keyAlgorithmName", "spkiSHA256"
+	};
 
 /* Formatting information used for the fixed informational column to the
    left of the displayed data */
 
-static int infoWidth = 4;
+static THREAD_LOCAL int infoWidth = 4;
 static const char *indentStringTbl[] = {
 	NULL, NULL, NULL,
 	"       : ",			/* "xxx xxx: " (3) */
@@ -313,50 +514,55 @@ static const char *indentStringTbl[] = {
 	"                 : ",	/* "xxxxxxxx xxxxxxxx: " (8) */
 	"", "", "", ""
 	};
-static const char *lenTbl[] = {
-	NULL, NULL, NULL,
-	"%3ld %3ld: ", "%4ld %4ld: ", "%5ld %5ld: ",
-	"%6ld %6ld: ", "%7ld %7ld: ", "%8ld %8ld: ",
-	"", "", "", ""
-	};
 static const char *lenIndefTbl[] = {
 	NULL, NULL, NULL,
-	"%3ld NDF: ", "%4ld NDEF: ", "%5ld INDEF: ",
-	"%6ld INDEF : ", "%7ld INDEF  : ", "%8ld INDEF   : ",
-	"", "", "", ""
-	};
-static const char *lenHexTbl[] = {
-	NULL, NULL, NULL,
-	"%03lX %3lX: ", "%04lX %4lX: ", "%05lX %5lX: ",
-	"%06lX %6lX: ", "%07lX %7lX: ", "%08lX %8lX: ",
-	"", "", "", ""
-	};
-static const char *lenHexIndefTbl[] = {
-	NULL, NULL, NULL,
-	"%03lX NDF: ", "%04lX NDEF: ", "%05lX INDEF: ",
-	"%06lX INDEF : ", "%07lX INDEF  : ", "%08lX INDEF   : ",
+	"NDF", "NDEF", "INDEF", "INDEF ", "INDEF  ", "INDEF   ",
 	"", "", "", ""
 	};
 
 #define INDENT_SIZE		( infoWidth + 1 + infoWidth + 1 + 1 )
 #define INDENT_STRING	indentStringTbl[ infoWidth ]
-#define LEN				lenTbl[ infoWidth ]
 #define LEN_INDEF		lenIndefTbl[ infoWidth ]
-#define LEN_HEX			lenHexTbl[ infoWidth ]
-#define LEN_HEX_INDEF	lenHexIndefTbl[ infoWidth ]
+
+/* The indentation for each nesting level is taken from the start of a
+   precomputed string for each indent style rather than being written one
+   level at a time */
+
+#define INDENT_DOTS_10		". . . . . . . . . . "
+#define INDENT_SPACES_10	"                    "
+#define INDENT_MAX_SIZE		160
+
+static const char indentDotsString[] = \
+	INDENT_DOTS_10 INDENT_DOTS_10 INDENT_DOTS_10 INDENT_DOTS_10 \
+	INDENT_DOTS_10 INDENT_DOTS_10 INDENT_DOTS_10 INDENT_DOTS_10;
+static const char indentSpacesString[] = \
+	INDENT_SPACES_10 INDENT_SPACES_10 INDENT_SPACES_10 INDENT_SPACES_10 \
+	INDENT_SPACES_10 INDENT_SPACES_10 INDENT_SPACES_10 INDENT_SPACES_10;
 
 /* Error and warning information */
 
-static int noErrors = 0;			/* Number of errors found */
-static int noWarnings = 0;			/* Number of warnings */
+static THREAD_LOCAL int noErrors = 0;	/* Number of errors found */
+static THREAD_LOCAL int noWarnings = 0;	/* Number of warnings */
 
 /* Position in the input stream */
 
-static int fPos = 0;				/* Absolute position in data */
+static THREAD_LOCAL int fPos = 0;	/* Absolute position in data */
+
+/* When the input is memory-mapped, the mapped data.  This is used to scan
+   ahead through large objects without going through stdio.  If we're
+   decoding part of an object in a parallel worker thread, we also record
+   the point to return to if we run into a fatal error */
+
+#ifdef USE_THREADS
+static const BYTE *inputBuffer = NULL;	/* Mapped input data */
+static long inputBufferSize = 0;	/* Size of mapped input data */
+static THREAD_LOCAL jmp_buf *workerAbort = NULL;	/* Worker error exit */
+#endif /* USE_THREADS */
 
 /* The output stream */
 
-static FILE *output;				/* Output stream */
+static THREAD_LOCAL FILE *output;	/* Output stream */
+static FILE *nullOutput;			/* Stream for discarded output */
 
 /* OID data sizes.  Because of Microsoft's "encode random noise and call it
    an OID" approach, we maintain two size limits, a sane one and one capable
@@ -530,13 +736,353 @@ static char *idstr( const int tagID )
 		}
 	}
 
+/* The OID information can also be compiled into the program, which
+   avoids having to locate and read the config file at startup.  To do
+   this, build dumpasn1 as usual, generate the OID table from the config
+   file with 'dumpasn1 --make-oid-table > dumpasn1oid.h', and rebuild with
+   -D BUILTIN_OIDS.  'dumpasn1 --check-oid-table' then compares the
+   compiled-in table against the config file.  Any config files given with
+   -c override the compiled-in entries.
+
+   The compiled-in table is indexed by a perfect hash, in which the OID
+   content is first hashed to a bucket and then hashed again using a seed
+   chosen for each bucket that gives every OID in the table its own slot,
+   see makeOIDtable() */
+
+static UINT32 hashOID( const BYTE *oid, const int oidLength,
+					   const UINT32 seed )
+	{
+	UINT32 hash = MASK32( 2166136261UL ^ ( seed * 16777619UL ) );
+	int i;
+
+	/* FNV-1a with a final mix to spread the low bits */
+	for( i = 0; i < oidLength; i++ )
+		hash = MASK32( ( hash ^ oid[ i ] ) * 16777619UL );
+	hash ^= hash >> 15;
+	hash = MASK32( hash * 0x2C1B3C6DUL );
+
+	return( hash ^ ( hash >> 12 ) );
+	}
+
+#ifdef BUILTIN_OIDS
+
+#include "dumpasn1oid.h"
+
+static const OIDINFO *getBuiltinOIDinfo( const BYTE *oid,
+										 const int oidLength )
+	{
+	const UINT32 bucket = hashOID( oid, oidLength, 0 ) % BUILTIN_OID_BUCKETS;
+	const int index = builtinOIDslots[ hashOID( oid, oidLength,
+									   builtinOIDseeds[ bucket ] ) % \
+									   BUILTIN_OID_SLOTS ];
+	const OIDINFO *oidPtr;
+
+	if( index < 0 )
+		return( NULL );
+	oidPtr = &builtinOIDs[ index ];
+	if( oidLength != oidPtr->oidLength - 2 || \
+		memcmp( oidPtr->oid + 2, oid, oidLength ) )
+		return( NULL );
+
+	return( oidPtr );
+	}
+#endif /* BUILTIN_OIDS */
+
+/* Once the config data has been read, the OIDs are indexed with a trie over
+   the bytes of their encoded form, which allows both exact lookups and
+   finding the longest known prefix of an OID that isn't in the config data.
+   The nodes are stored in a single array, with the children of each node
+   stored contiguously in order of their byte value so that they can be
+   binary-searched.  Nodes at the end of an arc (a byte without the high bit
+   set) also record a family name for the OIDs below them, either the
+   description of the OID that ends there or, if there's no such OID, the
+   leading words that the comments of all of the OIDs below it have in
+   common, so that for example an unknown OID under a set of OIDs commented
+   as "Microsoft code signing" and "Microsoft cert services" is reported as
+   being under Microsoft */
+
+typedef struct {
+	int firstChild, noChildren;	/* Position and number of children */
+	const OIDINFO *oidInfo;		/* OID ending at this node */
+	const char *familyName;		/* Name for OIDs under this node */
+	int familyNameLength;
+	BYTE value;					/* Encoded OID byte for this node */
+	} OID_TRIE_NODE;
+
+typedef struct {
+	const OIDINFO *oidInfo;		/* OID information */
+	int order;					/* Order in which OID was read */
+	} OID_TRIE_ENTRY;
+
+static OID_TRIE_NODE *oidTrie = NULL;
+static int oidTrieSize = 0;
+
+static int compareTrieEntries( const void *entry1Ptr, const void *entry2Ptr )
+	{
+	const OID_TRIE_ENTRY *entry1 = ( const OID_TRIE_ENTRY * ) entry1Ptr;
+	const OID_TRIE_ENTRY *entry2 = ( const OID_TRIE_ENTRY * ) entry2Ptr;
+	const int length1 = entry1->oidInfo->oidLength - 2;
+	const int length2 = entry2->oidInfo->oidLength - 2;
+	const int status = memcmp( entry1->oidInfo->oid + 2,
+							   entry2->oidInfo->oid + 2,
+							   min( length1, length2 ) );
+
+	if( status )
+		return( status );
+	if( length1 != length2 )
+		return( length1 - length2 );
+	return( entry1->order - entry2->order );
+	}
+
+/* Find the leading words that the comments for a set of OIDs have in
+   common */
+
+static void getFamilyName( OID_TRIE_NODE *node, const OID_TRIE_ENTRY *entries,
+						   const int noEntries )
+	{
+	const char *name = NULL;
+	int nameLength = 0, i;
+
+	for( i = 0; i < noEntries; i++ )
+		{
+		const char *comment = entries[ i ].oidInfo->comment;
+		int length;
+
+		if( comment == NULL )
+			continue;
+		if( name == NULL )
+			{
+			name = comment;
+			nameLength = strlen( comment );
+			continue;
+			}
+		for( length = 0; length < nameLength && \
+						 comment[ length ] == name[ length ]; length++ );
+		if( !( name[ length ] == ' ' || name[ length ] == '\0' ) || \
+			!( comment[ length ] == ' ' || comment[ length ] == '\0' ) )
+			{
+			/* We've stopped in the middle of a word, back up to the end
+			   of the previous one */
+			while( length > 0 && name[ length ] != ' ' )
+				length--;
+			}
+		nameLength = length;
+		}
+	while( nameLength > 0 && name[ nameLength - 1 ] == ' ' )
+		nameLength--;
+	if( nameLength > 0 )
+		{
+		node->familyName = name;
+		node->familyNameLength = nameLength;
+		}
+	}
+
+/* Build the trie node for a set of sorted OIDs that share the first depth
+   bytes of their encoding, returning the index of the next free node */
+
+static int buildTrieNode( const int nodeIndex, const OID_TRIE_ENTRY *entries,
+						  int noEntries, const int depth, int nextFree )
+	{
+	OID_TRIE_NODE *node = &oidTrie[ nodeIndex ];
+	const OID_TRIE_ENTRY *entryPtr = entries;
+	int entriesLeft = noEntries, childIndex;
+
+	/* If an OID ends at this node, record it.  Since the entries are
+	   sorted, it'll be the first one */
+	if( depth > 0 && entries[ 0 ].oidInfo->oidLength - 2 == depth )
+		{
+		node->oidInfo = entries[ 0 ].oidInfo;
+		entryPtr++;
+		entriesLeft--;
+		}
+	if( depth > 0 && !( node->value & 0x80 ) )
+		{
+		if( node->oidInfo != NULL && node->oidInfo->description != NULL )
+			{
+			node->familyName = node->oidInfo->description;
+			node->familyNameLength = strlen( node->oidInfo->description );
+			}
+		else
+			getFamilyName( node, entries, noEntries );
+		}
+	if( entriesLeft <= 0 )
+		return( nextFree );
+
+	/* Allocate the children, one for each distinct byte value at this
+	   depth */
+	node->firstChild = nextFree;
+	for( childIndex = 0; childIndex < entriesLeft; childIndex++ )
+		{
+		if( childIndex == 0 || entryPtr[ childIndex ].oidInfo->oid[ 2 + depth ] != \
+							   entryPtr[ childIndex - 1 ].oidInfo->oid[ 2 + depth ] )
+			node->noChildren++;
+		}
+	nextFree += node->noChildren;
+
+	/* Build each child */
+	for( childIndex = 0; childIndex < oidTrie[ nodeIndex ].noChildren; childIndex++ )
+		{
+		const int childNode = oidTrie[ nodeIndex ].firstChild + childIndex;
+		const BYTE value = entryPtr[ 0 ].oidInfo->oid[ 2 + depth ];
+		int count;
+
+		for( count = 1; count < entriesLeft && \
+						entryPtr[ count ].oidInfo->oid[ 2 + depth ] == value;
+			 count++ );
+		oidTrie[ childNode ].value = value;
+		nextFree = buildTrieNode( childNode, entryPtr, count, depth + 1,
+								  nextFree );
+		entryPtr += count;
+		entriesLeft -= count;
+		}
+
+	return( nextFree );
+	}
+
+/* Build the OID trie from the config data.  OIDs from config files take
+   precedence over compiled-in ones, and earlier entries over later ones */
+
+static void freeOIDtrie( void )
+	{
+	if( oidTrie != NULL )
+		free( oidTrie );
+	oidTrie = NULL;
+	oidTrieSize = 0;
+	}
+
+static int buildOIDtrie( void )
+	{
+	OID_TRIE_ENTRY *entries;
+	const OIDINFO *oidPtr;
+	int noEntries = 0, maxNodes = 1, i, j;
+
+	freeOIDtrie();
+	for( oidPtr = oidList; oidPtr != NULL; oidPtr = oidPtr->next )
+		{
+		noEntries++;
+		maxNodes += oidPtr->oidLength - 2;
+		}
+#ifdef BUILTIN_OIDS
+	noEntries += BUILTIN_OID_COUNT;
+	for( i = 0; i < BUILTIN_OID_COUNT; i++ )
+		maxNodes += builtinOIDs[ i ].oidLength - 2;
+#endif /* BUILTIN_OIDS */
+	if( noEntries <= 0 )
+		return( TRUE );
+	if( ( entries = ( OID_TRIE_ENTRY * ) \
+					malloc( noEntries * sizeof( OID_TRIE_ENTRY ) ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return( FALSE );
+		}
+	if( ( oidTrie = ( OID_TRIE_NODE * ) \
+					calloc( maxNodes, sizeof( OID_TRIE_NODE ) ) ) == NULL )
+		{
+		free( entries );
+		puts( "Out of memory." );
+		return( FALSE );
+		}
+
+	/* Sort the OIDs and remove duplicates, keeping the one that takes
+	   precedence */
+	i = 0;
+	for( oidPtr = oidList; oidPtr != NULL; oidPtr = oidPtr->next, i++ )
+		{
+		entries[ i ].oidInfo = oidPtr;
+		entries[ i ].order = i;
+		}
+#ifdef BUILTIN_OIDS
+	for( j = 0; j < BUILTIN_OID_COUNT; j++, i++ )
+		{
+		entries[ i ].oidInfo = &builtinOIDs[ j ];
+		entries[ i ].order = i;
+		}
+#endif /* BUILTIN_OIDS */
+	qsort( entries, noEntries, sizeof( OID_TRIE_ENTRY ), compareTrieEntries );
+	for( i = 1, j = 1; i < noEntries; i++ )
+		{
+		const OIDINFO *prevOidInfo = entries[ j - 1 ].oidInfo;
+
+		if( entries[ i ].oidInfo->oidLength == prevOidInfo->oidLength && \
+			!memcmp( entries[ i ].oidInfo->oid, prevOidInfo->oid,
+					 prevOidInfo->oidLength ) )
+			continue;
+		entries[ j++ ] = entries[ i ];
+		}
+	noEntries = j;
+
+	/* Build the trie */
+	oidTrieSize = buildTrieNode( 0, entries, noEntries, 0, 1 );
+	free( entries );
+
+	return( TRUE );
+	}
+
+/* Find the child of a trie node with the given value */
+
+static int findTrieChild( const OID_TRIE_NODE *node, const BYTE value )
+	{
+	int low = node->firstChild, high = node->firstChild + node->noChildren;
+
+	while( low < high )
+		{
+		const int mid = ( low + high ) / 2;
+
+		if( oidTrie[ mid ].value == value )
+			return( mid );
+		if( oidTrie[ mid ].value < value )
+			low = mid + 1;
+		else
+			high = mid;
+		}
+
+	return( -1 );
+	}
+
+/* Find the node with the longest known family name that's a proper prefix
+   of an OID, returning the length of the prefix */
+
+static const OID_TRIE_NODE *findOIDfamily( const BYTE *oid,
+										   const int oidLength,
+										   int *prefixLength )
+	{
+	const OID_TRIE_NODE *familyNode = NULL;
+	int nodeIndex = 0, i;
+
+	if( oidTrie == NULL )
+		return( NULL );
+	for( i = 0; i < oidLength - 1; i++ )
+		{
+		if( ( nodeIndex = findTrieChild( &oidTrie[ nodeIndex ],
+										 oid[ i ] ) ) < 0 )
+			break;
+		if( oidTrie[ nodeIndex ].familyName != NULL )
+			{
+			familyNode = &oidTrie[ nodeIndex ];
+			*prefixLength = i + 1;
+			}
+		}
+
+	return( familyNode );
+	}
+
 /* Return information on an object identifier */
 
-static OIDINFO *getOIDinfo( const BYTE *oid, const int oidLength )
+static const OIDINFO *getOIDinfo( const BYTE *oid, const int oidLength )
 	{
 	const BYTE oidByte = oid[ 1 ];
 	OIDINFO *oidPtr;
 
+	/* If the OIDs have been indexed, look it up in the index */
+	if( oidTrie != NULL )
+		{
+		int nodeIndex = 0, i;
+
+		for( i = 0; i < oidLength && nodeIndex >= 0; i++ )
+			nodeIndex = findTrieChild( &oidTrie[ nodeIndex ], oid[ i ] );
+		return( ( nodeIndex >= 0 ) ? oidTrie[ nodeIndex ].oidInfo : NULL );
+		}
+
 	for( oidPtr = oidList; oidPtr != NULL; oidPtr = oidPtr->next )
 		{
 		if( oidLength != oidPtr->oidLength - 2 )
@@ -546,8 +1092,11 @@ static OIDINFO *getOIDinfo( const BYTE *oid, const int oidLength )
 		if( !memcmp( oidPtr->oid + 2, oid, oidLength ) )
 			return( oidPtr );
 		}
-
+#ifdef BUILTIN_OIDS
+	return( getBuiltinOIDinfo( oid, oidLength ) );
+#else
 	return( NULL );
+#endif /* BUILTIN_OIDS */
 	}
 
 /* Add an OID attribute */
@@ -605,6 +1154,145 @@ static int isIA5( int ch )
 	return( TRUE );
 	}
 
+/* Check whether all of the characters in a block of text are IA5String
+   and PrintableString characters, returning the I and P flags that apply
+   to the whole block.  This allows long strings to be checked a block at a
+   time rather than a character at a time.  Since PrintableString is a
+   subset of IA5String, a character that isn't IA5 means that neither flag
+   can apply */
+
+#if defined( USE_SSE2 )
+
+#define SSE_IN_RANGE( chars, low, high ) \
+		_mm_and_si128( _mm_cmpgt_epi8( chars, _mm_set1_epi8( ( low ) - 1 ) ), \
+					   _mm_cmplt_epi8( chars, _mm_set1_epi8( ( high ) + 1 ) ) )
+#define SSE_EQUALS( chars, value ) \
+		_mm_cmpeq_epi8( chars, _mm_set1_epi8( value ) )
+
+/* Get a mask of the IA5 and PrintableString characters in a block of 16
+   characters.  Since the comparisons are signed, characters above 0x7F
+   are negative and fall outside all of the ranges */
+
+static __m128i getIA5chars( const __m128i chars )
+	{
+	return( SSE_IN_RANGE( chars, 0x20, 0x7E ) );
+	}
+
+static __m128i getPrintableChars( const __m128i chars )
+	{
+	__m128i isPrintable;
+
+	isPrintable = _mm_or_si128( SSE_IN_RANGE( chars, 'A', 'Z' ),
+								SSE_IN_RANGE( chars, 'a', 'z' ) );
+	isPrintable = _mm_or_si128( isPrintable,
+								SSE_IN_RANGE( chars, '+', ':' ) );
+	isPrintable = _mm_or_si128( isPrintable,
+								SSE_IN_RANGE( chars, '\'', ')' ) );
+	isPrintable = _mm_or_si128( isPrintable, SSE_EQUALS( chars, ' ' ) );
+	isPrintable = _mm_or_si128( isPrintable, SSE_EQUALS( chars, '=' ) );
+	return( _mm_or_si128( isPrintable, SSE_EQUALS( chars, '?' ) ) );
+	}
+#elif defined( USE_NEON )
+
+#define NEON_IN_RANGE( chars, low, high ) \
+		vandq_u8( vcgeq_u8( chars, vdupq_n_u8( low ) ), \
+				  vcleq_u8( chars, vdupq_n_u8( high ) ) )
+#define NEON_EQUALS( chars, value ) \
+		vceqq_u8( chars, vdupq_n_u8( value ) )
+
+static uint8x16_t getIA5chars( const uint8x16_t chars )
+	{
+	return( NEON_IN_RANGE( chars, 0x20, 0x7E ) );
+	}
+
+static uint8x16_t getPrintableChars( const uint8x16_t chars )
+	{
+	uint8x16_t isPrintable;
+
+	isPrintable = vorrq_u8( NEON_IN_RANGE( chars, 'A', 'Z' ),
+							NEON_IN_RANGE( chars, 'a', 'z' ) );
+	isPrintable = vorrq_u8( isPrintable, NEON_IN_RANGE( chars, '+', ':' ) );
+	isPrintable = vorrq_u8( isPrintable, NEON_IN_RANGE( chars, '\'', ')' ) );
+	isPrintable = vorrq_u8( isPrintable, NEON_EQUALS( chars, ' ' ) );
+	isPrintable = vorrq_u8( isPrintable, NEON_EQUALS( chars, '=' ) );
+	return( vorrq_u8( isPrintable, NEON_EQUALS( chars, '?' ) ) );
+	}
+#endif /* SIMD-specific character classification */
+
+static int classifyText( const BYTE *data, const int length )
+	{
+	int flags = PI, i = 0;
+#if defined( USE_SSE2 )
+	__m128i allPrintable = _mm_set1_epi8( -1 );
+
+	for( i = 0; i + 16 <= length; i += 16 )
+		{
+		const __m128i chars = \
+				_mm_loadu_si128( ( const __m128i * ) ( data + i ) );
+
+		if( _mm_movemask_epi8( getIA5chars( chars ) ) != 0xFFFF )
+			return( 0 );
+		allPrintable = _mm_and_si128( allPrintable,
+									  getPrintableChars( chars ) );
+		}
+	if( _mm_movemask_epi8( allPrintable ) != 0xFFFF )
+		flags = I;
+#elif defined( USE_NEON )
+	uint8x16_t allPrintable = vdupq_n_u8( 0xFF );
+
+	for( i = 0; i + 16 <= length; i += 16 )
+		{
+		const uint8x16_t chars = vld1q_u8( data + i );
+
+		if( vminvq_u8( getIA5chars( chars ) ) == 0 )
+			return( 0 );
+		allPrintable = vandq_u8( allPrintable, getPrintableChars( chars ) );
+		}
+	if( vminvq_u8( allPrintable ) == 0 )
+		flags = I;
+#endif /* SIMD-specific character classification */
+
+	for( ; i < length && flags; i++ )
+		{
+		const int ch = data[ i ];
+
+		flags &= ( ch < 128 ) ? charFlags[ ch ] : 0;
+		}
+
+	return( flags );
+	}
+
+/* Get bitmasks of the positions of the zero bytes and the IA5 characters
+   in a sample of up to 16 bytes of text */
+
+static void getTextMasks( const BYTE *data, const int length,
+						  int *zeroMask, int *ia5Mask )
+	{
+	const int validMask = ( 1 << length ) - 1;
+#if defined( USE_SSE2 )
+	BYTE buffer[ 16 ];
+	__m128i chars;
+
+	memset( buffer, 0, 16 );
+	memcpy( buffer, data, length );
+	chars = _mm_loadu_si128( ( const __m128i * ) buffer );
+	*zeroMask = _mm_movemask_epi8( _mm_cmpeq_epi8( chars,
+										_mm_setzero_si128() ) ) & validMask;
+	*ia5Mask = _mm_movemask_epi8( getIA5chars( chars ) ) & validMask;
+#else
+	int i;
+
+	*zeroMask = *ia5Mask = 0;
+	for( i = 0; i < length; i++ )
+		{
+		if( !data[ i ] )
+			*zeroMask |= 1 << i;
+		if( isIA5( data[ i ] ) )
+			*ia5Mask |= 1 << i;
+		}
+#endif /* USE_SSE2 */
+	}
+
 /****************************************************************************
 *																			*
 *							Config File Read Routines						*
@@ -1056,6 +1744,13 @@ static int readGlobalConfig( const char *path )
 #endif /* __WIN32__ */
 	int i;
 
+#ifdef BUILTIN_OIDS
+	/* If the OID information is compiled in, we only need the config file
+	   if we're working with the compiled-in table */
+	if( oidTableMode == OIDTABLE_NONE )
+		return( TRUE );
+#endif /* BUILTIN_OIDS */
+
 	/* First, try and find the config file in the same directory as the
 	   executable by walking down the path until we find the last occurrence
 	   of the program name.  This requires that argv[0] be set up properly,
@@ -1158,6 +1853,8 @@ static void freeConfig( void )
 	{
 	OIDINFO *oidPtr = oidList;
 
+	freeOIDtrie();
+
 	while( oidPtr != NULL )
 		{
 		OIDINFO *oidCursor = oidPtr;
@@ -1173,69 +1870,712 @@ static void freeConfig( void )
 
 /****************************************************************************
 *																			*
-*							Output/Formatting Routines						*
+*							OID Table Generation Routines					*
 *																			*
 ****************************************************************************/
 
-#ifdef __OS390__
+/* Write a string as a C string literal, escaping anything that isn't a
+   plain printable character.  Question marks are escaped to avoid
+   accidental trigraphs */
 
-static int asciiToEbcdic( const int ch )
+static void writeCString( FILE *outFile, const char *string )
 	{
-	char convBuffer[ 2 ];
+	if( string == NULL )
+		{
+		fputs( "NULL", outFile );
+		return;
+		}
+	putc( '"', outFile );
+	while( *string )
+		{
+		const int ch = byteToInt( *string++ );
 
-	convBuffer[ 0 ] = ch;
-	convBuffer[ 1 ] = '\0';
-	__atoe( convBuffer ); /* Convert ASCII to EBCDIC for 390 */
-	return( convBuffer[ 0 ] );
+		if( ch == '"' || ch == '\\' || ch == '?' )
+			fprintf( outFile, "\\%c", ch );
+		else
+			{
+			if( ch < 0x20 || ch >= 0x7F )
+				fprintf( outFile, "\\%03o", ch );
+			else
+				putc( ch, outFile );
+			}
+		}
+	putc( '"', outFile );
 	}
-#endif /* __OS390__ */
 
-/* Output formatted text */
+/* Get the list of unique OIDs from the config data.  Where an OID appears
+   more than once, the first entry is the one that getOIDinfo() finds, so
+   that's the one that we use */
 
-static int printString( const int level, const char *format, ... )
+static const OIDINFO **getUniqueOIDs( int *noOIDs )
 	{
-	va_list argPtr;
-	int length;
+	const OIDINFO **oidTable, *oidPtr;
+	int count = 0, i;
 
-	if( level >= maxNestLevel )
-		return( 0 );
-	va_start( argPtr, format );
-	length = vfprintf( output, format, argPtr );
-	va_end( argPtr );
+	for( oidPtr = oidList; oidPtr != NULL; oidPtr = oidPtr->next )
+		count++;
+	if( ( oidTable = ( const OIDINFO ** ) \
+					 malloc( ( count + 1 ) * sizeof( OIDINFO * ) ) ) == NULL )
+		return( NULL );
+	count = 0;
+	for( oidPtr = oidList; oidPtr != NULL; oidPtr = oidPtr->next )
+		{
+		for( i = 0; i < count; i++ )
+			{
+			if( oidTable[ i ]->oidLength == oidPtr->oidLength && \
+				!memcmp( oidTable[ i ]->oid, oidPtr->oid, oidPtr->oidLength ) )
+				break;
+			}
+		if( i >= count )
+			oidTable[ count++ ] = oidPtr;
+		}
+	*noOIDs = count;
 
-	return( length );
+	return( oidTable );
 	}
 
-/* Indent a string by the appropriate amount */
+/* Write the OID information from the config data as a C table with a
+   perfect-hash index.  The OIDs are first distributed into buckets of
+   around three OIDs each, then for each bucket, largest first, we look for
+   a hash seed that maps every OID in the bucket to a free slot in the
+   index */
 
-static void doIndent( const int level )
+static int makeOIDtable( FILE *outFile )
 	{
-	int i;
+	const OIDINFO **oidTable;
+	UINT32 *seeds;
+	int *bucketOf, *bucketOrder, *slots;
+	int noOIDs, noBuckets, noSlots, i, j, status = TRUE;
 
-	if( level >= maxNestLevel )
-		return;
-	for( i = 0; i < level; i++ )
+	if( ( oidTable = getUniqueOIDs( &noOIDs ) ) == NULL )
 		{
-		fprintf( output, printDots ? ". " : \
-						 shallowIndent ? " " : "  " );
+		puts( "Out of memory." );
+		return( FALSE );
 		}
-	}
-
-/* Complain about an error in the ASN.1 object */
-
-static void complain( const char *message, const int messageParam,
-					  const int level )
-	{
-	if( level < maxNestLevel )
+	if( noOIDs <= 0 )
 		{
-		if( !doPure )
-			fprintf( output, "%s", INDENT_STRING );
+		puts( "No OIDs found in config file." );
+		free( oidTable );
+		return( FALSE );
+		}
+	noBuckets = ( noOIDs / 3 ) + 1;
+	for( noSlots = 16; noSlots < noOIDs + ( noOIDs / 2 ); noSlots <<= 1 );
+	seeds = ( UINT32 * ) calloc( noBuckets, sizeof( UINT32 ) );
+	bucketOf = ( int * ) malloc( noOIDs * sizeof( int ) );
+	bucketOrder = ( int * ) calloc( noBuckets, sizeof( int ) );
+	slots = ( int * ) malloc( noSlots * sizeof( int ) );
+	if( seeds == NULL || bucketOf == NULL || bucketOrder == NULL || \
+		slots == NULL )
+		{
+		puts( "Out of memory." );
+		status = FALSE;
+		goto exit;
+		}
+	for( i = 0; i < noSlots; i++ )
+		slots[ i ] = -1;
+
+	/* Distribute the OIDs into buckets and sort the buckets by size, using
+	   the seeds array to temporarily hold the bucket sizes */
+	for( i = 0; i < noOIDs; i++ )
+		{
+		bucketOf[ i ] = ( int ) ( hashOID( oidTable[ i ]->oid + 2,
+										   oidTable[ i ]->oidLength - 2,
+										   0 ) % noBuckets );
+		seeds[ bucketOf[ i ] ]++;
+		}
+	for( i = 0; i < noBuckets; i++ )
+		{
+		const UINT32 bucketSize = seeds[ i ];
+
+		for( j = i; j > 0 && seeds[ bucketOrder[ j - 1 ] ] < bucketSize; j-- )
+			bucketOrder[ j ] = bucketOrder[ j - 1 ];
+		bucketOrder[ j ] = i;
+		}
+
+	/* Find a seed for each bucket that places all of its OIDs in free
+	   slots */
+	for( i = 0; i < noBuckets && status; i++ )
+		{
+		const int bucket = bucketOrder[ i ];
+		UINT32 seed;
+
+		if( seeds[ bucket ] == 0 )
+			break;	/* Only empty buckets left */
+		for( seed = 1; seed < 0x100000UL; seed++ )
+			{
+			int k;
+
+			/* Place each OID in the bucket, backing out if there's a
+			   collision */
+			for( j = 0; j < noOIDs; j++ )
+				{
+				int slot;
+
+				if( bucketOf[ j ] != bucket )
+					continue;
+				slot = ( int ) ( hashOID( oidTable[ j ]->oid + 2,
+										  oidTable[ j ]->oidLength - 2,
+										  seed ) % noSlots );
+				if( slots[ slot ] >= 0 )
+					break;
+				slots[ slot ] = j;
+				}
+			if( j >= noOIDs )
+				break;
+			for( k = 0; k < j; k++ )
+				{
+				if( bucketOf[ k ] == bucket )
+					{
+					slots[ hashOID( oidTable[ k ]->oid + 2,
+									oidTable[ k ]->oidLength - 2,
+									seed ) % noSlots ] = -1;
+					}
+				}
+			}
+		if( seed >= 0x100000UL )
+			{
+			puts( "Couldn't find a perfect hash for the OID table." );
+			status = FALSE;
+			}
+		seeds[ bucket ] = seed;
+		}
+	for( ; i < noBuckets && status; i++ )
+		seeds[ bucketOrder[ i ] ] = 0;
+	if( !status )
+		goto exit;
+
+	/* Write the table */
+	fputs( "/* OID table generated from the dumpasn1 config file by "
+		   "'dumpasn1 --make-oid-table',\n   do not edit */\n\n", outFile );
+	fprintf( outFile, "#define BUILTIN_OID_COUNT\t%d\n", noOIDs );
+	fprintf( outFile, "#define BUILTIN_OID_BUCKETS\t%d\n", noBuckets );
+	fprintf( outFile, "#define BUILTIN_OID_SLOTS\t%d\n\n", noSlots );
+	fputs( "static const OIDINFO builtinOIDs[ BUILTIN_OID_COUNT ] = {\n",
+		   outFile );
+	for( i = 0; i < noOIDs; i++ )
+		{
+		const OIDINFO *oidPtr = oidTable[ i ];
+
+		fputs( "\t{ NULL, { ", outFile );
+		for( j = 0; j < oidPtr->oidLength; j++ )
+			fprintf( outFile, ( j > 0 ) ? ", 0x%02X" : "0x%02X", oidPtr->oid[ j ] );
+		fprintf( outFile, " }, %d,\n\t  ", oidPtr->oidLength );
+		writeCString( outFile, oidPtr->comment );
+		fputs( ",\n\t  ", outFile );
+		writeCString( outFile, oidPtr->description );
+		fprintf( outFile, ", %d }%s\n", oidPtr->warn ? 1 : 0,
+				 ( i < noOIDs - 1 ) ? "," : "" );
+		}
+	fputs( "\t};\n\n", outFile );
+	fputs( "static const UINT32 builtinOIDseeds[ BUILTIN_OID_BUCKETS ] = {",
+		   outFile );
+	for( i = 0; i < noBuckets; i++ )
+		{
+		fprintf( outFile, "%s%s%luUL", ( i > 0 ) ? "," : "",
+				 ( i % 8 ) ? " " : "\n\t", ( unsigned long ) seeds[ i ] );
+		}
+	fputs( "\n\t};\n\n", outFile );
+	fputs( "static const short builtinOIDslots[ BUILTIN_OID_SLOTS ] = {",
+		   outFile );
+	for( i = 0; i < noSlots; i++ )
+		{
+		fprintf( outFile, "%s%s%d", ( i > 0 ) ? "," : "",
+				 ( i % 12 ) ? " " : "\n\t", slots[ i ] );
+		}
+	fputs( "\n\t};\n", outFile );
+
+exit:
+	free( oidTable );
+	if( seeds != NULL )
+		free( seeds );
+	if( bucketOf != NULL )
+		free( bucketOf );
+	if( bucketOrder != NULL )
+		free( bucketOrder );
+	if( slots != NULL )
+		free( slots );
+	return( status );
+	}
+
+#ifdef BUILTIN_OIDS
+
+/* Check that the compiled-in OID table matches the config data entry for
+   entry */
+
+static int checkOIDtable( void )
+	{
+	const OIDINFO **oidTable;
+	int noOIDs, noMismatches = 0, i;
+
+	if( ( oidTable = getUniqueOIDs( &noOIDs ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return( FALSE );
+		}
+	if( noOIDs != BUILTIN_OID_COUNT )
+		{
+		printf( "Config file contains %d OIDs, compiled-in table contains "
+				"%d.\n", noOIDs, BUILTIN_OID_COUNT );
+		noMismatches++;
+		}
+	for( i = 0; i < noOIDs; i++ )
+		{
+		const OIDINFO *oidPtr = oidTable[ i ];
+		const OIDINFO *builtinPtr = \
+				getBuiltinOIDinfo( oidPtr->oid + 2, oidPtr->oidLength - 2 );
+
+		if( builtinPtr == NULL || \
+			builtinPtr->warn != oidPtr->warn || \
+			( builtinPtr->comment == NULL ) != ( oidPtr->comment == NULL ) || \
+			( oidPtr->comment != NULL && \
+			  strcmp( builtinPtr->comment, oidPtr->comment ) ) || \
+			strcmp( builtinPtr->description, oidPtr->description ) )
+			{
+			printf( "Compiled-in table entry for '%s' doesn't match config "
+					"file.\n", oidPtr->description );
+			noMismatches++;
+			}
+		}
+	free( oidTable );
+	if( noMismatches )
+		return( FALSE );
+	printf( "Compiled-in OID table matches config file, %d entries.\n",
+			noOIDs );
+
+	return( TRUE );
+	}
+#endif /* BUILTIN_OIDS */
+
+/****************************************************************************
+*																			*
+*							Output/Formatting Routines						*
+*																			*
+****************************************************************************/
+
+#ifdef __OS390__
+
+static int asciiToEbcdic( const int ch )
+	{
+	char convBuffer[ 2 ];
+
+	convBuffer[ 0 ] = ch;
+	convBuffer[ 1 ] = '\0';
+	__atoe( convBuffer ); /* Convert ASCII to EBCDIC for 390 */
+	return( convBuffer[ 0 ] );
+	}
+#endif /* __OS390__ */
+
+/* Output formatted text */
+
+static int printString( const int level, const char *format, ... )
+	{
+	va_list argPtr;
+	int length;
+
+	if( level >= maxNestLevel )
+		return( 0 );
+	va_start( argPtr, format );
+	length = vfprintf( output, format, argPtr );
+	va_end( argPtr );
+
+	return( length );
+	}
+
+/* Print the blank informational column to the left of the displayed
+   data */
+
+static void printInfoIndent( const int level )
+	{
+	if( level >= maxNestLevel )
+		return;
+	fputs( INDENT_STRING, output );
+	}
+
+/* Print the offset and length in the informational column, right-aligned
+   to the column width.  This is called for every item, so we format the
+   values ourselves rather than going through fprintf() */
+
+static char *formatInfoValue( char *buffer, const long value,
+							  const int isHex, const char padChar )
+	{
+	char digits[ 32 ];
+	unsigned long uValue = ( unsigned long ) value;
+	int noDigits = 0, i;
+
+	if( !isHex && value < 0 )
+		uValue = -uValue;
+	do
+		{
+		digits[ noDigits++ ] = isHex ? "0123456789ABCDEF"[ uValue & 0x0F ] : \
+									   ( char ) ( '0' + uValue % 10 );
+		uValue = isHex ? uValue >> 4 : uValue / 10;
+		}
+	while( uValue > 0 );
+	if( !isHex && value < 0 )
+		digits[ noDigits++ ] = '-';
+	for( i = noDigits; i < infoWidth; i++ )
+		*buffer++ = padChar;
+	while( noDigits > 0 )
+		*buffer++ = digits[ --noDigits ];
+
+	return( buffer );
+	}
+
+static void printInfoColumn( const int level, const long offset,
+							 const long length, const int isIndefinite )
+	{
+	char buffer[ 80 ], *bufPtr;
+
+	if( level >= maxNestLevel )
+		return;
+	bufPtr = formatInfoValue( buffer, offset, doHexValues,
+							  doHexValues ? '0' : ' ' );
+	*bufPtr++ = ' ';
+	if( isIndefinite )
+		{
+		strcpy( bufPtr, LEN_INDEF );
+		bufPtr += strlen( bufPtr );
+		}
+	else
+		bufPtr = formatInfoValue( bufPtr, length, doHexValues, ' ' );
+	*bufPtr++ = ':';
+	*bufPtr++ = ' ';
+	fwrite( buffer, 1, bufPtr - buffer, output );
+	}
+
+/* Indent a string by the appropriate amount */
+
+static void doIndent( const int level )
+	{
+	const char *indentString = printDots ? indentDotsString : \
+											indentSpacesString;
+	int length;
+
+	if( level >= maxNestLevel )
+		return;
+	length = ( printDots || !shallowIndent ) ? level * 2 : level;
+	if( length <= 0 )
+		return;
+	while( length > INDENT_MAX_SIZE )
+		{
+		fwrite( indentString, 1, INDENT_MAX_SIZE, output );
+		length -= INDENT_MAX_SIZE;
+		}
+	fwrite( indentString, 1, length, output );
+	}
+
+/* Encapsulated data in an OCTET STRING or BIT STRING is decoded
+   speculatively rather than being probed and then re-read.  The output is
+   written to a checkpoint buffer until the first encapsulated item (or for
+   an indefinite-length SEQUENCE, the first item inside it) has been read
+   and checked against the heuristics in checkEncapsulate().  If it passes,
+   the buffered output is committed and decoding continues without going
+   back over the data, and if it fails we roll back to the checkpoint and
+   display the contents as a string or hex dump.  The checkpoint buffer is
+   a memory stream that's kept open and reused for each speculative
+   decode */
+
+#ifdef USE_THREADS
+
+typedef struct {
+	int level;					/* Level of first item, -1 = none */
+	long length;				/* Length of encapsulating item */
+	int checkNested;			/* Checking item inside indef.SEQUENCE */
+	FILE *savedOutput;			/* Output stream to restore */
+	FILE *stream;				/* Checkpoint buffer stream */
+	char *buffer;				/* Checkpoint buffer */
+	size_t bufSize;
+	} ENCAPS_STATE;
+
+static THREAD_LOCAL ENCAPS_STATE encapsState = \
+				{ -1, 0, FALSE, NULL, NULL, NULL, 0 };
+static THREAD_LOCAL jmp_buf encapsRollback;	/* Return point if check fails */
+
+/* Write the output from a successful speculative decode, and switch back
+   to the real output */
+
+static void commitEncapsulated( void )
+	{
+	fflush( encapsState.stream );
+	output = encapsState.savedOutput;
+	fwrite( encapsState.buffer, 1, encapsState.bufSize, output );
+	encapsState.level = -1;
+	}
+
+/* Free the checkpoint buffer when a thread exits */
+
+static void freeEncapsulated( void )
+	{
+	if( encapsState.stream == NULL )
+		return;
+	fclose( encapsState.stream );
+	free( encapsState.buffer );
+	encapsState.stream = NULL;
+	}
+#endif /* USE_THREADS */
+
+/* Bail out of a parallel decode or a server request on a fatal error.
+   Since the output from a worker thread is buffered, we can't report the
+   error from there but have to return to the caller and let it redo the
+   decode serially, which reports the problem at the correct location in the
+   output.  For a server request, the caller reports the error to the
+   client */
+
+static void abortWorker( void )
+	{
+#ifdef USE_THREADS
+	if( encapsState.level >= 0 )
+		commitEncapsulated();
+	if( workerAbort != NULL )
+		longjmp( *workerAbort, 1 );
+#endif /* USE_THREADS */
+	}
+
+/* Errors and warnings are also recorded as data for use when checking
+   large numbers of files.  Each one is identified by a code that's passed
+   in by the caller along with the message, and is recorded at the start
+   of the item that it applies to.  The most recent DIAG_RING_SIZE
+   diagnostics are kept in a preallocated ring buffer, and if there's an
+   error budget set then decoding stops as soon as it's exceeded */
+
+typedef enum {
+	DIAG_OTHER,					/* Unrecognised message */
+	DIAG_EOF,					/* Unexpected EOF */
+	DIAG_LENGTH,				/* Invalid length for type */
+	DIAG_LENGTH_NONCANONICAL,	/* Non-canonical length encoding */
+	DIAG_LENGTH_INCONSISTENT,	/* Contents don't match length */
+	DIAG_LENGTH_BAD,			/* Undecodable length (fatal) */
+	DIAG_ZERO_LENGTH,			/* Zero-length item */
+	DIAG_BOOLEAN_NONDER,		/* Non-DER BOOLEAN */
+	DIAG_INTEGER_NONDER,		/* Non-DER INTEGER */
+	DIAG_INTEGER_NEGATIVE,		/* INTEGER encoded as negative value */
+	DIAG_BITSTRING_UNUSED,		/* Invalid unused-bits count */
+	DIAG_BITSTRING_EMPTY,		/* Empty BIT STRING with unused bits */
+	DIAG_BITSTRING_ZERO_BITS,	/* Spurious zero bits */
+	DIAG_BITSTRING_ONE_BITS,	/* Spurious one bits */
+	DIAG_BITSTRING_TRUNCATED,	/* Truncated BIT STRING */
+	DIAG_OID_INVALID,			/* Invalid OID data */
+	DIAG_OID_ENCODING,			/* Invalid OID encoding */
+	DIAG_OID_GARBAGE,			/* OID contains garbage */
+	DIAG_OID_LENGTH,			/* OID too long (fatal) */
+	DIAG_OID_DEPRECATED,		/* OID marked as problematic in config */
+	DIAG_PRINTABLESTRING,		/* Invalid PrintableString chars */
+	DIAG_IA5STRING,				/* Invalid IA5String chars */
+	DIAG_BMPSTRING,				/* Odd-length BMPString */
+	DIAG_TIME,					/* Invalid time encoding */
+	DIAG_TIME_T,				/* Time outside 32-bit time_t range */
+	DIAG_TIME_RANGE,			/* Implausible time value */
+	DIAG_SEQUENCE_PRIMITIVE,	/* Primitive SEQUENCE */
+	DIAG_SET_PRIMITIVE,			/* Primitive SET */
+	DIAG_UNKNOWN_PRIMITIVE,		/* Unrecognised primitive */
+	DIAG_SPURIOUS_EOC,			/* EOC in definite-length item */
+	DIAG_SKIPPED_DATA,			/* Invalid data in skipped items */
+	DIAG_NESTING,				/* Excessive nesting (fatal) */
+	DIAG_INVALID_DATA,			/* Non-ASN.1 data (fatal) */
+	DIAG_BASE64,				/* Base64-encoded input (fatal) */
+	DIAG_TRAILING_DATA,			/* Data following the object */
+	DIAG_LAST					/* Last possible diagnostic code */
+	} DIAG_CODE;
+
+typedef enum {
+	DIAG_STOP_NONE,				/* Decoding wasn't stopped */
+	DIAG_STOP_MAX_ERRORS,		/* Error budget was exceeded */
+	DIAG_STOP_FATAL				/* Fatal error in data */
+	} DIAG_STOP;
+
+typedef struct {
+	DIAG_CODE code;				/* Diagnostic code */
+	const char *name;			/* Name for JSON output */
+	} DIAG_INFO;
+
+static const DIAG_INFO diagInfo[] = {
+	{ DIAG_OTHER, "other" },
+	{ DIAG_EOF, "unexpected-eof" },
+	{ DIAG_LENGTH, "invalid-length" },
+	{ DIAG_LENGTH_NONCANONICAL, "non-canonical-length" },
+	{ DIAG_LENGTH_INCONSISTENT, "inconsistent-length" },
+	{ DIAG_LENGTH_BAD, "bad-length" },
+	{ DIAG_ZERO_LENGTH, "zero-length" },
+	{ DIAG_BOOLEAN_NONDER, "non-der-boolean" },
+	{ DIAG_INTEGER_NONDER, "non-der-integer" },
+	{ DIAG_INTEGER_NEGATIVE, "negative-integer" },
+	{ DIAG_BITSTRING_UNUSED, "invalid-unused-bits" },
+	{ DIAG_BITSTRING_EMPTY, "empty-bitstring-unused-bits" },
+	{ DIAG_BITSTRING_ZERO_BITS, "spurious-zero-bits" },
+	{ DIAG_BITSTRING_ONE_BITS, "spurious-one-bits" },
+	{ DIAG_BITSTRING_TRUNCATED, "truncated-bitstring" },
+	{ DIAG_OID_INVALID, "invalid-oid" },
+	{ DIAG_OID_ENCODING, "invalid-oid-encoding" },
+	{ DIAG_OID_GARBAGE, "oid-garbage" },
+	{ DIAG_OID_LENGTH, "oid-too-long" },
+	{ DIAG_OID_DEPRECATED, "oid-warning" },
+	{ DIAG_PRINTABLESTRING, "invalid-printablestring" },
+	{ DIAG_IA5STRING, "invalid-ia5string" },
+	{ DIAG_BMPSTRING, "odd-length-bmpstring" },
+	{ DIAG_TIME, "invalid-time" },
+	{ DIAG_TIME_T, "time-t-range" },
+	{ DIAG_TIME_RANGE, "implausible-time" },
+	{ DIAG_SEQUENCE_PRIMITIVE, "primitive-sequence" },
+	{ DIAG_SET_PRIMITIVE, "primitive-set" },
+	{ DIAG_UNKNOWN_PRIMITIVE, "unknown-primitive" },
+	{ DIAG_SPURIOUS_EOC, "spurious-eoc" },
+	{ DIAG_SKIPPED_DATA, "invalid-skipped-data" },
+	{ DIAG_NESTING, "excessive-nesting" },
+	{ DIAG_INVALID_DATA, "invalid-data" },
+	{ DIAG_BASE64, "base64-input" },
+	{ DIAG_TRAILING_DATA, "trailing-data" },
+	{ DIAG_LAST, NULL }
+	};
+
+#define DIAG_RING_SIZE		256
+
+typedef struct {
+	long offset;				/* Position in data */
+	int depth;					/* Nesting level, -1 if unknown */
+	DIAG_CODE code;				/* Diagnostic code */
+	long param;					/* Parameter for message */
+	int isError;				/* Whether it's an error or a warning */
+	} DIAGNOSTIC;
+
+/* The diagnostics are recorded per decoding thread, since speculative
+   decoding of encapsulated data in any thread rolls back the count */
+
+static THREAD_LOCAL DIAGNOSTIC diagRing[ DIAG_RING_SIZE ];
+static THREAD_LOCAL long diagCount = 0;	/* Total no.diagnostics recorded */
+static THREAD_LOCAL DIAG_STOP diagStopReason = DIAG_STOP_NONE;
+static THREAD_LOCAL long diagItemPos = 0;	/* Start of current item */
+static THREAD_LOCAL int recordDiagnostics = FALSE;	/* Record diagnostics */
+static THREAD_LOCAL jmp_buf *decodeAbort = NULL;	/* Early-exit point */
+
+static const char *getDiagName( const DIAG_CODE code )
+	{
+	int i;
+
+	for( i = 0; diagInfo[ i ].code != DIAG_LAST; i++ )
+		{
+		if( diagInfo[ i ].code == code )
+			return( diagInfo[ i ].name );
+		}
+
+	return( diagInfo[ 0 ].name );
+	}
+
+/* Stop decoding and return to the caller that set up the exit point, if
+   there is one */
+
+static void stopDecoding( const DIAG_STOP reason )
+	{
+#ifdef USE_THREADS
+	if( encapsState.level >= 0 )
+		commitEncapsulated();
+#endif /* USE_THREADS */
+	if( decodeAbort != NULL )
+		{
+		diagStopReason = reason;
+		longjmp( *decodeAbort, 1 );
+		}
+	}
+
+static void storeDiagnostic( const DIAG_CODE code, const long param,
+							 const int level, const int isError )
+	{
+	DIAGNOSTIC *diagnostic = &diagRing[ diagCount++ % DIAG_RING_SIZE ];
+
+	diagnostic->offset = diagItemPos;
+	diagnostic->depth = ( level < 1000 ) ? level : -1;
+	diagnostic->code = code;
+	diagnostic->param = param;
+	diagnostic->isError = isError;
+	}
+
+/* Record a diagnostic once it's been reported, stopping if we've gone over
+   the error budget */
+
+static void addDiagnostic( const DIAG_CODE code, const long param,
+						   const int level, const int isError )
+	{
+	if( !recordDiagnostics )
+		return;
+	storeDiagnostic( code, param, level, isError );
+#ifdef USE_THREADS
+	if( encapsState.level >= 0 )
+		return;
+#endif /* USE_THREADS */
+	if( isError && maxErrors >= 0 && noErrors > maxErrors )
+		stopDecoding( DIAG_STOP_MAX_ERRORS );
+	}
+
+/* Record a fatal error.  If we're reporting diagnostics as data then we
+   stop decoding, otherwise we return to the caller to report the error and
+   exit */
+
+static void fatalDiagnostic( const DIAG_CODE code, const long param,
+							 const int level )
+	{
+	if( !recordDiagnostics || !jsonDiagnostics )
+		return;
+	noErrors++;
+	storeDiagnostic( code, param, level, TRUE );
+	stopDecoding( DIAG_STOP_FATAL );
+	}
+
+/* Write the recorded diagnostics as a JSON object */
+
+static void writeJSONdiagnostics( FILE *outFile, const char *fileName )
+	{
+	const long first = ( diagCount > DIAG_RING_SIZE ) ? \
+					   diagCount - DIAG_RING_SIZE : 0;
+	long i;
+
+	fputs( "{\"file\":\"", outFile );
+	for( ; *fileName; fileName++ )
+		{
+		const int ch = byteToInt( *fileName );
+
+		if( ch < 0x20 )
+			fprintf( outFile, "\\u%04X", ch );
+		else
+			{
+			if( ch == '"' || ch == '\\' )
+				fputc( '\\', outFile );
+			fputc( ch, outFile );
+			}
+		}
+	fprintf( outFile, "\",\"errors\":%d,\"warnings\":%d,\"stopped\":%s,"
+			 "\"dropped\":%ld,\"diagnostics\":[", noErrors, noWarnings,
+			 ( diagStopReason == DIAG_STOP_MAX_ERRORS ) ? "\"max-errors\"" : \
+			 ( diagStopReason == DIAG_STOP_FATAL ) ? "\"fatal\"" : "null",
+			 first );
+	for( i = first; i < diagCount; i++ )
+		{
+		const DIAGNOSTIC *diagnostic = &diagRing[ i % DIAG_RING_SIZE ];
+
+		fprintf( outFile, "%s{\"offset\":%ld,\"depth\":%d,\"code\":\"%s\","
+				 "\"severity\":\"%s\",\"param\":%ld}",
+				 ( i > first ) ? "," : "", diagnostic->offset,
+				 diagnostic->depth, getDiagName( diagnostic->code ),
+				 diagnostic->isError ? "error" : "warning",
+				 diagnostic->param );
+		}
+	fputs( "]}\n", outFile );
+	}
+
+/* Complain about an error in the ASN.1 object */
+
+static void complain( const DIAG_CODE code, const char *message,
+					  const int messageParam, const int level )
+	{
+	if( level < maxNestLevel )
+		{
+		if( !doPure )
+			fputs( INDENT_STRING, output );
 		doIndent( level + 1 );
 		}
 	fputs( "Error: ", output );
 	fprintf( output, message, messageParam );
 	fputs( ".\n", output );
 	noErrors++;
+	addDiagnostic( code, messageParam, level, TRUE );
 	}
 
 static void complainLength( const ASN1_ITEM *item, const int level )
@@ -1247,13 +2587,14 @@ static void complainLength( const ASN1_ITEM *item, const int level )
 	if( level < maxNestLevel )
 		{
 		if( !doPure )
-			fprintf( output, "%s", INDENT_STRING );
+			fputs( INDENT_STRING, output );
 		doIndent( level + 1 );
 		}
 #endif /* 0 */
 	fprintf( output, "Error: %s has invalid length %ld.\n",
 			 idstr( item->tag ), item->length );
 	noErrors++;
+	addDiagnostic( DIAG_LENGTH, item->length, level, TRUE );
 	}
 
 static void complainLengthCanonical( const ASN1_ITEM *item, const int level )
@@ -1267,7 +2608,7 @@ static void complainLengthCanonical( const ASN1_ITEM *item, const int level )
 	if( level < maxNestLevel )
 		{
 		if( !doPure )
-			fprintf( output, "%s", INDENT_STRING );
+			fputs( INDENT_STRING, output );
 		doIndent( level + 1 );
 		}
 #endif /* 0 */
@@ -1280,6 +2621,7 @@ static void complainLengthCanonical( const ASN1_ITEM *item, const int level )
 		}
 	fputs( "' has non-canonical encoding.\n", output );
 	noErrors++;
+	addDiagnostic( DIAG_LENGTH_NONCANONICAL, item->length, level, TRUE );
 	}
 
 static void complainInt( const BYTE *intValue, const int level )
@@ -1287,37 +2629,40 @@ static void complainInt( const BYTE *intValue, const int level )
 	if( level < maxNestLevel )
 		{
 		if( !doPure )
-			fprintf( output, "%s", INDENT_STRING );
+			fputs( INDENT_STRING, output );
 		doIndent( level + 1 );
 		}
 	fprintf( output, "Error: Integer '%02X %02X ...' has non-DER encoding.\n",
 			 intValue[ 0 ], intValue[ 1 ] );
 	noErrors++;
+	addDiagnostic( DIAG_INTEGER_NONDER,
+				   ( intValue[ 0 ] << 8 ) | intValue[ 1 ], level, TRUE );
 	}
 
 static void complainEOF( const int level, const int missingBytes )
 	{
 	printString( level, "%c", '\n' );
-	complain( ( missingBytes > 1 ) ? \
+	complain( DIAG_EOF, ( missingBytes > 1 ) ? \
 				"Unexpected EOF, %d bytes missing" : \
 				"Unexpected EOF, 1 byte missing", missingBytes, level );
 	}
 
 /* Warn about a (non-error) issue in the ASN.1 object */
 
-static void warn( const char *message, const int messageParam,
-				  const int level )
+static void warn( const DIAG_CODE code, const char *message,
+				  const int messageParam, const int level )
 	{
 	if( level < maxNestLevel )
 		{
 		if( !doPure )
-			fprintf( output, "%s", INDENT_STRING );
+			fputs( INDENT_STRING, output );
 		doIndent( level + 1 );
 		}
 	fputs( "Warning: ", output );
 	fprintf( output, message, messageParam );
 	fputs( ".\n", output );
 	noWarnings++;
+	addDiagnostic( code, messageParam, level, FALSE );
 	}
 
 /* Adjust the nesting-level value to make sure that we don't go off the edge
@@ -1510,7 +2855,8 @@ static void printValue( FILE *inFile, const int valueLength,
 	if( warnNonDER )
 		complainInt( intBuffer, level );
 	if( warnNegative )
-		complain( "Integer is encoded as a negative value", 0, level );
+		complain( DIAG_INTEGER_NEGATIVE,
+				  "Integer is encoded as a negative value", 0, level );
 	}
 
 /* Dump data as a string of hex digits up to a maximum of 128 bytes */
@@ -1572,7 +2918,7 @@ static void dumpHex( FILE *inFile, long length, int level,
 					}
 				printString( level, "%c", '\n' );
 				if( !doPure )
-					printString( level, "%s", INDENT_STRING );
+					printInfoIndent( level );
 				doIndent( level + 1 );
 				}
 			}
@@ -1626,7 +2972,7 @@ static void dumpHex( FILE *inFile, long length, int level,
 		length -= 128;
 		printString( level, "%c", '\n' );
 		if( !doPure )
-			printString( level, "%s", INDENT_STRING );
+			printInfoIndent( level );
 		doIndent( level + 5 );
 		printString( level, "[ Another %ld bytes skipped ]", length );
 		fPos += length;
@@ -1646,7 +2992,12 @@ static void dumpHex( FILE *inFile, long length, int level,
 				}
 			}
 		else
-			fseek( inFile, length, SEEK_CUR );
+			{
+			/* A memory stream can't be positioned past the end of the
+			   data, so if the data is truncated we move to the end */
+			if( fseek( inFile, length, SEEK_CUR ) )
+				fseek( inFile, 0, SEEK_END );
+			}
 		}
 	printString( level, "%c", '\n' );
 
@@ -1655,7 +3006,8 @@ static void dumpHex( FILE *inFile, long length, int level,
 		if( warnPadding )
 			complainInt( intBuffer, level );
 		if( warnNegative )
-			complain( "Integer is encoded as a negative value", 0, level );
+			complain( DIAG_INTEGER_NEGATIVE,
+					  "Integer is encoded as a negative value", 0, level );
 		}
 	if( option == DUMPHEX_BITSTRING )
 		{
@@ -1668,45 +3020,406 @@ static void dumpHex( FILE *inFile, long length, int level,
 			!( lastCh & ( 1 << param ) ) )
 			{
 			/* The last valid bit should be a one bit */
-			complain( "Spurious zero bits in bitstring", 0, level );
+			complain( DIAG_BITSTRING_ZERO_BITS,
+					  "Spurious zero bits in bitstring", 0, level );
 			}
 		if( ( ( 0xFF >> ( 8 - param ) ) & lastCh ) )
 			{
 			/* There shouldn't be any bits set after the last valid one.  We
 			   have to do the noBits check to avoid a fencepost error when
 			   there's exactly 32 bits */
-			complain( "Spurious one bits in bitstring", 0, level );
+			complain( DIAG_BITSTRING_ONE_BITS,
+					  "Spurious one bits in bitstring", 0, level );
 			}
 		}
 	}
 
-/* Convert a binary OID to its string equivalent */
+/* Integers that are too large to fit into a long are normally displayed as
+   hex data, but can also be displayed in decimal.  Values of up to 128 bits,
+   which covers most certificate serial numbers, are converted directly if
+   the compiler provides a 128-bit type.  Anything larger is converted using
+   16-bit limbs held in UINT32s, so that products and two-limb quantities
+   always fit in 32 bits, with large values like RSA moduli being split at a
+   power of ten into a high and low part that are converted recursively so
+   that most of the work is done on small numbers */
 
-static int oidToString( char *textOID, int *textOIDlength,
-						const BYTE *oid, const int oidLength )
+#define DECIMAL_MAX_SIZE	1024	/* Max.integer size to show in decimal */
+#define DECIMAL_MAX_LIMBS	( ( DECIMAL_MAX_SIZE / 2 ) + 1 )
+#define DECIMAL_MAX_DIGITS	( ( DECIMAL_MAX_SIZE * 5 ) / 2 + 8 )
+#define DECIMAL_SPLIT_LIMBS	32		/* Size above which we split the value */
+#define DECIMAL_MAX_POWERS	12		/* Max.no.powers of ten for splitting */
+#define DECIMAL_LINE_LENGTH	48		/* Digits per line for long values */
+
+/* The powers of ten 10^(4 * 2^i) used to split values */
+
+typedef struct {
+	UINT32 value[ DECIMAL_MAX_LIMBS ];
+	int length;
+	} BN_POWER;
+
+/* Divide a value by a single-limb divisor, returning the remainder */
+
+static UINT32 bnDivideSmall( UINT32 *value, int *length,
+							 const UINT32 divisor )
 	{
-	BYTE uuidBuffer[ 32 ];
-	long value;
-	int length = 0, uuidBufPos = -1, uuidBitCount = 5, i;
-	int validEncoding = TRUE, isUUID = FALSE;
+	UINT32 remainder = 0;
+	int i;
 
-	for( i = 0, value = 0; i < oidLength; i++ )
+	for( i = *length - 1; i >= 0; i-- )
 		{
-		const BYTE data = oid[ i ];
-		const long valTmp = value << 7;
+		const UINT32 dividend = ( remainder << 16 ) | value[ i ];
 
-		/* Pick apart the encoding.  We keep going after hitting an encoding
-		   error at the start of an arc because the overall length is
-		   bounded and we may still be able to recover something worth
-		   printing */
-		if( length > 128 - 32 )
+		value[ i ] = dividend / divisor;
+		remainder = dividend % divisor;
+		}
+	while( *length > 0 && value[ *length - 1 ] == 0 )
+		( *length )--;
+
+	return( remainder );
+	}
+
+/* Multiply two values */
+
+static int bnMultiply( UINT32 *result, const UINT32 *a, const int aLength,
+					   const UINT32 *b, const int bLength )
+	{
+	int length = aLength + bLength, i, j;
+
+	memset( result, 0, length * sizeof( UINT32 ) );
+	for( i = 0; i < aLength; i++ )
+		{
+		UINT32 carry = 0;
+
+		for( j = 0; j < bLength; j++ )
 			{
-			/* Excessively long OID, add a continuation marker and exit */
-			length += sprintf( textOID + length, "..." );
-			validEncoding = FALSE;
-			break;
+			const UINT32 product = ( a[ i ] * b[ j ] ) + result[ i + j ] + carry;
+
+			result[ i + j ] = product & 0xFFFF;
+			carry = product >> 16;
 			}
-		if( value == 0 && data == 0x80 )
+		result[ i + bLength ] = carry;
+		}
+	while( length > 0 && result[ length - 1 ] == 0 )
+		length--;
+
+	return( length );
+	}
+
+/* Divide a value u by a multi-limb divisor v using Knuth's Algorithm D,
+   returning the quotient and remainder.  The divisor must be no longer
+   than the dividend and have a nonzero top limb */
+
+static void bnDivide( UINT32 *quotient, int *quotientLength,
+					  UINT32 *remainder, int *remainderLength,
+					  const UINT32 *u, const int m,
+					  const UINT32 *v, const int n )
+	{
+	UINT32 un[ DECIMAL_MAX_LIMBS + 1 ], vn[ DECIMAL_MAX_LIMBS ];
+	int shift, i, j;
+
+	/* Normalise the operands so that the top bit of the divisor is set,
+	   which ensures that the estimated quotient digit is at most two
+	   too large */
+	for( shift = 0; !( v[ n - 1 ] & ( 0x8000 >> shift ) ); shift++ );
+	for( i = n - 1; i > 0; i-- )
+		{
+		vn[ i ] = ( ( v[ i ] << shift ) | \
+					( v[ i - 1 ] >> ( 16 - shift ) ) ) & 0xFFFF;
+		}
+	vn[ 0 ] = ( v[ 0 ] << shift ) & 0xFFFF;
+	un[ m ] = u[ m - 1 ] >> ( 16 - shift );
+	for( i = m - 1; i > 0; i-- )
+		{
+		un[ i ] = ( ( u[ i ] << shift ) | \
+					( u[ i - 1 ] >> ( 16 - shift ) ) ) & 0xFFFF;
+		}
+	un[ 0 ] = ( u[ 0 ] << shift ) & 0xFFFF;
+
+	for( j = m - n; j >= 0; j-- )
+		{
+		const UINT32 dividend = ( un[ j + n ] << 16 ) | un[ j + n - 1 ];
+		UINT32 qHat = dividend / vn[ n - 1 ], rHat = dividend % vn[ n - 1 ];
+		UINT32 carry = 0, borrow = 0;
+
+		/* Estimate the quotient digit from the top limbs and correct the
+		   estimate if it's too large */
+		while( qHat > 0xFFFF || ( n > 1 && \
+			   qHat * vn[ n - 2 ] > ( ( rHat << 16 ) | un[ j + n - 2 ] ) ) )
+			{
+			qHat--;
+			rHat += vn[ n - 1 ];
+			if( rHat > 0xFFFF )
+				break;
+			}
+
+		/* Multiply and subtract */
+		for( i = 0; i <= n; i++ )
+			{
+			UINT32 product = carry;
+
+			if( i < n )
+				product += qHat * vn[ i ];
+			carry = product >> 16;
+			product = ( product & 0xFFFF ) + borrow;
+			borrow = ( un[ i + j ] < product ) ? 1 : 0;
+			un[ i + j ] = ( un[ i + j ] + ( borrow << 16 ) - product ) & 0xFFFF;
+			}
+		quotient[ j ] = qHat;
+
+		/* If the result was negative, the estimate was one too large so
+		   we add the divisor back */
+		if( borrow )
+			{
+			quotient[ j ]--;
+			carry = 0;
+			for( i = 0; i < n; i++ )
+				{
+				const UINT32 sum = un[ i + j ] + vn[ i ] + carry;
+
+				un[ i + j ] = sum & 0xFFFF;
+				carry = sum >> 16;
+				}
+			un[ j + n ] = ( un[ j + n ] + carry ) & 0xFFFF;
+			}
+		}
+
+	/* Denormalise the remainder */
+	for( i = 0; i < n - 1; i++ )
+		{
+		remainder[ i ] = ( ( un[ i ] >> shift ) | \
+						   ( un[ i + 1 ] << ( 16 - shift ) ) ) & 0xFFFF;
+		}
+	remainder[ n - 1 ] = un[ n - 1 ] >> shift;
+	for( *quotientLength = m - n + 1;
+		 *quotientLength > 0 && quotient[ *quotientLength - 1 ] == 0;
+		 ( *quotientLength )-- );
+	for( *remainderLength = n;
+		 *remainderLength > 0 && remainder[ *remainderLength - 1 ] == 0;
+		 ( *remainderLength )-- );
+	}
+
+/* Convert a value to exactly noDigits decimal digits, padded with leading
+   zeroes.  Small values are converted by repeated division by 10^4, larger
+   ones are split into value / 10^k and value % 10^k, which are converted
+   separately */
+
+static void bnToDecimal( char *digits, const int noDigits,
+						 const UINT32 *value, const int length,
+						 const BN_POWER *powers, int level )
+	{
+	UINT32 quotient[ DECIMAL_MAX_LIMBS ], remainder[ DECIMAL_MAX_LIMBS ];
+	int quotientLength, remainderLength, lowDigits;
+
+	if( length <= DECIMAL_SPLIT_LIMBS || level < 0 )
+		{
+		int i;
+
+		memcpy( quotient, value, length * sizeof( UINT32 ) );
+		quotientLength = length;
+		for( i = noDigits; i > 0; )
+			{
+			UINT32 chunk = ( quotientLength > 0 ) ? \
+				bnDivideSmall( quotient, &quotientLength, 10000 ) : 0;
+			int j;
+
+			for( j = 0; j < 4 && i > 0; j++ )
+				{
+				digits[ --i ] = '0' + ( int ) ( chunk % 10 );
+				chunk /= 10;
+				}
+			}
+		return;
+		}
+
+	/* Split the value at the largest power of ten that's about half its
+	   size */
+	while( level > 0 && powers[ level ].length * 2 > length + 1 )
+		level--;
+	bnDivide( quotient, &quotientLength, remainder, &remainderLength,
+			  value, length, powers[ level ].value, powers[ level ].length );
+	lowDigits = 4 << level;
+	bnToDecimal( digits + noDigits - lowDigits, lowDigits, remainder,
+				 remainderLength, powers, level - 1 );
+	bnToDecimal( digits, noDigits - lowDigits, quotient, quotientLength,
+				 powers, level );
+	}
+
+/* Convert a big-endian unsigned value to a decimal string, returning the
+   number of digits */
+
+static int bignumToString( char *string, const BYTE *data, int length )
+	{
+	BN_POWER powers[ DECIMAL_MAX_POWERS ];
+	UINT32 value[ DECIMAL_MAX_LIMBS ];
+	int valueLength = 0, noDigits, noPowers, i;
+
+	while( length > 0 && *data == 0 )
+		{
+		data++;
+		length--;
+		}
+	if( length <= 0 )
+		{
+		strcpy( string, "0" );
+		return( 1 );
+		}
+#ifdef __SIZEOF_INT128__
+	if( length <= 16 )
+		{
+		const unsigned long long divisor = 10000000000000000000ULL;
+		unsigned __int128 value128 = 0;
+		unsigned long long low, middle;
+
+		/* It fits into 128 bits, convert it directly.  We have to split
+		   the value into 19-digit chunks since printf() can't handle
+		   128-bit values */
+		for( i = 0; i < length; i++ )
+			value128 = ( value128 << 8 ) | data[ i ];
+		low = ( unsigned long long ) ( value128 % divisor );
+		value128 /= divisor;
+		if( value128 == 0 )
+			return( sprintf( string, "%llu", low ) );
+		middle = ( unsigned long long ) ( value128 % divisor );
+		value128 /= divisor;
+		if( value128 == 0 )
+			return( sprintf( string, "%llu%019llu", middle, low ) );
+		return( sprintf( string, "%llu%019llu%019llu",
+						 ( unsigned long long ) value128, middle, low ) );
+		}
+#endif /* __SIZEOF_INT128__ */
+
+	/* Convert the value to little-endian limbs */
+	for( i = length; i > 0; i -= 2 )
+		{
+		value[ valueLength++ ] = ( i > 1 ) ? \
+				( data[ i - 2 ] << 8 ) | data[ i - 1 ] : data[ i - 1 ];
+		}
+
+	/* Calculate the powers of ten needed to split the value */
+	powers[ 0 ].value[ 0 ] = 10000;
+	powers[ 0 ].length = 1;
+	for( noPowers = 1; noPowers < DECIMAL_MAX_POWERS && \
+		 powers[ noPowers - 1 ].length * 4 <= valueLength + 1; noPowers++ )
+		{
+		powers[ noPowers ].length = \
+			bnMultiply( powers[ noPowers ].value,
+						powers[ noPowers - 1 ].value,
+						powers[ noPowers - 1 ].length,
+						powers[ noPowers - 1 ].value,
+						powers[ noPowers - 1 ].length );
+		}
+
+	/* Convert the value with enough digits to hold any value of this
+	   size (log10( 2 ) = 0.30103) and strip the leading zeroes */
+	noDigits = ( ( length * 8 * 30103L ) / 100000L ) + 1;
+	bnToDecimal( string, noDigits, value, valueLength, powers, noPowers - 1 );
+	for( i = 0; i < noDigits - 1 && string[ i ] == '0'; i++ );
+	memmove( string, string + i, noDigits - i );
+	string[ noDigits - i ] = '\0';
+
+	return( noDigits - i );
+	}
+
+/* Display an integer that's too large for a long in decimal */
+
+static void printDecimal( FILE *inFile, const int length, int level )
+	{
+	const int displayHeaderLength = ( ( doPure ) ? 0 : INDENT_SIZE ) + 2;
+	BYTE buffer[ DECIMAL_MAX_SIZE ], intBuffer[ 2 ];
+	char digits[ DECIMAL_MAX_DIGITS + 1 ];
+	int isNegative, warnPadding, noDigits, i;
+
+	for( i = 0; i < length; i++ )
+		{
+		const int ch = getc( inFile );
+
+		if( ch == EOF )
+			{
+			fPos += i;
+			complainEOF( level, length - i );
+			return;
+			}
+		buffer[ i ] = ch;
+		}
+	fPos += length;
+
+	/* Check for the first 9 bits being identical */
+	warnPadding = ( buffer[ 0 ] == 0x00 && !( buffer[ 1 ] & 0x80 ) ) || \
+				  ( buffer[ 0 ] == 0xFF && ( buffer[ 1 ] & 0x80 ) );
+	intBuffer[ 0 ] = buffer[ 0 ];
+	intBuffer[ 1 ] = buffer[ 1 ];
+
+	/* If it's negative, display the magnitude with a minus sign */
+	isNegative = ( buffer[ 0 ] & 0x80 ) ? TRUE : FALSE;
+	if( isNegative )
+		{
+		int carry = 1;
+
+		for( i = length - 1; i >= 0; i-- )
+			{
+			const int value = ( ~buffer[ i ] & 0xFF ) + carry;
+
+			buffer[ i ] = value & 0xFF;
+			carry = value >> 8;
+			}
+		}
+	digits[ 0 ] = '-';
+	noDigits = bignumToString( digits + isNegative, buffer, length );
+	noDigits += isNegative;
+
+	/* Display the value on the same line as the label if it'll fit,
+	   otherwise on as many lines as it takes */
+	if( displayHeaderLength + ( level * 2 ) + noDigits < outputWidth )
+		printString( level, " %s\n", digits );
+	else
+		{
+		level = adjustLevel( level, ( outputWidth - displayHeaderLength - \
+									  DECIMAL_LINE_LENGTH ) / 2 );
+		for( i = 0; i < noDigits; i += DECIMAL_LINE_LENGTH )
+			{
+			printString( level, "%c", '\n' );
+			if( !doPure )
+				printInfoIndent( level );
+			doIndent( level + 1 );
+			printString( level, "%.*s", DECIMAL_LINE_LENGTH, digits + i );
+			}
+		printString( level, "%c", '\n' );
+		}
+
+	if( warnPadding )
+		complainInt( intBuffer, level );
+	if( isNegative )
+		complain( DIAG_INTEGER_NEGATIVE,
+				  "Integer is encoded as a negative value", 0, level );
+	}
+
+/* Convert a binary OID to its string equivalent */
+
+static int oidToString( char *textOID, int *textOIDlength,
+						const BYTE *oid, const int oidLength )
+	{
+	BYTE uuidBuffer[ 32 ];
+	long value;
+	int length = 0, uuidBufPos = -1, uuidBitCount = 5, i;
+	int validEncoding = TRUE, isUUID = FALSE;
+
+	for( i = 0, value = 0; i < oidLength; i++ )
+		{
+		const BYTE data = oid[ i ];
+		const long valTmp = value << 7;
+
+		/* Pick apart the encoding.  We keep going after hitting an encoding
+		   error at the start of an arc because the overall length is
+		   bounded and we may still be able to recover something worth
+		   printing */
+		if( length > 128 - 32 )
+			{
+			/* Excessively long OID, add a continuation marker and exit */
+			length += sprintf( textOID + length, "..." );
+			validEncoding = FALSE;
+			break;
+			}
+		if( value == 0 && data == 0x80 )
 			{
 			/* Invalid leading zero value, 0x80 & 0x7F == 0 */
 			validEncoding = FALSE;
@@ -1834,9 +3547,11 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 	unsigned int bitString = 0, currentBitMask = 0x80, remainderMask = 0xFF;
 	int bitFlag, value = 0, noBits, bitNo = -1, i;
 	char *errorStr = NULL;
+	DIAG_CODE errorCode = DIAG_OTHER;
 
 	if( unused < 0 || unused > 7 )
-		complain( "Invalid number %d of unused bits", unused, level );
+		complain( DIAG_BITSTRING_UNUSED,
+				  "Invalid number %d of unused bits", unused, level );
 	noBits = ( length * 8 ) - unused;
 
 	/* ASN.1 bitstrings start at bit 0, so we need to reverse the order of
@@ -1848,6 +3563,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 			{
 			noBits = 0;
 			errorStr = "Truncated BIT STRING data";
+			errorCode = DIAG_BITSTRING_TRUNCATED;
 			}
 		fPos++;
 		}
@@ -1858,6 +3574,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 		if( ch == EOF )
 			{
 			errorStr = "Truncated BIT STRING data";
+			errorCode = DIAG_BITSTRING_TRUNCATED;
 			break;
 			}
 		bitString = ( bitString << 8 ) | ch;
@@ -1868,7 +3585,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 	if( errorStr != NULL )
 		{
 		printString( level, "%c", '\n' );
-		complain( errorStr, 0, level );
+		complain( errorCode, errorStr, 0, level );
 		return;
 		}
 	if( reverseBitString )
@@ -1881,6 +3598,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 				{
 				/* The last valid bit should be a one bit */
 				errorStr = "Spurious zero bits in bitstring";
+				errorCode = DIAG_BITSTRING_ZERO_BITS;
 				}
 			bitFlag <<= 1;
 			bitString <<= 1;
@@ -1893,6 +3611,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 			   have to do the noBits check to avoid a fencepost error when
 			   there's exactly 32 bits */
 			errorStr = "Spurious one bits in bitstring";
+			errorCode = DIAG_BITSTRING_ONE_BITS;
 			}
 		}
 	else
@@ -1902,6 +3621,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 			{
 			/* The last valid bit should be a one bit */
 			errorStr = "Spurious zero bits in bitstring";
+			errorCode = DIAG_BITSTRING_ZERO_BITS;
 			}
 		if( noBits < sizeof( int ) && \
 			( ( 0xFF >> ( 8 - unused ) ) & value ) && \
@@ -1911,6 +3631,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 			   have to do the noBits check to avoid a fencepost error when
 			   there's exactly 32 bits */
 			errorStr = "Spurious one bits in bitstring";
+			errorCode = DIAG_BITSTRING_ONE_BITS;
 			}
 		}
 
@@ -1920,7 +3641,7 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 	   flag is set */
 	printString( level, "%c", '\n' );
 	if( !doPure )
-		printString( level, "%s", INDENT_STRING );
+		printInfoIndent( level );
 	doIndent( level + 1 );
 	printString( level, "%c", '\'' );
 	if( reverseBitString )
@@ -1942,7 +3663,67 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 		printString( level, "%s", "'B\n" );
 
 	if( errorStr != NULL )
-		complain( errorStr, 0, level );
+		complain( errorCode, errorStr, 0, level );
+	}
+
+/* Strings are read through a buffer so that runs of plain text can be
+   checked and displayed a line at a time rather than a character at a
+   time.  The buffer only ever contains data from the string itself, with
+   any reads past the end of the string going directly to the input */
+
+#define STRING_BUFFER_SIZE	4096
+
+typedef struct {
+	FILE *inFile;				/* Input stream */
+	BYTE buffer[ STRING_BUFFER_SIZE ];	/* Buffered string data */
+	int bufPos, bufLength;		/* Position and amount of data in buffer */
+	long dataLeft;				/* String data that hasn't been buffered */
+	int pushback;				/* Character pushed back, or EOF */
+	} STRING_READER;
+
+/* Make sure that at least minLength bytes of string data are buffered if
+   possible, returning the amount of data available */
+
+static int fillStringReader( STRING_READER *reader, const int minLength )
+	{
+	int available = reader->bufLength - reader->bufPos;
+
+	if( available < minLength && reader->dataLeft > 0 )
+		{
+		const int readLength = ( int ) min( STRING_BUFFER_SIZE - available,
+											reader->dataLeft );
+		int count;
+
+		memmove( reader->buffer, reader->buffer + reader->bufPos,
+				 available );
+		reader->bufPos = 0;
+		count = fread( reader->buffer + available, 1, readLength,
+					   reader->inFile );
+		if( count < readLength )
+			reader->dataLeft = 0;	/* EOF, further reads will fail */
+		else
+			reader->dataLeft -= count;
+		if( count > 0 )
+			available += count;
+		reader->bufLength = available;
+		}
+
+	return( available );
+	}
+
+static int readStringChar( STRING_READER *reader )
+	{
+	int ch;
+
+	if( reader->pushback != EOF )
+		{
+		ch = reader->pushback;
+		reader->pushback = EOF;
+		return( ch );
+		}
+	if( fillStringReader( reader, 1 ) <= 0 )
+		return( getc( reader->inFile ) );
+	return( reader->buffer[ reader->bufPos++ ] );
 	}
 
 /* Display data as a text string up to a maximum of 240 characters (8 lines
@@ -1957,12 +3738,14 @@ static void dumpBitString( FILE *inFile, const int length, const int unused,
 static void displayString( FILE *inFile, long length, int level,
 						   const STR_OPTION strOption )
 	{
+	STRING_READER reader;
 	char timeStr[ 64 ];
 	long noBytes = length;
 	int lineLength = 48, i;
 	int firstTime = TRUE, doTimeStr = FALSE, warnIA5 = FALSE;
 	int warnPrintable = FALSE, warnTime = FALSE, warnBMP = FALSE;
 	int warnTimeT = FALSE, warnTimeCrazy = FALSE, warnTimeCrazyAlt = FALSE;
+	int isPlainText = FALSE;
 
 	if( noBytes > 384 && !printAllData )
 		noBytes = 384;	/* Only output a maximum of 384 bytes */
@@ -1977,6 +3760,17 @@ static void displayString( FILE *inFile, long length, int level,
 	if( !doTimeStr && length <= 40 )
 		printString( level, "%s", " '" );	/* Print string on same line */
 	level = adjustLevel( level, ( doPure ) ? 15 : 8 );
+#ifndef __OS390__
+	if( !doTimeStr && \
+		( strOption == STR_NONE || strOption == STR_PRINTABLE || \
+		  strOption == STR_IA5 || strOption == STR_LATIN1 || \
+		  strOption == STR_UTF8 ) )
+		isPlainText = TRUE;
+#endif /* !__OS390__ */
+	memset( &reader, 0, sizeof( STRING_READER ) );
+	reader.inFile = inFile;
+	reader.dataLeft = length;
+	reader.pushback = EOF;
 	for( i = 0; i < noBytes; i++ )
 		{
 		int ch;
@@ -1989,12 +3783,37 @@ static void displayString( FILE *inFile, long length, int level,
 				printString( level, "%c", '\'' );
 			printString( level, "%c", '\n' );
 			if( !doPure )
-				printString( level, "%s", INDENT_STRING );
+				printInfoIndent( level );
 			doIndent( level + 1 );
 			printString( level, "%c", '\'' );
 			firstTime = FALSE;
 			}
-		ch = getc( inFile );
+
+		/* If the string can contain plain text and the next line of it is
+		   all printable ASCII, display the whole line at once */
+		if( isPlainText && lineLength == 48 && reader.pushback == EOF && \
+			( i == 0 || ( length > 40 && !( i % lineLength ) ) ) )
+			{
+			const int chunkLength = ( int ) min( noBytes - i, lineLength );
+
+			if( fillStringReader( &reader, chunkLength ) >= chunkLength )
+				{
+				const BYTE *chunk = reader.buffer + reader.bufPos;
+				const int flags = classifyText( chunk, chunkLength );
+
+				if( flags & I )
+					{
+					if( strOption == STR_PRINTABLE && !( flags & P ) )
+						warnPrintable = TRUE;
+					printString( level, "%.*s", chunkLength, chunk );
+					reader.bufPos += chunkLength;
+					fPos += chunkLength;
+					i += chunkLength - 1;
+					continue;
+					}
+				}
+			}
+		ch = readStringChar( &reader );
 		if( ch == EOF )
 			{
 			complainEOF( level, noBytes - i );
@@ -2012,7 +3831,7 @@ static void displayString( FILE *inFile, long length, int level,
 				}
 			else
 				{
-				wChBuf[ 0 ] = ( ch << 8 ) | getc( inFile );
+				wChBuf[ 0 ] = ( ch << 8 ) | readStringChar( &reader );
 				wChBuf[ 1 ] = 0;
 				if( displayUnicode( wChBuf, level ) )
 					{
@@ -2024,13 +3843,13 @@ static void displayString( FILE *inFile, long length, int level,
 
 				/* The value can't be displayed as Unicode, fall back to
 				   displaying it as normal text */
-				ungetc( wChBuf[ 0 ] & 0xFF, inFile );
+				reader.pushback = wChBuf[ 0 ] & 0xFF;
 				}
 			}
 		if( strOption == STR_UTF8 && ( ch & 0x80 ) )
 			{
 			wchar_t wChBuf[ 2 ];
-			const int secondCh = getc( inFile );
+			const int secondCh = readStringChar( &reader );
 
 			/* It's a multibyte UTF8 character, read it as a widechar */
 			if( ( ch & 0xE0 ) == 0xC0 )		/* 111xxxxx -> 110xxxxx */
@@ -2044,19 +3863,23 @@ static void displayString( FILE *inFile, long length, int level,
 				{
 				if( ( ch & 0xF0 ) == 0xE0 )	/* 1111xxxx -> 1110xxxx */
 					{
-					const int thirdCh = getc( inFile );
+					const int thirdCh = readStringChar( &reader );
 
 					/* 3-byte character in the range 0x800...0xFFFF */
 					wChBuf[ 0 ] = ( ( ch & 0x1F ) << 12 ) | \
 								  ( ( secondCh & 0x3F ) << 6 ) | \
 									( thirdCh & 0x3F );
+					i += 2;		/* We've read 3 characters */
+					fPos += 3;
 					}
 				else
 					{
+					/* Invalid lead byte, display a placeholder for the 2
+					   characters that we've read */
 					wChBuf[ 0 ] = '.';
+					i++;		/* We've read 2 characters */
+					fPos += 2;
 					}
-				i += 2;		/* We've read 3 characters */
-				fPos += 3;
 				}
 			wChBuf[ 1 ] = 0;
 			if( !displayUnicode( wChBuf, level ) )
@@ -2116,7 +3939,7 @@ static void displayString( FILE *inFile, long length, int level,
 				   ASCII chars, skipping the following zero byte.  This is
 				   safe since the code that detects reversed BMPStrings
 				   has already checked that every second byte is zero */
-				getc( inFile );
+				readStringChar( &reader );
 				i++;
 				fPos++;
 				/* Fall through */
@@ -2139,27 +3962,50 @@ static void displayString( FILE *inFile, long length, int level,
 		length -= 384;
 		printString( level, "%s", "'\n" );
 		if( !doPure )
-			printString( level, "%s", INDENT_STRING );
+			printInfoIndent( level );
 		doIndent( level + 5 );
 		printString( level, "[ Another %ld characters skipped ]", length );
 		fPos += length;
-		while( length-- )
+		while( length > 0 )
 			{
-			int ch = getc( inFile );
+			int chunkLength = 0, flags;
 
-			if( ch == EOF )
+			/* Check the remaining data a buffer at a time if possible */
+			if( reader.pushback == EOF )
+				chunkLength = fillStringReader( &reader, 1 );
+			if( chunkLength > 0 )
 				{
-				complainEOF( level, length );
-				return;
+				chunkLength = ( int ) min( chunkLength, length );
+				flags = classifyText( reader.buffer + reader.bufPos,
+									  chunkLength );
+				reader.bufPos += chunkLength;
+				length -= chunkLength;
+				}
+			else
+				{
+				const int ch = readStringChar( &reader );
+
+				length--;
+				if( ch == EOF )
+					{
+					complainEOF( level, length );
+					return;
+					}
+				flags = ( ch < 128 ) ? charFlags[ ch ] : 0;
 				}
-			if( strOption == STR_PRINTABLE && !isPrintable( ch ) )
+			if( strOption == STR_PRINTABLE && !( flags & P ) )
 				warnPrintable = TRUE;
-			if( strOption == STR_IA5 && !isIA5( ch ) )
+			if( strOption == STR_IA5 && !( flags & I ) )
 				warnIA5 = TRUE;
 			}
 		}
 	else
 		{
+		/* A BMPString can end with a character read past the end of the
+		   string being pushed back, in which case it's returned to the
+		   input stream */
+		if( reader.pushback != EOF )
+			ungetc( reader.pushback, inFile );
 		if( doTimeStr )
 			{
 			const char *timeStrPtr = ( strOption == STR_UTCTIME ) ? \
@@ -2213,555 +4059,1757 @@ static void displayString( FILE *inFile, long length, int level,
 
 	/* Display any problems we encountered */
 	if( warnPrintable )
-		complain( "PrintableString contains illegal character(s)", 0, level );
+		complain( DIAG_PRINTABLESTRING,
+				  "PrintableString contains illegal character(s)", 0, level );
 	if( warnIA5 )
-		complain( "IA5String contains illegal character(s)", 0, level );
+		complain( DIAG_IA5STRING,
+				  "IA5String contains illegal character(s)", 0, level );
 	if( warnTime )
-		complain( "Time is encoded incorrectly", 0, level );
+		complain( DIAG_TIME, "Time is encoded incorrectly", 0, level );
 	if( warnTimeT )
-		warn( "Time value cannot be represented in a 32-bit time_t", 0, level );
+		warn( DIAG_TIME_T,
+			  "Time value cannot be represented in a 32-bit time_t", 0, level );
 	if( warnTimeCrazy )
 		{
-		complain( warnTimeCrazyAlt ? \
+		complain( DIAG_TIME_RANGE, warnTimeCrazyAlt ? \
 				  "Time value is either more than twenty years in the past or "
 						"more than half a century in the future" : \
-				  "Time value is more than half a century in the future", 0, level );
+				  "Time value is more than half a century in the future",
+				  0, level );
 		}
 	if( warnBMP )
-		complain( "BMPString has missing final byte/half character", 0, level );
+		complain( DIAG_BMPSTRING,
+				  "BMPString has missing final byte/half character", 0, level );
 	}
 
 /****************************************************************************
 *																			*
-*								ASN.1 Parsing Routines						*
+*							Schema Labelling Routines						*
 *																			*
 ****************************************************************************/
 
-/* Get an ASN.1 object's tag and length.  Returns TRUE for an item
-   available, FALSE for end-of-data, and a negative value for an invalid
-   data */
+/* Context-specific tags in common objects are hard to make sense of without
+   the ASN.1 module to hand, and everyone has to remember that [3] in a
+   TBSCertificate is the extensions.  To help with this we can label fields
+   with their names from the schema for the object.  Each type is described
+   by a list of fields, with the type of the field giving the list for the
+   contents of a constructed or encapsulating field.  Fields whose type
+   depends on an OID, for example the content of a ContentInfo, are given
+   their type through a selector table for the OID field that precedes them.
 
-static int getItem( FILE *inFile, ASN1_ITEM *item )
-	{
-	int tag, length, index = 0;
+   Before we start decoding, the field lists are compiled into a flat table
+   of states, one per field position, with a 256-entry transition table
+   for each state that's indexed by the identifier octet of the next item.
+   This means that matching an item against the schema is a single table
+   lookup, and the only time that we do anything with the field names is
+   when we print the label.  State 0 is a dead state that matches nothing,
+   which is also what the zero-initialised per-level state refers to */
 
-	memset( item, 0, sizeof( ASN1_ITEM ) );
-	item->indefinite = FALSE;
-	tag = fgetc( inFile );
-	if( tag == EOF )
-		return( FALSE );
-	item->header[ index++ ] = tag;
-	fPos++;
-	item->id = tag & ~TAG_MASK;
-	tag &= TAG_MASK;
-	if( tag == TAG_MASK )
-		{
-		int value;
+#define SCHEMA_ANY			-1		/* Field matches any identifier */
 
-		/* Long tag encoded as sequence of 7-bit values.  This doesn't try to
-		   handle tags > INT_MAX, it'd be pretty peculiar ASN.1 if it had to
-		   use tags this large */
-		tag = 0;
-		do
-			{
-			value = fgetc( inFile );
-			if( value == EOF )
-				return( FALSE );
-			tag = ( tag << 7 ) | ( value & 0x7F );
-			item->header[ index++ ] = value;
-			fPos++;
-			}
-		while( value & LEN_XTND && index < 5 && !feof( inFile ) );
-		if( index >= 5 )
-			return( FALSE );
-		}
-	item->tag = tag;
-	length = fgetc( inFile );
-	if( length == EOF )
-		return( FALSE );
-	fPos++;
-	item->header[ index++ ] = length;
-	item->headerSize = index;
-	if( length & LEN_XTND )
-		{
-		const int lengthStart = index;
-		int i;
+#define SCHEMA_OPTIONAL		0x01	/* Field may be absent */
+#define SCHEMA_REPEAT		0x02	/* SEQUENCE OF/SET OF element */
+#define SCHEMA_ALTERNATIVE	0x04	/* CHOICE alternative to next field */
+#define SCHEMA_DEFINED_BY	0x08	/* Contents type selected by an OID */
 
-		length &= LEN_MASK;
-		if( length > 4 )
-			{
-			/* Impossible length value, probably because we've run into
-			   the weeds */
-			return( -1 );
-			}
-		item->headerSize += length;
-		item->length = 0;
-		if( !length )
-			item->indefinite = TRUE;
-		for( i = 0; i < length; i++ )
-			{
-			int ch = fgetc( inFile );
+#define MAKE_CTAG( tag )	( CONTEXT | CONSTRUCTED | ( tag ) )
+#define MAKE_CTAG_PRIMITIVE( tag )	( CONTEXT | ( tag ) )
 
-			if( ch == EOF )
-				{
-				fPos += length - i;
-				return( FALSE );
-				}
-			item->length = ( item->length << 8 ) | ch;
-			item->header[ i + index ] = ch;
-			}
-		fPos += length;
+/* The types that we know about.  The field lists for these are given in
+   schemaTypes[] in the same order */
 
-		/* Check for the length being less then 128, which means it
-		   shouldn't be encoded as a long length */
-		if( !item->indefinite && item->length < 128 )
-			item->nonCanonical = lengthStart;
+typedef enum {
+	SCHEMA_TYPE_NONE,
+	/* Top-level objects */
+	SCHEMA_TYPE_CERT_ROOT, SCHEMA_TYPE_CRL_ROOT, SCHEMA_TYPE_CMS_ROOT,
+	SCHEMA_TYPE_PKCS8_ROOT, SCHEMA_TYPE_PKCS12_ROOT,
+	/* General-purpose types */
+	SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_TYPE_NAME, SCHEMA_TYPE_RDN,
+	SCHEMA_TYPE_AVA, SCHEMA_TYPE_ATTRIBUTES, SCHEMA_TYPE_ATTRIBUTE,
+	SCHEMA_TYPE_ATTRIBUTE_VALUES, SCHEMA_TYPE_EXPLICIT_INTEGER,
+	SCHEMA_TYPE_EXPLICIT_EXTENSIONS, SCHEMA_TYPE_EXTENSIONS,
+	SCHEMA_TYPE_EXTENSION,
+	/* Certificate extensions */
+	SCHEMA_TYPE_BASIC_CONSTRAINTS_ENC, SCHEMA_TYPE_BASIC_CONSTRAINTS,
+	SCHEMA_TYPE_KEY_USAGE_ENC, SCHEMA_TYPE_SKID_ENC,
+	SCHEMA_TYPE_AKID_ENC, SCHEMA_TYPE_AKID, SCHEMA_TYPE_EKU_ENC,
+	SCHEMA_TYPE_EKU, SCHEMA_TYPE_SAN_ENC, SCHEMA_TYPE_IAN_ENC,
+	SCHEMA_TYPE_GENERAL_NAMES, SCHEMA_TYPE_CRL_NUMBER_ENC,
+	SCHEMA_TYPE_CRL_REASON_ENC,
+	/* X.509 certificates and CRLs */
+	SCHEMA_TYPE_CERTIFICATE, SCHEMA_TYPE_TBS_CERTIFICATE,
+	SCHEMA_TYPE_VALIDITY, SCHEMA_TYPE_SPKI, SCHEMA_TYPE_CERTIFICATE_LIST,
+	SCHEMA_TYPE_TBS_CERT_LIST, SCHEMA_TYPE_REVOKED_CERTS,
+	SCHEMA_TYPE_REVOKED_CERT,
+	/* CMS */
+	SCHEMA_TYPE_CONTENT_INFO, SCHEMA_TYPE_DATA_CONTENT,
+	SCHEMA_TYPE_SIGNED_DATA_CONTENT, SCHEMA_TYPE_SIGNED_DATA,
+	SCHEMA_TYPE_DIGEST_ALGORITHMS, SCHEMA_TYPE_ENCAP_CONTENT_INFO,
+	SCHEMA_TYPE_CERTIFICATE_SET, SCHEMA_TYPE_CRL_SET,
+	SCHEMA_TYPE_SIGNER_INFOS, SCHEMA_TYPE_SIGNER_INFO,
+	SCHEMA_TYPE_ISSUER_AND_SERIAL,
+	/* PKCS #8 */
+	SCHEMA_TYPE_PRIVATE_KEY_INFO, SCHEMA_TYPE_ENCRYPTED_PRIVATE_KEY_INFO,
+	/* PKCS #12 */
+	SCHEMA_TYPE_PFX, SCHEMA_TYPE_PFX_CONTENT_INFO,
+	SCHEMA_TYPE_AUTH_SAFE_DATA, SCHEMA_TYPE_AUTH_SAFE_ENC,
+	SCHEMA_TYPE_AUTH_SAFE, SCHEMA_TYPE_SAFE_CONTENT_INFO,
+	SCHEMA_TYPE_SAFE_CONTENTS_DATA, SCHEMA_TYPE_SAFE_CONTENTS_ENC,
+	SCHEMA_TYPE_ENCRYPTED_DATA_CONTENT, SCHEMA_TYPE_ENCRYPTED_DATA,
+	SCHEMA_TYPE_ENCRYPTED_CONTENT_INFO, SCHEMA_TYPE_SAFE_CONTENTS,
+	SCHEMA_TYPE_SAFE_BAG, SCHEMA_TYPE_KEY_BAG, SCHEMA_TYPE_SHROUDED_KEY_BAG,
+	SCHEMA_TYPE_CERT_BAG_VALUE, SCHEMA_TYPE_CERT_BAG,
+	SCHEMA_TYPE_X509_CERT_VALUE, SCHEMA_TYPE_CRL_BAG_VALUE,
+	SCHEMA_TYPE_CRL_BAG, SCHEMA_TYPE_SAFE_CONTENTS_BAG, SCHEMA_TYPE_MAC_DATA,
+	SCHEMA_TYPE_DIGEST_INFO,
+	SCHEMA_TYPE_LAST
+	} SCHEMA_TYPE;
+
+/* The OID-selected types that we know about, given in schemaSelectors[] in
+   the same order */
 
-		/* Check for the first 9 bits of the length being identical and
-		   if they are, remember where the encoded non-canonical length
-		   starts */
-		if( item->headerSize - lengthStart > 1 )
-			{
-			if( ( item->header[ lengthStart ] == 0x00 ) && \
-				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x00 ) )
-				item->nonCanonical = lengthStart - 1;
-			if( ( item->header[ lengthStart ] == 0xFF ) && \
-				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x80 ) )
-				item->nonCanonical = lengthStart - 1;
-			}
-		}
-	else
-		item->length = length;
+typedef enum {
+	SCHEMA_SELECT_NONE, SCHEMA_SELECT_EXTENSION, SCHEMA_SELECT_CMS_CONTENT,
+	SCHEMA_SELECT_PFX_CONTENT, SCHEMA_SELECT_SAFE_CONTENT,
+	SCHEMA_SELECT_SAFE_BAG, SCHEMA_SELECT_CERT_BAG, SCHEMA_SELECT_LAST
+	} SCHEMA_SELECT;
 
-	return( TRUE );
-	}
+/* A field in a type, and the type selected by an OID value */
 
-/* Check whether a BIT STRING or OCTET STRING encapsulates another object */
+typedef struct {
+	const char *name;			/* Field name, NULL = end of type */
+	int id;						/* Identifier octet or SCHEMA_ANY */
+	int flags;					/* SCHEMA_OPTIONAL etc */
+	SCHEMA_TYPE type;			/* Type of contents */
+	SCHEMA_SELECT selector;		/* Selector for following DEFINED BY field */
+	} SCHEMA_FIELD;
 
-static int checkEncapsulate( FILE *inFile, const int length )
-	{
-	ASN1_ITEM nestedItem;
-	const int currentPos = fPos;
-	int diffPos, status;
+typedef struct {
+	const char *oid;			/* Encoded OID value, NULL = end of table */
+	int oidLength;
+	SCHEMA_TYPE type;			/* Type selected by the OID */
+	} SCHEMA_SELECTOR;
 
-	/* If we're not looking for encapsulated objects, return */
-	if( !checkEncaps )
-		return( FALSE );
+#define SCHEMA_OID( oid )	oid, sizeof( oid ) - 1
 
-	/* An item of length < 2 can never have encapsulated data.  Even for
-	   length 2 it can only be an encapsulated NULL, which is somewhat odd,
-	   but no doubt there's some PKI protocol somewhere that does this */
-	if( length < 2 )
-		return( FALSE );
+/* Top-level objects.  These are marked as repeated so that a file
+   containing a series of objects gets labelled all the way through.  A
+   field with an empty name isn't labelled, and doesn't appear in the
+   labels for the fields inside it */
 
-	/* Read the details of the next item in the input stream */
-	status = getItem( inFile, &nestedItem );
-	diffPos = fPos - currentPos;
-	fPos = currentPos;
-	fseek( inFile, -diffPos, SEEK_CUR );
-	if( status <= 0 )
-		return( FALSE );
+static const SCHEMA_FIELD certRootFields[] = {
+	{ "", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_CERTIFICATE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD crlRootFields[] = {
+	{ "", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_CERTIFICATE_LIST, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD cmsRootFields[] = {
+	{ "", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_CONTENT_INFO, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD pkcs8RootFields[] = {
+	{ "", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_PRIVATE_KEY_INFO, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD pkcs12RootFields[] = {
+	{ "", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_PFX, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-	/* If it's not a standard tag class, don't try and dig down into it */
-	if( ( nestedItem.id & CLASS_MASK ) != UNIVERSAL && \
-		( nestedItem.id & CLASS_MASK ) != CONTEXT )
-		return( FALSE );
+/* General-purpose types */
 
-	/* There is one special-case situation that overrides the check below,
-	   which is when the nested content is indefinite-length.  This is
-	   rather tricky to check for because we'd need to read some distance
-	   ahead into the stream to be able to safely decide whether we've got
-	   true nested content or a false positive, for now we require that
-	   the nested content has to be a SEQUENCE containing valid ASN.1 at
-	   the start, giving about 24 bits of checking.  There's a small risk
-	   of false negatives for encapsulated primitive items, but since
-	   they're primitive it should be relatively easy to make out the
-	   contents inside the OCTET STRING */
-	if( nestedItem.tag == SEQUENCE && nestedItem.indefinite )
-		{
-		/* Skip the indefinite-length SEQUENCE and make sure that it's
-		   followed by a valid item */
-		status = getItem( inFile, &nestedItem );
-		if( status > 0 )
-			status = getItem( inFile, &nestedItem );
-		diffPos = fPos - currentPos;
-		fPos = currentPos;
-		fseek( inFile, -diffPos, SEEK_CUR );
-		if( status <= 0 )
-			return( FALSE );
+static const SCHEMA_FIELD algorithmIdFields[] = {
+	{ "algorithm", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "parameters", SCHEMA_ANY, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD nameFields[] = {
+	{ "rdn", CONSTRUCTED | SET, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_RDN, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD rdnFields[] = {
+	{ "ava", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_AVA, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD avaFields[] = {
+	{ "type", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "value", SCHEMA_ANY, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD attributesFields[] = {
+	{ "attribute", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_ATTRIBUTE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD attributeFields[] = {
+	{ "attrType", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "attrValues", CONSTRUCTED | SET, 0,
+	  SCHEMA_TYPE_ATTRIBUTE_VALUES, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD attributeValuesFields[] = {
+	{ "attrValue", SCHEMA_ANY, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD explicitIntegerFields[] = {
+	{ "", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD explicitExtensionsFields[] = {
+	{ "", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_EXTENSIONS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD extensionsFields[] = {
+	{ "extension", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_EXTENSION, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD extensionFields[] = {
+	{ "extnID", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_EXTENSION },
+	{ "critical", BOOLEAN, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "extnValue", OCTETSTRING, SCHEMA_DEFINED_BY,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-		/* If the tag on the nest item looks vaguely valid, assume that we've
-		   go nested content */
-		if( ( nestedItem.tag <= 0 || nestedItem.tag > 0x31 ) || \
-			( nestedItem.length >= length ) )
-			return( FALSE );
-		return( TRUE );
-		}
+/* Certificate extensions.  The *Enc types are the contents of the
+   extnValue OCTET STRING */
 
-	/* If it doesn't fit exactly within the current item it's not an
-	   encapsulated object */
-	if( nestedItem.length != length - diffPos )
-		return( FALSE );
+static const SCHEMA_FIELD basicConstraintsEncFields[] = {
+	{ "basicConstraints", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_BASIC_CONSTRAINTS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD basicConstraintsFields[] = {
+	{ "cA", BOOLEAN, SCHEMA_OPTIONAL, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "pathLenConstraint", INTEGER, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD keyUsageEncFields[] = {
+	{ "keyUsage", BITSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD skidEncFields[] = {
+	{ "subjectKeyIdentifier", OCTETSTRING, 0,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD akidEncFields[] = {
+	{ "authorityKeyIdentifier", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_AKID, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD akidFields[] = {
+	{ "keyIdentifier", MAKE_CTAG_PRIMITIVE( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "authorityCertIssuer", MAKE_CTAG( 1 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_GENERAL_NAMES, SCHEMA_SELECT_NONE },
+	{ "authorityCertSerialNumber", MAKE_CTAG_PRIMITIVE( 2 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD ekuEncFields[] = {
+	{ "extKeyUsage", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_EKU, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD ekuFields[] = {
+	{ "keyPurposeId", OID, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD sanEncFields[] = {
+	{ "subjectAltName", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_GENERAL_NAMES, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD ianEncFields[] = {
+	{ "issuerAltName", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_GENERAL_NAMES, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD generalNamesFields[] = {
+	{ "generalName", SCHEMA_ANY, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD crlNumberEncFields[] = {
+	{ "cRLNumber", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD crlReasonEncFields[] = {
+	{ "reasonCode", ENUMERATED, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-	/* If it doesn't have a valid-looking tag, don't try and go any further */
-	if( nestedItem.tag <= 0 || nestedItem.tag > 0x31 )
-		return( FALSE );
+/* X.509 certificates and CRLs, RFC 5280 */
 
-	/* Now things get a bit complicated because it's possible to get some
-	   (very rare) false positives, for example if a NUMERICSTRING of
-	   exactly the right length is nested within an OCTET STRING, since
-	   numeric values all look like constructed tags of some kind.  To
-	   handle this we look for nested constructed items that should really
-	   be primitive */
-	if( ( nestedItem.id & FORM_MASK ) == PRIMITIVE )
-		return( TRUE );
+static const SCHEMA_FIELD certificateFields[] = {
+	{ "tbsCertificate", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_TBS_CERTIFICATE, SCHEMA_SELECT_NONE },
+	{ "signatureAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "signatureValue", BITSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD tbsCertificateFields[] = {
+	{ "version", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_EXPLICIT_INTEGER, SCHEMA_SELECT_NONE },
+	{ "serialNumber", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "signature", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "issuer", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_NAME, SCHEMA_SELECT_NONE },
+	{ "validity", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_VALIDITY, SCHEMA_SELECT_NONE },
+	{ "subject", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_NAME, SCHEMA_SELECT_NONE },
+	{ "subjectPublicKeyInfo", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_SPKI, SCHEMA_SELECT_NONE },
+	{ "issuerUniqueID", MAKE_CTAG_PRIMITIVE( 1 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "subjectUniqueID", MAKE_CTAG_PRIMITIVE( 2 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "extensions", MAKE_CTAG( 3 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_EXPLICIT_EXTENSIONS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD validityFields[] = {
+	{ "notBefore", UTCTIME, SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "notBefore", GENERALIZEDTIME, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "notAfter", UTCTIME, SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "notAfter", GENERALIZEDTIME, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD spkiFields[] = {
+	{ "algorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "subjectPublicKey", BITSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD certificateListFields[] = {
+	{ "tbsCertList", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_TBS_CERT_LIST, SCHEMA_SELECT_NONE },
+	{ "signatureAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "signatureValue", BITSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD tbsCertListFields[] = {
+	{ "version", INTEGER, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "signature", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "issuer", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_NAME, SCHEMA_SELECT_NONE },
+	{ "thisUpdate", UTCTIME, SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "thisUpdate", GENERALIZEDTIME, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "nextUpdate", UTCTIME, SCHEMA_OPTIONAL | SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "nextUpdate", GENERALIZEDTIME, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "revokedCertificates", CONSTRUCTED | SEQUENCE, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_REVOKED_CERTS, SCHEMA_SELECT_NONE },
+	{ "crlExtensions", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_EXPLICIT_EXTENSIONS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD revokedCertsFields[] = {
+	{ "revokedCertificate", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_REVOKED_CERT, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD revokedCertFields[] = {
+	{ "userCertificate", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "revocationDate", UTCTIME, SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "revocationDate", GENERALIZEDTIME, 0,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "crlEntryExtensions", CONSTRUCTED | SEQUENCE, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_EXTENSIONS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-	/* It's constructed, make sure that it's something for which it makes
-	   sense as a constructed object.  At worst this will give some false
-	   negatives for really wierd objects (nested constructed strings inside
-	   OCTET STRINGs), but these should probably never occur anyway */
-	if( nestedItem.tag == SEQUENCE || \
-		nestedItem.tag == SET )
-		return( TRUE );
+/* CMS, RFC 5652 */
 
-	return( FALSE );
-	}
+static const SCHEMA_FIELD contentInfoFields[] = {
+	{ "contentType", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_CMS_CONTENT },
+	{ "content", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL | SCHEMA_DEFINED_BY,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD dataContentFields[] = {
+	{ "data", OCTETSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD signedDataContentFields[] = {
+	{ "signedData", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_SIGNED_DATA, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD signedDataFields[] = {
+	{ "version", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "digestAlgorithms", CONSTRUCTED | SET, 0,
+	  SCHEMA_TYPE_DIGEST_ALGORITHMS, SCHEMA_SELECT_NONE },
+	{ "encapContentInfo", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ENCAP_CONTENT_INFO, SCHEMA_SELECT_NONE },
+	{ "certificates", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_CERTIFICATE_SET, SCHEMA_SELECT_NONE },
+	{ "crls", MAKE_CTAG( 1 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_CRL_SET, SCHEMA_SELECT_NONE },
+	{ "signerInfos", CONSTRUCTED | SET, 0,
+	  SCHEMA_TYPE_SIGNER_INFOS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD digestAlgorithmsFields[] = {
+	{ "digestAlgorithm", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD encapContentInfoFields[] = {
+	{ "eContentType", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "eContent", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD certificateSetFields[] = {
+	{ "certificate", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_CERTIFICATE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD crlSetFields[] = {
+	{ "crl", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_CERTIFICATE_LIST, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD signerInfosFields[] = {
+	{ "signerInfo", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_SIGNER_INFO, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD signerInfoFields[] = {
+	{ "version", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "sid", CONSTRUCTED | SEQUENCE, SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_ISSUER_AND_SERIAL, SCHEMA_SELECT_NONE },
+	{ "sid", MAKE_CTAG_PRIMITIVE( 0 ), 0,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "digestAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "signedAttrs", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_ATTRIBUTES, SCHEMA_SELECT_NONE },
+	{ "signatureAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "signature", OCTETSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "unsignedAttrs", MAKE_CTAG( 1 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_ATTRIBUTES, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD issuerAndSerialFields[] = {
+	{ "issuer", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_NAME, SCHEMA_SELECT_NONE },
+	{ "serialNumber", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-/* Check whether a zero-length item is OK */
+/* PKCS #8, RFC 5958 */
+
+static const SCHEMA_FIELD privateKeyInfoFields[] = {
+	{ "version", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "privateKeyAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "privateKey", OCTETSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "attributes", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_ATTRIBUTES, SCHEMA_SELECT_NONE },
+	{ "publicKey", MAKE_CTAG_PRIMITIVE( 1 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD encryptedPrivateKeyInfoFields[] = {
+	{ "encryptionAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "encryptedData", OCTETSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-static int zeroLengthOK( const ASN1_ITEM *item )
-	{
-	/* An implicitly-tagged NULL can have a zero length.  An occurrence of this
-	   type of item is almost always an error, however OCSP uses a weird status
-	   encoding that encodes result values in tags and then has to use a NULL
-	   value to indicate that there's nothing there except the tag that encodes
-	   the status, so we allow this as well if zero-length content is explicitly
-	   enabled */
-	if( zeroLengthAllowed && ( item->id & CLASS_MASK ) == CONTEXT )
-		return( TRUE );
+/* PKCS #12, RFC 7292.  The authSafe is a ContentInfo whose data content
+   encapsulates a sequence of further ContentInfos, each of which contains
+   (possibly encrypted) SafeContents holding the bags with the keys and
+   certificates */
+
+static const SCHEMA_FIELD pfxFields[] = {
+	{ "version", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "authSafe", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_PFX_CONTENT_INFO, SCHEMA_SELECT_NONE },
+	{ "macData", CONSTRUCTED | SEQUENCE, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_MAC_DATA, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD pfxContentInfoFields[] = {
+	{ "contentType", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_PFX_CONTENT },
+	{ "content", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL | SCHEMA_DEFINED_BY,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD authSafeDataFields[] = {
+	{ "data", OCTETSTRING, 0, SCHEMA_TYPE_AUTH_SAFE_ENC, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD authSafeEncFields[] = {
+	{ "authenticatedSafe", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_AUTH_SAFE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD authSafeFields[] = {
+	{ "contentInfo", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_SAFE_CONTENT_INFO, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD safeContentInfoFields[] = {
+	{ "contentType", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_SAFE_CONTENT },
+	{ "content", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL | SCHEMA_DEFINED_BY,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD safeContentsDataFields[] = {
+	{ "data", OCTETSTRING, 0,
+	  SCHEMA_TYPE_SAFE_CONTENTS_ENC, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD safeContentsEncFields[] = {
+	{ "safeContents", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_SAFE_CONTENTS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD encryptedDataContentFields[] = {
+	{ "encryptedData", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ENCRYPTED_DATA, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD encryptedDataFields[] = {
+	{ "version", INTEGER, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "encryptedContentInfo", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ENCRYPTED_CONTENT_INFO, SCHEMA_SELECT_NONE },
+	{ "unprotectedAttrs", MAKE_CTAG( 1 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_ATTRIBUTES, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD encryptedContentInfoFields[] = {
+	{ "contentType", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "contentEncryptionAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "encryptedContent", MAKE_CTAG_PRIMITIVE( 0 ),
+	  SCHEMA_OPTIONAL | SCHEMA_ALTERNATIVE,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "encryptedContent", MAKE_CTAG( 0 ), SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD safeContentsFields[] = {
+	{ "safeBag", CONSTRUCTED | SEQUENCE, SCHEMA_REPEAT,
+	  SCHEMA_TYPE_SAFE_BAG, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD safeBagFields[] = {
+	{ "bagId", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_SAFE_BAG },
+	{ "bagValue", MAKE_CTAG( 0 ), SCHEMA_DEFINED_BY,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "bagAttributes", CONSTRUCTED | SET, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_ATTRIBUTES, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD keyBagFields[] = {
+	{ "keyBag", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_PRIVATE_KEY_INFO, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD shroudedKeyBagFields[] = {
+	{ "pkcs8ShroudedKeyBag", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ENCRYPTED_PRIVATE_KEY_INFO, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD certBagValueFields[] = {
+	{ "certBag", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_CERT_BAG, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD certBagFields[] = {
+	{ "certId", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_CERT_BAG },
+	{ "certValue", MAKE_CTAG( 0 ), SCHEMA_DEFINED_BY,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD x509CertValueFields[] = {
+	{ "x509Certificate", OCTETSTRING, 0,
+	  SCHEMA_TYPE_CERT_ROOT, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD crlBagValueFields[] = {
+	{ "crlBag", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_CRL_BAG, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD crlBagFields[] = {
+	{ "crlId", OID, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "crlValue", MAKE_CTAG( 0 ), 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD safeContentsBagFields[] = {
+	{ "safeContentsBag", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_SAFE_CONTENTS, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD macDataFields[] = {
+	{ "mac", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_DIGEST_INFO, SCHEMA_SELECT_NONE },
+	{ "macSalt", OCTETSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ "iterations", INTEGER, SCHEMA_OPTIONAL,
+	  SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
+static const SCHEMA_FIELD digestInfoFields[] = {
+	{ "digestAlgorithm", CONSTRUCTED | SEQUENCE, 0,
+	  SCHEMA_TYPE_ALGORITHM_ID, SCHEMA_SELECT_NONE },
+	{ "digest", OCTETSTRING, 0, SCHEMA_TYPE_NONE, SCHEMA_SELECT_NONE },
+	{ NULL }
+	};
 
-	/* If we can't recognise the type from the tag, reject it */
-	if( ( item->id & CLASS_MASK ) != UNIVERSAL )
-		return( FALSE );
+static const SCHEMA_FIELD *const schemaTypes[] = {
+	NULL,
+	certRootFields, crlRootFields, cmsRootFields, pkcs8RootFields,
+	pkcs12RootFields,
+	algorithmIdFields, nameFields, rdnFields, avaFields, attributesFields,
+	attributeFields, attributeValuesFields, explicitIntegerFields,
+	explicitExtensionsFields, extensionsFields, extensionFields,
+	basicConstraintsEncFields, basicConstraintsFields, keyUsageEncFields,
+	skidEncFields, akidEncFields, akidFields, ekuEncFields, ekuFields,
+	sanEncFields, ianEncFields, generalNamesFields, crlNumberEncFields,
+	crlReasonEncFields,
+	certificateFields, tbsCertificateFields, validityFields, spkiFields,
+	certificateListFields, tbsCertListFields, revokedCertsFields,
+	revokedCertFields,
+	contentInfoFields, dataContentFields, signedDataContentFields,
+	signedDataFields, digestAlgorithmsFields, encapContentInfoFields,
+	certificateSetFields, crlSetFields, signerInfosFields, signerInfoFields,
+	issuerAndSerialFields,
+	privateKeyInfoFields, encryptedPrivateKeyInfoFields,
+	pfxFields, pfxContentInfoFields, authSafeDataFields, authSafeEncFields,
+	authSafeFields, safeContentInfoFields, safeContentsDataFields,
+	safeContentsEncFields, encryptedDataContentFields, encryptedDataFields,
+	encryptedContentInfoFields, safeContentsFields, safeBagFields,
+	keyBagFields, shroudedKeyBagFields, certBagValueFields, certBagFields,
+	x509CertValueFields, crlBagValueFields, crlBagFields,
+	safeContentsBagFields, macDataFields, digestInfoFields
+	};
 
-	/* The following types are zero-length by definition */
-	if( item->tag == EOC || item->tag == NULLTAG )
-		return( TRUE );
+/* The types selected by OIDs */
+
+static const SCHEMA_SELECTOR extensionSelectors[] = {
+	{ SCHEMA_OID( "\x55\x1D\x0E" ), SCHEMA_TYPE_SKID_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x0F" ), SCHEMA_TYPE_KEY_USAGE_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x11" ), SCHEMA_TYPE_SAN_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x12" ), SCHEMA_TYPE_IAN_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x13" ), SCHEMA_TYPE_BASIC_CONSTRAINTS_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x14" ), SCHEMA_TYPE_CRL_NUMBER_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x15" ), SCHEMA_TYPE_CRL_REASON_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x23" ), SCHEMA_TYPE_AKID_ENC },
+	{ SCHEMA_OID( "\x55\x1D\x25" ), SCHEMA_TYPE_EKU_ENC },
+	{ NULL }
+	};
+static const SCHEMA_SELECTOR cmsContentSelectors[] = {
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x01" ), SCHEMA_TYPE_DATA_CONTENT },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x02" ), SCHEMA_TYPE_SIGNED_DATA_CONTENT },
+	{ NULL }
+	};
+static const SCHEMA_SELECTOR pfxContentSelectors[] = {
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x01" ), SCHEMA_TYPE_AUTH_SAFE_DATA },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x02" ), SCHEMA_TYPE_SIGNED_DATA_CONTENT },
+	{ NULL }
+	};
+static const SCHEMA_SELECTOR safeContentSelectors[] = {
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x01" ), SCHEMA_TYPE_SAFE_CONTENTS_DATA },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x07\x06" ), SCHEMA_TYPE_ENCRYPTED_DATA_CONTENT },
+	{ NULL }
+	};
+static const SCHEMA_SELECTOR safeBagSelectors[] = {
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x0C\x0A\x01\x01" ), SCHEMA_TYPE_KEY_BAG },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x0C\x0A\x01\x02" ), SCHEMA_TYPE_SHROUDED_KEY_BAG },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x0C\x0A\x01\x03" ), SCHEMA_TYPE_CERT_BAG_VALUE },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x0C\x0A\x01\x04" ), SCHEMA_TYPE_CRL_BAG_VALUE },
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x0C\x0A\x01\x06" ), SCHEMA_TYPE_SAFE_CONTENTS_BAG },
+	{ NULL }
+	};
+static const SCHEMA_SELECTOR certBagSelectors[] = {
+	{ SCHEMA_OID( "\x2A\x86\x48\x86\xF7\x0D\x01\x09\x16\x01" ), SCHEMA_TYPE_X509_CERT_VALUE },
+	{ NULL }
+	};
 
-	/* A real with a value of zero has zero length */
-	if( item->tag == REAL )
-		return( TRUE );
+static const SCHEMA_SELECTOR *const schemaSelectors[] = {
+	NULL, extensionSelectors, cmsContentSelectors, pfxContentSelectors,
+	safeContentSelectors, safeBagSelectors, certBagSelectors
+	};
 
-	/* Everything after this point requires input from the user to say that
-	   zero-length data is OK (usually it's not, so we flag it as a
-	   problem) */
-	if( !zeroLengthAllowed )
-		return( FALSE );
+/* The names used to select the top-level object type */
 
-	/* String types can have zero length except for the Unrestricted
-	   Character String type ([UNIVERSAL 29]) which has to have at least one
-	   octet for the CH-A/CH-B index */
-	if( item->tag == OCTETSTRING || item->tag == NUMERICSTRING || \
-		item->tag == PRINTABLESTRING || item->tag == T61STRING || \
-		item->tag == VIDEOTEXSTRING || item->tag == VISIBLESTRING || \
-		item->tag == IA5STRING || item->tag == GRAPHICSTRING || \
-		item->tag == GENERALSTRING || item->tag == UNIVERSALSTRING || \
-		item->tag == BMPSTRING || item->tag == UTF8STRING || \
-		item->tag == OBJDESCRIPTOR )
-		return( TRUE );
+typedef struct {
+	const char *name;
+	SCHEMA_TYPE type;
+	} SCHEMA_NAME;
+
+static const SCHEMA_NAME schemaNames[] = {
+	{ "cert", SCHEMA_TYPE_CERT_ROOT }, { "x509", SCHEMA_TYPE_CERT_ROOT },
+	{ "crl", SCHEMA_TYPE_CRL_ROOT }, { "cms", SCHEMA_TYPE_CMS_ROOT },
+	{ "pkcs8", SCHEMA_TYPE_PKCS8_ROOT }, { "pkcs12", SCHEMA_TYPE_PKCS12_ROOT },
+	{ NULL, SCHEMA_TYPE_NONE }
+	};
 
-	/* SEQUENCE and SET can be zero if there are absent optional/default
-	   components */
-	if( item->tag == SEQUENCE || item->tag == SET )
-		return( TRUE );
+/* The compiled schema.  Each state is a position in a field list, and the
+   transition for an identifier octet gives the state for the field that
+   the item with that identifier matches, or 0 if it doesn't match
+   anything.  We don't need to remember the state for the following field
+   since it's stored with the matched field */
+
+typedef struct {
+	const SCHEMA_FIELD *field;	/* Field at this position, NULL if none */
+	int nextState;				/* State after the field has been matched */
+	int contentState;			/* State for the field's contents */
+	} SCHEMA_STATE;
+
+static SCHEMA_STATE *schemaStates = NULL;
+static unsigned short *schemaTransitions = NULL;
+static int schemaTypeStart[ SCHEMA_TYPE_LAST ];
+
+/* The schema state for each nesting level: The state for the next item at
+   this level, the field matched by the current item, and the type selected
+   by an OID at this level, which is inherited by the levels below it */
+
+typedef struct {
+	int state;					/* State for next item */
+	int field;					/* State of field matched by current item */
+	int selected;				/* State for type selected by an OID */
+	} SCHEMA_LEVEL;
+
+static THREAD_LOCAL SCHEMA_LEVEL schemaLevels[ MAX_NESTING_LEVEL + 2 ];
+
+/* Select the schema for the top-level object by name */
+
+static int selectSchema( const char *name )
+	{
+	int i;
+
+	for( i = 0; schemaNames[ i ].name != NULL; i++ )
+		{
+		if( !strcmp( schemaNames[ i ].name, name ) )
+			{
+			schemaRoot = schemaNames[ i ].type;
+			return( TRUE );
+			}
+		}
 
 	return( FALSE );
 	}
 
-/* Check whether the next item looks like text */
+/* Compile the field lists into the state and transition tables */
 
-static STR_OPTION checkForText( FILE *inFile, const int length )
+static int compileSchema( void )
 	{
-	char buffer[ 16 ];
-	int isBMP = FALSE, isUnicode = FALSE;
-	int sampleLength = min( length, 16 ), i;
+	int noStates = 1, type, state;
 
-	/* If the sample is very short, we're more careful about what we
-	   accept */
-	if( sampleLength < 4 )
+	/* Make sure that the type and selector tables match their enums */
+	if( sizeof( schemaTypes ) / sizeof( SCHEMA_FIELD * ) != SCHEMA_TYPE_LAST || \
+		sizeof( schemaSelectors ) / sizeof( SCHEMA_SELECTOR * ) != SCHEMA_SELECT_LAST )
+		return( FALSE );
+
+	/* Assign a state to each position in each field list, including the
+	   end of the list */
+	for( type = 1; type < SCHEMA_TYPE_LAST; type++ )
 		{
-		/* If the sample size is too small, don't try anything */
-		if( sampleLength <= 2 )
-			return( STR_NONE );
+		const SCHEMA_FIELD *fields = schemaTypes[ type ];
+		int i;
 
-		/* For samples of 3-4 characters we only allow ASCII text.  These
-		   short strings are used in some places (eg PKCS #12 files) as
-		   IDs */
-		sampleLength = fread( buffer, 1, sampleLength, inFile );
-		if( sampleLength <= 0 )
-			return( STR_NONE );
-		fseek( inFile, -sampleLength, SEEK_CUR );
-		for( i = 0; i < sampleLength; i++ )
+		schemaTypeStart[ type ] = noStates;
+		for( i = 0; fields[ i ].name != NULL; i++ );
+		noStates += i + 1;
+		}
+	if( ( schemaStates = calloc( noStates, sizeof( SCHEMA_STATE ) ) ) == NULL || \
+		( schemaTransitions = calloc( noStates * 256,
+									  sizeof( unsigned short ) ) ) == NULL )
+		return( FALSE );
+
+	/* Fill in the states and the transitions out of them.  Starting from
+	   each position we look for a field that matches each identifier,
+	   skipping optional and repeated fields and alternatives that don't
+	   match */
+	for( type = 1; type < SCHEMA_TYPE_LAST; type++ )
+		{
+		const SCHEMA_FIELD *fields = schemaTypes[ type ];
+		int i;
+
+		state = schemaTypeStart[ type ];
+		for( i = 0; fields[ i ].name != NULL; i++ )
 			{
-			const int ch = byteToInt( buffer[ i ] );
+			SCHEMA_STATE *stateInfo = &schemaStates[ state + i ];
+			int next = i;
 
-			if( !( isalpha( ch ) || isdigit( ch ) || isspace( ch ) ) )
-				return( STR_NONE );
+			stateInfo->field = &fields[ i ];
+			if( !( fields[ i ].flags & SCHEMA_REPEAT ) )
+				{
+				while( fields[ next ].flags & SCHEMA_ALTERNATIVE )
+					next++;
+				next++;
+				}
+			stateInfo->nextState = state + next;
+			stateInfo->contentState = ( fields[ i ].type != SCHEMA_TYPE_NONE ) ? \
+									  schemaTypeStart[ fields[ i ].type ] : 0;
 			}
-		return( STR_IA5 );
-		}
+		for( i = 0; fields[ i ].name != NULL; i++ )
+			{
+			unsigned short *transitions = \
+							schemaTransitions + ( state + i ) * 256;
+			int id;
 
-	/* Check for ASCII-looking text */
-	sampleLength = fread( buffer, 1, sampleLength, inFile );
-	if( sampleLength <= 0 )
-		return( STR_NONE );
-	fseek( inFile, -sampleLength, SEEK_CUR );
-	if( isdigit( byteToInt( buffer[ 0 ] ) ) && \
-		( length == 13 || length == 15 ) && \
-		buffer[ length - 1 ] == 'Z' )
-		{
-		/* It looks like a time string, make sure that it really is one */
-		for( i = 0; i < length - 1; i++ )
-			{
-			if( !isdigit( byteToInt( buffer[ i ] ) ) )
-				break;
-			}
-		if( i == length - 1 )
-			return( ( length == 13 ) ? STR_UTCTIME : STR_GENERALIZED );
-		}
-	for( i = 0; i < sampleLength; i++ )
-		{
-		/* If even bytes are zero, it could be a BMPString.  Initially
-		   we set isBMP to FALSE, if it looks like a BMPString we set it to
-		   TRUE, if we then encounter a nonzero byte it's neither an ASCII
-		   nor a BMPString */
-		if( !( i & 1 ) )
-			{
-			if( !buffer[ i ] )
+			for( id = 0; id < 256; id++ )
 				{
-				/* If we thought we were in a Unicode string but we've found a
-				   zero byte where it'd occur in a BMP string, it's neither a
-				   Unicode nor BMP string */
-				if( isUnicode )
-					return( STR_NONE );
+				int j;
 
-				/* We've collapsed the eigenstate (in an earlier incarnation
-				   isBMP could take values of -1, 0, or 1, with 0 being
-				   undecided, in which case this comment made a bit more
-				   sense) */
-				if( i < sampleLength - 2 )
+				for( j = i; fields[ j ].name != NULL; j++ )
 					{
-					/* If the last char(s) are zero but preceding ones
-					   weren't, don't treat it as a BMP string.  This can
-					   happen when storing a null-terminated string if the
-					   implementation gets the length wrong and stores the
-					   null as well */
-					isBMP = TRUE;
+					if( fields[ j ].id == SCHEMA_ANY || fields[ j ].id == id )
+						{
+						transitions[ id ] = ( unsigned short ) ( state + j );
+						break;
+						}
+					if( !( fields[ j ].flags & ( SCHEMA_OPTIONAL | \
+							SCHEMA_REPEAT | SCHEMA_ALTERNATIVE ) ) )
+						break;
 					}
-				continue;
-				}
-			else
-				{
-				/* If we thought we were in a BMPString but we've found a
-				   nonzero byte where there should be a zero, it's neither
-				   an ASCII nor BMP string */
-				if( isBMP )
-					return( STR_NONE );
-				}
-			}
-		else
-			{
-			/* Just to make it tricky, Microsoft stuff Unicode strings into
-			   some places (to avoid having to convert them to BMPStrings,
-			   presumably) so we have to check for these as well */
-			if( !buffer[ i ] )
-				{
-				if( isBMP )
-					return( STR_NONE );
-				isUnicode = TRUE;
-				continue;
-				}
-			else
-				{
-				if( isUnicode )
-					return( STR_NONE );
 				}
 			}
-		if( buffer[ i ] < 0x20 || buffer[ i ] > 0x7E )
-			return( STR_NONE );
 		}
 
-	/* It looks like a text string */
-	return( isUnicode ? STR_BMP_REVERSED : isBMP ? STR_BMP : STR_IA5 );
+	return( TRUE );
 	}
 
-/* Dump the header bytes for an object, useful for vgrepping the original
-   object from a hex dump */
+/* Set up the schema state for a nesting level.  The top level always
+   starts with the root type, other levels start with the type of the
+   contents of the field matched by the item that contains them */
 
-static void dumpHeader( FILE *inFile, const ASN1_ITEM *item, const int level )
+static void startSchemaLevel( const int level )
 	{
-	int extraLen = 24 - item->headerSize, i;
+	SCHEMA_LEVEL *schemaLevel = &schemaLevels[ level ];
+	const SCHEMA_LEVEL *parentLevel;
+	const SCHEMA_STATE *parentField;
 
-	/* Dump the tag and length bytes */
-	if( !doPure )
-		printString( level, "%s", "    " );
-	printString( level, "<%02X", *item->header );
-	for( i = 1; i < item->headerSize; i++ )
-		printString( level, " %02X", item->header[ i ] );
-
-	/* If we're asked for more, dump enough extra data to make up 24 bytes.
-	   This is somewhat ugly since it assumes we can seek backwards over the
-	   data, which means it won't always work on streams */
-	if( extraLen > 0 && doDumpHeader > 1 )
+	if( level > MAX_NESTING_LEVEL )
+		return;
+	schemaLevel->field = 0;
+	if( level <= 0 )
 		{
-		/* Make sure that we don't print too much data.  This doesn't work
-		   for indefinite-length data, we don't try and guess the length with
-		   this since it involves picking apart what we're printing */
-		if( extraLen > item->length && !item->indefinite )
-			extraLen = ( int ) item->length;
-
-		for( i = 0; i < extraLen; i++ )
-			{
-			const int ch = fgetc( inFile );
-
-			if( ch == EOF )
-				{
-				/* Exit loop and get fseek() offset correct */
-				extraLen = i;
-				break;
-				}
-			printString( level, " %02X", ch );
-			}
-		fseek( inFile, -extraLen, SEEK_CUR );
+		schemaLevel->state = schemaTypeStart[ schemaRoot ];
+		schemaLevel->selected = 0;
+		return;
 		}
-
-	printString( level, "%s", ">\n" );
+	parentLevel = &schemaLevels[ level - 1 ];
+	parentField = &schemaStates[ parentLevel->field ];
+	schemaLevel->selected = parentLevel->selected;
+	if( parentField->field != NULL && \
+		( parentField->field->flags & SCHEMA_DEFINED_BY ) )
+		schemaLevel->state = parentLevel->selected;
+	else
+		schemaLevel->state = parentField->contentState;
 	}
 
-/* Print a constructed ASN.1 object */
-
-static int printAsn1( FILE *inFile, const int level, long length,
-					  const int isIndefinite );
-
-static void markConstructed( const int level, const ASN1_ITEM *item )
-	{
-	/* If it's a type that's not normally constructed, tag it as such */
-	if( item->id == BOOLEAN || item->id == INTEGER || \
-		item->id == BITSTRING || item->id == OCTETSTRING || \
-		item->id == ENUMERATED	|| item->id == UTF8STRING || \
-		( item->id >= NUMERICSTRING && item->id <= BMPSTRING ) )
-		printString( level, "%s", " (constructed)" );
-	}
+/* Match an item at a nesting level against the schema */
 
-static void printConstructed( FILE *inFile, int level, const ASN1_ITEM *item )
+static void matchSchemaItem( const int level, const ASN1_ITEM *item )
 	{
-	int result;
+	SCHEMA_LEVEL *schemaLevel = &schemaLevels[ level ];
+	int field;
 
-	/* Special case for zero-length objects */
-	if( !item->length && !item->indefinite )
+	if( level > MAX_NESTING_LEVEL )
+		return;
+	if( item->header[ 0 ] == EOC )
 		{
-		printString( level, "%s", " {}\n" );
-		if( item->nonCanonical )
-			complainLengthCanonical( item, level );
+		schemaLevel->field = 0;
 		return;
 		}
+	field = schemaTransitions[ schemaLevel->state * 256 + item->header[ 0 ] ];
+	schemaLevel->field = field;
+	schemaLevel->state = schemaStates[ field ].nextState;
+	}
 
-	printString( level, "%s", " {\n" );
-	if( item->nonCanonical )
-		complainLengthCanonical( item, level );
-	result = printAsn1( inFile, level + 1, item->length, item->indefinite );
-	if( result )
+/* If the OID at this level selects the type of a following field,
+   remember the type */
+
+static void selectSchemaType( const int level, const BYTE *oid,
+							  const int oidLength )
+	{
+	SCHEMA_LEVEL *schemaLevel = &schemaLevels[ level ];
+	const SCHEMA_FIELD *field;
+	const SCHEMA_SELECTOR *selector;
+
+	if( level > MAX_NESTING_LEVEL )
+		return;
+	field = schemaStates[ schemaLevel->field ].field;
+	if( field == NULL || field->selector == SCHEMA_SELECT_NONE )
+		return;
+	schemaLevel->selected = 0;
+	for( selector = schemaSelectors[ field->selector ];
+		 selector->oid != NULL; selector++ )
 		{
-		fprintf( output, "Error: Inconsistent object length, %d byte%s "
-				 "difference.\n", result, ( result > 1 ) ? "s" : "" );
-		noErrors++;
+		if( selector->oidLength == oidLength && \
+			!memcmp( selector->oid, oid, oidLength ) )
+			{
+			schemaLevel->selected = schemaTypeStart[ selector->type ];
+			break;
+			}
 		}
-	if( !doPure )
-		printString( level, "%s", INDENT_STRING );
-	printString( level, "%s", ( printDots ) ? ". " : "  " );
-	doIndent( level );
-	printString( level, "%s", "}\n" );
 	}
 
-/* Print a single ASN.1 object */
+/* Print the label for the item at this level, made up of the names of the
+   fields at each level down to it.  This is called for every item, so we
+   assemble the label in a buffer and write it in one go rather than
+   writing each name separately */
 
-static void printASN1object( FILE *inFile, ASN1_ITEM *item, int level )
+static void printSchemaLabel( const int level )
 	{
-	OIDINFO *oidInfo;
-	STR_OPTION stringType;
-	BYTE buffer[ MAX_OID_SIZE ];
-	const int nonOutlineObject = \
-			( doOutlineOnly && ( item->id & FORM_MASK ) != CONSTRUCTED ) ? \
-			TRUE : FALSE;
-	int ch;
+	const SCHEMA_FIELD *field;
+	char buffer[ 512 ];
+	int length = 0, i;
 
-	if( ( item->id & CLASS_MASK ) != UNIVERSAL )
+	if( level >= maxNestLevel || level > MAX_NESTING_LEVEL )
+		return;
+	field = schemaStates[ schemaLevels[ level ].field ].field;
+	if( field == NULL || !*field->name )
+		return;
+	for( i = 0; i <= level; i++ )
 		{
-		static const char *const classtext[] =
-			{ "UNIVERSAL ", "APPLICATION ", "", "PRIVATE " };
+		const SCHEMA_FIELD *levelField = \
+						schemaStates[ schemaLevels[ i ].field ].field;
+		const char *name;
+		int nameLength;
 
-		/* Print the object type */
-		if( !nonOutlineObject )
+		if( levelField == NULL || !*levelField->name )
+			continue;
+		name = levelField->name;
+		nameLength = strlen( name );
+		if( length + nameLength + 1 > ( int ) sizeof( buffer ) )
 			{
-			printString( level, "[%s%d]",
-						 classtext[ ( item->id & CLASS_MASK ) >> 6 ], item->tag );
+			fwrite( buffer, 1, length, output );
+			length = 0;
 			}
+		memcpy( buffer + length, name, nameLength );
+		length += nameLength;
+		buffer[ length++ ] = ( i < level ) ? '.' : ' ';
+		}
+	fwrite( buffer, 1, length, output );
+	}
 
-		/* Perform a sanity check */
-		if( ( item->tag != NULLTAG ) && ( item->length < 0 ) )
-			{
-			int i;
+/****************************************************************************
+*																			*
+*								ASN.1 Parsing Routines						*
+*																			*
+****************************************************************************/
 
-			fflush( stdout );
-			fprintf( stderr, "\nError: Object has bad length field, tag = %02X, "
-					 "length = %lX, value =", item->tag, item->length );
-			fprintf( stderr, "<%02X", *item->header );
-			for( i = 1; i < item->headerSize; i++ )
-				fprintf( stderr, " %02X", item->header[ i ] );
-			fputs( ">.\n", stderr );
-			exit( EXIT_FAILURE );
-			}
+/* Get an ASN.1 object's tag and length.  Returns TRUE for an item
+   available, FALSE for end-of-data, and a negative value for an invalid
+   data */
 
-		if( !item->length && !item->indefinite && !zeroLengthOK( item ) )
-			{
-			printString( level, "%c", '\n' );
-			complain( "Object has zero length", 0, level );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
-			return;
-			}
+static int getItem( FILE *inFile, ASN1_ITEM *item )
+	{
+	int tag, length, index = 0;
 
-		/* If it's constructed, print the various fields in it */
-		if( ( item->id & FORM_MASK ) == CONSTRUCTED )
+	memset( item, 0, sizeof( ASN1_ITEM ) );
+	item->indefinite = FALSE;
+	tag = fgetc( inFile );
+	if( tag == EOF )
+		return( FALSE );
+	item->header[ index++ ] = tag;
+	fPos++;
+	item->id = tag & ~TAG_MASK;
+	tag &= TAG_MASK;
+	if( tag == TAG_MASK )
+		{
+		int value;
+
+		/* Long tag encoded as sequence of 7-bit values.  This doesn't try to
+		   handle tags > INT_MAX, it'd be pretty peculiar ASN.1 if it had to
+		   use tags this large */
+		tag = 0;
+		do
 			{
-			markConstructed( level, item );
-			printConstructed( inFile, level, item );
-			return;
+			value = fgetc( inFile );
+			if( value == EOF )
+				return( FALSE );
+			tag = ( tag << 7 ) | ( value & 0x7F );
+			item->header[ index++ ] = value;
+			fPos++;
 			}
+		while( value & LEN_XTND && index < 5 && !feof( inFile ) );
+		if( index >= 5 )
+			return( FALSE );
+		}
+	item->tag = tag;
+	length = fgetc( inFile );
+	if( length == EOF )
+		return( FALSE );
+	fPos++;
+	item->header[ index++ ] = length;
+	item->headerSize = index;
+	if( length & LEN_XTND )
+		{
+		const int lengthStart = index;
+		int i;
 
-		/* It'sprimitive, if we're only displaying the ASN.1 in outline
-		   form, supress the display by dumping it with a nesting level that
-		   ensures it won't get output (this clears the data from the input
-		   without displaying it) */
-		if( nonOutlineObject )
+		length &= LEN_MASK;
+		if( length > 4 )
 			{
-			dumpHex( inFile, item->length, 1000, DUMPHEX_NORMAL, 0 );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
-			printString( level, "%c", '\n' );
-			return;
+			/* Impossible length value, probably because we've run into
+			   the weeds */
+			return( -1 );
 			}
-
-		/* It's primitive, if it's a seekable stream try and determine
-		   whether it's text so we can display it as such */
-		if( !useStdin && \
-			( stringType = checkForText( inFile, item->length ) ) != STR_NONE )
+		item->headerSize += length;
+		item->length = 0;
+		if( !length )
+			item->indefinite = TRUE;
+		for( i = 0; i < length; i++ )
 			{
-			/* It looks like a text string, dump it as text */
-			displayString( inFile, item->length, level, stringType );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
-			return;
+			int ch = fgetc( inFile );
+
+			if( ch == EOF )
+				{
+				fPos += length - i;
+				return( FALSE );
+				}
+			item->length = ( item->length << 8 ) | ch;
+			item->header[ i + index ] = ch;
+			}
+		fPos += length;
+
+		/* Check for the length being less then 128, which means it
+		   shouldn't be encoded as a long length */
+		if( !item->indefinite && item->length < 128 )
+			item->nonCanonical = lengthStart;
+
+		/* Check for the first 9 bits of the length being identical and
+		   if they are, remember where the encoded non-canonical length
+		   starts */
+		if( item->headerSize - lengthStart > 1 )
+			{
+			if( ( item->header[ lengthStart ] == 0x00 ) && \
+				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x00 ) )
+				item->nonCanonical = lengthStart - 1;
+			if( ( item->header[ lengthStart ] == 0xFF ) && \
+				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x80 ) )
+				item->nonCanonical = lengthStart - 1;
+			}
+		}
+	else
+		item->length = length;
+
+	return( TRUE );
+	}
+
+/* Get an ASN.1 object's tag and length from a block of memory, with the
+   same return values as getItem().  This, getNextMemItem(), and
+   getMemField() are also used as the parsing core for the Swift package in
+   Sources/ASN1/CDumpASN1, so any changes need to be made there as well */
+
+static int getMemItem( const BYTE *data, const long dataLength,
+					   ASN1_ITEM *item )
+	{
+	int tag, length, index = 0;
+
+	memset( item, 0, sizeof( ASN1_ITEM ) );
+	if( dataLength < 1 )
+		return( FALSE );
+	tag = data[ index ];
+	item->header[ index++ ] = tag;
+	item->id = tag & ~TAG_MASK;
+	tag &= TAG_MASK;
+	if( tag == TAG_MASK )
+		{
+		int value;
+
+		/* Long tag encoded as sequence of 7-bit values, see getItem() */
+		tag = 0;
+		do
+			{
+			if( index >= dataLength )
+				return( FALSE );
+			value = data[ index ];
+			tag = ( tag << 7 ) | ( value & 0x7F );
+			item->header[ index++ ] = value;
+			}
+		while( value & LEN_XTND && index < 5 );
+		if( index >= 5 )
+			return( FALSE );
+		}
+	item->tag = tag;
+	if( index >= dataLength )
+		return( FALSE );
+	length = data[ index ];
+	item->header[ index++ ] = length;
+	item->headerSize = index;
+	if( length & LEN_XTND )
+		{
+		const int lengthStart = index;
+		int i;
+
+		length &= LEN_MASK;
+		if( length > 4 )
+			return( -1 );
+		item->headerSize += length;
+		if( !length )
+			item->indefinite = TRUE;
+		if( index + length > dataLength )
+			return( FALSE );
+		for( i = 0; i < length; i++ )
+			{
+			const int ch = data[ index + i ];
+
+			item->length = ( item->length << 8 ) | ch;
+			item->header[ i + index ] = ch;
+			}
+
+		/* Check for non-canonical length encodings, see getItem() */
+		if( !item->indefinite && item->length < 128 )
+			item->nonCanonical = lengthStart;
+		if( item->headerSize - lengthStart > 1 )
+			{
+			if( ( item->header[ lengthStart ] == 0x00 ) && \
+				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x00 ) )
+				item->nonCanonical = lengthStart - 1;
+			if( ( item->header[ lengthStart ] == 0xFF ) && \
+				( ( item->header[ lengthStart + 1 ] & 0x80 ) == 0x80 ) )
+				item->nonCanonical = lengthStart - 1;
+			}
+		}
+	else
+		item->length = length;
+
+	return( TRUE );
+	}
+
+/* Get the next definite-length item from a block of memory, returning a
+   pointer to its contents and moving the data pointer past it.  This lets
+   us skip over items using only their lengths when we're only interested
+   in a few fields in an object */
+
+static const BYTE *getNextMemItem( const BYTE **dataPtr, long *dataLeft,
+								   ASN1_ITEM *item )
+	{
+	const BYTE *content;
+
+	if( getMemItem( *dataPtr, *dataLeft, item ) <= 0 || \
+		item->indefinite || item->length < 0 || \
+		item->length > *dataLeft - item->headerSize )
+		return( NULL );
+	content = *dataPtr + item->headerSize;
+	*dataPtr = content + item->length;
+	*dataLeft -= item->headerSize + item->length;
+
+	return( content );
+	}
+
+/* Open a block of memory as an input stream for the stream-based parsing
+   code.  If there's no support for memory streams we copy the data to a
+   temporary file */
+
+static FILE *openMemStream( const BYTE *data, const long length )
+	{
+	FILE *inFile;
+
+#ifdef USE_THREADS
+	inFile = fmemopen( ( void * ) data, length, "rb" );
+#else
+	if( ( inFile = tmpfile() ) != NULL )
+		{
+		if( fwrite( data, 1, length, inFile ) != ( size_t ) length )
+			{
+			fclose( inFile );
+			return( NULL );
+			}
+		rewind( inFile );
+		}
+#endif /* USE_THREADS */
+
+	return( inFile );
+	}
+
+/* Check whether a BIT STRING or OCTET STRING encapsulates another object */
+
+static int checkEncapsulate( FILE *inFile, const int length )
+	{
+	ASN1_ITEM nestedItem;
+	const int currentPos = fPos;
+	int diffPos, status;
+
+	/* If we're not looking for encapsulated objects, return */
+	if( !checkEncaps )
+		return( FALSE );
+
+	/* An item of length < 2 can never have encapsulated data.  Even for
+	   length 2 it can only be an encapsulated NULL, which is somewhat odd,
+	   but no doubt there's some PKI protocol somewhere that does this */
+	if( length < 2 )
+		return( FALSE );
+
+	/* Read the details of the next item in the input stream */
+	status = getItem( inFile, &nestedItem );
+	diffPos = fPos - currentPos;
+	fPos = currentPos;
+	fseek( inFile, -diffPos, SEEK_CUR );
+	if( status <= 0 )
+		return( FALSE );
+
+	/* If it's not a standard tag class, don't try and dig down into it */
+	if( ( nestedItem.id & CLASS_MASK ) != UNIVERSAL && \
+		( nestedItem.id & CLASS_MASK ) != CONTEXT )
+		return( FALSE );
+
+	/* There is one special-case situation that overrides the check below,
+	   which is when the nested content is indefinite-length.  This is
+	   rather tricky to check for because we'd need to read some distance
+	   ahead into the stream to be able to safely decide whether we've got
+	   true nested content or a false positive, for now we require that
+	   the nested content has to be a SEQUENCE containing valid ASN.1 at
+	   the start, giving about 24 bits of checking.  There's a small risk
+	   of false negatives for encapsulated primitive items, but since
+	   they're primitive it should be relatively easy to make out the
+	   contents inside the OCTET STRING */
+	if( nestedItem.tag == SEQUENCE && nestedItem.indefinite )
+		{
+		/* Skip the indefinite-length SEQUENCE and make sure that it's
+		   followed by a valid item */
+		status = getItem( inFile, &nestedItem );
+		if( status > 0 )
+			status = getItem( inFile, &nestedItem );
+		diffPos = fPos - currentPos;
+		fPos = currentPos;
+		fseek( inFile, -diffPos, SEEK_CUR );
+		if( status <= 0 )
+			return( FALSE );
+
+		/* If the tag on the nest item looks vaguely valid, assume that we've
+		   go nested content */
+		if( ( nestedItem.tag <= 0 || nestedItem.tag > 0x31 ) || \
+			( nestedItem.length >= length ) )
+			return( FALSE );
+		return( TRUE );
+		}
+
+	/* If it doesn't fit exactly within the current item it's not an
+	   encapsulated object */
+	if( nestedItem.length != length - diffPos )
+		return( FALSE );
+
+	/* If it doesn't have a valid-looking tag, don't try and go any further */
+	if( nestedItem.tag <= 0 || nestedItem.tag > 0x31 )
+		return( FALSE );
+
+	/* Now things get a bit complicated because it's possible to get some
+	   (very rare) false positives, for example if a NUMERICSTRING of
+	   exactly the right length is nested within an OCTET STRING, since
+	   numeric values all look like constructed tags of some kind.  To
+	   handle this we look for nested constructed items that should really
+	   be primitive */
+	if( ( nestedItem.id & FORM_MASK ) == PRIMITIVE )
+		return( TRUE );
+
+	/* It's constructed, make sure that it's something for which it makes
+	   sense as a constructed object.  At worst this will give some false
+	   negatives for really wierd objects (nested constructed strings inside
+	   OCTET STRINGs), but these should probably never occur anyway */
+	if( nestedItem.tag == SEQUENCE || \
+		nestedItem.tag == SET )
+		return( TRUE );
+
+	return( FALSE );
+	}
+
+#ifdef USE_THREADS
+
+/* Commit a speculative decode once the first item has passed the checks.
+   Since any errors reported during the speculative decode could have been
+   rolled back, we only check them against the error budget now */
+
+static void commitEncapsulatedItem( void )
+	{
+	commitEncapsulated();
+	if( recordDiagnostics && maxErrors >= 0 && noErrors > maxErrors )
+		stopDecoding( DIAG_STOP_MAX_ERRORS );
+	}
+
+/* Check the first encapsulated item, rolling back the speculative decode
+   if it doesn't look like encapsulated data */
+
+static void checkEncapsulatedItem( const ASN1_ITEM *item )
+	{
+	const long length = encapsState.length;
+
+	/* If it's the item following an indefinite-length SEQUENCE, the tag
+	   has to look vaguely valid */
+	if( encapsState.checkNested )
+		{
+		if( item->tag <= 0 || item->tag > 0x31 || item->length >= length )
+			longjmp( encapsRollback, 1 );
+		commitEncapsulatedItem();
+		return;
+		}
+
+	/* Otherwise the checks are the same as those in checkEncapsulate() */
+	if( ( item->id & CLASS_MASK ) != UNIVERSAL && \
+		( item->id & CLASS_MASK ) != CONTEXT )
+		longjmp( encapsRollback, 1 );
+	if( item->tag == SEQUENCE && item->indefinite )
+		{
+		encapsState.checkNested = TRUE;
+		return;
+		}
+	if( item->length != length - item->headerSize || \
+		item->tag <= 0 || item->tag > 0x31 )
+		longjmp( encapsRollback, 1 );
+	if( ( item->id & FORM_MASK ) == CONSTRUCTED && \
+		item->tag != SEQUENCE && item->tag != SET )
+		longjmp( encapsRollback, 1 );
+	commitEncapsulatedItem();
+	}
+#endif /* USE_THREADS */
+
+/* If a BIT STRING or OCTET STRING encapsulates another object, print it
+   as a constructed item.  Returns FALSE, with the input at the start of
+   the contents, if it doesn't */
+
+static void printConstructed( FILE *inFile, int level,
+							  const ASN1_ITEM *item );
+
+static int printEncapsulated( FILE *inFile, const ASN1_ITEM *item,
+							  const int level )
+	{
+#ifdef USE_THREADS
+	const long startPos = fPos, savedDiagCount = diagCount;
+	const long savedItemPos = diagItemPos;
+	const int savedErrors = noErrors, savedWarnings = noWarnings;
+#endif /* USE_THREADS */
+
+	if( !checkEncaps || item->length < 2 )
+		return( FALSE );
+
+#ifdef USE_THREADS
+	/* Decode the contents speculatively into the checkpoint buffer.  We
+	   don't do this if the nested content could run into the nesting
+	   limit before it's checked, since that's a fatal error */
+	if( encapsState.stream == NULL )
+		{
+		encapsState.stream = open_memstream( &encapsState.buffer,
+											 &encapsState.bufSize );
+		}
+	if( level + 2 < MAX_NESTING_LEVEL && encapsState.level < 0 && \
+		encapsState.stream != NULL )
+		{
+		encapsState.level = level + 1;
+		encapsState.length = item->length;
+		encapsState.checkNested = FALSE;
+		encapsState.savedOutput = output;
+		rewind( encapsState.stream );
+		output = encapsState.stream;
+		if( setjmp( encapsRollback ) )
+			{
+			/* It's not encapsulated data, discard the output and go back
+			   to the start of the contents */
+			output = encapsState.savedOutput;
+			encapsState.level = -1;
+			fseek( inFile, startPos - fPos, SEEK_CUR );
+			fPos = startPos;
+			noErrors = savedErrors;
+			noWarnings = savedWarnings;
+			diagCount = savedDiagCount;
+			diagItemPos = savedItemPos;
+			return( FALSE );
+			}
+		printString( level, "%s", ", encapsulates" );
+		printConstructed( inFile, level, item );
+		if( encapsState.level >= 0 )
+			{
+			ASN1_ITEM nextItem;
+			const long endPos = fPos;
+			int status;
+
+			/* The contents ended with an indefinite-length SEQUENCE header
+			   before there was an item to check, in which case we check
+			   the one that follows it as checkEncapsulate() does */
+			status = getItem( inFile, &nextItem );
+			fseek( inFile, endPos - fPos, SEEK_CUR );
+			fPos = endPos;
+			if( status <= 0 )
+				longjmp( encapsRollback, 1 );
+			checkEncapsulatedItem( &nextItem );
+			}
+		return( TRUE );
+		}
+#endif /* USE_THREADS */
+
+	if( !checkEncapsulate( inFile, item->length ) )
+		return( FALSE );
+
+	/* It's something encapsulated inside the string, print it as a
+	   constructed item */
+	printString( level, "%s", ", encapsulates" );
+	printConstructed( inFile, level, item );
+	return( TRUE );
+	}
+
+/* Check whether a zero-length item is OK */
+
+static int zeroLengthOK( const ASN1_ITEM *item )
+	{
+	/* An implicitly-tagged NULL can have a zero length.  An occurrence of this
+	   type of item is almost always an error, however OCSP uses a weird status
+	   encoding that encodes result values in tags and then has to use a NULL
+	   value to indicate that there's nothing there except the tag that encodes
+	   the status, so we allow this as well if zero-length content is explicitly
+	   enabled */
+	if( zeroLengthAllowed && ( item->id & CLASS_MASK ) == CONTEXT )
+		return( TRUE );
+
+	/* If we can't recognise the type from the tag, reject it */
+	if( ( item->id & CLASS_MASK ) != UNIVERSAL )
+		return( FALSE );
+
+	/* The following types are zero-length by definition */
+	if( item->tag == EOC || item->tag == NULLTAG )
+		return( TRUE );
+
+	/* A real with a value of zero has zero length */
+	if( item->tag == REAL )
+		return( TRUE );
+
+	/* Everything after this point requires input from the user to say that
+	   zero-length data is OK (usually it's not, so we flag it as a
+	   problem) */
+	if( !zeroLengthAllowed )
+		return( FALSE );
+
+	/* String types can have zero length except for the Unrestricted
+	   Character String type ([UNIVERSAL 29]) which has to have at least one
+	   octet for the CH-A/CH-B index */
+	if( item->tag == OCTETSTRING || item->tag == NUMERICSTRING || \
+		item->tag == PRINTABLESTRING || item->tag == T61STRING || \
+		item->tag == VIDEOTEXSTRING || item->tag == VISIBLESTRING || \
+		item->tag == IA5STRING || item->tag == GRAPHICSTRING || \
+		item->tag == GENERALSTRING || item->tag == UNIVERSALSTRING || \
+		item->tag == BMPSTRING || item->tag == UTF8STRING || \
+		item->tag == OBJDESCRIPTOR )
+		return( TRUE );
+
+	/* SEQUENCE and SET can be zero if there are absent optional/default
+	   components */
+	if( item->tag == SEQUENCE || item->tag == SET )
+		return( TRUE );
+
+	return( FALSE );
+	}
+
+/* Check whether the next item looks like text */
+
+#define EVEN_BYTES	0x5555		/* Mask for bytes at even positions */
+
+static STR_OPTION checkForText( FILE *inFile, const int length )
+	{
+	char buffer[ 16 ];
+	int zeroMask, textMask, validMask, bmpMask, unicodeMask;
+	int isBMP = FALSE, isUnicode = FALSE;
+	int sampleLength = min( length, 16 ), i;
+
+	/* If the sample is very short, we're more careful about what we
+	   accept */
+	if( sampleLength < 4 )
+		{
+		/* If the sample size is too small, don't try anything */
+		if( sampleLength <= 2 )
+			return( STR_NONE );
+
+		/* For samples of 3-4 characters we only allow ASCII text.  These
+		   short strings are used in some places (eg PKCS #12 files) as
+		   IDs */
+		sampleLength = fread( buffer, 1, sampleLength, inFile );
+		if( sampleLength <= 0 )
+			return( STR_NONE );
+		fseek( inFile, -sampleLength, SEEK_CUR );
+		for( i = 0; i < sampleLength; i++ )
+			{
+			const int ch = byteToInt( buffer[ i ] );
+
+			if( !( isalpha( ch ) || isdigit( ch ) || isspace( ch ) ) )
+				return( STR_NONE );
+			}
+		return( STR_IA5 );
+		}
+
+	/* Check for ASCII-looking text */
+	sampleLength = fread( buffer, 1, sampleLength, inFile );
+	if( sampleLength <= 0 )
+		return( STR_NONE );
+	fseek( inFile, -sampleLength, SEEK_CUR );
+	if( isdigit( byteToInt( buffer[ 0 ] ) ) && \
+		( length == 13 || length == 15 ) && \
+		buffer[ length - 1 ] == 'Z' )
+		{
+		/* It looks like a time string, make sure that it really is one */
+		for( i = 0; i < length - 1; i++ )
+			{
+			if( !isdigit( byteToInt( buffer[ i ] ) ) )
+				break;
+			}
+		if( i == length - 1 )
+			return( ( length == 13 ) ? STR_UTCTIME : STR_GENERALIZED );
+		}
+
+	/* Classify the bytes in the sample, with each bit in the masks
+	   corresponding to one byte.  Any nonzero bytes have to be ASCII text
+	   characters */
+	getTextMasks( ( const BYTE * ) buffer, sampleLength, &zeroMask,
+				  &textMask );
+	validMask = ( 1 << sampleLength ) - 1;
+	if( ~zeroMask & ~textMask & validMask )
+		return( STR_NONE );
+
+	/* If even bytes are zero, it could be a BMPString, in which case all
+	   of the following even bytes have to be zero and all odd bytes
+	   nonzero, otherwise it's neither an ASCII nor a BMPString.  If the
+	   last char(s) are zero but preceding ones weren't, we don't treat it
+	   as a BMP string.  This can happen when storing a null-terminated
+	   string if the implementation gets the length wrong and stores the
+	   null as well */
+	bmpMask = zeroMask & EVEN_BYTES & ( ( 1 << ( sampleLength - 2 ) ) - 1 );
+	if( bmpMask )
+		{
+		const int followingMask = validMask & \
+								  ~( ( ( bmpMask & -bmpMask ) << 1 ) - 1 );
+
+		if( ( ~zeroMask & EVEN_BYTES & followingMask ) || \
+			( zeroMask & ~EVEN_BYTES & followingMask ) )
+			return( STR_NONE );
+		isBMP = TRUE;
+		}
+
+	/* Just to make it tricky, Microsoft stuff Unicode strings into some
+	   places (to avoid having to convert them to BMPStrings, presumably)
+	   so we have to check for these as well, which have the opposite
+	   pattern of zero bytes */
+	unicodeMask = zeroMask & ~EVEN_BYTES;
+	if( unicodeMask )
+		{
+		const int followingMask = validMask & \
+							~( ( ( unicodeMask & -unicodeMask ) << 1 ) - 1 );
+
+		if( ( zeroMask & EVEN_BYTES & followingMask ) || \
+			( ~zeroMask & ~EVEN_BYTES & followingMask ) )
+			return( STR_NONE );
+		isUnicode = TRUE;
+		}
+
+	/* It looks like a text string */
+	return( isUnicode ? STR_BMP_REVERSED : isBMP ? STR_BMP : STR_IA5 );
+	}
+
+/* Dump the header bytes for an object, useful for vgrepping the original
+   object from a hex dump */
+
+static void dumpHeader( FILE *inFile, const ASN1_ITEM *item, const int level )
+	{
+	int extraLen = 24 - item->headerSize, i;
+
+	/* Dump the tag and length bytes */
+	if( !doPure )
+		printString( level, "%s", "    " );
+	printString( level, "<%02X", *item->header );
+	for( i = 1; i < item->headerSize; i++ )
+		printString( level, " %02X", item->header[ i ] );
+
+	/* If we're asked for more, dump enough extra data to make up 24 bytes.
+	   This is somewhat ugly since it assumes we can seek backwards over the
+	   data, which means it won't always work on streams */
+	if( extraLen > 0 && doDumpHeader > 1 )
+		{
+		/* Make sure that we don't print too much data.  This doesn't work
+		   for indefinite-length data, we don't try and guess the length with
+		   this since it involves picking apart what we're printing */
+		if( extraLen > item->length && !item->indefinite )
+			extraLen = ( int ) item->length;
+
+		for( i = 0; i < extraLen; i++ )
+			{
+			const int ch = fgetc( inFile );
+
+			if( ch == EOF )
+				{
+				/* Exit loop and get fseek() offset correct */
+				extraLen = i;
+				break;
+				}
+			printString( level, " %02X", ch );
+			}
+		fseek( inFile, -extraLen, SEEK_CUR );
+		}
+
+	printString( level, "%s", ">\n" );
+	}
+
+/* Print a constructed ASN.1 object */
+
+static int printAsn1( FILE *inFile, const int level, long length,
+					  const int isIndefinite );
+#ifdef USE_THREADS
+static long decodeParallel( FILE *inFile, const int level, long length,
+							int *parallelOK );
+static int processDisplayOption( const char **argPtrPtr,
+								 const char **errorString );
+#endif /* USE_THREADS */
+
+static void markConstructed( const int level, const ASN1_ITEM *item )
+	{
+	/* If it's a type that's not normally constructed, tag it as such */
+	if( item->id == BOOLEAN || item->id == INTEGER || \
+		item->id == BITSTRING || item->id == OCTETSTRING || \
+		item->id == ENUMERATED	|| item->id == UTF8STRING || \
+		( item->id >= NUMERICSTRING && item->id <= BMPSTRING ) )
+		printString( level, "%s", " (constructed)" );
+	}
+
+static void printConstructed( FILE *inFile, int level, const ASN1_ITEM *item )
+	{
+	const long itemPos = diagItemPos;
+	int result;
+
+	/* Special case for zero-length objects */
+	if( !item->length && !item->indefinite )
+		{
+		printString( level, "%s", " {}\n" );
+		if( item->nonCanonical )
+			complainLengthCanonical( item, level );
+		return;
+		}
+
+	printString( level, "%s", " {\n" );
+	if( item->nonCanonical )
+		complainLengthCanonical( item, level );
+	if( schemaRoot != SCHEMA_TYPE_NONE )
+		startSchemaLevel( level + 1 );
+	result = printAsn1( inFile, level + 1, item->length, item->indefinite );
+	diagItemPos = itemPos;
+	if( result )
+		{
+		fprintf( output, "Error: Inconsistent object length, %d byte%s "
+				 "difference.\n", result, ( result > 1 ) ? "s" : "" );
+		noErrors++;
+		addDiagnostic( DIAG_LENGTH_INCONSISTENT, result, level, TRUE );
+		}
+	if( !doPure )
+		printInfoIndent( level );
+	printString( level, "%s", ( printDots ) ? ". " : "  " );
+	doIndent( level );
+	printString( level, "%s", "}\n" );
+	}
+
+/* Print a single ASN.1 object */
+
+static void printASN1object( FILE *inFile, ASN1_ITEM *item, int level )
+	{
+	const OIDINFO *oidInfo;
+	STR_OPTION stringType;
+	BYTE buffer[ MAX_OID_SIZE ];
+	const int nonOutlineObject = \
+			( doOutlineOnly && ( item->id & FORM_MASK ) != CONSTRUCTED ) ? \
+			TRUE : FALSE;
+	int ch = 0;
+
+	if( ( item->id & CLASS_MASK ) != UNIVERSAL )
+		{
+		static const char *const classtext[] =
+			{ "UNIVERSAL ", "APPLICATION ", "", "PRIVATE " };
+
+		/* Print the object type */
+		if( !nonOutlineObject )
+			{
+			printString( level, "[%s%d]",
+						 classtext[ ( item->id & CLASS_MASK ) >> 6 ], item->tag );
+			}
+
+		/* Perform a sanity check */
+		if( ( item->tag != NULLTAG ) && ( item->length < 0 ) )
+			{
+			int i;
+
+			abortWorker();
+			fatalDiagnostic( DIAG_LENGTH_BAD, item->length, level );
+			fflush( stdout );
+			fprintf( stderr, "\nError: Object has bad length field, tag = %02X, "
+					 "length = %lX, value =", item->tag, item->length );
+			fprintf( stderr, "<%02X", *item->header );
+			for( i = 1; i < item->headerSize; i++ )
+				fprintf( stderr, " %02X", item->header[ i ] );
+			fputs( ">.\n", stderr );
+			exit( EXIT_FAILURE );
+			}
+
+		if( !item->length && !item->indefinite && !zeroLengthOK( item ) )
+			{
+			printString( level, "%c", '\n' );
+			complain( DIAG_ZERO_LENGTH, "Object has zero length", 0, level );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			return;
+			}
+
+		/* If it's constructed, print the various fields in it */
+		if( ( item->id & FORM_MASK ) == CONSTRUCTED )
+			{
+			markConstructed( level, item );
+			printConstructed( inFile, level, item );
+			return;
+			}
+
+		/* It'sprimitive, if we're only displaying the ASN.1 in outline
+		   form, supress the display by dumping it with a nesting level that
+		   ensures it won't get output (this clears the data from the input
+		   without displaying it) */
+		if( nonOutlineObject )
+			{
+			dumpHex( inFile, item->length, 1000, DUMPHEX_NORMAL, 0 );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			printString( level, "%c", '\n' );
+			return;
+			}
+
+		/* It's primitive, if it's a seekable stream try and determine
+		   whether it's text so we can display it as such */
+		if( !useStdin && \
+			( stringType = checkForText( inFile, item->length ) ) != STR_NONE )
+			{
+			/* It looks like a text string, dump it as text */
+			displayString( inFile, item->length, level, stringType );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			return;
 			}
 
 		/* This could be anything, dump it as hex data */
@@ -2772,582 +5820,9510 @@ static void printASN1object( FILE *inFile, ASN1_ITEM *item, int level )
 		return;
 		}
 
-	/* Print the object type */
-	if( !doOutlineOnly || ( item->id & FORM_MASK ) == CONSTRUCTED )
-		printString( level, "%s", idstr( item->tag ) );
+	/* Print the object type */
+	if( !doOutlineOnly || ( item->id & FORM_MASK ) == CONSTRUCTED )
+		printString( level, "%s", idstr( item->tag ) );
+
+	/* Perform a sanity check */
+	if( ( item->tag != NULLTAG ) && ( item->length < 0 ) )
+		{
+		int i;
+
+		abortWorker();
+		fatalDiagnostic( DIAG_LENGTH_BAD, item->length, level );
+		fflush( stdout );
+		fprintf( stderr, "\nError: Object has bad length field, tag = %02X, "
+				 "length = %lX, value =", item->tag, item->length );
+		fprintf( stderr, "<%02X", *item->header );
+		for( i = 1; i < item->headerSize; i++ )
+			fprintf( stderr, " %02X", item->header[ i ] );
+		fputs( ">.\n", stderr );
+		exit( EXIT_FAILURE );
+		}
+
+	/* If it's constructed, print the various fields in it */
+	if( ( item->id & FORM_MASK ) == CONSTRUCTED )
+		{
+		markConstructed( level, item );
+		printConstructed( inFile, level, item );
+		return;
+		}
+
+	/* It's primitive */
+	if( doOutlineOnly )
+		{
+		/* If we're only displaying the ASN.1 in outline form, set an
+		   artificially high nesting level that ensures it won't get output
+		   (this clears the data from the input without displaying it) */
+		level = 1000;
+		}
+	if( !item->length && !zeroLengthOK( item ) )
+		{
+		printString( level, "%c", '\n' );
+		complain( DIAG_ZERO_LENGTH, "Object has zero length", 0, level );
+		if( item->nonCanonical )
+			complainLengthCanonical( item, level );
+		return;
+		}
+	switch( item->tag )
+		{
+		case BOOLEAN:
+			if( item->length != 1 )
+				complainLength( item, level );
+			ch = getc( inFile );
+			if( ch == EOF )
+				{
+				complainEOF( level, 1 );
+				return;
+				}
+			printString( level, " %s\n", ch ? "TRUE" : "FALSE" );
+			if( ch != 0 && ch != 0xFF )
+				{
+				complain( DIAG_BOOLEAN_NONDER,
+						  "BOOLEAN '%02X' has non-DER encoding", ch,
+						  level );
+				}
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			fPos++;
+			break;
+
+		case INTEGER:
+		case ENUMERATED:
+			if( item->length > 4 && decimalIntegers && \
+				item->length <= DECIMAL_MAX_SIZE )
+				{
+				printDecimal( inFile, item->length, level );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+				}
+			else
+			if( item->length > 4 )
+				{
+				dumpHex( inFile, item->length, level, DUMPHEX_INTEGER, 0 );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+				}
+			else
+				{
+				printValue( inFile, item->length, level );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+				}
+			break;
+
+		case BITSTRING:
+			if( item->length < 1 )
+				{
+				/* A bitstring always has to contain at least one byte, the unused-bits 
+				   count */
+				complainLength( item, level );
+				}
+			if( ( ch = getc( inFile ) ) != 0 )
+				{
+				if( ch == EOF )
+					{
+					complainEOF( level, item->length );
+					return;
+					}
+				printString( level, " %d unused bit%s",
+							 ch, ( ch != 1 ) ? "s" : "" );
+				if( item->length <= 1 )
+					{
+					complain( DIAG_BITSTRING_EMPTY,
+							  "Empty BIT STRING has non-zero unused-bits "
+							  "value", 0, level );
+					return;
+					}
+				}
+			item->length--;
+			fPos++;
+			if( item->length <= 0 )
+				{
+				printString( level, " %s\n", "(no bits set)" );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+				return;
+				}
+			if( item->length <= sizeof( int ) )
+				{
+				/* It's short enough to be a bit flag, dump it as a sequence
+				   of bits */
+				dumpBitString( inFile, ( int ) item->length, ch, level );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+				break;
+				}
+			/* Fall through to dump it as an octet string */
+
+		case OCTETSTRING:
+			if( printEncapsulated( inFile, item, level ) )
+				break;
+			if( !useStdin && !dumpText && \
+				( stringType = checkForText( inFile, item->length ) ) != STR_NONE )
+				{
+				/* If we'd be doing a straight hex dump and it looks like
+				   encapsulated text, display it as such.  If the user has
+				   overridden character set type checking and it's a string
+				   type for which we normally perform type checking, we reset
+				   its type to none */
+				displayString( inFile, item->length, level, \
+					( !checkCharset && ( stringType == STR_IA5 || \
+										 stringType == STR_PRINTABLE ) ) ? \
+					STR_NONE : stringType );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+				return;
+				}
+			if( item->tag == BITSTRING )
+				dumpHex( inFile, item->length, level, DUMPHEX_BITSTRING, ch );
+			else
+				dumpHex( inFile, item->length, level, DUMPHEX_NORMAL, 0 );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+
+		case OID:
+			{
+			char textOID[ 128 ], prefixOID[ 128 ];
+			int length, isValid;
+
+			/* Hierarchical Object Identifier */
+			if( item->length <= 0 || item->length >= MAX_OID_SIZE )
+				{
+				abortWorker();
+				fatalDiagnostic( DIAG_OID_LENGTH, item->length, level );
+				fflush( stdout );
+				fprintf( stderr, "\nError: Object identifier length %ld too "
+						 "large.\n", item->length );
+				exit( EXIT_FAILURE );
+				}
+			length = fread( buffer, 1, ( size_t ) item->length, inFile );
+			fPos += item->length;
+			if( item->length < 3 )
+				{
+				fputs( ".\n", output );
+				complainLength( item, level );
+				break;
+				}
+			if( length < item->length )
+				{
+				fputs( ".\n", output );
+				complain( DIAG_OID_INVALID, "Invalid OID data", 0, level );
+				break;
+				}
+			if( schemaRoot != SCHEMA_TYPE_NONE )
+				selectSchemaType( level, buffer, ( int ) item->length );
+			if( ( oidInfo = getOIDinfo( buffer, ( int ) item->length ) ) != NULL )
+				{
+				/* Convert the binary OID to text form */
+				isValid = oidToString( textOID, &length, buffer,
+									   ( int ) item->length );
+
+				/* Check if LHS status info + indent + "OID " string + oid
+				   name + "(" + oid value + ")" will wrap */
+				if( ( ( doPure ) ? 0 : INDENT_SIZE ) + ( level * 2 ) + 18 + \
+					strlen( oidInfo->description ) + 2 + length >= outputWidth )
+					{
+					printString( level, "%c", '\n' );
+					if( !doPure )
+						printInfoIndent( level );
+					doIndent( level + 1 );
+					}
+				else
+					printString( level, "%c", ' ' );
+				printString( level, "%s (%s)\n", oidInfo->description, textOID );
+
+				/* Display extra comments about the OID if required */
+				if( extraOIDinfo && oidInfo->comment != NULL )
+					{
+					if( !doPure )
+						printInfoIndent( level );
+					doIndent( level + 1 );
+					printString( level, "(%s)\n", oidInfo->comment );
+					}
+				if( !isValid )
+					complain( DIAG_OID_ENCODING,
+							  "OID has invalid encoding", 0, level );
+				if( item->nonCanonical )
+					complainLengthCanonical( item, level );
+
+				/* If there's a warning associated with this OID, remember
+				   that there was a problem */
+				if( oidInfo->warn )
+					{
+					noWarnings++;
+					addDiagnostic( DIAG_OID_DEPRECATED, 0, level, FALSE );
+					}
+
+				break;
+				}
+
+			/* Print the OID as a text string */
+			isValid = oidToString( textOID, &length, buffer,
+								   ( int ) item->length );
+			printString( level, " '%s'\n", textOID );
+			if( isValid )
+				{
+				const OID_TRIE_NODE *familyNode;
+				int prefixLength;
+
+				/* If the OID is under a known arc, report the family that
+				   it belongs to */
+				familyNode = findOIDfamily( buffer, ( int ) item->length,
+											&prefixLength );
+				if( familyNode != NULL && \
+					oidToString( prefixOID, &length, buffer, prefixLength ) && \
+					!strncmp( textOID, prefixOID, length ) && \
+					textOID[ length ] == ' ' )
+					{
+					if( !doPure )
+						printInfoIndent( level );
+					doIndent( level + 1 );
+					printString( level, "(under %.*s: %s + %s)\n",
+								 familyNode->familyNameLength,
+								 familyNode->familyName, prefixOID,
+								 textOID + length + 1 );
+					}
+				if( item->length > MAX_SANE_OID_SIZE )
+					{
+					/* This typically only occurs with Microsoft's "encode 
+					   random noise and call it an OID" values, so we warn 
+					   about the fact that it's not really an OID */
+					complain( DIAG_OID_GARBAGE,
+							  "OID contains random garbage", 0, level );
+					}
+				}			
+			else
+				complain( DIAG_OID_ENCODING,
+						  "OID has invalid encoding", 0, level );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+			}
+
+		case EOC:
+			printString( level, "<<EOC>> %c", '\n' );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+
+		case NULLTAG:
+			printString( level, "%c", '\n' );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+
+		case OBJDESCRIPTOR:
+		case GRAPHICSTRING:
+		case VISIBLESTRING:
+		case GENERALSTRING:
+		case UNIVERSALSTRING:
+		case NUMERICSTRING:
+		case VIDEOTEXSTRING:
+		case PRINTABLESTRING:
+			displayString( inFile, item->length, level, STR_PRINTABLE );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+		case UTF8STRING:
+			displayString( inFile, item->length, level, STR_UTF8 );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+		case BMPSTRING:
+			displayString( inFile, item->length, level, STR_BMP );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+		case UTCTIME:
+			displayString( inFile, item->length, level, STR_UTCTIME );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+		case GENERALIZEDTIME:
+			displayString( inFile, item->length, level, STR_GENERALIZED );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+		case IA5STRING:
+			displayString( inFile, item->length, level, STR_IA5 );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+		case T61STRING:
+			displayString( inFile, item->length, level, STR_LATIN1 );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			break;
+
+		case SEQUENCE:
+			printString( level, "%c", '\n' );
+			complain( DIAG_SEQUENCE_PRIMITIVE,
+					  "SEQUENCE has invalid primitive encoding", 0, level );
+			break;
+
+		case SET:
+			printString( level, "%c", '\n' );
+			complain( DIAG_SET_PRIMITIVE,
+					  "SET has invalid primitive encoding", 0, level );
+			break;
+
+		default:
+			printString( level, "%c", '\n' );
+			if( !doPure )
+				printInfoIndent( level );
+			doIndent( level + 1 );
+			printString( level, "%s",
+						 "Unrecognised primitive, hex value is:");
+			dumpHex( inFile, item->length, level, DUMPHEX_NORMAL, 0 );
+			if( item->nonCanonical )
+				complainLengthCanonical( item, level );
+			noErrors++;		/* Treat it as an error */
+			addDiagnostic( DIAG_UNKNOWN_PRIMITIVE, item->tag, level, TRUE );
+		}
+	}
+
+/* Print a complex ASN.1 object */
+
+static long processObjectStart( FILE *inFile, const ASN1_ITEM *item )
+	{
+	long length = LENGTH_MAGIC;
+
+	/* If the length isn't known and the item has a definite length, set the
+	   length to the item's length */
+	if( !item->indefinite )
+		{
+		length = item->headerSize + item->length;
+
+		/* We can also adjust the width of the informational data column to
+		   maximise the amount of screen real estate (for lengths less than
+		   the default of four) or get rid of oversized columns (for lengths
+		   greater than four) */
+		if( length < 1000 )
+			infoWidth = 3;
+		else
+		if( length > 9999999 )
+			infoWidth = 8;
+		else
+		if( length > 999999 )
+			infoWidth = 7;
+		else
+		if( length > 99999 )
+			infoWidth = 6;
+		else
+		if( length > 9999 )
+			infoWidth = 5;
+		}
+
+	/* If the input isn't seekable, turn off some options that require the
+	   use of fseek().  This check isn't perfect (some streams are slightly
+	   seekable due to buffering) but it's better than nothing.
+	   
+	   This is complicated by a problem under Windows for which running 
+	   things in pipe mode is pretty erratic, in particular using fseek()
+	   below results in all subsequent reads returning EOF.  To try and
+	   ameliorate this we first try other checks to see if we're using 
+	   stdin before trying the fseek() check */
+#ifdef __WIN32__
+	if( useStdin || inFile == stdin || \
+		fseek( inFile, -item->headerSize, SEEK_CUR ) )
+#else
+	if( fseek( inFile, -item->headerSize, SEEK_CUR ) )
+#endif /* __WIN32__ */
+		{
+		useStdin = TRUE;
+		checkEncaps = FALSE;
+		if( !noWarnStdin )
+			{
+			puts( "Warning: Input is non-seekable, some functionality has "
+				  "been disabled." );
+			}
+
+		return( length );
+		}
+
+	/* If it looks like we've been given a text file, typically due to the
+	   input being base64-encoded, check whether it is all text */
+	if( ( isalnum( item->header[ 0 ] ) && isalnum( item->header[ 1 ] ) ) || \
+		  ( item->header[ 0 ] == '-' && item->header[ 1 ] == '-' ) )
+		{
+		BYTE buffer[ 4 ];
+		int count, i;
+
+		count = fread( buffer, 1, 4, inFile );
+		for( i = 0; i < count; i++ )
+			{
+			if( buffer[ i ] != '-' && !isalnum( buffer[ i ] ) )
+				break;
+			}
+		if( i >= 4 && \
+			item->header[ 0 ] == 0x30 || item->header[ 0 ] == 0x31 )
+			{
+			/* Special-case handling for situations that would produce a 
+			   false positive, items containing nested SEQUENCE (0x30)/SET 
+			   (0x31) of an appropriate length will look like ASCII since
+			   the encoding is 0x30 0xXX 0x30 0xXX 0x30 0xXX, e.g. "0g0e0c",
+			   so we check for the pattern [0|1] alnum [0|1] alnum ... */
+			if( buffer[ 2 ] == 0x30 || buffer[ 2 ] == 0x31 )
+				{
+				/* It's at least 0x30 0xXX 0x30 0xXX, assume it's binary.
+				   This can lead to a minute number of false negatives, but 
+				   that's OK since (a) it's no any normal encoding format 
+				   for ASN.1 binary data and (b) all it'll do is produce
+				   an attempt to decode text as ASN.1 */
+				i = 0;
+				}
+			}
+		if( i >= 4 )
+			{
+			abortWorker();
+			fatalDiagnostic( DIAG_BASE64, 0, 0 );
+			fputs( "Error: This file appears to be a base64-encoded text "
+				   "file, not binary data.\n", stderr );
+			fputs( "       In order to display it you first need to decode "
+				   "it into its\n", stderr );
+			fputs( "       binary form.\n", stderr );
+			exit( EXIT_FAILURE );
+			}
+		fseek( inFile, -4, SEEK_CUR );
+		}
+
+	/* Undo the fseek() that we used to determine whether the input was
+	   seekable */
+	fseek( inFile, item->headerSize, SEEK_CUR );
+
+	return( length );
+	}
+
+/* Skip the remaining items in a constructed object once we've displayed
+   the maximum number of items.  Normally we skip them using only their
+   lengths without decoding the contents, but if we've been asked to
+   validate the skipped items then we run them through the decoder with
+   the output discarded, in the same way as the syntax-check-only mode.
+   Returns the same length-mismatch value as printAsn1() */
+
+static int skipItems( FILE *inFile, const int level, long length,
+					  const int isIndefinite, const int doValidate )
+	{
+	FILE *displayOutput = output;
+	const long startPos = fPos, itemPos = diagItemPos;
+	long noItems = 0;
+	int status = TRUE;
+
+	if( doValidate )
+		output = nullOutput;
+	while( isIndefinite || length > 0 )
+		{
+		ASN1_ITEM item;
+		const long itemStartPos = fPos;
+
+		if( ( status = getItem( inFile, &item ) ) <= 0 )
+			break;
+		diagItemPos = itemStartPos;
+		if( item.header[ 0 ] == EOC && isIndefinite )
+			break;
+		if( doValidate )
+			{
+			/* Decode the item, with any problems being recorded in the
+			   error and warning counts */
+			printASN1object( inFile, &item, level );
+			}
+		else
+			{
+			if( item.indefinite )
+				{
+				/* We can't skip indefinite-length items by length, so we
+				   have to skip their contents item by item */
+				( void ) skipItems( inFile, 1000, 0, TRUE, FALSE );
+				}
+			else
+				{
+				long skipLength = item.length;
+
+				fPos += skipLength;
+				if( useStdin )
+					{
+					while( skipLength-- > 0 && getc( inFile ) != EOF );
+					}
+				else
+					{
+					if( fseek( inFile, skipLength, SEEK_CUR ) )
+						fseek( inFile, 0, SEEK_END );
+					}
+				}
+			}
+		noItems++;
+		if( !isIndefinite )
+			length -= fPos - itemStartPos;
+		}
+	output = displayOutput;
+	diagItemPos = itemPos;
+
+	/* Tell the user what we've skipped */
+	if( level < 1000 )
+		{
+		if( !doPure )
+			printInfoIndent( level );
+		doIndent( level );
+		printString( level, "[ Another %ld item%s, %ld bytes skipped ]\n",
+					 noItems, ( noItems != 1 ) ? "s" : "", fPos - startPos );
+		}
+	if( status < 0 )
+		complain( DIAG_SKIPPED_DATA,
+				  "Invalid data encountered in skipped items", 0, level );
+	if( isIndefinite )
+		return( 0 );
+	if( length < 0 )
+		return( ( int ) -length );
+	if( length > 0 )
+		{
+		fprintf( output, "Error: Inconsistent object length, %ld byte%s "
+				 "difference.\n", length, ( length > 1 ) ? "s" : "" );
+		noErrors++;
+		addDiagnostic( DIAG_LENGTH_INCONSISTENT, length, level, TRUE );
+		}
+	return( 0 );
+	}
+
+static int printAsn1( FILE *inFile, const int level, long length,
+					  const int isIndefinite )
+	{
+	ASN1_ITEM item;
+	const long itemPos = diagItemPos;
+	long lastPos = fPos, noItems = 0;
+	int seenEOC = FALSE, status;
+#ifdef USE_THREADS
+	int parallelOK = TRUE;
+#endif /* USE_THREADS */
+
+	/* Bail out on suspiciously complex data */
+	if( level > MAX_NESTING_LEVEL )
+		{
+		complain( DIAG_NESTING,
+				  "Object contains more than %d levels of nesting", 
+				  MAX_NESTING_LEVEL, level );
+		abortWorker();
+		if( jsonDiagnostics )
+			stopDecoding( DIAG_STOP_FATAL );
+		exit( EXIT_FAILURE );
+		}
+
+	/* Special-case for zero-length objects */
+	if( !length && !isIndefinite )
+		return( 0 );
+
+	/* If we're labelling fields and it's a top-level object, start at the
+	   root of the schema */
+	if( schemaRoot != SCHEMA_TYPE_NONE && level <= 0 )
+		startSchemaLevel( 0 );
+
+#ifdef USE_THREADS
+	/* If it's a large object, try and decode as many of its components as
+	   possible in parallel */
+	if( !isIndefinite )
+		{
+		length = decodeParallel( inFile, level, length, &parallelOK );
+		if( length <= 0 )
+			return( 0 );
+		lastPos = fPos;
+		}
+#endif /* USE_THREADS */
+
+	while( ( status = getItem( inFile, &item ) ) > 0 )
+		{
+		int nonOutlineObject = FALSE;
+
+		diagItemPos = lastPos;
+
+#ifdef USE_THREADS
+		/* If we're speculatively decoding encapsulated data, make sure that
+		   it really is encapsulated data */
+		if( encapsState.level >= 0 && level >= encapsState.level )
+			checkEncapsulatedItem( &item );
+#endif /* USE_THREADS */
+
+		/* If we're labelling fields, find the field for this item */
+		if( schemaRoot != SCHEMA_TYPE_NONE )
+			matchSchemaItem( level, &item );
+
+		/* Perform various special checks the first time that we're called */
+		if( length == LENGTH_MAGIC )
+			length = processObjectStart( inFile, &item );
+
+		/* Dump the header as hex data if requested */
+		if( doDumpHeader )
+			dumpHeader( inFile, &item, level );
+
+		/* If we're displaying the ASN.1 outline only and it's not a
+		   constructed object, don't display anything */
+		if( doOutlineOnly && ( item.id & FORM_MASK ) != CONSTRUCTED )
+			nonOutlineObject = TRUE;
+
+		/* Print the offset and length, unless we're in pure ASN.1-only
+		   output mode or we're displaying the outline only and it's not
+		   a constructed object */
+		if( item.header[ 0 ] == EOC )
+			{
+			seenEOC = TRUE;
+			if( !isIndefinite)
+				complain( DIAG_SPURIOUS_EOC,
+						  "Spurious EOC in definite-length item", 0, level );
+			}
+		if( !doPure && !nonOutlineObject )
+			{
+			if( item.indefinite || !seenEOC )
+				{
+				printInfoColumn( level, lastPos, item.length,
+								 item.indefinite );
+				}
+			}
+
+		/* Print details on the item */
+		if( !seenEOC )
+			{
+			if( !nonOutlineObject )
+				{
+				doIndent( level );
+				if( schemaRoot != SCHEMA_TYPE_NONE )
+					printSchemaLabel( level );
+				}
+			printASN1object( inFile, &item, level );
+			}
+
+		/* If it was an indefinite-length object (no length was ever set) and
+		   we've come back to the top level, exit */
+		if( length == LENGTH_MAGIC )
+			return( 0 );
+
+		length -= fPos - lastPos;
+		lastPos = fPos;
+		if( isIndefinite )
+			{
+			if( seenEOC )
+				return( 0 );
+			}
+		else
+			{
+			if( length <= 0 )
+				{
+				if( length < 0 )
+					return( ( int ) -length );
+				return( 0 );
+				}
+			else
+				{
+				if( length == 1 )
+					{
+					const int ch = fgetc( inFile );
+
+					/* If we've run out of input but there should be more
+					   present, let the caller know */
+					if( ch == EOF )
+						return( 1 );
+
+					/* No object can be one byte long, try and recover.  This
+					   only works sometimes because it can be caused by
+					   spurious data in an OCTET STRING hole or an incorrect
+					   length encoding.  The following workaround tries to
+					   recover from spurious data by skipping the byte if
+					   it's zero or a non-basic-ASN.1 tag, but keeping it if
+					   it could be valid ASN.1 */
+					if( ch > 0 && ch <= 0x31 )
+						ungetc( ch, inFile );
+					else
+						{
+						fPos++;
+						return( 1 );
+						}
+					}
+#ifdef USE_THREADS
+				else
+					{
+					/* Decode as many of the following components as 
+					   possible in parallel */
+					length = decodeParallel( inFile, level, length, 
+											 &parallelOK );
+					if( length <= 0 )
+						return( 0 );
+					lastPos = fPos;
+					}
+#endif /* USE_THREADS */
+				}
+			}
+
+		/* If we've displayed the maximum number of items for this object,
+		   skip the remainder */
+		if( maxItems > 0 && ++noItems >= maxItems )
+			{
+			return( skipItems( inFile, level, length, isIndefinite,
+							   validateSkipped ) );
+			}
+		}
+#ifdef USE_THREADS
+	if( encapsState.level >= 0 && level >= encapsState.level )
+		{
+		/* We couldn't read the item to check in speculatively-decoded
+		   encapsulated data, so it's not encapsulated data */
+		longjmp( encapsRollback, 1 );
+		}
+#endif /* USE_THREADS */
+	if( status == -1 )
+		{
+		int i;
+
+		abortWorker();
+		diagItemPos = lastPos;
+		fatalDiagnostic( DIAG_INVALID_DATA, item.header[ 0 ], level );
+		fflush( stdout );
+		fprintf( stderr, "\nError: Invalid data encountered at position "
+				 "%d:", fPos );
+		for( i = 0; i < item.headerSize; i++ )
+			fprintf( stderr, " %02X", item.header[ i ] );
+		fprintf( stderr, ".\n" );
+		exit( EXIT_FAILURE );
+		}
+
+	/* If we see an EOF and there's supposed to be more data present,
+	   complain */
+	diagItemPos = itemPos;
+	if( length && length != LENGTH_MAGIC )
+		{
+		fprintf( output, "Error: Inconsistent object length, %ld byte%s "
+				 "difference.\n", length, ( length > 1 ) ? "s" : "" );
+		noErrors++;
+		addDiagnostic( DIAG_LENGTH_INCONSISTENT, length, level, TRUE );
+		}
+	return( 0 );
+	}
+
+/* If we're dumping a standalone ASN.1 object and there's further data
+   appended to it, warn the user of its existence.  This is a bit hit-and-
+   miss since there may or may not be additional EOCs present, dumpasn1
+   always stops once it knows that the data should end (without trying to
+   read any trailing EOCs) because data from some sources has the EOCs
+   truncated, and most apps know that they have to stop at
+   min( data_end, EOCs ).  To avoid false positives, we skip at least 4 EOCs
+   worth of data and if there's still more present, we complain */
+
+static void checkTrailingData( FILE *inFile )
+	{
+	BYTE buffer[ 16 ];
+	long position = ftell( inFile );
+
+	( void ) fread( buffer, 1, 8, inFile );		/* Skip 4 EOCs */
+	if( !feof( inFile ) )
+		{
+		diagItemPos = position;
+		warn( DIAG_TRAILING_DATA,
+			  "Further data follows ASN.1 data at position %ld.\n", 
+			  position, 0 );
+		}
+	}
+
+/****************************************************************************
+*																			*
+*							Parallel Decoding Routines						*
+*																			*
+****************************************************************************/
+
+#ifdef USE_THREADS
+
+/* Objects like CRLs can contain millions of small components that we'd
+   otherwise have to plod through one after the other.  If the input is
+   memory-mapped, we perform a cheap length-only scan to find the component
+   boundaries, group the components into chunks of around
+   PARALLEL_CHUNK_SIZE bytes, and decode each chunk in its own thread into a
+   memory buffer, after which the buffers are written out in order.
+   Components that are larger than PARALLEL_CHUNK_SIZE are left for the
+   serial decode, which may in turn decode their contents in parallel.
+   Since no component in a chunk can be larger than PARALLEL_CHUNK_SIZE, the
+   chunk length is always well below LENGTH_MAGIC */
+
+#define PARALLEL_MIN_SIZE	262144L	/* Min.object size for parallel decode */
+#define PARALLEL_CHUNK_SIZE	65536L	/* Amount of data for each thread */
+
+/* Get and set the current thread's display options */
+
+static void getDumpOptions( DUMP_OPTIONS *options )
+	{
+	options->printDots = printDots;
+	options->doPure = doPure;
+	options->doDumpHeader = doDumpHeader;
+	options->extraOIDinfo = extraOIDinfo;
+	options->doHexValues = doHexValues;
+	options->zeroLengthAllowed = zeroLengthAllowed;
+	options->dumpText = dumpText;
+	options->printAllData = printAllData;
+	options->checkEncaps = checkEncaps;
+	options->checkCharset = checkCharset;
+	options->reverseBitString = reverseBitString;
+	options->rawTimeString = rawTimeString;
+	options->shallowIndent = shallowIndent;
+	options->outputWidth = outputWidth;
+	options->maxNestLevel = maxNestLevel;
+	options->doOutlineOnly = doOutlineOnly;
+	options->maxItems = maxItems;
+	options->validateSkipped = validateSkipped;
+	}
+
+static void setDumpOptions( const DUMP_OPTIONS *options )
+	{
+	printDots = options->printDots;
+	doPure = options->doPure;
+	doDumpHeader = options->doDumpHeader;
+	extraOIDinfo = options->extraOIDinfo;
+	doHexValues = options->doHexValues;
+	zeroLengthAllowed = options->zeroLengthAllowed;
+	dumpText = options->dumpText;
+	printAllData = options->printAllData;
+	checkEncaps = options->checkEncaps;
+	checkCharset = options->checkCharset;
+	reverseBitString = options->reverseBitString;
+	rawTimeString = options->rawTimeString;
+	shallowIndent = options->shallowIndent;
+	outputWidth = options->outputWidth;
+	maxNestLevel = options->maxNestLevel;
+	doOutlineOnly = options->doOutlineOnly;
+	maxItems = options->maxItems;
+	validateSkipped = options->validateSkipped;
+	}
+
+/* The state information for each parallel decode job */
+
+typedef struct {
+	/* Job inputs: The data to decode and the parse state to start with */
+	long position, length;		/* Position and length of data in buffer */
+	int level;					/* Nesting level of data */
+	int fPos, infoWidth;		/* Parse state */
+	DUMP_OPTIONS options;		/* Display options */
+	const SCHEMA_LEVEL *schemaLevels;	/* Schema state for each level */
+	int schemaState;			/* Schema state for first component */
+
+	/* Job outputs */
+	char *outBuffer;			/* Decoded output */
+	size_t outBufSize;
+	int noErrors, noWarnings;	/* Error and warning counts */
+	int status;					/* Whether the decode succeeded */
+	} PARALLEL_JOB;
+
+/* Find the total size of the item at the given position in the mapped
+   input without decoding it, returning zero if the item can't be handled
+   by a length-only scan */
+
+static long scanItemSize( const long position, const long endPos )
+	{
+	const BYTE *data = inputBuffer + position;
+	const long maxLength = endPos - position;
+	ASN1_ITEM item;
+
+	/* EOCs in definite-length data affect the handling of everything that
+	   follows, so we leave them for the serial decode */
+	if( maxLength < 2 || data[ 0 ] == EOC )
+		return( 0 );
+
+	/* Get the item's header, rejecting indefinite-length items */
+	if( getMemItem( data, maxLength, &item ) <= 0 || item.indefinite || \
+		item.length < 0 || item.length > maxLength - item.headerSize )
+		return( 0 );
+
+	return( item.headerSize + item.length );
+	}
+
+/* Decode a chunk of data in a worker thread.  If the decode runs into
+   problems, we report a failure and leave it for the serial decode, which
+   will report the problem in the correct location in the output */
+
+static void *parallelWorker( void *arg )
+	{
+	PARALLEL_JOB *job = ( PARALLEL_JOB * ) arg;
+	jmp_buf abortEnv;
+	FILE *inFile;
+
+	/* Set up the parse state for the worker thread */
+	setDumpOptions( &job->options );
+	fPos = job->fPos;
+	infoWidth = job->infoWidth;
+	noErrors = noWarnings = 0;
+	if( schemaRoot != SCHEMA_TYPE_NONE )
+		{
+		memcpy( schemaLevels, job->schemaLevels,
+				( job->level + 1 ) * sizeof( SCHEMA_LEVEL ) );
+		schemaLevels[ job->level ].state = job->schemaState;
+		}
+	if( ( output = open_memstream( &job->outBuffer, \
+								   &job->outBufSize ) ) == NULL )
+		return( NULL );
+	if( ( inFile = fmemopen( ( void * ) ( inputBuffer + job->position ),
+							 inputBufferSize - job->position, "rb" ) ) == NULL )
+		{
+		fclose( output );
+		return( NULL );
+		}
+
+	/* Decode the data, returning to here if there's a fatal error.  In
+	   order for the decode to be valid, the chunk has to have been decoded
+	   without any length inconsistencies that would lead to the serial
+	   decode ending up at a different position */
+	workerAbort = &abortEnv;
+	if( !setjmp( abortEnv ) )
+		{
+		if( printAsn1( inFile, job->level, job->length, FALSE ) == 0 && \
+			ftell( inFile ) == job->length )
+			job->status = TRUE;
+		}
+	workerAbort = NULL;
+	fclose( inFile );
+	fclose( output );
+	freeEncapsulated();
+	job->noErrors = noErrors;
+	job->noWarnings = noWarnings;
+
+	return( NULL );
+	}
+
+/* Decode as many of the components at the current position as possible in
+   parallel, returning the remaining length of the object being decoded.  If
+   there's a problem with the parallel decode, we stop at the component
+   where the problem occurred and turn off parallel decoding for the rest
+   of the object */
+
+static long decodeParallel( FILE *inFile, const int level, long length,
+							int *parallelOK )
+	{
+	PARALLEL_JOB jobs[ MAX_THREADS ];
+	pthread_t threads[ MAX_THREADS ];
+	long position;
+	int schemaState = schemaLevels[ level ].state, stopScan = FALSE;
+
+	/* Make sure that it's worth decoding this in parallel.  We don't try
+	   and do nested parallel decodes inside worker threads, or parallel
+	   decodes when we're only displaying the first few items in an
+	   object */
+	if( parallelThreads <= 1 || inputBuffer == NULL || useStdin || \
+		workerAbort != NULL || !*parallelOK || maxItems > 0 || \
+		encapsState.level >= 0 || length == LENGTH_MAGIC || \
+		length < PARALLEL_MIN_SIZE )
+		return( length );
+	position = ftell( inFile );
+	if( position < 0 || length > inputBufferSize - position )
+		return( length );
+
+	while( length >= PARALLEL_MIN_SIZE && !stopScan )
+		{
+		const long endPos = position + length;
+		long scanPos = position;
+		int noJobs, noStarted, i;
+
+		/* Scan ahead and split the following components into chunks, one
+		   for each thread */
+		for( noJobs = 0; noJobs < parallelThreads && !stopScan; noJobs++ )
+			{
+			PARALLEL_JOB *job = &jobs[ noJobs ];
+
+			memset( job, 0, sizeof( PARALLEL_JOB ) );
+			job->position = scanPos;
+			job->schemaState = schemaState;
+			while( job->length < PARALLEL_CHUNK_SIZE )
+				{
+				const long itemSize = ( scanPos < endPos ) ? \
+									  scanItemSize( scanPos, endPos ) : 0;
+
+				if( itemSize <= 0 || itemSize >= PARALLEL_CHUNK_SIZE )
+					{
+					stopScan = TRUE;
+					break;
+					}
+
+				/* If we're labelling fields, step the schema state over
+				   the component.  Components that select the type of
+				   other components are left for the serial decode */
+				if( schemaRoot != SCHEMA_TYPE_NONE )
+					{
+					const int field = schemaTransitions[ schemaState * 256 + \
+												inputBuffer[ scanPos ] ];
+
+					if( field && \
+						schemaStates[ field ].field->selector != SCHEMA_SELECT_NONE )
+						{
+						stopScan = TRUE;
+						break;
+						}
+					schemaState = schemaStates[ field ].nextState;
+					}
+				job->length += itemSize;
+				scanPos += itemSize;
+				}
+			if( job->length <= 0 )
+				break;
+			job->level = level;
+			job->fPos = fPos + ( int ) ( job->position - position );
+			job->infoWidth = infoWidth;
+			job->schemaLevels = schemaLevels;
+			getDumpOptions( &job->options );
+			}
+		if( noJobs <= 0 )
+			break;
+
+		/* Decode the chunks in parallel */
+		for( noStarted = 0; noStarted < noJobs; noStarted++ )
+			{
+			if( pthread_create( &threads[ noStarted ], NULL, parallelWorker,
+								&jobs[ noStarted ] ) )
+				break;
+			}
+		for( i = 0; i < noStarted; i++ )
+			pthread_join( threads[ i ], NULL );
+
+		/* Write the output from each chunk in order, stopping at the first
+		   one that couldn't be decoded, which is left for the serial
+		   decode */
+		for( i = 0; i < noStarted && jobs[ i ].status; i++ )
+			{
+			const PARALLEL_JOB *job = &jobs[ i ];
+
+			fwrite( job->outBuffer, 1, job->outBufSize, output );
+			noErrors += job->noErrors;
+			noWarnings += job->noWarnings;
+			fPos += ( int ) job->length;
+			position += job->length;
+			length -= job->length;
+			}
+		if( i < noJobs )
+			{
+			*parallelOK = FALSE;
+			stopScan = TRUE;
+			schemaState = jobs[ i ].schemaState;
+			}
+		schemaLevels[ level ].state = schemaState;
+		for( i = 0; i < noJobs; i++ )
+			{
+			if( jobs[ i ].outBuffer != NULL )
+				free( jobs[ i ].outBuffer );
+			}
+		}
+	fseek( inFile, position, SEEK_SET );
+
+	return( length );
+	}
+
+/* Map a file into memory, returning NULL if it can't be mapped, for
+   example because it's a device or empty.  Since the data is usually read
+   from start to finish, we let the kernel know that it can read ahead and
+   discard pages that have already been read */
+
+static const BYTE *mapFile( const char *fileName, long *length )
+	{
+	struct stat statInfo;
+	void *buffer;
+	int fd;
+
+	if( ( fd = open( fileName, O_RDONLY ) ) < 0 )
+		return( NULL );
+	if( fstat( fd, &statInfo ) < 0 || !S_ISREG( statInfo.st_mode ) || \
+		statInfo.st_size <= 0 || statInfo.st_size > INT_MAX )
+		{
+		close( fd );
+		return( NULL );
+		}
+	buffer = mmap( NULL, statInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( buffer == MAP_FAILED )
+		return( NULL );
+#ifdef MADV_SEQUENTIAL
+	madvise( buffer, statInfo.st_size, MADV_SEQUENTIAL );
+#endif /* MADV_SEQUENTIAL */
+	*length = statInfo.st_size;
+
+	return( buffer );
+	}
+
+/* Open a file as a memory-mapped stream.  If the file can't be mapped, we
+   fall back to reading it normally */
+
+static FILE *openMappedFile( const char *fileName )
+	{
+	const BYTE *buffer;
+	FILE *inFile;
+	long length;
+
+	if( ( buffer = mapFile( fileName, &length ) ) == NULL )
+		return( fopen( fileName, "rb" ) );
+	if( ( inFile = fmemopen( ( void * ) buffer, length, "rb" ) ) == NULL )
+		{
+		munmap( ( void * ) buffer, length );
+		return( fopen( fileName, "rb" ) );
+		}
+	inputBuffer = buffer;
+	inputBufferSize = length;
+
+	return( inFile );
+	}
+
+static void closeMappedFile( void )
+	{
+	if( inputBuffer != NULL )
+		munmap( ( void * ) inputBuffer, inputBufferSize );
+	inputBuffer = NULL;
+	inputBufferSize = 0;
+	}
+#endif /* USE_THREADS */
+
+/****************************************************************************
+*																			*
+*							Compressed Input Routines						*
+*																			*
+****************************************************************************/
+
+/* Archived objects are often stored compressed.  Rather than requiring
+   that they be decompressed to a temporary file or piped in via stdin,
+   which disables the display options that need to look ahead in the
+   input, we recognise gzip and zstd data by their magic numbers and read
+   it through a custom stdio stream that decompresses it on the fly into a
+   sliding window.  The window covers the recently-read data as well as
+   the data that's been read ahead, so that the small seeks back that the
+   decoder makes after looking ahead at the data can be satisfied from
+   memory.  Seeks forwards decompress and discard the data in between, and
+   seeks back past the start of the window, which are rare, restart the
+   decompression from the start of the input */
+
+typedef enum {
+	COMPRESSION_NONE,		/* Uncompressed data */
+	COMPRESSION_GZIP,		/* gzip/zlib */
+	COMPRESSION_ZSTD		/* zstd */
+	} COMPRESSION_TYPE;
+
+/* Check whether a block of memory or an input stream contains compressed
+   data */
+
+static COMPRESSION_TYPE getMemCompressionType( const BYTE *data,
+											   const long length )
+	{
+	if( length >= 2 && data[ 0 ] == 0x1F && data[ 1 ] == 0x8B )
+		return( COMPRESSION_GZIP );
+	if( length >= 4 && data[ 0 ] == 0x28 && data[ 1 ] == 0xB5 && \
+		data[ 2 ] == 0x2F && data[ 3 ] == 0xFD )
+		return( COMPRESSION_ZSTD );
+
+	return( COMPRESSION_NONE );
+	}
+
+static COMPRESSION_TYPE getCompressionType( FILE *inFile )
+	{
+	BYTE magic[ 4 ];
+	const int count = fread( magic, 1, 4, inFile );
+
+	rewind( inFile );
+	return( getMemCompressionType( magic, count ) );
+	}
+
+#ifdef USE_COMPRESSION
+
+#define COMPRESSED_WINDOW_SIZE	1048576L	/* Size of decompression window */
+#define COMPRESSED_BUFFER_SIZE	65536L		/* Size of input buffer */
+
+typedef struct {
+	FILE *inFile;				/* Compressed input */
+	COMPRESSION_TYPE type;		/* Compression type */
+#ifdef USE_ZLIB
+	z_stream zStream;			/* zlib state */
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	ZSTD_DStream *zstdStream;	/* zstd state */
+#endif /* USE_ZSTD */
+	BYTE inBuffer[ COMPRESSED_BUFFER_SIZE ];	/* Compressed data */
+	long inPos, inLength;		/* Position and amount of compressed data */
+	BYTE window[ COMPRESSED_WINDOW_SIZE ];	/* Decompressed data */
+	long windowStart, windowLength;	/* Position and length of window */
+	long position;				/* Current position in decompressed data */
+	int endOfData;				/* Whether we've reached the end of the data */
+	} COMPRESSED_STREAM;
+
+/* Reset the decompression state to the start of the input */
+
+static int resetDecompression( COMPRESSED_STREAM *stream )
+	{
+	rewind( stream->inFile );
+	stream->inPos = stream->inLength = 0;
+	stream->windowStart = stream->windowLength = 0;
+	stream->endOfData = FALSE;
+#ifdef USE_ZLIB
+	if( stream->type == COMPRESSION_GZIP )
+		{
+		stream->zStream.avail_in = 0;
+		return( inflateReset( &stream->zStream ) == Z_OK );
+		}
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( stream->type == COMPRESSION_ZSTD )
+		return( !ZSTD_isError( ZSTD_initDStream( stream->zstdStream ) ) );
+#endif /* USE_ZSTD */
+
+	return( FALSE );
+	}
+
+/* Decompress more data into the window, returning the amount of data
+   added.  If the window is full, we discard the older half of it */
+
+static long decompressData( COMPRESSED_STREAM *stream )
+	{
+	long outLength = 0;
+
+	if( stream->windowLength >= COMPRESSED_WINDOW_SIZE )
+		{
+		const long keepLength = COMPRESSED_WINDOW_SIZE / 2;
+
+		memmove( stream->window,
+				 stream->window + stream->windowLength - keepLength,
+				 keepLength );
+		stream->windowStart += stream->windowLength - keepLength;
+		stream->windowLength = keepLength;
+		}
+	while( outLength <= 0 && !stream->endOfData )
+		{
+		BYTE *outPtr = stream->window + stream->windowLength;
+		const long outAvail = COMPRESSED_WINDOW_SIZE - stream->windowLength;
+		int inputEnd = FALSE;
+
+		/* Refill the input buffer if necessary */
+		if( stream->inPos >= stream->inLength )
+			{
+			stream->inPos = 0;
+			stream->inLength = fread( stream->inBuffer, 1,
+									  COMPRESSED_BUFFER_SIZE,
+									  stream->inFile );
+			if( stream->inLength <= 0 )
+				inputEnd = TRUE;
+			}
+
+#ifdef USE_ZLIB
+		if( stream->type == COMPRESSION_GZIP )
+			{
+			z_stream *zStream = &stream->zStream;
+			int status;
+
+			zStream->next_in = stream->inBuffer + stream->inPos;
+			zStream->avail_in = stream->inLength - stream->inPos;
+			zStream->next_out = outPtr;
+			zStream->avail_out = outAvail;
+			status = inflate( zStream, Z_NO_FLUSH );
+			outLength = outAvail - zStream->avail_out;
+			stream->inPos = stream->inLength - zStream->avail_in;
+			if( status == Z_STREAM_END )
+				{
+				/* There may be further concatenated gzip members
+				   following this one */
+				if( inflateReset( zStream ) != Z_OK )
+					stream->endOfData = TRUE;
+				}
+			else
+				{
+				if( ( status != Z_OK && status != Z_BUF_ERROR ) || \
+					( inputEnd && outLength <= 0 ) )
+					stream->endOfData = TRUE;
+				}
+			}
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+		if( stream->type == COMPRESSION_ZSTD )
+			{
+			ZSTD_inBuffer inBuffer;
+			ZSTD_outBuffer outBuffer;
+			size_t status;
+
+			inBuffer.src = stream->inBuffer;
+			inBuffer.size = stream->inLength;
+			inBuffer.pos = stream->inPos;
+			outBuffer.dst = outPtr;
+			outBuffer.size = outAvail;
+			outBuffer.pos = 0;
+			status = ZSTD_decompressStream( stream->zstdStream, &outBuffer,
+											&inBuffer );
+			outLength = outBuffer.pos;
+			stream->inPos = inBuffer.pos;
+			if( ZSTD_isError( status ) || ( inputEnd && outLength <= 0 ) )
+				stream->endOfData = TRUE;
+			}
+#endif /* USE_ZSTD */
+		}
+	stream->windowLength += outLength;
+
+	return( outLength );
+	}
+
+/* The stdio stream functions */
+
+static long compressedRead( COMPRESSED_STREAM *stream, char *buffer,
+							const long length )
+	{
+	long count = 0;
+
+	while( count < length )
+		{
+		const long windowEnd = stream->windowStart + stream->windowLength;
+		long copyLength;
+
+		if( stream->position >= windowEnd )
+			{
+			if( decompressData( stream ) <= 0 )
+				break;
+			continue;
+			}
+		copyLength = min( windowEnd - stream->position, length - count );
+		memcpy( buffer + count,
+				stream->window + ( stream->position - stream->windowStart ),
+				copyLength );
+		stream->position += copyLength;
+		count += copyLength;
+		}
+
+	return( count );
+	}
+
+static long compressedSeek( COMPRESSED_STREAM *stream, long offset,
+							const int whence )
+	{
+	if( whence == SEEK_CUR )
+		offset += stream->position;
+	if( whence == SEEK_END )
+		{
+		/* We have to decompress everything to find the end of the data */
+		while( decompressData( stream ) > 0 );
+		offset += stream->windowStart + stream->windowLength;
+		}
+	if( offset < 0 )
+		return( -1 );
+
+	/* If it's before the start of the window, start again from the
+	   beginning */
+	if( offset < stream->windowStart && !resetDecompression( stream ) )
+		return( -1 );
+
+	/* Decompress up to the new position, which can't be past the end of
+	   the data */
+	while( offset > stream->windowStart + stream->windowLength )
+		{
+		if( decompressData( stream ) <= 0 )
+			return( -1 );
+		}
+	stream->position = offset;
+
+	return( offset );
+	}
+
+static int compressedClose( COMPRESSED_STREAM *stream )
+	{
+#ifdef USE_ZLIB
+	if( stream->type == COMPRESSION_GZIP )
+		inflateEnd( &stream->zStream );
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( stream->type == COMPRESSION_ZSTD )
+		ZSTD_freeDStream( stream->zstdStream );
+#endif /* USE_ZSTD */
+	fclose( stream->inFile );
+	free( stream );
+
+	return( 0 );
+	}
+
+#if defined( __linux__ )
+
+static ssize_t streamRead( void *cookie, char *buffer, size_t length )
+	{
+	return( compressedRead( cookie, buffer, length ) );
+	}
+
+static int streamSeek( void *cookie, off64_t *offset, int whence )
+	{
+	const long position = compressedSeek( cookie, ( long ) *offset, whence );
+
+	if( position < 0 )
+		return( -1 );
+	*offset = position;
+	return( 0 );
+	}
+
+static int streamClose( void *cookie )
+	{
+	return( compressedClose( cookie ) );
+	}
+
+static FILE *openStream( COMPRESSED_STREAM *stream )
+	{
+	cookie_io_functions_t ioFunctions = { streamRead, NULL, streamSeek,
+										  streamClose };
+
+	return( fopencookie( stream, "rb", ioFunctions ) );
+	}
+#else
+
+static int streamRead( void *cookie, char *buffer, int length )
+	{
+	return( ( int ) compressedRead( cookie, buffer, length ) );
+	}
+
+static fpos_t streamSeek( void *cookie, fpos_t offset, int whence )
+	{
+	return( compressedSeek( cookie, ( long ) offset, whence ) );
+	}
+
+static int streamClose( void *cookie )
+	{
+	return( compressedClose( cookie ) );
+	}
+
+static FILE *openStream( COMPRESSED_STREAM *stream )
+	{
+	return( funopen( stream, streamRead, NULL, streamSeek, streamClose ) );
+	}
+#endif /* OS-specific custom stream handling */
+
+/* Check whether we can decompress a given type of data */
+
+static int isCompressionSupported( const COMPRESSION_TYPE type )
+	{
+#ifdef USE_ZLIB
+	if( type == COMPRESSION_GZIP )
+		return( TRUE );
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( type == COMPRESSION_ZSTD )
+		return( TRUE );
+#endif /* USE_ZSTD */
+
+	return( FALSE );
+	}
+
+/* Open a stream that decompresses the data in a file, taking ownership of
+   the file */
+
+static FILE *openCompressedStream( FILE *inFile,
+								   const COMPRESSION_TYPE type )
+	{
+	COMPRESSED_STREAM *stream;
+	FILE *outStream;
+	int status = FALSE;
+
+	if( ( stream = ( COMPRESSED_STREAM * ) \
+				   malloc( sizeof( COMPRESSED_STREAM ) ) ) == NULL )
+		{
+		fclose( inFile );
+		return( NULL );
+		}
+	memset( stream, 0, sizeof( COMPRESSED_STREAM ) );
+	stream->inFile = inFile;
+	stream->type = type;
+#ifdef USE_ZLIB
+	if( type == COMPRESSION_GZIP )
+		{
+		/* Window bits + 32 enables automatic gzip/zlib header detection */
+		status = ( inflateInit2( &stream->zStream, MAX_WBITS + 32 ) == Z_OK );
+		}
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( type == COMPRESSION_ZSTD )
+		{
+		if( ( stream->zstdStream = ZSTD_createDStream() ) != NULL )
+			{
+			if( ZSTD_isError( ZSTD_initDStream( stream->zstdStream ) ) )
+				ZSTD_freeDStream( stream->zstdStream );
+			else
+				status = TRUE;
+			}
+		}
+#endif /* USE_ZSTD */
+	if( !status )
+		{
+		fclose( inFile );
+		free( stream );
+		return( NULL );
+		}
+	if( ( outStream = openStream( stream ) ) == NULL )
+		compressedClose( stream );
+
+	return( outStream );
+	}
+
+/* Read all of the data in a compressed file into memory, taking ownership
+   of the file.  Since we can't tell how big the data will be once it's
+   decompressed, we read it into a buffer that's expanded as required */
+
+static BYTE *readCompressedData( FILE *inFile, long *dataLength )
+	{
+	BYTE *data = NULL;
+	long length = 0, maxLength = 0, count;
+
+	if( ( inFile = openCompressedStream( inFile,
+								getCompressionType( inFile ) ) ) == NULL )
+		return( NULL );
+	do
+		{
+		if( length >= maxLength )
+			{
+			BYTE *newData;
+
+			maxLength = maxLength ? maxLength * 2 : 65536L;
+			if( maxLength > INT_MAX || \
+				( newData = ( BYTE * ) realloc( data, maxLength ) ) == NULL )
+				{
+				length = 0;
+				break;
+				}
+			data = newData;
+			}
+		count = fread( data + length, 1, maxLength - length, inFile );
+		length += count;
+		}
+	while( count > 0 );
+	fclose( inFile );
+	if( length <= 0 )
+		{
+		if( data != NULL )
+			free( data );
+		return( NULL );
+		}
+	*dataLength = length;
+
+	return( data );
+	}
+#endif /* USE_COMPRESSION */
+
+/* Complain about compressed input that we can't decompress */
+
+static void complainCompressed( const char *fileName,
+								const COMPRESSION_TYPE type )
+	{
+	printf( "Input file '%s' is %s-compressed, dumpasn1 needs to be "
+			"built with -D %s to\ndecompress it.\n", fileName,
+			( type == COMPRESSION_GZIP ) ? "gzip" : "zstd",
+			( type == COMPRESSION_GZIP ) ? "USE_ZLIB" : "USE_ZSTD" );
+	}
+
+/* Open an input file, decompressing it if required and mapping it into
+   memory if it's being decoded in parallel */
+
+static FILE *openInputFile( const char *fileName )
+	{
+	COMPRESSION_TYPE type;
+	FILE *inFile;
+
+	if( ( inFile = fopen( fileName, "rb" ) ) == NULL )
+		{
+		perror( fileName );
+		return( NULL );
+		}
+	type = getCompressionType( inFile );
+	if( type != COMPRESSION_NONE )
+		{
+#ifdef USE_COMPRESSION
+		if( isCompressionSupported( type ) )
+			{
+			if( ( inFile = openCompressedStream( inFile, type ) ) == NULL )
+				puts( "Couldn't set up decompression of input data." );
+			return( inFile );
+			}
+#endif /* USE_COMPRESSION */
+		complainCompressed( fileName, type );
+		fclose( inFile );
+		return( NULL );
+		}
+#ifdef USE_THREADS
+	/* If we're decoding in parallel, the threads work directly on the
+	   memory-mapped input */
+	if( parallelThreads > 1 )
+		{
+		fclose( inFile );
+		if( ( inFile = openMappedFile( fileName ) ) == NULL )
+			perror( fileName );
+		}
+#endif /* USE_THREADS */
+
+	return( inFile );
+	}
+
+/****************************************************************************
+*																			*
+*							Compressed Output Routines						*
+*																			*
+****************************************************************************/
+
+/* A verbose dump of a large object can produce many times as much text as
+   there is input, to the point where writing it becomes the bottleneck.
+   To deal with this we can compress the output with gzip or zstd as it's
+   produced.  The compression is done in a separate thread so that it runs
+   in parallel with the decoding, with the two exchanging data via a pair
+   of buffers: the decoder fills one buffer while the compression thread
+   compresses the other, so that the decoder only has to wait if it fills
+   its buffer before the compression thread has finished with the other
+   one */
+
+#ifdef USE_COMPRESSED_OUTPUT
+
+#define OUTPUT_BUFFER_SIZE		1048576L	/* Size of each output buffer */
+#define OUTPUT_STREAM_BUFFER	65536L		/* Size of stdio buffer */
+
+typedef struct {
+	FILE *outFile;				/* Compressed output */
+	COMPRESSION_TYPE type;		/* Compression type */
+#ifdef USE_ZLIB
+	z_stream zStream;			/* zlib state */
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	ZSTD_CStream *zstdStream;	/* zstd state */
+#endif /* USE_ZSTD */
+
+	/* The buffer being filled by the decoder, and the one waiting to be
+	   or being compressed, or -1 if the compression thread is idle */
+	BYTE *buffers[ 2 ];
+	long lengths[ 2 ];
+	int fillBuffer, compressBuffer;
+	BYTE *outBuffer;			/* Compressed data */
+
+	/* The compression thread and the state that it shares with the
+	   decoder */
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t stateChanged;
+	int finished, writeError;
+	} COMPRESSED_OUTPUT;
+
+/* Compress a buffer of data and write it to the output, finishing the
+   compressed data if it's the last buffer */
+
+static int compressBuffer( COMPRESSED_OUTPUT *stream, const BYTE *data,
+						   const long length, const int isFinal )
+	{
+#ifdef USE_ZLIB
+	if( stream->type == COMPRESSION_GZIP )
+		{
+		z_stream *zStream = &stream->zStream;
+
+		zStream->next_in = ( BYTE * ) data;
+		zStream->avail_in = length;
+		do
+			{
+			long outLength;
+
+			zStream->next_out = stream->outBuffer;
+			zStream->avail_out = OUTPUT_BUFFER_SIZE;
+			if( deflate( zStream, isFinal ? Z_FINISH : Z_NO_FLUSH ) == \
+															Z_STREAM_ERROR )
+				return( FALSE );
+			outLength = OUTPUT_BUFFER_SIZE - zStream->avail_out;
+			if( fwrite( stream->outBuffer, 1, outLength,
+						stream->outFile ) != ( size_t ) outLength )
+				return( FALSE );
+			}
+		while( zStream->avail_out == 0 );
+		}
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( stream->type == COMPRESSION_ZSTD )
+		{
+		ZSTD_inBuffer inBuffer;
+		size_t remaining;
+
+		inBuffer.src = data;
+		inBuffer.size = length;
+		inBuffer.pos = 0;
+		do
+			{
+			ZSTD_outBuffer outBuffer;
+
+			outBuffer.dst = stream->outBuffer;
+			outBuffer.size = OUTPUT_BUFFER_SIZE;
+			outBuffer.pos = 0;
+			if( inBuffer.pos < inBuffer.size )
+				{
+				remaining = ZSTD_compressStream( stream->zstdStream,
+												 &outBuffer, &inBuffer );
+				}
+			else
+				{
+				remaining = isFinal ? \
+					ZSTD_endStream( stream->zstdStream, &outBuffer ) : 0;
+				}
+			if( ZSTD_isError( remaining ) || \
+				fwrite( stream->outBuffer, 1, outBuffer.pos,
+						stream->outFile ) != outBuffer.pos )
+				return( FALSE );
+			}
+		while( inBuffer.pos < inBuffer.size || remaining > 0 );
+		}
+#endif /* USE_ZSTD */
+
+	return( TRUE );
+	}
+
+/* Compress buffers as the decoder fills them */
+
+static void *compressWorker( void *arg )
+	{
+	COMPRESSED_OUTPUT *stream = ( COMPRESSED_OUTPUT * ) arg;
+	int status = TRUE;
+
+	while( TRUE )
+		{
+		int bufferNo;
+
+		/* Wait for a buffer to compress */
+		pthread_mutex_lock( &stream->mutex );
+		while( stream->compressBuffer < 0 && !stream->finished )
+			pthread_cond_wait( &stream->stateChanged, &stream->mutex );
+		bufferNo = stream->compressBuffer;
+		pthread_mutex_unlock( &stream->mutex );
+		if( bufferNo < 0 )
+			break;
+
+		/* Compress it and hand it back to the decoder */
+		if( status )
+			{
+			status = compressBuffer( stream, stream->buffers[ bufferNo ],
+									 stream->lengths[ bufferNo ], FALSE );
+			}
+		pthread_mutex_lock( &stream->mutex );
+		stream->compressBuffer = -1;
+		if( !status )
+			stream->writeError = TRUE;
+		pthread_cond_signal( &stream->stateChanged );
+		pthread_mutex_unlock( &stream->mutex );
+		}
+
+	/* Finish the compressed data */
+	if( status && !compressBuffer( stream, NULL, 0, TRUE ) )
+		status = FALSE;
+	if( fflush( stream->outFile ) )
+		status = FALSE;
+	if( !status )
+		stream->writeError = TRUE;
+
+	return( NULL );
+	}
+
+/* Pass the buffer that the decoder has filled to the compression thread,
+   waiting for it to finish with the other buffer if necessary */
+
+static int submitBuffer( COMPRESSED_OUTPUT *stream )
+	{
+	int status;
+
+	pthread_mutex_lock( &stream->mutex );
+	while( stream->compressBuffer >= 0 )
+		pthread_cond_wait( &stream->stateChanged, &stream->mutex );
+	stream->compressBuffer = stream->fillBuffer;
+	status = stream->writeError ? FALSE : TRUE;
+	pthread_cond_signal( &stream->stateChanged );
+	pthread_mutex_unlock( &stream->mutex );
+	stream->fillBuffer ^= 1;
+	stream->lengths[ stream->fillBuffer ] = 0;
+
+	return( status );
+	}
+
+/* The stdio stream functions */
+
+static long compressedWrite( COMPRESSED_OUTPUT *stream, const char *data,
+							 const long length )
+	{
+	long count = 0;
+
+	while( count < length )
+		{
+		const int bufferNo = stream->fillBuffer;
+		const long copyLength = min( length - count,
+						OUTPUT_BUFFER_SIZE - stream->lengths[ bufferNo ] );
+
+		memcpy( stream->buffers[ bufferNo ] + stream->lengths[ bufferNo ],
+				data + count, copyLength );
+		stream->lengths[ bufferNo ] += copyLength;
+		count += copyLength;
+		if( stream->lengths[ bufferNo ] >= OUTPUT_BUFFER_SIZE && \
+			!submitBuffer( stream ) )
+			return( -1 );
+		}
+
+	return( count );
+	}
+
+static void freeCompressedOutput( COMPRESSED_OUTPUT *stream )
+	{
+#ifdef USE_ZLIB
+	if( stream->type == COMPRESSION_GZIP )
+		deflateEnd( &stream->zStream );
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( stream->type == COMPRESSION_ZSTD )
+		ZSTD_freeCStream( stream->zstdStream );
+#endif /* USE_ZSTD */
+	pthread_mutex_destroy( &stream->mutex );
+	pthread_cond_destroy( &stream->stateChanged );
+	free( stream->buffers[ 0 ] );
+	free( stream->buffers[ 1 ] );
+	free( stream->outBuffer );
+	free( stream );
+	}
+
+static int compressedOutputClose( COMPRESSED_OUTPUT *stream )
+	{
+	int status = TRUE;
+
+	/* Pass over any remaining data and wait for the compression thread to
+	   finish */
+	if( stream->lengths[ stream->fillBuffer ] > 0 )
+		status = submitBuffer( stream );
+	pthread_mutex_lock( &stream->mutex );
+	stream->finished = TRUE;
+	pthread_cond_signal( &stream->stateChanged );
+	pthread_mutex_unlock( &stream->mutex );
+	pthread_join( stream->thread, NULL );
+	if( stream->writeError )
+		status = FALSE;
+	freeCompressedOutput( stream );
+
+	return( status ? 0 : EOF );
+	}
+
+#if defined( __linux__ )
+
+static ssize_t outputStreamWrite( void *cookie, const char *data,
+								  size_t length )
+	{
+	return( compressedWrite( cookie, data, length ) );
+	}
+
+static int outputStreamClose( void *cookie )
+	{
+	return( compressedOutputClose( cookie ) );
+	}
+
+static FILE *openCompressedOutputStream( COMPRESSED_OUTPUT *stream )
+	{
+	cookie_io_functions_t ioFunctions = { NULL, outputStreamWrite, NULL,
+										  outputStreamClose };
+
+	return( fopencookie( stream, "w", ioFunctions ) );
+	}
+#else
+
+static int outputStreamWrite( void *cookie, const char *data, int length )
+	{
+	return( ( int ) compressedWrite( cookie, data, length ) );
+	}
+
+static int outputStreamClose( void *cookie )
+	{
+	return( compressedOutputClose( cookie ) );
+	}
+
+static FILE *openCompressedOutputStream( COMPRESSED_OUTPUT *stream )
+	{
+	return( funopen( stream, NULL, outputStreamWrite, NULL,
+					 outputStreamClose ) );
+	}
+#endif /* OS-specific custom stream handling */
+
+/* Open a stream that compresses the data written to it into the given
+   file.  Closing the stream waits for the compression to finish */
+
+static FILE *openCompressedOutput( FILE *outFile,
+								   const COMPRESSION_TYPE type )
+	{
+	COMPRESSED_OUTPUT *stream;
+	FILE *outStream;
+	int status = FALSE;
+
+	if( ( stream = ( COMPRESSED_OUTPUT * ) \
+				   calloc( 1, sizeof( COMPRESSED_OUTPUT ) ) ) == NULL )
+		return( NULL );
+	stream->outFile = outFile;
+	stream->type = type;
+	stream->compressBuffer = -1;
+	pthread_mutex_init( &stream->mutex, NULL );
+	pthread_cond_init( &stream->stateChanged, NULL );
+	stream->buffers[ 0 ] = ( BYTE * ) malloc( OUTPUT_BUFFER_SIZE );
+	stream->buffers[ 1 ] = ( BYTE * ) malloc( OUTPUT_BUFFER_SIZE );
+	stream->outBuffer = ( BYTE * ) malloc( OUTPUT_BUFFER_SIZE );
+	if( stream->buffers[ 0 ] == NULL || stream->buffers[ 1 ] == NULL || \
+		stream->outBuffer == NULL )
+		{
+		freeCompressedOutput( stream );
+		return( NULL );
+		}
+
+	/* Set up the compression.  Since the aim is to keep up with the
+	   decoder, we use the fastest gzip setting and zstd's default, which
+	   is both faster and better than that */
+#ifdef USE_ZLIB
+	if( type == COMPRESSION_GZIP )
+		{
+		/* Window bits + 16 produces a gzip rather than zlib header */
+		status = ( deflateInit2( &stream->zStream, Z_BEST_SPEED, Z_DEFLATED,
+								 MAX_WBITS + 16, 8,
+								 Z_DEFAULT_STRATEGY ) == Z_OK );
+		}
+#endif /* USE_ZLIB */
+#ifdef USE_ZSTD
+	if( type == COMPRESSION_ZSTD )
+		{
+		if( ( stream->zstdStream = ZSTD_createCStream() ) != NULL )
+			{
+			if( ZSTD_isError( ZSTD_initCStream( stream->zstdStream,
+												ZSTD_CLEVEL_DEFAULT ) ) )
+				{
+				ZSTD_freeCStream( stream->zstdStream );
+				stream->zstdStream = NULL;
+				}
+			else
+				status = TRUE;
+			}
+		}
+#endif /* USE_ZSTD */
+	if( !status )
+		{
+		stream->type = COMPRESSION_NONE;
+		freeCompressedOutput( stream );
+		return( NULL );
+		}
+
+	/* Start the compression thread and hand the stream to stdio */
+	if( pthread_create( &stream->thread, NULL, compressWorker, stream ) )
+		{
+		freeCompressedOutput( stream );
+		return( NULL );
+		}
+	if( ( outStream = openCompressedOutputStream( stream ) ) == NULL )
+		{
+		compressedOutputClose( stream );
+		return( NULL );
+		}
+	setvbuf( outStream, NULL, _IOFBF, OUTPUT_STREAM_BUFFER );
+
+	return( outStream );
+	}
+
+/* Send the output through a compressor if that's been requested, and
+   finish the compressed output once we're done */
+
+static int beginOutputCompression( void )
+	{
+	if( outputCompression == COMPRESSION_NONE )
+		return( TRUE );
+	if( ( output = openCompressedOutput( stdout,
+							( COMPRESSION_TYPE ) outputCompression ) ) == NULL )
+		{
+		output = stdout;
+		puts( "Couldn't set up compression of output data." );
+		return( FALSE );
+		}
+
+	return( TRUE );
+	}
+
+static int endOutputCompression( void )
+	{
+	int status;
+
+	if( outputCompression == COMPRESSION_NONE || output == stdout )
+		return( TRUE );
+	status = fclose( output );
+	output = stdout;
+	if( status )
+		{
+		/* We can't report this via stdout since it contains the
+		   compressed data */
+		fputs( "Couldn't write compressed output.\n", stderr );
+		return( FALSE );
+		}
+
+	return( TRUE );
+	}
+#endif /* USE_COMPRESSED_OUTPUT */
+
+/****************************************************************************
+*																			*
+*							Hashing/Encoding Routines						*
+*																			*
+****************************************************************************/
+
+/* SHA-256 as per FIPS 180-4, used to fingerprint objects like the
+   SubjectPublicKeyInfo for key pinning.  This is a straightforward
+   implementation, which is still much faster than the rate at which we can
+   parse data */
+
+#define SHA256_DIGEST_SIZE	32
+#define SHA256_BLOCK_SIZE	64
+
+#define ROTR32( x, n )		MASK32( ( ( x ) >> ( n ) ) | ( ( x ) << ( 32 - ( n ) ) ) )
+
+typedef struct {
+	UINT32 state[ 8 ];					/* Hash state */
+	BYTE buffer[ SHA256_BLOCK_SIZE ];	/* Partial data block */
+	UINT32 lengthHi, lengthLo;			/* Data length in bytes */
+	} SHA256_INFO;
+
+static const UINT32 sha256K[ 64 ] = {
+	0x428A2F98UL, 0x71374491UL, 0xB5C0FBCFUL, 0xE9B5DBA5UL,
+	0x3956C25BUL, 0x59F111F1UL, 0x923F82A4UL, 0xAB1C5ED5UL,
+	0xD807AA98UL, 0x12835B01UL, 0x243185BEUL, 0x550C7DC3UL,
+	0x72BE5D74UL, 0x80DEB1FEUL, 0x9BDC06A7UL, 0xC19BF174UL,
+	0xE49B69C1UL, 0xEFBE4786UL, 0x0FC19DC6UL, 0x240CA1CCUL,
+	0x2DE92C6FUL, 0x4A7484AAUL, 0x5CB0A9DCUL, 0x76F988DAUL,
+	0x983E5152UL, 0xA831C66DUL, 0xB00327C8UL, 0xBF597FC7UL,
+	0xC6E00BF3UL, 0xD5A79147UL, 0x06CA6351UL, 0x14292967UL,
+	0x27B70A85UL, 0x2E1B2138UL, 0x4D2C6DFCUL, 0x53380D13UL,
+	0x650A7354UL, 0x766A0ABBUL, 0x81C2C92EUL, 0x92722C85UL,
+	0xA2BFE8A1UL, 0xA81A664BUL, 0xC24B8B70UL, 0xC76C51A3UL,
+	0xD192E819UL, 0xD6990624UL, 0xF40E3585UL, 0x106AA070UL,
+	0x19A4C116UL, 0x1E376C08UL, 0x2748774CUL, 0x34B0BCB5UL,
+	0x391C0CB3UL, 0x4ED8AA4AUL, 0x5B9CCA4FUL, 0x682E6FF3UL,
+	0x748F82EEUL, 0x78A5636FUL, 0x84C87814UL, 0x8CC70208UL,
+	0x90BEFFFAUL, 0xA4506CEBUL, 0xBEF9A3F7UL, 0xC67178F2UL
+	};
+
+static void sha256Block( UINT32 *state, const BYTE *block )
+	{
+	UINT32 W[ 64 ], a, b, c, d, e, f, g, h;
+	int i;
+
+	for( i = 0; i < 16; i++ )
+		{
+		W[ i ] = ( ( UINT32 ) block[ i * 4 ] << 24 ) | \
+				 ( ( UINT32 ) block[ i * 4 + 1 ] << 16 ) | \
+				 ( ( UINT32 ) block[ i * 4 + 2 ] << 8 ) | block[ i * 4 + 3 ];
+		}
+	for( i = 16; i < 64; i++ )
+		{
+		const UINT32 s0 = ROTR32( W[ i - 15 ], 7 ) ^ \
+						  ROTR32( W[ i - 15 ], 18 ) ^ ( W[ i - 15 ] >> 3 );
+		const UINT32 s1 = ROTR32( W[ i - 2 ], 17 ) ^ \
+						  ROTR32( W[ i - 2 ], 19 ) ^ ( W[ i - 2 ] >> 10 );
+
+		W[ i ] = MASK32( W[ i - 16 ] + s0 + W[ i - 7 ] + s1 );
+		}
+	a = state[ 0 ]; b = state[ 1 ]; c = state[ 2 ]; d = state[ 3 ];
+	e = state[ 4 ]; f = state[ 5 ]; g = state[ 6 ]; h = state[ 7 ];
+	for( i = 0; i < 64; i++ )
+		{
+		const UINT32 S1 = ROTR32( e, 6 ) ^ ROTR32( e, 11 ) ^ ROTR32( e, 25 );
+		const UINT32 S0 = ROTR32( a, 2 ) ^ ROTR32( a, 13 ) ^ ROTR32( a, 22 );
+		const UINT32 temp1 = MASK32( h + S1 + ( ( e & f ) ^ ( ~e & g ) ) + \
+									 sha256K[ i ] + W[ i ] );
+		const UINT32 temp2 = MASK32( S0 + ( ( a & b ) ^ ( a & c ) ^ ( b & c ) ) );
+
+		h = g; g = f; f = e;
+		e = MASK32( d + temp1 );
+		d = c; c = b; b = a;
+		a = MASK32( temp1 + temp2 );
+		}
+	state[ 0 ] = MASK32( state[ 0 ] + a ); state[ 1 ] = MASK32( state[ 1 ] + b );
+	state[ 2 ] = MASK32( state[ 2 ] + c ); state[ 3 ] = MASK32( state[ 3 ] + d );
+	state[ 4 ] = MASK32( state[ 4 ] + e ); state[ 5 ] = MASK32( state[ 5 ] + f );
+	state[ 6 ] = MASK32( state[ 6 ] + g ); state[ 7 ] = MASK32( state[ 7 ] + h );
+	}
+
+static void sha256Init( SHA256_INFO *sha256Info )
+	{
+	static const UINT32 sha256IV[ 8 ] = {
+		0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+		0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+		};
+
+	memset( sha256Info, 0, sizeof( SHA256_INFO ) );
+	memcpy( sha256Info->state, sha256IV, sizeof( sha256IV ) );
+	}
+
+static void sha256Update( SHA256_INFO *sha256Info, const BYTE *data,
+						  long length )
+	{
+	int bufPos = ( int ) ( sha256Info->lengthLo & ( SHA256_BLOCK_SIZE - 1 ) );
+	const UINT32 oldLengthLo = sha256Info->lengthLo;
+
+	/* Update the data length */
+	sha256Info->lengthLo = MASK32( sha256Info->lengthLo + ( UINT32 ) length );
+	if( sha256Info->lengthLo < oldLengthLo )
+		sha256Info->lengthHi++;
+
+	/* Complete any partial block, hash as many full blocks as we can, and
+	   save the remainder for later */
+	if( bufPos > 0 )
+		{
+		const int bytesToCopy = ( int ) min( length, SHA256_BLOCK_SIZE - bufPos );
+
+		memcpy( sha256Info->buffer + bufPos, data, bytesToCopy );
+		data += bytesToCopy;
+		length -= bytesToCopy;
+		bufPos += bytesToCopy;
+		if( bufPos < SHA256_BLOCK_SIZE )
+			return;
+		sha256Block( sha256Info->state, sha256Info->buffer );
+		}
+	while( length >= SHA256_BLOCK_SIZE )
+		{
+		sha256Block( sha256Info->state, data );
+		data += SHA256_BLOCK_SIZE;
+		length -= SHA256_BLOCK_SIZE;
+		}
+	if( length > 0 )
+		memcpy( sha256Info->buffer, data, length );
+	}
+
+static void sha256Final( SHA256_INFO *sha256Info, BYTE *digest )
+	{
+	const UINT32 bitsHi = MASK32( ( sha256Info->lengthHi << 3 ) | \
+								  ( sha256Info->lengthLo >> 29 ) );
+	const UINT32 bitsLo = MASK32( sha256Info->lengthLo << 3 );
+	int bufPos = ( int ) ( sha256Info->lengthLo & ( SHA256_BLOCK_SIZE - 1 ) );
+	int i;
+
+	/* Add the padding and bit count, in a second block if necessary */
+	sha256Info->buffer[ bufPos++ ] = 0x80;
+	if( bufPos > SHA256_BLOCK_SIZE - 8 )
+		{
+		memset( sha256Info->buffer + bufPos, 0, SHA256_BLOCK_SIZE - bufPos );
+		sha256Block( sha256Info->state, sha256Info->buffer );
+		bufPos = 0;
+		}
+	memset( sha256Info->buffer + bufPos, 0, SHA256_BLOCK_SIZE - 8 - bufPos );
+	for( i = 0; i < 4; i++ )
+		{
+		sha256Info->buffer[ SHA256_BLOCK_SIZE - 8 + i ] = \
+							( BYTE ) ( bitsHi >> ( 24 - ( i * 8 ) ) );
+		sha256Info->buffer[ SHA256_BLOCK_SIZE - 4 + i ] = \
+							( BYTE ) ( bitsLo >> ( 24 - ( i * 8 ) ) );
+		}
+	sha256Block( sha256Info->state, sha256Info->buffer );
+
+	for( i = 0; i < SHA256_DIGEST_SIZE; i++ )
+		digest[ i ] = ( BYTE ) ( sha256Info->state[ i / 4 ] >> ( 24 - ( ( i % 4 ) * 8 ) ) );
+	}
+
+static void sha256( const BYTE *data, const long length, BYTE *digest )
+	{
+	SHA256_INFO sha256Info;
+
+	sha256Init( &sha256Info );
+	sha256Update( &sha256Info, data, length );
+	sha256Final( &sha256Info, digest );
+	}
+
+/* Base64 encode and decode data.  The decoding is used to handle PEM-
+   encoded data and skips whitespace and line breaks, returning -1 if it
+   encounters anything other than base64 data */
+
+static const char base64Chars[] = \
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64Encode( char *outBuffer, const BYTE *data,
+						 const int dataLength )
+	{
+	int outPos = 0, i;
+
+	for( i = 0; i < dataLength; i += 3 )
+		{
+		const long value = ( ( long ) data[ i ] << 16 ) | \
+				( ( i + 1 < dataLength ) ? ( data[ i + 1 ] << 8 ) : 0 ) | \
+				( ( i + 2 < dataLength ) ? data[ i + 2 ] : 0 );
+
+		outBuffer[ outPos++ ] = base64Chars[ ( value >> 18 ) & 0x3F ];
+		outBuffer[ outPos++ ] = base64Chars[ ( value >> 12 ) & 0x3F ];
+		outBuffer[ outPos++ ] = ( i + 1 < dataLength ) ? \
+								base64Chars[ ( value >> 6 ) & 0x3F ] : '=';
+		outBuffer[ outPos++ ] = ( i + 2 < dataLength ) ? \
+								base64Chars[ value & 0x3F ] : '=';
+		}
+	outBuffer[ outPos ] = '\0';
+
+	return( outPos );
+	}
+
+static long base64Decode( BYTE *outBuffer, const char *data,
+						  const long dataLength )
+	{
+	long value = 0, outPos = 0, i;
+	int noBits = 0;
+
+	for( i = 0; i < dataLength; i++ )
+		{
+		const int ch = byteToInt( data[ i ] );
+		const char *charPos;
+
+		if( ch == '=' )
+			break;
+		if( isspace( ch ) )
+			continue;
+		if( ch == '\0' || ( charPos = strchr( base64Chars, ch ) ) == NULL )
+			return( -1 );
+		value = ( ( value << 6 ) | ( charPos - base64Chars ) ) & 0xFFFFFFL;
+		noBits += 6;
+		if( noBits >= 8 )
+			{
+			noBits -= 8;
+			outBuffer[ outPos++ ] = ( BYTE ) ( value >> noBits );
+			}
+		}
+
+	return( outPos );
+	}
+
+/****************************************************************************
+*																			*
+*						Certificate Inventory Routines						*
+*																			*
+****************************************************************************/
+
+/* When we're producing an inventory of certificates we don't dump the
+   certificates but walk the given files and directories and print one row
+   per certificate with its names, validity period, key algorithm, and the
+   SHA-256 hash of the SubjectPublicKeyInfo as used for key pinning.  Since
+   we only need a few fields from each certificate, they're located by
+   skipping over items in memory rather than by going through the full
+   decode */
+
+typedef struct {
+	char *buffer;				/* Text data */
+	int length, maxLength;		/* Current and maximum length */
+	} TEXT_BUFFER;
+
+typedef struct {
+	char **names;				/* File names */
+	int noNames, maxNames;		/* Current and maximum no.names */
+	} FILE_LIST;
+
+typedef struct {
+	const FILE_LIST *fileList;	/* Files to process */
+	FILE *outFile;				/* Output stream */
+	TEXT_BUFFER rows;			/* Rows waiting to be written */
+	int noCerts, noFiles, noSkipped;	/* Certificates and files processed */
+	int noFiltered;				/* Certificates filtered out */
+	} INVENTORY_JOB;
+
+typedef struct {
+	TEXT_BUFFER *rows;			/* Rows for the file being processed */
+	const char *fileName;		/* Name of the file */
+	int noFiltered;				/* Certificates filtered out */
+	} INVENTORY_OBJECT;
+
+/* The function applied to each object found in a file */
+
+typedef int ( *OBJECT_FUNCTION )( void *arg, const BYTE *data,
+								  const long dataLength );
+
+/* The point at which we flush accumulated rows to the output */
+
+#define INVENTORY_FLUSH_SIZE	32768
+
+/* The files to process are handed out to the worker threads in order, and
+   the output is written under the same lock */
+
+#ifdef USE_THREADS
+static pthread_mutex_t inventoryMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif /* USE_THREADS */
+static int inventoryNextFile = 0;
+
+/* Short names for the attribute types commonly found in DNs, anything
+   else is displayed using the name from the config file or as a dotted
+   OID */
+
+typedef struct {
+	const char *oid;			/* Encoded OID value */
+	const int oidLength;
+	const char *name;			/* Short name */
+	} DN_NAME_INFO;
+
+static const DN_NAME_INFO dnNameInfo[] = {
+	{ "\x55\x04\x03", 3, "CN" },
+	{ "\x55\x04\x06", 3, "C" },
+	{ "\x55\x04\x0A", 3, "O" },
+	{ "\x55\x04\x0B", 3, "OU" },
+	{ "\x55\x04\x07", 3, "L" },
+	{ "\x55\x04\x08", 3, "ST" },
+	{ "\x55\x04\x09", 3, "street" },
+	{ "\x55\x04\x05", 3, "serialNumber" },
+	{ "\x55\x04\x04", 3, "SN" },
+	{ "\x55\x04\x2A", 3, "GN" },
+	{ "\x55\x04\x0C", 3, "title" },
+	{ "\x55\x04\x11", 3, "postalCode" },
+	{ "\x2A\x86\x48\x86\xF7\x0D\x01\x09\x01", 9, "emailAddress" },
+	{ "\x09\x92\x26\x89\x93\xF2\x2C\x64\x01\x19", 10, "DC" },
+	{ "\x09\x92\x26\x89\x93\xF2\x2C\x64\x01\x01", 10, "UID" },
+	{ NULL, 0, NULL }
+	};
+
+/* Append data to a text buffer, expanding it as required */
+
+static int appendText( TEXT_BUFFER *textBuffer, const char *text,
+					   const int length )
+	{
+	if( textBuffer->length + length + 1 > textBuffer->maxLength )
+		{
+		const int newLength = ( textBuffer->maxLength * 2 > \
+								textBuffer->length + length + 256 ) ? \
+							  textBuffer->maxLength * 2 : \
+							  textBuffer->length + length + 256;
+		char *newBuffer = ( char * ) realloc( textBuffer->buffer, newLength );
+
+		if( newBuffer == NULL )
+			return( FALSE );
+		textBuffer->buffer = newBuffer;
+		textBuffer->maxLength = newLength;
+		}
+	memcpy( textBuffer->buffer + textBuffer->length, text, length );
+	textBuffer->length += length;
+	textBuffer->buffer[ textBuffer->length ] = '\0';
+
+	return( TRUE );
+	}
+
+#define appendString( textBuffer, string ) \
+		appendText( textBuffer, string, strlen( string ) )
+
+/* Append a character value to a text buffer as UTF-8, escaping characters
+   that are special in a DN string as per RFC 4514 */
+
+static int appendDNchar( TEXT_BUFFER *textBuffer, const long ch )
+	{
+	char buffer[ 8 ];
+	int length = 0;
+
+	if( ch < 0x20 || ch == 0x7F )
+		length = sprintf( buffer, "\\%02X", ( int ) ch );
+	else
+		{
+		if( ch < 0x80 )
+			{
+			if( strchr( ",+\"\\<>;", ( int ) ch ) != NULL )
+				buffer[ length++ ] = '\\';
+			buffer[ length++ ] = ( char ) ch;
+			}
+		else
+			{
+			if( ch < 0x800 )
+				buffer[ length++ ] = ( char ) ( 0xC0 | ( ch >> 6 ) );
+			else
+				{
+				if( ch < 0x10000L )
+					buffer[ length++ ] = ( char ) ( 0xE0 | ( ch >> 12 ) );
+				else
+					{
+					buffer[ length++ ] = ( char ) ( 0xF0 | ( ( ch >> 18 ) & 0x07 ) );
+					buffer[ length++ ] = ( char ) ( 0x80 | ( ( ch >> 12 ) & 0x3F ) );
+					}
+				buffer[ length++ ] = ( char ) ( 0x80 | ( ( ch >> 6 ) & 0x3F ) );
+				}
+			buffer[ length++ ] = ( char ) ( 0x80 | ( ch & 0x3F ) );
+			}
+		}
+
+	return( appendText( textBuffer, buffer, length ) );
+	}
+
+/* Get the next item from a block of memory if it has the given tag,
+   leaving the data pointer unchanged if it doesn't */
+
+static const BYTE *getMemField( const BYTE **dataPtr, long *dataLeft,
+								ASN1_ITEM *item, const int id,
+								const int tag )
+	{
+	const BYTE *data = *dataPtr;
+	const BYTE *content;
+	long length = *dataLeft;
+
+	content = getNextMemItem( &data, &length, item );
+	if( content == NULL || item->id != id || item->tag != tag )
+		return( NULL );
+	*dataPtr = data;
+	*dataLeft = length;
+
+	return( content );
+	}
+
+/* Append an OID to a text buffer in dotted form */
+
+static int appendOID( TEXT_BUFFER *textBuffer, const BYTE *oid,
+					  const int oidLength )
+	{
+	char textOID[ 128 ];
+	int textOIDlength, i;
+
+	if( oidLength > MAX_OID_SIZE || \
+		!oidToString( textOID, &textOIDlength, oid, oidLength ) )
+		return( appendString( textBuffer, "?" ) );
+	for( i = 0; i < textOIDlength; i++ )
+		{
+		if( textOID[ i ] == ' ' )
+			textOID[ i ] = '.';
+		}
+
+	return( appendText( textBuffer, textOID, textOIDlength ) );
+	}
+
+/* Append a DN attribute value to a text buffer, converting the various
+   string types to UTF-8.  Anything that isn't a string is displayed as the
+   hex-encoded BER as per RFC 4514 */
+
+static int appendDNvalue( TEXT_BUFFER *textBuffer, const ASN1_ITEM *item,
+						  const BYTE *value )
+	{
+	const long length = item->length;
+	long i;
+	int status = TRUE;
+
+	if( item->id == UNIVERSAL )
+		{
+		switch( item->tag )
+			{
+			case UTF8STRING:
+				/* UTF-8 data is copied as is, with only the special
+				   characters escaped */
+				for( i = 0; i < length && status; i++ )
+					{
+					if( value[ i ] < 0x80 )
+						status = appendDNchar( textBuffer, value[ i ] );
+					else
+						status = appendText( textBuffer,
+											 ( const char * ) value + i, 1 );
+					}
+				return( status );
+
+			case PRINTABLESTRING:
+			case IA5STRING:
+			case VISIBLESTRING:
+			case NUMERICSTRING:
+			case T61STRING:
+				/* T61Strings are almost always latin-1 in practice */
+				for( i = 0; i < length && status; i++ )
+					status = appendDNchar( textBuffer, value[ i ] );
+				return( status );
+
+			case BMPSTRING:
+				if( length % 2 )
+					break;
+				for( i = 0; i < length && status; i += 2 )
+					{
+					status = appendDNchar( textBuffer,
+										   ( ( long ) value[ i ] << 8 ) | value[ i + 1 ] );
+					}
+				return( status );
+
+			case UNIVERSALSTRING:
+				if( length % 4 || value[ 0 ] != 0 )
+					break;
+				for( i = 0; i < length && status; i += 4 )
+					{
+					status = appendDNchar( textBuffer,
+										   ( ( long ) value[ i + 1 ] << 16 ) | \
+										   ( ( long ) value[ i + 2 ] << 8 ) | \
+										   value[ i + 3 ] );
+					}
+				return( status );
+			}
+		}
+
+	/* It's not a string type, display it as hex */
+	status = appendString( textBuffer, "#" );
+	for( i = 0; i < item->headerSize && status; i++ )
+		{
+		char buffer[ 8 ];
+
+		sprintf( buffer, "%02X", item->header[ i ] );
+		status = appendText( textBuffer, buffer, 2 );
+		}
+	for( i = 0; i < length && status; i++ )
+		{
+		char buffer[ 8 ];
+
+		sprintf( buffer, "%02X", value[ i ] );
+		status = appendText( textBuffer, buffer, 2 );
+		}
+
+	return( status );
+	}
+
+/* Append a DN to a text buffer in the form "CN=x, O=y, C=z", in the order
+   in which the RDNs are encoded, with multivalued RDNs joined with '+' */
+
+static int appendDN( TEXT_BUFFER *textBuffer, const BYTE *dn, long dnLength )
+	{
+	ASN1_ITEM item;
+	const BYTE *rdn;
+	long rdnLength;
+	int isFirst = TRUE;
+
+	while( dnLength > 0 )
+		{
+		if( ( rdn = getMemField( &dn, &dnLength, &item,
+								 UNIVERSAL | CONSTRUCTED, SET ) ) == NULL )
+			return( FALSE );
+		rdnLength = item.length;
+		if( !isFirst && !appendString( textBuffer, ", " ) )
+			return( FALSE );
+		isFirst = FALSE;
+		while( rdnLength > 0 )
+			{
+			const DN_NAME_INFO *nameInfo;
+			const BYTE *ava, *oid, *value;
+			long avaLength;
+			int oidLength, i;
+
+			/* Get the attribute type and value */
+			if( ( ava = getMemField( &rdn, &rdnLength, &item,
+									 UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+				return( FALSE );
+			avaLength = item.length;
+			if( ( oid = getMemField( &ava, &avaLength, &item,
+									 UNIVERSAL, OID ) ) == NULL || \
+				item.length < 2 || item.length > MAX_OID_SIZE )
+				return( FALSE );
+			oidLength = ( int ) item.length;
+			if( ( value = getNextMemItem( &ava, &avaLength, &item ) ) == NULL )
+				return( FALSE );
+
+			/* Display the attribute type as a short name if we know it,
+			   otherwise as the name from the config file or as an OID */
+			for( i = 0; dnNameInfo[ i ].oid != NULL; i++ )
+				{
+				if( dnNameInfo[ i ].oidLength == oidLength && \
+					!memcmp( dnNameInfo[ i ].oid, oid, oidLength ) )
+					break;
+				}
+			nameInfo = &dnNameInfo[ i ];
+			if( nameInfo->name != NULL )
+				{
+				if( !appendString( textBuffer, nameInfo->name ) )
+					return( FALSE );
+				}
+			else
+				{
+				const OIDINFO *oidInfo = getOIDinfo( oid, oidLength );
+
+				if( oidInfo != NULL && oidInfo->description != NULL && \
+					strchr( oidInfo->description, ' ' ) == NULL )
+					{
+					if( !appendString( textBuffer, oidInfo->description ) )
+						return( FALSE );
+					}
+				else
+					{
+					if( !appendOID( textBuffer, oid, oidLength ) )
+						return( FALSE );
+					}
+				}
+			if( !appendString( textBuffer, "=" ) || \
+				!appendDNvalue( textBuffer, &item, value ) )
+				return( FALSE );
+			if( rdnLength > 0 && !appendString( textBuffer, "+" ) )
+				return( FALSE );
+			}
+		}
+
+	return( TRUE );
+	}
+
+/* Check the eight ASCII digits at the given position and convert them
+   into two-digit values.  Since times are fixed-width we can do this a
+   word at a time rather than a character at a time: with the digits
+   loaded little-endian into a 64-bit word, every byte must have a high
+   nibble of 3 and a low nibble that doesn't carry into the high nibble
+   when 6 is added to it, after which multiplying by 10 and adding the
+   word shifted down by one byte leaves the value of each pair of digits
+   in the low byte of each 16-bit lane.  Returns the pairs packed into 16-
+   bit lanes, or 0 if there's a non-digit present, which can't be confused
+   with the digits of a valid time since these can't all be zero */
+
+#define DIGIT_HIGH_NIBBLES		0xF0F0F0F0F0F0F0F0ULL
+#define DIGIT_ZEROES			0x3030303030303030ULL
+#define DIGIT_CARRY				0x0606060606060606ULL
+#define DIGIT_PAIR_MASK			0x00FF00FF00FF00FFULL
+
+static unsigned long long getDigitPairs( const BYTE *value )
+	{
+	unsigned long long word = 0;
+	int i;
+
+	/* Load the digits little-endian, which also avoids any alignment
+	   problems */
+	for( i = 7; i >= 0; i-- )
+		word = ( word << 8 ) | value[ i ];
+	if( ( word & DIGIT_HIGH_NIBBLES ) != DIGIT_ZEROES || \
+		( ( word + DIGIT_CARRY ) & DIGIT_HIGH_NIBBLES ) != DIGIT_ZEROES )
+		return( 0 );
+	word -= DIGIT_ZEROES;
+
+	return( ( word * 10 + ( word >> 8 ) ) & DIGIT_PAIR_MASK );
+	}
+
+#define getDigitPair( pairs, index ) \
+		( ( int ) ( ( ( pairs ) >> ( ( index ) * 16 ) ) & 0xFF ) )
+
+/* Convert a UTCTime or GeneralizedTime in the standard DER form, either
+   YYMMDDhhmmssZ or YYYYMMDDhhmmssZ, into seconds since 1970 without going
+   via any text formatting or sscanf().  The digits are converted as two
+   overlapping groups of eight, the first covering the (century,) year,
+   month, and day and the second the day, hour, minute, and second.
+   Returns FALSE if the time isn't in the standard DER form */
+
+static int getTimeValue( const BYTE *value, const long length,
+						 const int isUTCTime, long long *timeValue )
+	{
+	const int yearLength = isUTCTime ? 2 : 4;
+	unsigned long long datePairs, timePairs;
+	long long days;
+	int year, month, day, hour, minute, second, yearOfEra;
+
+	if( length != yearLength + 11 || value[ yearLength + 10 ] != 'Z' )
+		return( FALSE );
+	datePairs = getDigitPairs( value );
+	timePairs = getDigitPairs( value + yearLength + 2 );
+	if( datePairs == 0 || timePairs == 0 )
+		return( FALSE );
+	if( isUTCTime )
+		{
+		/* Two-digit years are interpreted as per RFC 5280 */
+		year = getDigitPair( datePairs, 0 );
+		year += ( year < 50 ) ? 2000 : 1900;
+		month = getDigitPair( datePairs, 1 );
+		}
+	else
+		{
+		year = getDigitPair( datePairs, 0 ) * 100 + \
+			   getDigitPair( datePairs, 1 );
+		month = getDigitPair( datePairs, 2 );
+		}
+	day = getDigitPair( timePairs, 0 );
+	hour = getDigitPair( timePairs, 1 );
+	minute = getDigitPair( timePairs, 2 );
+	second = getDigitPair( timePairs, 3 );
+	if( month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || \
+		minute > 59 || second > 59 )
+		return( FALSE );
+	if( day > 28 )
+		{
+		static const int monthDays[] = { 31, 29, 31, 30, 31, 30,
+										 31, 31, 30, 31, 30, 31 };
+		const int isLeapYear = ( year % 4 == 0 && year % 100 != 0 ) || \
+							   year % 400 == 0;
+
+		if( day > monthDays[ month - 1 ] || \
+			( month == 2 && day == 29 && !isLeapYear ) )
+			return( FALSE );
+		}
+
+	/* Convert the date to days since 1970 using a year that starts in
+	   March so that the leap day comes at the end, with 146097 days in
+	   each 400-year cycle and 719468 days from 0000-03-01 to 1970-01-01.
+	   The year is offset by one cycle so that it doesn't go negative for
+	   January and February of the year 0 */
+	year += ( month <= 2 ) ? 399 : 400;
+	yearOfEra = year % 400;
+	days = ( long long ) ( year / 400 - 1 ) * 146097 + \
+		   yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + \
+		   ( 153 * ( month + ( ( month > 2 ) ? -3 : 9 ) ) + 2 ) / 5 + \
+		   day - 1 - 719468;
+	*timeValue = days * 86400 + hour * 3600 + minute * 60 + second;
+
+	return( TRUE );
+	}
+
+/* Check whether a certificate's validity period passes the
+   --expiring-before and --valid-at filters.  This only needs to compare
+   the times, so they're converted directly to seconds rather than being
+   formatted, and the notBefore time is only converted if it's needed */
+
+static int checkValidityFilter( const BYTE *validity, long validityLength )
+	{
+	ASN1_ITEM item;
+	const BYTE *time;
+	long long notBefore = 0, notAfter;
+
+	if( ( time = getNextMemItem( &validity, &validityLength,
+								 &item ) ) == NULL || \
+		item.id != UNIVERSAL || \
+		( item.tag != UTCTIME && item.tag != GENERALIZEDTIME ) )
+		return( FALSE );
+	if( filterValidAt && \
+		!getTimeValue( time, item.length, item.tag == UTCTIME, &notBefore ) )
+		return( FALSE );
+	if( ( time = getNextMemItem( &validity, &validityLength,
+								 &item ) ) == NULL || \
+		item.id != UNIVERSAL || \
+		( item.tag != UTCTIME && item.tag != GENERALIZEDTIME ) || \
+		!getTimeValue( time, item.length, item.tag == UTCTIME, &notAfter ) )
+		return( FALSE );
+	if( filterExpiry && notAfter >= expiryTime )
+		return( FALSE );
+	if( filterValidAt && ( validAtTime < notBefore || \
+						   validAtTime > notAfter ) )
+		return( FALSE );
+
+	return( TRUE );
+	}
+
+/* Append a UTCTime or GeneralizedTime to a text buffer in ISO 8601 form,
+   or as is if it isn't in the standard DER format */
+
+static int appendTime( TEXT_BUFFER *textBuffer, const ASN1_ITEM *item,
+					   const BYTE *value )
+	{
+	const int yearLength = ( item->tag == UTCTIME ) ? 2 : 4;
+	char buffer[ 32 ];
+	int i;
+
+	if( item->length != yearLength + 11 || value[ yearLength + 10 ] != 'Z' )
+		{
+		for( i = 0; i < item->length && i < 31; i++ )
+			{
+			buffer[ i ] = isprint( value[ i ] ) && value[ i ] != '"' && \
+						  value[ i ] != ',' ? value[ i ] : '.';
+			}
+		return( appendText( textBuffer, buffer, i ) );
+		}
+	for( i = 0; i < yearLength + 10; i++ )
+		{
+		if( !isdigit( value[ i ] ) )
+			return( appendText( textBuffer, ( const char * ) value, i ) );
+		}
+	if( item->tag == UTCTIME )
+		{
+		/* Two-digit years are interpreted as per RFC 5280 */
+		sprintf( buffer, "%s", ( value[ 0 ] < '5' ) ? "20" : "19" );
+		}
+	else
+		{
+		buffer[ 0 ] = value[ 0 ];
+		buffer[ 1 ] = value[ 1 ];
+		value += 2;
+		}
+	sprintf( buffer + 2, "%.2s-%.2s-%.2sT%.2s:%.2s:%.2sZ", value, value + 2,
+			 value + 4, value + 6, value + 8, value + 10 );
+
+	return( appendString( textBuffer, buffer ) );
+	}
+
+/* Append an inventory field to a text buffer, quoting it as required for
+   the output format */
+
+static int appendField( TEXT_BUFFER *textBuffer, const char *name,
+						const char *value, const int isFirst )
+	{
+	const char *valuePtr;
+	int status = TRUE;
+
+	if( inventoryFormat == INVENTORY_CSV )
+		{
+		if( !isFirst )
+			status = appendString( textBuffer, "," );
+		if( strpbrk( value, ",\"\r\n" ) == NULL )
+			return( status && appendString( textBuffer, value ) );
+
+		/* Quote the field, doubling any quotes inside it */
+		status = appendString( textBuffer, "\"" );
+		for( valuePtr = value; *valuePtr && status; valuePtr++ )
+			{
+			if( *valuePtr == '"' )
+				status = appendString( textBuffer, "\"" );
+			status = status && appendText( textBuffer, valuePtr, 1 );
+			}
+		return( status && appendString( textBuffer, "\"" ) );
+		}
+
+	/* It's JSON, escape the value as a string */
+	status = appendString( textBuffer, isFirst ? "{\"" : ",\"" );
+	status = status && appendString( textBuffer, name );
+	status = status && appendString( textBuffer, "\":\"" );
+	for( valuePtr = value; *valuePtr && status; valuePtr++ )
+		{
+		const int ch = byteToInt( *valuePtr );
+
+		if( ch < 0x20 )
+			{
+			char buffer[ 8 ];
+
+			sprintf( buffer, "\\u%04X", ch );
+			status = appendString( textBuffer, buffer );
+			continue;
+			}
+		if( ch == '"' || ch == '\\' )
+			status = appendString( textBuffer, "\\" );
+		status = status && appendText( textBuffer, valuePtr, 1 );
+		}
+
+	return( status && appendString( textBuffer, "\"" ) );
+	}
+
+/* Add a row for a certificate to the inventory.  Returns FALSE if the data
+   isn't a certificate, with isFiltered set if it's a certificate that's
+   been filtered out by validity */
+
+static int addInventoryCert( TEXT_BUFFER *rows, const char *fileName,
+							 const BYTE *cert, long certLength,
+							 int *isFiltered )
+	{
+	TEXT_BUFFER fields[ 7 ];
+	ASN1_ITEM item;
+	const OIDINFO *oidInfo = NULL;
+	const BYTE *certData, *tbs, *issuer, *validity, *subject, *spki;
+	const BYTE *spkiStart, *algoID, *oid = NULL;
+	BYTE hash[ SHA256_DIGEST_SIZE ];
+	char hashText[ 64 ];
+	long tbsLength, issuerLength, validityLength, subjectLength;
+	long spkiLength;
+	int oidLength = 0, i, status = FALSE;
+
+	*isFiltered = FALSE;
+
+	/* Locate the fields in the certificate that we need */
+	if( ( certData = getMemField( &cert, &certLength, &item,
+								  UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( FALSE );
+	certLength = item.length;
+	if( ( tbs = getMemField( &certData, &certLength, &item,
+							 UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( FALSE );
+	tbsLength = item.length;
+	( void ) getMemField( &tbs, &tbsLength, &item, CONTEXT | CONSTRUCTED, 0 );
+	if( getMemField( &tbs, &tbsLength, &item, UNIVERSAL, INTEGER ) == NULL || \
+		getMemField( &tbs, &tbsLength, &item,
+					 UNIVERSAL | CONSTRUCTED, SEQUENCE ) == NULL || \
+		( issuer = getMemField( &tbs, &tbsLength, &item,
+								UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( FALSE );
+	issuerLength = item.length;
+	if( ( validity = getMemField( &tbs, &tbsLength, &item,
+								  UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( FALSE );
+	validityLength = item.length;
+	if( ( filterExpiry || filterValidAt ) && \
+		!checkValidityFilter( validity, validityLength ) )
+		{
+		/* It's a certificate but it's been filtered out, don't add a row
+		   for it */
+		*isFiltered = TRUE;
+		return( TRUE );
+		}
+	if( ( subject = getMemField( &tbs, &tbsLength, &item,
+								 UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( FALSE );
+	subjectLength = item.length;
+	spkiStart = tbs;
+	if( ( spki = getMemField( &tbs, &tbsLength, &item,
+							  UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) == NULL )
+		return( FALSE );
+	spkiLength = item.length;
+	sha256( spkiStart, item.headerSize + item.length, hash );
+	if( ( algoID = getMemField( &spki, &spkiLength, &item,
+								UNIVERSAL | CONSTRUCTED, SEQUENCE ) ) != NULL )
+		{
+		spkiLength = item.length;
+		oid = getMemField( &algoID, &spkiLength, &item, UNIVERSAL, OID );
+		oidLength = ( int ) item.length;
+		}
+	if( oid == NULL || oidLength < 2 || oidLength > MAX_OID_SIZE )
+		return( FALSE );
+
+	/* Format the fields */
+	memset( fields, 0, sizeof( fields ) );
+	if( !appendString( &fields[ 0 ], fileName ) || \
+		!appendDN( &fields[ 1 ], subject, subjectLength ) || \
+		!appendDN( &fields[ 2 ], issuer, issuerLength ) )
+		goto exit;
+	for( i = 3; i < 5; i++ )
+		{
+		const BYTE *time;
+
+		if( ( time = getNextMemItem( &validity, &validityLength,
+									 &item ) ) == NULL || \
+			item.id != UNIVERSAL || \
+			( item.tag != UTCTIME && item.tag != GENERALIZEDTIME ) || \
+			!appendTime( &fields[ i ], &item, time ) )
+			goto exit;
+		}
+	if( !appendOID( &fields[ 5 ], oid, oidLength ) )
+		goto exit;
+	oidInfo = getOIDinfo( oid, oidLength );
+	if( !appendString( &fields[ 6 ], ( oidInfo != NULL && \
+						oidInfo->description != NULL ) ? \
+						oidInfo->description : "" ) )
+		goto exit;
+	base64Encode( hashText, hash, SHA256_DIGEST_SIZE );
+
+	/* Add the row */
+	status = TRUE;
+	for( i = 0; i < 7 && status; i++ )
+		{
+		status = appendField( rows, inventoryFieldNames[ i ],
+							  fields[ i ].buffer, i == 0 );
+		}
+	status = status && appendField( rows, inventoryFieldNames[ 7 ],
+									hashText, FALSE );
+	if( inventoryFormat != INVENTORY_CSV )
+		status = status && appendString( rows, "}" );
+	status = status && appendString( rows, "\n" );
+
+exit:
+	for( i = 0; i < 7; i++ )
+		{
+		if( fields[ i ].buffer != NULL )
+			free( fields[ i ].buffer );
+		}
+	return( status );
+	}
+
+/* Find a string in a block of memory */
+
+static const BYTE *findMemString( const BYTE *data, const long dataLength,
+								  const char *string )
+	{
+	const int stringLength = strlen( string );
+	const BYTE *dataPtr = data;
+
+	while( dataLength - ( dataPtr - data ) >= stringLength )
+		{
+		dataPtr = memchr( dataPtr, string[ 0 ],
+						  dataLength - ( dataPtr - data ) - stringLength + 1 );
+		if( dataPtr == NULL )
+			return( NULL );
+		if( !memcmp( dataPtr, string, stringLength ) )
+			return( dataPtr );
+		dataPtr++;
+		}
+
+	return( NULL );
+	}
+
+/* Apply a function to each object in a block of data.  The data can be
+   either one or more DER-encoded objects or PEM-encoded data with one or
+   more objects, with PEM blocks that don't contain certificates being
+   skipped if certsOnly is set.  Returns the number of objects processed */
+
+static int processObjects( const BYTE *data, long dataLength,
+						   const int certsOnly,
+						   OBJECT_FUNCTION objectFunction, void *arg )
+	{
+	const BYTE *pemStart;
+	int noCerts = 0;
+
+	/* If it's not PEM data, process it as a sequence of DER objects */
+	if( findMemString( data, dataLength, "-----BEGIN " ) == NULL )
+		{
+		while( dataLength > 0 )
+			{
+			const BYTE *cert = data;
+			ASN1_ITEM item;
+
+			if( getNextMemItem( &data, &dataLength, &item ) == NULL || \
+				!objectFunction( arg, cert, data - cert ) )
+				break;
+			noCerts++;
+			}
+		return( noCerts );
+		}
+
+	/* It's PEM data, decode each block in turn */
+	while( ( pemStart = findMemString( data, dataLength, "-----BEGIN " ) ) != NULL )
+		{
+		const BYTE *labelEnd, *pemEnd;
+		BYTE *certBuffer;
+		long certLength;
+		int isCert;
+
+		dataLength -= pemStart - data;
+		data = pemStart;
+		if( ( labelEnd = findMemString( data + 11, dataLength - 11,
+										"-----" ) ) == NULL || \
+			( pemEnd = findMemString( labelEnd, dataLength - ( labelEnd - data ),
+									  "-----END " ) ) == NULL )
+			break;
+		isCert = labelEnd - data >= 22 && \
+				 !memcmp( labelEnd - 11, "CERTIFICATE", 11 );
+		labelEnd += 5;
+		dataLength -= pemEnd + 9 - data;
+		data = pemEnd + 9;
+		if( certsOnly && !isCert )
+			continue;
+
+		/* Decode the object and process it */
+		certLength = pemEnd - labelEnd;
+		if( ( certBuffer = ( BYTE * ) malloc( certLength ) ) == NULL )
+			break;
+		certLength = base64Decode( certBuffer, ( const char * ) labelEnd,
+								   certLength );
+		if( certLength > 0 && \
+			objectFunction( arg, certBuffer, certLength ) )
+			noCerts++;
+		free( certBuffer );
+		}
+
+	return( noCerts );
+	}
+
+/* Add the certificates in a block of data to the inventory */
+
+static int addInventoryObject( void *arg, const BYTE *data,
+							   const long dataLength )
+	{
+	INVENTORY_OBJECT *object = ( INVENTORY_OBJECT * ) arg;
+	int isFiltered, status;
+
+	status = addInventoryCert( object->rows, object->fileName, data,
+							   dataLength, &isFiltered );
+	if( status && isFiltered )
+		object->noFiltered++;
+	return( status );
+	}
+
+static int addInventoryData( TEXT_BUFFER *rows, const char *fileName,
+							 const BYTE *data, long dataLength,
+							 int *noFiltered )
+	{
+	INVENTORY_OBJECT object;
+	int noCerts;
+
+	object.rows = rows;
+	object.fileName = fileName;
+	object.noFiltered = 0;
+	noCerts = processObjects( data, dataLength, TRUE, addInventoryObject,
+							  &object );
+	*noFiltered = object.noFiltered;
+	return( noCerts );
+	}
+
+/* Read a file into memory */
+
+static BYTE *readFileData( const char *fileName, long *dataLength )
+	{
+	FILE *inFile;
+	BYTE *data;
+	long length;
+
+	if( ( inFile = fopen( fileName, "rb" ) ) == NULL )
+		return( NULL );
+#ifdef USE_COMPRESSION
+	if( isCompressionSupported( getCompressionType( inFile ) ) )
+		return( readCompressedData( inFile, dataLength ) );
+#endif /* USE_COMPRESSION */
+	if( fseek( inFile, 0, SEEK_END ) || ( length = ftell( inFile ) ) <= 0 || \
+		fseek( inFile, 0, SEEK_SET ) || \
+		( data = ( BYTE * ) malloc( length ) ) == NULL )
+		{
+		fclose( inFile );
+		return( NULL );
+		}
+	if( fread( data, 1, length, inFile ) != ( size_t ) length )
+		{
+		free( data );
+		data = NULL;
+		}
+	fclose( inFile );
+	*dataLength = length;
+
+	return( data );
+	}
+
+/* Map a file into memory, or read it if it can't be mapped or needs to be
+   decompressed */
+
+static const BYTE *getFileData( const char *fileName, long *dataLength,
+								int *isMapped )
+	{
+#ifdef USE_THREADS
+	const BYTE *data;
+#endif /* USE_THREADS */
+
+	*isMapped = FALSE;
+#ifdef USE_THREADS
+	if( ( data = mapFile( fileName, dataLength ) ) != NULL )
+		{
+		/* If it's compressed, we have to read it in order to decompress
+		   it */
+		if( getMemCompressionType( data, *dataLength ) == COMPRESSION_NONE )
+			{
+			*isMapped = TRUE;
+			return( data );
+			}
+		munmap( ( void * ) data, *dataLength );
+		}
+#endif /* USE_THREADS */
+
+	return( readFileData( fileName, dataLength ) );
+	}
+
+static void freeFileData( const BYTE *data, const long dataLength,
+						  const int isMapped )
+	{
+#ifdef USE_THREADS
+	if( isMapped )
+		munmap( ( void * ) data, dataLength );
+	else
+#endif /* USE_THREADS */
+	free( ( void * ) data );
+	}
+
+/* Add a file to the list of files to process */
+
+static int addFileName( FILE_LIST *fileList, const char *fileName )
+	{
+	char *name;
+
+	if( fileList->noNames >= fileList->maxNames )
+		{
+		const int newMaxNames = fileList->maxNames ? \
+								fileList->maxNames * 2 : 256;
+		char **newNames = ( char ** ) realloc( fileList->names,
+											   newMaxNames * sizeof( char * ) );
+
+		if( newNames == NULL )
+			return( FALSE );
+		fileList->names = newNames;
+		fileList->maxNames = newMaxNames;
+		}
+	if( ( name = ( char * ) malloc( strlen( fileName ) + 1 ) ) == NULL )
+		return( FALSE );
+	strcpy( name, fileName );
+	fileList->names[ fileList->noNames++ ] = name;
+
+	return( TRUE );
+	}
+
+/* Add a file, or under Unix all of the files in a directory tree, to the
+   list of files to process.  Symbolic links to directories aren't followed
+   to avoid loops */
+
+static int addInventoryPath( FILE_LIST *fileList, const char *path )
+	{
+#ifdef __UNIX__
+	struct stat statInfo;
+	struct dirent *entry;
+	DIR *dir;
+
+	if( stat( path, &statInfo ) < 0 || !S_ISDIR( statInfo.st_mode ) )
+		return( addFileName( fileList, path ) );
+	if( ( dir = opendir( path ) ) == NULL )
+		{
+		perror( path );
+		return( TRUE );
+		}
+	while( ( entry = readdir( dir ) ) != NULL )
+		{
+		char *childPath;
+		int status = TRUE;
+
+		if( !strcmp( entry->d_name, "." ) || !strcmp( entry->d_name, ".." ) )
+			continue;
+		if( ( childPath = ( char * ) malloc( strlen( path ) + 1 + \
+							strlen( entry->d_name ) + 1 ) ) == NULL )
+			{
+			closedir( dir );
+			return( FALSE );
+			}
+		sprintf( childPath, ( path[ strlen( path ) - 1 ] == '/' ) ? \
+				 "%s%s" : "%s/%s", path, entry->d_name );
+		if( lstat( childPath, &statInfo ) == 0 )
+			{
+			if( S_ISDIR( statInfo.st_mode ) )
+				status = addInventoryPath( fileList, childPath );
+			else
+				{
+				if( S_ISREG( statInfo.st_mode ) || \
+					( S_ISLNK( statInfo.st_mode ) && \
+					  stat( childPath, &statInfo ) == 0 && \
+					  S_ISREG( statInfo.st_mode ) ) )
+					status = addFileName( fileList, childPath );
+				}
+			}
+		free( childPath );
+		if( !status )
+			{
+			closedir( dir );
+			return( FALSE );
+			}
+		}
+	closedir( dir );
+
+	return( TRUE );
+#else
+	return( addFileName( fileList, path ) );
+#endif /* __UNIX__ */
+	}
+
+/* Write the accumulated rows to the output */
+
+static void flushInventoryRows( INVENTORY_JOB *job )
+	{
+	if( job->rows.length <= 0 )
+		return;
+#ifdef USE_THREADS
+	pthread_mutex_lock( &inventoryMutex );
+#endif /* USE_THREADS */
+	fwrite( job->rows.buffer, 1, job->rows.length, job->outFile );
+#ifdef USE_THREADS
+	pthread_mutex_unlock( &inventoryMutex );
+#endif /* USE_THREADS */
+	job->rows.length = 0;
+	}
+
+/* Process files from the list until there are none left */
+
+static void *inventoryWorker( void *arg )
+	{
+	INVENTORY_JOB *job = ( INVENTORY_JOB * ) arg;
+
+	while( TRUE )
+		{
+		const char *fileName;
+		BYTE *data;
+		long dataLength;
+		int noCerts = 0, noFiltered = 0;
+
+		/* Get the next file to process */
+#ifdef USE_THREADS
+		pthread_mutex_lock( &inventoryMutex );
+#endif /* USE_THREADS */
+		fileName = ( inventoryNextFile < job->fileList->noNames ) ? \
+				   job->fileList->names[ inventoryNextFile++ ] : NULL;
+#ifdef USE_THREADS
+		pthread_mutex_unlock( &inventoryMutex );
+#endif /* USE_THREADS */
+		if( fileName == NULL )
+			break;
+
+		/* Add any certificates in the file to the inventory */
+		if( ( data = readFileData( fileName, &dataLength ) ) != NULL )
+			{
+			noCerts = addInventoryData( &job->rows, fileName, data,
+										dataLength, &noFiltered );
+			free( data );
+			}
+		job->noFiles++;
+		job->noCerts += noCerts;
+		job->noFiltered += noFiltered;
+		if( noCerts <= 0 )
+			job->noSkipped++;
+		if( job->rows.length >= INVENTORY_FLUSH_SIZE )
+			flushInventoryRows( job );
+		}
+	flushInventoryRows( job );
+
+	return( NULL );
+	}
+
+static int compareFileNames( const void *name1, const void *name2 )
+	{
+	return( strcmp( *( const char ** ) name1, *( const char ** ) name2 ) );
+	}
+
+/* Produce an inventory of the certificates in the given files and
+   directories */
+
+static int doInventory( char *paths[], const int noPaths )
+	{
+	FILE_LIST fileList;
+	INVENTORY_JOB jobs[ MAX_THREADS ];
+	int noCerts = 0, noFiles = 0, noSkipped = 0, noFiltered = 0;
+	int noJobs = 1, i;
+
+	/* Build the list of files, sorted so that the output order is stable */
+	memset( &fileList, 0, sizeof( FILE_LIST ) );
+	for( i = 0; i < noPaths; i++ )
+		{
+		if( !addInventoryPath( &fileList, paths[ i ] ) )
+			{
+			puts( "Out of memory." );
+			return( EXIT_FAILURE );
+			}
+		}
+	if( fileList.noNames > 1 )
+		qsort( fileList.names, fileList.noNames, sizeof( char * ),
+			   compareFileNames );
+
+	/* Print the header and process the files, in parallel if possible */
+	if( inventoryFormat == INVENTORY_CSV )
+		{
+		for( i = 0; i < 8; i++ )
+			printf( ( i > 0 ) ? ",%s" : "%s", inventoryFieldNames[ i ] );
+		putchar( '\n' );
+		}
+	memset( jobs, 0, sizeof( jobs ) );
+	for( i = 0; i < MAX_THREADS; i++ )
+		{
+		jobs[ i ].fileList = &fileList;
+		jobs[ i ].outFile = stdout;
+		}
+	inventoryNextFile = 0;
+#ifdef USE_THREADS
+	if( parallelThreads > 1 && fileList.noNames > 1 )
+		{
+		pthread_t threads[ MAX_THREADS ];
+
+		noJobs = min( parallelThreads, fileList.noNames );
+		for( i = 0; i < noJobs; i++ )
+			{
+			if( pthread_create( &threads[ i ], NULL, inventoryWorker,
+								&jobs[ i ] ) )
+				break;
+			}
+		noJobs = i;
+		if( noJobs <= 0 )
+			{
+			/* If we couldn't create any threads, do it ourselves */
+			inventoryWorker( &jobs[ 0 ] );
+			noJobs = 1;
+			}
+		else
+			{
+			for( i = 0; i < noJobs; i++ )
+				pthread_join( threads[ i ], NULL );
+			}
+		}
+	else
+#endif /* USE_THREADS */
+	inventoryWorker( &jobs[ 0 ] );
+
+	/* Clean up and print a summary */
+	for( i = 0; i < noJobs; i++ )
+		{
+		noCerts += jobs[ i ].noCerts;
+		noFiles += jobs[ i ].noFiles;
+		noSkipped += jobs[ i ].noSkipped;
+		noFiltered += jobs[ i ].noFiltered;
+		if( jobs[ i ].rows.buffer != NULL )
+			free( jobs[ i ].rows.buffer );
+		}
+	for( i = 0; i < fileList.noNames; i++ )
+		free( fileList.names[ i ] );
+	if( fileList.names != NULL )
+		free( fileList.names );
+	fflush( stdout );
+	if( filterExpiry || filterValidAt )
+		{
+		/* Only some of the certificates were listed, report how many */
+		fprintf( stderr, "%d of ", noCerts - noFiltered );
+		}
+	fprintf( stderr, "%d certificate%s in %d file%s%s, %d file%s skipped.\n",
+			 noCerts, ( noCerts != 1 ) ? "s" : "", noFiles,
+			 ( noFiles != 1 ) ? "s" : "",
+			 ( filterExpiry || filterValidAt ) ? " listed" : "",
+			 noSkipped, ( noSkipped != 1 ) ? "s" : "" );
+
+	return( EXIT_SUCCESS );
+	}
+
+/****************************************************************************
+*																			*
+*							File Reading Routines							*
+*																			*
+****************************************************************************/
+
+/* When we're processing a large collection of small files like a directory
+   full of certificates, most of the time goes into opening, mapping, and
+   closing each file rather than decoding it.  To avoid this we read ahead
+   of the caller, either by submitting the open, read, and close for a
+   window of files to the kernel in one go via io_uring if we're built with
+   -D USE_IO_URING, or with a pool of threads that read the files with
+   pread() if not or if io_uring isn't available at runtime.  The files are
+   returned in order, already in memory so that they can be passed straight
+   to the in-memory parser.  Anything that isn't a small uncompressed file,
+   or that couldn't be read, is handled by getFileData() when it's returned,
+   which also takes care of reporting errors in the usual manner */
+
+#define READER_WINDOW		64		/* No.files read ahead of the caller */
+#define READER_THREADS		4		/* No.threads reading files */
+#define READER_BUFFER_SIZE	65536	/* Max.size for io_uring reads */
+#define READER_MAX_SIZE		1048576L	/* Max.size for thread reads */
+
+/* The state of each file in the read-ahead window.  For io_uring we track
+   the number of outstanding completions for the open/read/close chain, for
+   the thread pool whether the reader thread is done with it */
+
+typedef struct {
+	BYTE *data;					/* File data, NULL if we couldn't read it */
+	long length;				/* File data length */
+	int pending;				/* No.operations still outstanding */
+	int openStatus;				/* io_uring: Result of the open */
+	} READER_SLOT;
+
+typedef struct {
+	/* The files to read, the next one to read, and the number that the
+	   caller has finished with */
+	char **names;
+	int noNames, nextRead, noReleased;
+
+	/* The files being read and the one that the caller currently has */
+	READER_SLOT slots[ READER_WINDOW ];
+	const BYTE *data;
+	long dataLength;
+	int hasFile, isFileData, isMapped;
+
+#ifdef USE_IO_URING
+	/* The io_uring submission and completion rings and the buffers that
+	   the files are read into */
+	int ringFd;
+	unsigned sqLocalTail;
+	void *sqRing, *cqRing;
+	size_t sqRingSize, cqRingSize, sqeSize;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	BYTE *buffers;
+#endif /* USE_IO_URING */
+#ifdef USE_THREADS
+	/* The reader threads */
+	pthread_t threads[ READER_THREADS ];
+	pthread_mutex_t mutex;
+	pthread_cond_t canRead, dataReady;
+	int noThreads, shutdown;
+#endif /* USE_THREADS */
+	} FILE_READER;
+
+#ifdef USE_IO_URING
+
+/* glibc doesn't provide wrappers for the io_uring system calls */
+
+static int ioUringSetup( const unsigned entries,
+						 struct io_uring_params *params )
+	{
+	return( ( int ) syscall( __NR_io_uring_setup, entries, params ) );
+	}
+
+static int ioUringEnter( const int ringFd, const unsigned toSubmit,
+						 const unsigned minComplete, const unsigned flags )
+	{
+	return( ( int ) syscall( __NR_io_uring_enter, ringFd, toSubmit,
+							 minComplete, flags, NULL, 0 ) );
+	}
+
+static int ioUringRegister( const int ringFd, const unsigned opcode,
+							const void *arg, const unsigned noArgs )
+	{
+	return( ( int ) syscall( __NR_io_uring_register, ringFd, opcode, arg,
+							 noArgs ) );
+	}
+
+/* Set up the ring.  We read each file into a slot in a table of registered
+   ("direct") file descriptors, which avoids having to install a real file
+   descriptor for it, and rely on the kernel looking up the file for a
+   linked request when it runs rather than when it's submitted, so that the
+   read can use the file opened by the open that's linked before it */
+
+static int initUring( FILE_READER *reader )
+	{
+	struct io_uring_params params;
+	int fileTable[ READER_WINDOW ], i;
+
+	memset( &params, 0, sizeof( struct io_uring_params ) );
+	if( ( reader->ringFd = ioUringSetup( READER_WINDOW * 4, &params ) ) < 0 )
+		return( FALSE );
+	if( !( params.features & IORING_FEAT_LINKED_FILE ) )
+		{
+		close( reader->ringFd );
+		return( FALSE );
+		}
+
+	/* Map the rings into our address space */
+	reader->sqRingSize = params.sq_off.array + \
+						 params.sq_entries * sizeof( unsigned );
+	reader->cqRingSize = params.cq_off.cqes + \
+						 params.cq_entries * sizeof( struct io_uring_cqe );
+	reader->sqeSize = params.sq_entries * sizeof( struct io_uring_sqe );
+	reader->sqRing = mmap( NULL, reader->sqRingSize, PROT_READ | PROT_WRITE,
+						   MAP_SHARED | MAP_POPULATE, reader->ringFd,
+						   IORING_OFF_SQ_RING );
+	reader->cqRing = mmap( NULL, reader->cqRingSize, PROT_READ | PROT_WRITE,
+						   MAP_SHARED | MAP_POPULATE, reader->ringFd,
+						   IORING_OFF_CQ_RING );
+	reader->sqes = mmap( NULL, reader->sqeSize, PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_POPULATE, reader->ringFd,
+						 IORING_OFF_SQES );
+	if( reader->sqRing == MAP_FAILED || reader->cqRing == MAP_FAILED || \
+		reader->sqes == MAP_FAILED )
+		{
+		if( reader->sqRing != MAP_FAILED )
+			munmap( reader->sqRing, reader->sqRingSize );
+		if( reader->cqRing != MAP_FAILED )
+			munmap( reader->cqRing, reader->cqRingSize );
+		if( reader->sqes != MAP_FAILED )
+			munmap( reader->sqes, reader->sqeSize );
+		close( reader->ringFd );
+		return( FALSE );
+		}
+	reader->sqHead = ( unsigned * ) \
+					 ( ( BYTE * ) reader->sqRing + params.sq_off.head );
+	reader->sqTail = ( unsigned * ) \
+					 ( ( BYTE * ) reader->sqRing + params.sq_off.tail );
+	reader->sqMask = ( unsigned * ) \
+					 ( ( BYTE * ) reader->sqRing + params.sq_off.ring_mask );
+	reader->sqArray = ( unsigned * ) \
+					  ( ( BYTE * ) reader->sqRing + params.sq_off.array );
+	reader->cqHead = ( unsigned * ) \
+					 ( ( BYTE * ) reader->cqRing + params.cq_off.head );
+	reader->cqTail = ( unsigned * ) \
+					 ( ( BYTE * ) reader->cqRing + params.cq_off.tail );
+	reader->cqMask = ( unsigned * ) \
+					 ( ( BYTE * ) reader->cqRing + params.cq_off.ring_mask );
+	reader->cqes = ( struct io_uring_cqe * ) \
+				   ( ( BYTE * ) reader->cqRing + params.cq_off.cqes );
+	for( i = 0; i < ( int ) params.sq_entries; i++ )
+		reader->sqArray[ i ] = i;
+	reader->sqLocalTail = *reader->sqTail;
+
+	/* Register an empty table of direct file descriptors and allocate the
+	   buffers to read the files into */
+	for( i = 0; i < READER_WINDOW; i++ )
+		fileTable[ i ] = -1;
+	if( ioUringRegister( reader->ringFd, IORING_REGISTER_FILES, fileTable,
+						 READER_WINDOW ) < 0 || \
+		( reader->buffers = ( BYTE * ) \
+				malloc( READER_WINDOW * READER_BUFFER_SIZE ) ) == NULL )
+		{
+		munmap( reader->sqRing, reader->sqRingSize );
+		munmap( reader->cqRing, reader->cqRingSize );
+		munmap( reader->sqes, reader->sqeSize );
+		close( reader->ringFd );
+		return( FALSE );
+		}
+
+	return( TRUE );
+	}
+
+/* Queue a request */
+
+static struct io_uring_sqe *queueRequest( FILE_READER *reader,
+										  const int opcode, const int slot,
+										  const int op )
+	{
+	struct io_uring_sqe *sqe = \
+			&reader->sqes[ reader->sqLocalTail++ & *reader->sqMask ];
+
+	memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+	sqe->opcode = opcode;
+	sqe->user_data = ( slot << 2 ) | op;
+
+	return( sqe );
+	}
+
+/* Queue the open, read, and close for a file as a linked chain.  The links
+   are hard links so that the close is always run, even if the read fails */
+
+static void queueFileRead( FILE_READER *reader, const int fileNo )
+	{
+	const int slot = fileNo % READER_WINDOW;
+	struct io_uring_sqe *sqe;
+
+	sqe = queueRequest( reader, IORING_OP_OPENAT, slot, 0 );
+	sqe->fd = AT_FDCWD;
+	sqe->addr = ( unsigned long ) reader->names[ fileNo ];
+	sqe->open_flags = O_RDONLY;
+	sqe->file_index = slot + 1;
+	sqe->flags = IOSQE_IO_HARDLINK;
+	sqe = queueRequest( reader, IORING_OP_READ, slot, 1 );
+	sqe->fd = slot;
+	sqe->addr = ( unsigned long ) \
+				( reader->buffers + ( slot * READER_BUFFER_SIZE ) );
+	sqe->len = READER_BUFFER_SIZE;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+	sqe = queueRequest( reader, IORING_OP_CLOSE, slot, 2 );
+	sqe->file_index = slot + 1;
+	reader->slots[ slot ].pending = 3;
+	reader->slots[ slot ].data = NULL;
+	}
+
+/* Submit any queued requests and process completions, optionally waiting
+   for at least one completion */
+
+static int processUring( FILE_READER *reader, const int wait )
+	{
+	unsigned head, tail;
+	int status = 0;
+
+	/* Submit anything that the kernel hasn't consumed yet */
+	__atomic_store_n( reader->sqTail, reader->sqLocalTail, __ATOMIC_RELEASE );
+	do
+		{
+		const unsigned toSubmit = reader->sqLocalTail - \
+					__atomic_load_n( reader->sqHead, __ATOMIC_ACQUIRE );
+
+		if( toSubmit == 0 && !wait )
+			break;
+		status = ioUringEnter( reader->ringFd, toSubmit, wait ? 1 : 0,
+							   wait ? IORING_ENTER_GETEVENTS : 0 );
+		}
+	while( status < 0 && errno == EINTR );
+	if( status < 0 )
+		return( FALSE );
+
+	/* Record the results of the completed requests */
+	head = *reader->cqHead;
+	tail = __atomic_load_n( reader->cqTail, __ATOMIC_ACQUIRE );
+	while( head != tail )
+		{
+		const struct io_uring_cqe *cqe = &reader->cqes[ head & *reader->cqMask ];
+		READER_SLOT *slotInfo = &reader->slots[ cqe->user_data >> 2 ];
+		const int op = ( int ) ( cqe->user_data & 3 );
+
+		if( op == 0 )
+			slotInfo->openStatus = cqe->res;
+		if( op == 1 && cqe->res > 0 && cqe->res < READER_BUFFER_SIZE )
+			{
+			/* If the read filled the buffer then the file may be larger
+			   than this, in which case it'll be read by getFileData() */
+			slotInfo->data = reader->buffers + \
+					( ( cqe->user_data >> 2 ) * READER_BUFFER_SIZE );
+			slotInfo->length = cqe->res;
+			}
+		slotInfo->pending--;
+		head++;
+		}
+	__atomic_store_n( reader->cqHead, head, __ATOMIC_RELEASE );
+
+	return( TRUE );
+	}
+
+/* Get the next file via io_uring */
+
+static int readUringFile( FILE_READER *reader, const int fileNo )
+	{
+	READER_SLOT *slotInfo = &reader->slots[ fileNo % READER_WINDOW ];
+
+	/* Keep the window full and wait for the file's chain to complete */
+	while( reader->nextRead < reader->noNames && \
+		   reader->nextRead < reader->noReleased + READER_WINDOW )
+		queueFileRead( reader, reader->nextRead++ );
+	if( !processUring( reader, FALSE ) )
+		return( FALSE );
+	while( slotInfo->pending > 0 )
+		{
+		if( !processUring( reader, TRUE ) )
+			return( FALSE );
+		}
+
+	return( TRUE );
+	}
+
+static void endUring( FILE_READER *reader )
+	{
+	int i;
+
+	/* Wait for any outstanding requests to complete before we free the
+	   buffers that they're reading into */
+	for( i = 0; i < READER_WINDOW; i++ )
+		{
+		while( reader->slots[ i ].pending > 0 )
+			{
+			if( !processUring( reader, TRUE ) )
+				return;
+			}
+		}
+	munmap( reader->sqRing, reader->sqRingSize );
+	munmap( reader->cqRing, reader->cqRingSize );
+	munmap( reader->sqes, reader->sqeSize );
+	close( reader->ringFd );
+	free( reader->buffers );
+	}
+#endif /* USE_IO_URING */
+
+#ifdef USE_THREADS
+
+/* Read a small file into memory */
+
+static BYTE *readSmallFile( const char *fileName, long *dataLength )
+	{
+	struct stat statInfo;
+	BYTE *data;
+	long length = 0;
+	int fd;
+
+	if( ( fd = open( fileName, O_RDONLY ) ) < 0 )
+		return( NULL );
+	if( fstat( fd, &statInfo ) < 0 || !S_ISREG( statInfo.st_mode ) || \
+		statInfo.st_size <= 0 || statInfo.st_size > READER_MAX_SIZE || \
+		( data = ( BYTE * ) malloc( statInfo.st_size ) ) == NULL )
+		{
+		close( fd );
+		return( NULL );
+		}
+	while( length < statInfo.st_size )
+		{
+		const ssize_t count = pread( fd, data + length,
+									 statInfo.st_size - length, length );
+
+		if( count <= 0 )
+			{
+			if( count < 0 && errno == EINTR )
+				continue;
+			break;
+			}
+		length += count;
+		}
+	close( fd );
+	if( length < statInfo.st_size )
+		{
+		free( data );
+		return( NULL );
+		}
+	*dataLength = length;
+
+	return( data );
+	}
+
+/* Read files ahead of the caller */
+
+static void *readerWorker( void *arg )
+	{
+	FILE_READER *reader = ( FILE_READER * ) arg;
+
+	while( TRUE )
+		{
+		BYTE *data;
+		long length = 0;
+		int fileNo;
+
+		/* Wait for a free slot in the window and get the next file */
+		pthread_mutex_lock( &reader->mutex );
+		while( !reader->shutdown && reader->nextRead < reader->noNames && \
+			   reader->nextRead >= reader->noReleased + READER_WINDOW )
+			pthread_cond_wait( &reader->canRead, &reader->mutex );
+		if( reader->shutdown || reader->nextRead >= reader->noNames )
+			{
+			pthread_mutex_unlock( &reader->mutex );
+			break;
+			}
+		fileNo = reader->nextRead++;
+		pthread_mutex_unlock( &reader->mutex );
+
+		/* Read the file, leaving anything compressed for getFileData() */
+		data = readSmallFile( reader->names[ fileNo ], &length );
+		if( data != NULL && \
+			getMemCompressionType( data, length ) != COMPRESSION_NONE )
+			{
+			free( data );
+			data = NULL;
+			}
+
+		/* Hand it over to the caller */
+		pthread_mutex_lock( &reader->mutex );
+		reader->slots[ fileNo % READER_WINDOW ].data = data;
+		reader->slots[ fileNo % READER_WINDOW ].length = length;
+		reader->slots[ fileNo % READER_WINDOW ].pending = 0;
+		pthread_cond_broadcast( &reader->dataReady );
+		pthread_mutex_unlock( &reader->mutex );
+		}
+
+	return( NULL );
+	}
+#endif /* USE_THREADS */
+
+/* Start reading a list of files */
+
+static void openFileReader( FILE_READER *reader, char *names[],
+							const int noNames )
+	{
+#ifdef USE_THREADS
+	int i;
+#endif /* USE_THREADS */
+
+	memset( reader, 0, sizeof( FILE_READER ) );
+	reader->names = names;
+	reader->noNames = noNames;
+#ifdef USE_IO_URING
+	if( noNames > 1 && initUring( reader ) )
+		return;
+	reader->ringFd = -1;
+#endif /* USE_IO_URING */
+#ifdef USE_THREADS
+	if( noNames > 1 )
+		{
+		pthread_mutex_init( &reader->mutex, NULL );
+		pthread_cond_init( &reader->canRead, NULL );
+		pthread_cond_init( &reader->dataReady, NULL );
+		for( i = 0; i < READER_WINDOW; i++ )
+			reader->slots[ i ].pending = 1;
+		for( i = 0; i < READER_THREADS && i < noNames; i++ )
+			{
+			if( pthread_create( &reader->threads[ i ], NULL, readerWorker,
+								reader ) )
+				break;
+			}
+		reader->noThreads = i;
+		}
+#endif /* USE_THREADS */
+	}
+
+/* Let the reader reuse the slot for the file that the caller has finished
+   with */
+
+static void releaseFile( FILE_READER *reader )
+	{
+	if( !reader->hasFile )
+		return;
+	if( reader->isFileData )
+		freeFileData( reader->data, reader->dataLength, reader->isMapped );
+	reader->hasFile = FALSE;
+#ifdef USE_THREADS
+	if( reader->noThreads > 0 )
+		{
+		/* The data was read by one of the reader threads, free it and let
+		   them know that there's a free slot */
+		if( !reader->isFileData )
+			free( ( void * ) reader->data );
+		pthread_mutex_lock( &reader->mutex );
+		reader->noReleased++;
+		pthread_cond_broadcast( &reader->canRead );
+		pthread_mutex_unlock( &reader->mutex );
+		return;
+		}
+#endif /* USE_THREADS */
+	reader->noReleased++;
+	}
+
+/* Get the next file in the list, returning NULL with errno set if it
+   can't be read.  The data remains valid until the next call or until the
+   reader is closed */
+
+static const BYTE *readNextFile( FILE_READER *reader, long *dataLength )
+	{
+	const int fileNo = reader->noReleased + ( reader->hasFile ? 1 : 0 );
+	READER_SLOT *slotInfo = &reader->slots[ fileNo % READER_WINDOW ];
+	int haveSlot = FALSE;
+
+	releaseFile( reader );
+	if( fileNo >= reader->noNames )
+		return( NULL );
+
+	/* Get the data that was read ahead for the file if there is any */
+#ifdef USE_IO_URING
+	if( reader->ringFd >= 0 )
+		{
+		haveSlot = readUringFile( reader, fileNo );
+		if( haveSlot && slotInfo->data != NULL && \
+			getMemCompressionType( slotInfo->data,
+								   slotInfo->length ) != COMPRESSION_NONE )
+			slotInfo->data = NULL;
+		}
+#endif /* USE_IO_URING */
+#ifdef USE_THREADS
+	if( reader->noThreads > 0 )
+		{
+		pthread_mutex_lock( &reader->mutex );
+		while( slotInfo->pending > 0 )
+			pthread_cond_wait( &reader->dataReady, &reader->mutex );
+		slotInfo->pending = 1;
+		pthread_mutex_unlock( &reader->mutex );
+		haveSlot = TRUE;
+		}
+#endif /* USE_THREADS */
+	reader->hasFile = TRUE;
+	if( haveSlot && slotInfo->data != NULL )
+		{
+		reader->data = slotInfo->data;
+		reader->dataLength = slotInfo->length;
+		reader->isFileData = FALSE;
+		}
+	else
+		{
+		/* It's not a small uncompressed file or we couldn't read it, have
+		   getFileData() deal with it */
+		reader->data = getFileData( reader->names[ fileNo ],
+									&reader->dataLength, &reader->isMapped );
+		reader->isFileData = TRUE;
+		if( reader->data == NULL )
+			{
+			reader->isFileData = FALSE;
+			return( NULL );
+			}
+		}
+	*dataLength = reader->dataLength;
+
+	return( reader->data );
+	}
+
+/* Report a file that readNextFile() couldn't read.  Devices and other
+   special files and empty files are rejected without errno being set, so
+   we check for these explicitly rather than reporting a leftover error */
+
+static void reportReadError( const char *fileName )
+	{
+#ifdef __UNIX__
+	struct stat statInfo;
+
+	if( stat( fileName, &statInfo ) == 0 )
+		{
+		if( !S_ISREG( statInfo.st_mode ) )
+			{
+			fprintf( stderr, "%s: Not a regular file.\n", fileName );
+			return;
+			}
+		if( statInfo.st_size <= 0 )
+			{
+			fprintf( stderr, "%s: File contains no data.\n", fileName );
+			return;
+			}
+		}
+#endif /* __UNIX__ */
+	perror( fileName );
+	}
+
+/* Finish reading the list of files */
+
+static void closeFileReader( FILE_READER *reader )
+	{
+#ifdef USE_THREADS
+	int i;
+#endif /* USE_THREADS */
+
+	releaseFile( reader );
+#ifdef USE_IO_URING
+	if( reader->ringFd >= 0 )
+		endUring( reader );
+#endif /* USE_IO_URING */
+#ifdef USE_THREADS
+	if( reader->noThreads > 0 )
+		{
+		pthread_mutex_lock( &reader->mutex );
+		reader->shutdown = TRUE;
+		pthread_cond_broadcast( &reader->canRead );
+		pthread_mutex_unlock( &reader->mutex );
+		for( i = 0; i < reader->noThreads; i++ )
+			pthread_join( reader->threads[ i ], NULL );
+
+		/* Free anything that was read ahead but never returned */
+		for( i = 0; i < READER_WINDOW; i++ )
+			{
+			if( reader->slots[ i ].pending == 0 && \
+				reader->slots[ i ].data != NULL )
+				free( reader->slots[ i ].data );
+			}
+		pthread_mutex_destroy( &reader->mutex );
+		pthread_cond_destroy( &reader->canRead );
+		pthread_cond_destroy( &reader->dataReady );
+		}
+#endif /* USE_THREADS */
+	}
+
+/****************************************************************************
+*																			*
+*							Structural Diff Routines						*
+*																			*
+****************************************************************************/
+
+/* Comparing the text dumps of two objects, for example a certificate and a
+   re-issued version of it, is noisy since a change in the length of one
+   item shifts the offsets of everything that follows it.  Instead, we walk
+   the two encoded objects in parallel, skipping subtrees whose encodings
+   are identical after a length check and memcmp() and descending into
+   constructed items (and encapsulated ones, if enabled) that differ, so
+   that only the innermost items that differ are reported, dumped as they
+   would be for each file.  Items are matched up by their position within
+   the enclosing item, so an inserted or deleted item is reported as a
+   difference in each of the following items at that level.  Since all
+   accesses are to the mapped input data, memory use is independent of the
+   size of the objects */
+
+typedef struct {
+	const char *fileName1, *fileName2;	/* Names of files being compared */
+	const BYTE *data1, *data2;	/* Start of data in each file */
+	int path[ MAX_NESTING_LEVEL + 2 ];	/* Path to current item */
+	int pathID[ MAX_NESTING_LEVEL + 2 ], pathTag[ MAX_NESTING_LEVEL + 2 ];
+	long noDiffs;				/* Number of differences found */
+	long bytesSkipped;			/* Amount of identical data skipped */
+	} DIFF_STATE;
+
+/* Get the total size of the object at the given position, including the
+   contents of indefinite-length items, returning -1 if it can't be
+   decoded */
+
+static long getMemObjectSize( const BYTE *data, const long dataLength,
+							  ASN1_ITEM *item, const int level )
+	{
+	ASN1_ITEM nestedItem;
+	long position;
+
+	if( level > MAX_NESTING_LEVEL || \
+		getMemItem( data, dataLength, item ) <= 0 || item->length < 0 )
+		return( -1 );
+	if( !item->indefinite )
+		{
+		if( item->length > dataLength - item->headerSize )
+			return( -1 );
+		return( item->headerSize + item->length );
+		}
+	if( ( item->id & FORM_MASK ) != CONSTRUCTED )
+		return( -1 );
+
+	/* It's an indefinite-length item, find the EOC that ends it */
+	for( position = item->headerSize; position < dataLength - 1; )
+		{
+		long size;
+
+		if( data[ position ] == EOC && data[ position + 1 ] == 0 )
+			return( position + 2 );
+		size = getMemObjectSize( data + position, dataLength - position,
+								 &nestedItem, level + 1 );
+		if( size <= 0 )
+			return( -1 );
+		position += size;
+		}
+
+	return( -1 );
+	}
+
+/* Check whether a BIT STRING or OCTET STRING encapsulates a single
+   constructed object, returning the encapsulated data if it does */
+
+static const BYTE *getMemEncapsulated( const BYTE *content, long *length,
+									   const ASN1_ITEM *item, const int level )
+	{
+	ASN1_ITEM nestedItem;
+
+	if( !checkEncaps || item->id != UNIVERSAL || item->indefinite || \
+		( item->tag != OCTETSTRING && item->tag != BITSTRING ) )
+		return( NULL );
+	if( item->tag == BITSTRING )
+		{
+		/* There must be no unused bits */
+		if( *length < 1 || content[ 0 ] != 0 )
+			return( NULL );
+		content++;
+		( *length )--;
+		}
+	if( *length < 2 || ( content[ 0 ] & FORM_MASK ) != CONSTRUCTED || \
+		getMemObjectSize( content, *length, &nestedItem,
+						  level + 1 ) != *length )
+		return( NULL );
+
+	return( content );
+	}
+
+/* Get a name for an item's tag */
+
+static const char *getItemName( char *buffer, const ASN1_ITEM *item )
+	{
+	switch( item->id & CLASS_MASK )
+		{
+		case UNIVERSAL:
+			return( idstr( item->tag ) );
+
+		case APPLICATION:
+			sprintf( buffer, "[APPLICATION %d]", item->tag );
+			break;
+
+		case PRIVATE:
+			sprintf( buffer, "[PRIVATE %d]", item->tag );
+			break;
+
+		default:
+			sprintf( buffer, "[%d]", item->tag );
+		}
+
+	return( buffer );
+	}
+
+/* Print the path to the item that differs */
+
+static void printDiffPath( const DIFF_STATE *state, const int level )
+	{
+	char buffer[ 32 ];
+	int i;
+
+	for( i = 0; i <= level; i++ )
+		fprintf( output, "%s%d", ( i > 0 ) ? "." : "", state->path[ i ] );
+	fputs( " (", output );
+	for( i = 0; i <= level; i++ )
+		{
+		ASN1_ITEM item;
+
+		memset( &item, 0, sizeof( ASN1_ITEM ) );
+		item.id = state->pathID[ i ];
+		item.tag = state->pathTag[ i ];
+		fprintf( output, "%s%s", ( i > 0 ) ? " > " : "",
+				 getItemName( buffer, &item ) );
+		}
+	fputs( ")", output );
+	}
+
+/* Dump the version of an item in one of the files */
+
+static void printDiffItem( const char marker, const char *fileName,
+						   const BYTE *fileData, const BYTE *data,
+						   const long length, const int level )
+	{
+	const int savedErrors = noErrors, savedWarnings = noWarnings;
+	FILE *inFile;
+#ifdef USE_THREADS
+	jmp_buf abortEnv;
+#endif /* USE_THREADS */
+
+	fprintf( output, "%c %s:\n", marker, fileName );
+	if( ( inFile = openMemStream( data, length ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return;
+		}
+
+	/* Dump the item as it would appear in the dump of the whole file.  If
+	   there's a fatal error in the data, we stop the dump and continue
+	   with the next difference */
+	fPos = ( int ) ( data - fileData );
+#ifdef USE_THREADS
+	workerAbort = &abortEnv;
+	if( !setjmp( abortEnv ) )
+#endif /* USE_THREADS */
+	printAsn1( inFile, level, length, FALSE );
+#ifdef USE_THREADS
+	workerAbort = NULL;
+#endif /* USE_THREADS */
+	fclose( inFile );
+	noErrors = savedErrors;
+	noWarnings = savedWarnings;
+	}
+
+/* Report a difference between two items, either of which may be absent */
+
+static void reportDiff( DIFF_STATE *state, const BYTE *data1,
+						const long length1, const BYTE *data2,
+						const long length2, const int level )
+	{
+	if( state->noDiffs++ > 0 )
+		fputc( '\n', output );
+	if( data1 == NULL || data2 == NULL )
+		{
+		fputs( "Item ", output );
+		printDiffPath( state, level );
+		fprintf( output, " only in %s:\n",
+				 ( data1 != NULL ) ? state->fileName1 : state->fileName2 );
+		}
+	else
+		{
+		fputs( "Difference in ", output );
+		printDiffPath( state, level );
+		fputs( ":\n", output );
+		}
+	if( data1 != NULL )
+		printDiffItem( '<', state->fileName1, state->data1, data1, length1,
+					   level );
+	if( data2 != NULL )
+		printDiffItem( '>', state->fileName2, state->data2, data2, length2,
+					   level );
+	}
+
+/* Compare the items in two blocks of data */
+
+static void diffItems( DIFF_STATE *state, const BYTE *data1, long length1,
+					   const BYTE *data2, long length2, const int level )
+	{
+	int index;
+
+	for( index = 0; length1 > 0 || length2 > 0; index++ )
+		{
+		ASN1_ITEM item1, item2;
+		const BYTE *content1, *content2;
+		long size1 = 0, size2 = 0, contentLength1, contentLength2;
+
+		/* Get the next item from each side.  If either can't be decoded, we
+		   compare the remaining data as a whole */
+		memset( &item1, 0, sizeof( ASN1_ITEM ) );
+		memset( &item2, 0, sizeof( ASN1_ITEM ) );
+		if( length1 > 0 )
+			size1 = getMemObjectSize( data1, length1, &item1, level );
+		if( length2 > 0 )
+			size2 = getMemObjectSize( data2, length2, &item2, level );
+		state->path[ level ] = index;
+		if( size1 < 0 || size2 < 0 )
+			{
+			if( length1 == length2 && !memcmp( data1, data2, length1 ) )
+				{
+				state->bytesSkipped += length1;
+				return;
+				}
+			if( state->noDiffs++ > 0 )
+				fputc( '\n', output );
+			fprintf( output, "Undecodable data at offset %ld in %s and "
+					 "%ld in %s differs.\n",
+					 ( long ) ( data1 - state->data1 ), state->fileName1,
+					 ( long ) ( data2 - state->data2 ), state->fileName2 );
+			return;
+			}
+		state->pathID[ level ] = ( size1 > 0 ) ? item1.id : item2.id;
+		state->pathTag[ level ] = ( size1 > 0 ) ? item1.tag : item2.tag;
+
+		/* If the item is only present on one side, report it */
+		if( size1 <= 0 || size2 <= 0 )
+			{
+			reportDiff( state, ( size1 > 0 ) ? data1 : NULL, size1,
+						( size2 > 0 ) ? data2 : NULL, size2, level );
+			data1 += size1;
+			length1 -= size1;
+			data2 += size2;
+			length2 -= size2;
+			continue;
+			}
+
+		/* If the items are identical, skip them */
+		if( size1 == size2 && !memcmp( data1, data2, size1 ) )
+			{
+			state->bytesSkipped += size1;
+			data1 += size1;
+			length1 -= size1;
+			data2 += size2;
+			length2 -= size2;
+			continue;
+			}
+
+		/* If they're the same type of constructed or encapsulating item,
+		   find where they differ, otherwise report the whole item */
+		content1 = data1 + item1.headerSize;
+		content2 = data2 + item2.headerSize;
+		contentLength1 = size1 - item1.headerSize - \
+						 ( item1.indefinite ? 2 : 0 );
+		contentLength2 = size2 - item2.headerSize - \
+						 ( item2.indefinite ? 2 : 0 );
+		if( item1.id != item2.id || item1.tag != item2.tag || \
+			level >= MAX_NESTING_LEVEL )
+			reportDiff( state, data1, size1, data2, size2, level );
+		else
+			{
+			if( ( item1.id & FORM_MASK ) == CONSTRUCTED )
+				diffItems( state, content1, contentLength1, content2,
+						   contentLength2, level + 1 );
+			else
+				{
+				content1 = getMemEncapsulated( content1, &contentLength1,
+											   &item1, level );
+				content2 = getMemEncapsulated( content2, &contentLength2,
+											   &item2, level );
+				if( content1 != NULL && content2 != NULL )
+					diffItems( state, content1, contentLength1, content2,
+							   contentLength2, level + 1 );
+				else
+					reportDiff( state, data1, size1, data2, size2, level );
+				}
+			}
+		data1 += size1;
+		length1 -= size1;
+		data2 += size2;
+		length2 -= size2;
+		}
+	}
+
+/* Compare two files */
+
+static int doDiff( const char *fileName1, const char *fileName2 )
+	{
+	DIFF_STATE state;
+	const BYTE *data[ 2 ];
+	const char *fileNames[ 2 ];
+	long dataLength[ 2 ];
+	int isMapped[ 2 ], i;
+
+	/* Map the files into memory, or read them if they can't be mapped */
+	fileNames[ 0 ] = fileName1;
+	fileNames[ 1 ] = fileName2;
+	for( i = 0; i < 2; i++ )
+		{
+		if( ( data[ i ] = getFileData( fileNames[ i ], &dataLength[ i ],
+									   &isMapped[ i ] ) ) == NULL )
+			{
+			perror( fileNames[ i ] );
+			if( i > 0 )
+				freeFileData( data[ 0 ], dataLength[ 0 ], isMapped[ 0 ] );
+			return( EXIT_FAILURE );
+			}
+		}
+
+	/* Compare the data */
+	memset( &state, 0, sizeof( DIFF_STATE ) );
+	state.fileName1 = fileName1;
+	state.fileName2 = fileName2;
+	state.data1 = data[ 0 ];
+	state.data2 = data[ 1 ];
+	diffItems( &state, data[ 0 ], dataLength[ 0 ], data[ 1 ], dataLength[ 1 ],
+			   0 );
+	for( i = 0; i < 2; i++ )
+		freeFileData( data[ i ], dataLength[ i ], isMapped[ i ] );
+	if( state.noDiffs > 0 )
+		fputc( '\n', output );
+	fflush( output );
+	if( state.noDiffs <= 0 )
+		fprintf( stderr, "No differences, %ld bytes compared.\n",
+				 state.bytesSkipped );
+	else
+		fprintf( stderr, "%ld difference%s, %ld identical bytes skipped.\n",
+				 state.noDiffs, ( state.noDiffs != 1 ) ? "s" : "",
+				 state.bytesSkipped );
+
+	return( ( state.noDiffs > 0 ) ? EXIT_FAILURE : EXIT_SUCCESS );
+	}
+
+/****************************************************************************
+*																			*
+*							Object Extraction Routines						*
+*																			*
+****************************************************************************/
+
+/* Extracting many sub-objects from one file, for example all of the
+   certificates in a PKCS #7 certificate bag, would require one run with
+   -<number> -f<file> per object.  Instead, we read a manifest with one
+   line per object of the form:
+
+	<offset or path> <output file> [<SHA-256 of object in hex>]
+
+   where the offset is as for -<number> (or in hex with a leading '0x')
+   and the path is the dotted item path as displayed by --diff, so that
+   for a certificate '0.0.6' is the subjectPublicKeyInfo.  Paths descend
+   into encapsulated data if that's enabled.  Once all objects have been
+   located, they're sorted by position and written in a single forward
+   pass over the mapped input data, with each one written directly from
+   the mapped data in a single unbuffered write.  If a hash is given, the
+   object is only written if its hash matches */
+
+typedef struct {
+	long offset;				/* Position of object in data */
+	char *fileName;				/* File to write object to */
+	BYTE hash[ SHA256_DIGEST_SIZE ];	/* Expected hash of object */
+	int hasHash;				/* Whether hash is present */
+	int lineNo;					/* Manifest line for object */
+	} EXTRACT_ENTRY;
+
+static int compareExtractEntries( const void *entry1Ptr,
+								  const void *entry2Ptr )
+	{
+	const EXTRACT_ENTRY *entry1 = ( const EXTRACT_ENTRY * ) entry1Ptr;
+	const EXTRACT_ENTRY *entry2 = ( const EXTRACT_ENTRY * ) entry2Ptr;
+
+	if( entry1->offset != entry2->offset )
+		return( ( entry1->offset < entry2->offset ) ? -1 : 1 );
+	return( entry1->lineNo - entry2->lineNo );
+	}
+
+/* Find the position of the item at the given path, returning -1 if there's
+   no such item */
+
+static long findPathItem( const BYTE *data, long dataLength,
+						  const char *path )
+	{
+	const BYTE *dataStart = data;
+	int level;
+
+	for( level = 0; level <= MAX_NESTING_LEVEL; level++ )
+		{
+		ASN1_ITEM item;
+		const BYTE *content;
+		long size, contentLength;
+		int index;
+
+		/* Get the index of the item at this level and skip the preceding
+		   items */
+		if( !isdigit( byteToInt( *path ) ) )
+			return( -1 );
+		for( index = atoi( path ); TRUE; index-- )
+			{
+			size = getMemObjectSize( data, dataLength, &item, level );
+			if( size <= 0 )
+				return( -1 );
+			if( index <= 0 )
+				break;
+			data += size;
+			dataLength -= size;
+			}
+		while( isdigit( byteToInt( *path ) ) )
+			path++;
+		if( !*path )
+			return( data - dataStart );
+		if( *path++ != '.' )
+			return( -1 );
+
+		/* Move down into the constructed or encapsulated item */
+		content = data + item.headerSize;
+		contentLength = size - item.headerSize - ( item.indefinite ? 2 : 0 );
+		if( ( item.id & FORM_MASK ) != CONSTRUCTED )
+			{
+			content = getMemEncapsulated( content, &contentLength, &item,
+										  level );
+			if( content == NULL )
+				return( -1 );
+			}
+		data = content;
+		dataLength = contentLength;
+		}
+
+	return( -1 );
+	}
+
+/* Parse a manifest line into an extraction entry */
+
+static int parseExtractEntry( EXTRACT_ENTRY *entry, char *line,
+							  const BYTE *data, const long dataLength )
+	{
+	char *position, *fileName, *hash;
+	int i;
+
+	position = strtok( line, " \t" );
+	fileName = strtok( NULL, " \t" );
+	hash = strtok( NULL, " \t" );
+	if( position == NULL || fileName == NULL || strtok( NULL, " \t" ) )
+		{
+		printf( "Invalid entry in manifest line %d.\n", lineNo );
+		return( FALSE );
+		}
+
+	/* Get the position of the object, either directly as an offset or by
+	   locating the item at the given path */
+	if( strchr( position, '.' ) != NULL )
+		entry->offset = findPathItem( data, dataLength, position );
+	else
+		{
+		if( position[ 0 ] == '0' && toupper( position[ 1 ] ) == 'X' )
+			{
+			if( sscanf( position + 2, "%lx", &entry->offset ) != 1 )
+				entry->offset = -1;
+			}
+		else
+			entry->offset = isdigit( byteToInt( *position ) ) ? \
+							atol( position ) : -1;
+		if( entry->offset >= dataLength )
+			entry->offset = -1;
+		}
+	if( entry->offset < 0 )
+		{
+		printf( "No object at '%s' in manifest line %d.\n", position,
+				lineNo );
+		return( FALSE );
+		}
+
+	/* Get the hash if there's one present */
+	if( hash != NULL )
+		{
+		if( strlen( hash ) != SHA256_DIGEST_SIZE * 2 )
+			{
+			printf( "Invalid SHA-256 hash in manifest line %d.\n", lineNo );
+			return( FALSE );
+			}
+		for( i = 0; i < SHA256_DIGEST_SIZE; i++ )
+			{
+			int value;
+
+			if( !isxdigit( byteToInt( hash[ i * 2 ] ) ) || \
+				!isxdigit( byteToInt( hash[ i * 2 + 1 ] ) ) || \
+				sscanf( hash + i * 2, "%2x", &value ) != 1 )
+				{
+				printf( "Invalid SHA-256 hash in manifest line %d.\n",
+						lineNo );
+				return( FALSE );
+				}
+			entry->hash[ i ] = value;
+			}
+		entry->hasHash = TRUE;
+		}
+	if( ( entry->fileName = strdup( fileName ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return( FALSE );
+		}
+	entry->lineNo = lineNo;
+
+	return( TRUE );
+	}
+
+/* Write an object to its output file */
+
+static int extractObject( const EXTRACT_ENTRY *entry, const BYTE *data,
+						  const long dataLength )
+	{
+	ASN1_ITEM item;
+	FILE *outFile;
+	long size;
+
+	size = getMemObjectSize( data + entry->offset,
+							 dataLength - entry->offset, &item, 0 );
+	if( size <= 0 )
+		{
+		printf( "Non-ASN.1 data at offset %ld in manifest line %d.\n",
+				entry->offset, entry->lineNo );
+		return( FALSE );
+		}
+	if( entry->hasHash )
+		{
+		BYTE hash[ SHA256_DIGEST_SIZE ];
+
+		sha256( data + entry->offset, size, hash );
+		if( memcmp( hash, entry->hash, SHA256_DIGEST_SIZE ) )
+			{
+			printf( "SHA-256 of object at offset %ld in manifest line %d "
+					"doesn't match, not\nwriting it to '%s'.\n",
+					entry->offset, entry->lineNo, entry->fileName );
+			return( FALSE );
+			}
+		}
+	if( ( outFile = fopen( entry->fileName, "wb" ) ) == NULL )
+		{
+		perror( entry->fileName );
+		return( FALSE );
+		}
+	setvbuf( outFile, NULL, _IONBF, 0 );
+	if( fwrite( data + entry->offset, 1, size, outFile ) != ( size_t ) size )
+		{
+		perror( entry->fileName );
+		fclose( outFile );
+		return( FALSE );
+		}
+	if( fclose( outFile ) )
+		{
+		perror( entry->fileName );
+		return( FALSE );
+		}
+	printf( "Wrote %ld bytes at offset %ld to '%s'.\n", size,
+			entry->offset, entry->fileName );
+
+	return( TRUE );
+	}
+
+/* Extract the objects listed in a manifest from a file */
+
+static int doExtract( const char *manifestName, const char *fileName )
+	{
+	EXTRACT_ENTRY *entries = NULL;
+	COMPRESSION_TYPE type;
+	FILE *manifestFile;
+	const BYTE *data;
+	char buffer[ MAX_LINESIZE + 8 ];
+	long dataLength;
+	int noEntries = 0, maxEntries = 0, noExtracted = 0, noInvalid = 0;
+	int isMapped, status = TRUE, i;
+
+	if( ( data = getFileData( fileName, &dataLength, &isMapped ) ) == NULL )
+		{
+		perror( fileName );
+		return( EXIT_FAILURE );
+		}
+	type = getMemCompressionType( data, dataLength );
+	if( type != COMPRESSION_NONE )
+		{
+		complainCompressed( fileName, type );
+		freeFileData( data, dataLength, isMapped );
+		return( EXIT_FAILURE );
+		}
+	if( ( manifestFile = fopen( manifestName, "rb" ) ) == NULL )
+		{
+		perror( manifestName );
+		freeFileData( data, dataLength, isMapped );
+		return( EXIT_FAILURE );
+		}
+
+	/* Read the manifest and locate each object in it */
+	for( lineNo = 1; !feof( manifestFile ); lineNo++ )
+		{
+		if( !readLine( manifestFile, buffer ) )
+			{
+			status = FALSE;
+			break;
+			}
+		if( !*buffer )
+			continue;
+		if( noEntries >= maxEntries )
+			{
+			EXTRACT_ENTRY *newEntries;
+
+			maxEntries = ( maxEntries > 0 ) ? maxEntries * 2 : 32;
+			newEntries = realloc( entries,
+								  maxEntries * sizeof( EXTRACT_ENTRY ) );
+			if( newEntries == NULL )
+				{
+				puts( "Out of memory." );
+				status = FALSE;
+				break;
+				}
+			entries = newEntries;
+			}
+		memset( &entries[ noEntries ], 0, sizeof( EXTRACT_ENTRY ) );
+		if( !parseExtractEntry( &entries[ noEntries ], buffer, data,
+								dataLength ) )
+			{
+			noInvalid++;
+			status = FALSE;
+			continue;
+			}
+		noEntries++;
+		}
+	fclose( manifestFile );
+
+	/* Write the objects in the order in which they occur in the data */
+	if( status )
+		{
+		qsort( entries, noEntries, sizeof( EXTRACT_ENTRY ),
+			   compareExtractEntries );
+		for( i = 0; i < noEntries; i++ )
+			{
+			if( extractObject( &entries[ i ], data, dataLength ) )
+				noExtracted++;
+			}
+		}
+	for( i = 0; i < noEntries; i++ )
+		free( entries[ i ].fileName );
+	free( entries );
+	freeFileData( data, dataLength, isMapped );
+	fflush( stdout );
+	fprintf( stderr, "%d of %d object%s extracted", noExtracted,
+			 noEntries + noInvalid, ( noEntries + noInvalid != 1 ) ? "s" : "" );
+	if( noInvalid > 0 )
+		{
+		fprintf( stderr, ", %d manifest entr%s invalid", noInvalid,
+				 ( noInvalid != 1 ) ? "ies" : "y" );
+		}
+	fputs( ".\n", stderr );
+
+	return( ( status && noExtracted == noEntries ) ? \
+			EXIT_SUCCESS : EXIT_FAILURE );
+	}
+
+/****************************************************************************
+*																			*
+*							DER Checking Routines							*
+*																			*
+****************************************************************************/
+
+/* The normal dump checks many of the DER encoding rules as it goes, but
+   since it reads the data as a stream it can't check the ones that involve
+   comparing one item with another, and it also accepts BER constructs like
+   indefinite lengths.  --check-der checks each file against the DER rules
+   without dumping it, working directly on the mapped data so that nothing
+   is copied.  In addition to the checks made for the dump, it rejects
+   indefinite lengths, non-minimal tags, constructed encodings of string
+   types, and time values that aren't in the DER form.  The elements of a
+   SET are checked to be in the canonical order, which for a SET OF (all
+   elements having the same tag) means comparing each element's encoding
+   with that of the element before it, and for other SETs means comparing
+   their tags.  Explicitly-encoded BOOLEAN FALSE values in a SEQUENCE are
+   reported as warnings since in all common schemas these are DEFAULT FALSE
+   values, which DER requires to be omitted */
+
+typedef struct {
+	const char *fileName;		/* File being checked */
+	const BYTE *data;			/* Start of data in file */
+	long noErrors, noWarnings;	/* Number of problems found */
+	} DER_CHECK;
+
+/* Report a problem with an item */
+
+static void derComplain( DER_CHECK *state, const BYTE *position,
+						 const int isError, const char *format, ... )
+	{
+	va_list argPtr;
+
+	fprintf( output, "%s: Offset %ld: %s: ", state->fileName,
+			 ( long ) ( position - state->data ),
+			 isError ? "Error" : "Warning" );
+	va_start( argPtr, format );
+	vfprintf( output, format, argPtr );
+	va_end( argPtr );
+	fputs( ".\n", output );
+	if( isError )
+		state->noErrors++;
+	else
+		state->noWarnings++;
+	}
+
+/* Compare the tags of two items in the canonical order for a SET, which is
+   universal, application, context-specific, private, then by tag value */
+
+static int compareTags( const ASN1_ITEM *item1, const ASN1_ITEM *item2 )
+	{
+	const int class1 = item1->id & CLASS_MASK, class2 = item2->id & CLASS_MASK;
+
+	if( class1 != class2 )
+		return( ( class1 < class2 ) ? -1 : 1 );
+	if( item1->tag != item2->tag )
+		return( ( item1->tag < item2->tag ) ? -1 : 1 );
+	return( 0 );
+	}
+
+/* Compare two encodings in the canonical order for a SET OF, where the
+   shorter one is treated as if it were padded with trailing zeroes */
+
+static int compareEncodings( const BYTE *data1, const long length1,
+							 const BYTE *data2, const long length2 )
+	{
+	const BYTE *tail;
+	long tailLength;
+	const int result = memcmp( data1, data2, min( length1, length2 ) );
+
+	if( result != 0 || length1 == length2 )
+		return( result );
+	if( length1 > length2 )
+		{
+		tail = data1 + length2;
+		tailLength = length1 - length2;
+		}
+	else
+		{
+		tail = data2 + length1;
+		tailLength = length2 - length1;
+		}
+	while( tailLength > 0 && *tail == 0 )
+		{
+		tail++;
+		tailLength--;
+		}
+	if( tailLength <= 0 )
+		return( 0 );
+	return( ( length1 > length2 ) ? 1 : -1 );
+	}
+
+/* Check that a time value is in the DER form, with seconds, no trailing
+   zeroes in fractional seconds, and a 'Z' suffix */
+
+static int checkDERtime( const BYTE *data, const ASN1_ITEM *item )
+	{
+	const long length = item->length;
+	long i;
+
+	if( item->tag == UTCTIME )
+		return( length == 13 && data[ 12 ] == 'Z' );
+	if( length < 15 || data[ length - 1 ] != 'Z' )
+		return( FALSE );
+	for( i = 0; i < 14; i++ )
+		{
+		if( !isdigit( byteToInt( data[ i ] ) ) )
+			return( FALSE );
+		}
+	if( length == 15 )
+		return( TRUE );
+	if( data[ 14 ] != '.' || length < 17 || data[ length - 2 ] == '0' )
+		return( FALSE );
+	for( i = 15; i < length - 1; i++ )
+		{
+		if( !isdigit( byteToInt( data[ i ] ) ) )
+			return( FALSE );
+		}
+	return( TRUE );
+	}
+
+/* Check the contents of a primitive item */
+
+static void checkDERprimitive( DER_CHECK *state, const BYTE *position,
+							   const BYTE *content, const ASN1_ITEM *item,
+							   const int parentTag )
+	{
+	const long length = item->length;
+	long i;
+
+	switch( item->tag )
+		{
+		case BOOLEAN:
+			if( length != 1 )
+				{
+				derComplain( state, position, TRUE,
+							 "BOOLEAN has invalid length %ld", length );
+				break;
+				}
+			if( content[ 0 ] != 0 && content[ 0 ] != 0xFF )
+				{
+				derComplain( state, position, TRUE,
+							 "BOOLEAN '%02X' has non-DER encoding",
+							 content[ 0 ] );
+				break;
+				}
+			if( content[ 0 ] == 0 && parentTag == SEQUENCE )
+				{
+				derComplain( state, position, FALSE,
+							 "BOOLEAN FALSE is probably an encoded DEFAULT "
+							 "value" );
+				}
+			break;
+
+		case INTEGER:
+		case ENUMERATED:
+			if( length < 1 )
+				{
+				derComplain( state, position, TRUE,
+							 "%s has invalid length 0", idstr( item->tag ) );
+				break;
+				}
+			if( length > 1 && \
+				( ( content[ 0 ] == 0x00 && !( content[ 1 ] & 0x80 ) ) || \
+				  ( content[ 0 ] == 0xFF && ( content[ 1 ] & 0x80 ) ) ) )
+				{
+				derComplain( state, position, TRUE,
+							 "%s '%02X %02X ...' has non-DER encoding",
+							 idstr( item->tag ), content[ 0 ], content[ 1 ] );
+				}
+			break;
+
+		case BITSTRING:
+			if( length < 1 || content[ 0 ] > 7 )
+				{
+				derComplain( state, position, TRUE,
+							 "BIT STRING has invalid unused-bits value" );
+				break;
+				}
+			if( length == 1 && content[ 0 ] != 0 )
+				{
+				derComplain( state, position, TRUE,
+							 "Empty BIT STRING has non-zero unused-bits "
+							 "value" );
+				break;
+				}
+			if( length > 1 && \
+				( content[ length - 1 ] & ( ( 1 << content[ 0 ] ) - 1 ) ) )
+				{
+				derComplain( state, position, TRUE,
+							 "BIT STRING has non-zero unused bits" );
+				}
+			break;
+
+		case NULLTAG:
+			if( length != 0 )
+				{
+				derComplain( state, position, TRUE,
+							 "NULL has invalid length %ld", length );
+				}
+			break;
+
+		case OID:
+			if( length < 1 || ( content[ length - 1 ] & 0x80 ) )
+				{
+				derComplain( state, position, TRUE, "Invalid OID data" );
+				break;
+				}
+			for( i = 0; i < length; i++ )
+				{
+				if( content[ i ] == 0x80 && \
+					( i == 0 || !( content[ i - 1 ] & 0x80 ) ) )
+					{
+					derComplain( state, position, TRUE,
+								 "OID has invalid encoding" );
+					break;
+					}
+				}
+			break;
+
+		case UTCTIME:
+		case GENERALIZEDTIME:
+			if( !checkDERtime( content, item ) )
+				{
+				derComplain( state, position, TRUE,
+							 "%s isn't in the DER form", idstr( item->tag ) );
+				}
+			break;
+
+		case SEQUENCE:
+		case SET:
+			derComplain( state, position, TRUE,
+						 "%s has invalid primitive encoding",
+						 idstr( item->tag ) );
+			break;
+		}
+	}
+
+/* Check the items in a block of data.  The parent tag is the tag of the
+   enclosing item if it's a universal type, or -1 otherwise, and is used to
+   check the BOOLEAN DEFAULT and SET ordering rules.  Returns FALSE if the
+   data can't be decoded, in which case there's no point in continuing */
+
+static int checkDERitems( DER_CHECK *state, const BYTE *data, long length,
+						   const int parentTag, const int level )
+	{
+	ASN1_ITEM item, prevItem;
+	const BYTE *prevData = NULL, *tagOrderError = NULL;
+	const BYTE *encodingOrderError = NULL;
+	long prevSize = 0;
+	int isSetOf = TRUE;
+
+	prevItem.id = prevItem.tag = 0;
+	if( level > MAX_NESTING_LEVEL )
+		{
+		derComplain( state, data, TRUE,
+					 "Object contains more than %d levels of nesting",
+					 MAX_NESTING_LEVEL );
+		return( FALSE );
+		}
+	while( length > 0 )
+		{
+		const BYTE *content, *encapsulated;
+		long size, contentLength;
+		char nameBuffer[ 32 ];
+
+		/* Get the item, bailing out if it can't be decoded since we can't
+		   get to anything that follows it.  Most items have a low tag
+		   number and a short length, so we decode those directly and only
+		   use the general-purpose decoder for the others */
+		if( data[ 0 ] == EOC && length >= 2 && data[ 1 ] == 0 )
+			{
+			derComplain( state, data, TRUE,
+						 "Spurious EOC in definite-length item" );
+			return( FALSE );
+			}
+		if( length >= 2 && ( data[ 0 ] & TAG_MASK ) != TAG_MASK && \
+			!( data[ 1 ] & LEN_XTND ) )
+			{
+			item.id = data[ 0 ] & ~TAG_MASK;
+			item.tag = data[ 0 ] & TAG_MASK;
+			item.length = data[ 1 ];
+			item.indefinite = item.nonCanonical = FALSE;
+			item.header[ 0 ] = data[ 0 ];
+			item.headerSize = 2;
+			size = ( 2 + item.length <= length ) ? 2 + item.length : -1;
+			}
+		else
+			size = getMemObjectSize( data, length, &item, level );
+		if( size <= 0 )
+			{
+			derComplain( state, data, TRUE, ( length < 2 ) ? \
+							"Truncated item, %ld bytes left" : \
+							"Invalid or truncated item, %ld bytes left",
+						 length );
+			return( FALSE );
+			}
+		content = data + item.headerSize;
+		contentLength = item.indefinite ? \
+						size - item.headerSize - 2 : item.length;
+
+		/* Check the tag and length encoding */
+		if( ( item.header[ 0 ] & TAG_MASK ) == TAG_MASK && \
+			( item.tag < TAG_MASK || item.header[ 1 ] == 0x80 ) )
+			{
+			derComplain( state, data, TRUE, "Tag %s has non-minimal encoding",
+						 getItemName( nameBuffer, &item ) );
+			}
+		if( item.indefinite )
+			{
+			derComplain( state, data, TRUE, "%s has indefinite length",
+						 getItemName( nameBuffer, &item ) );
+			}
+		if( item.nonCanonical )
+			{
+			derComplain( state, data, TRUE,
+						 "Length %ld has non-canonical encoding",
+						 item.length );
+			}
+
+		/* Check the contents */
+		if( ( item.id & FORM_MASK ) == CONSTRUCTED )
+			{
+			if( ( item.id & CLASS_MASK ) == UNIVERSAL && \
+				item.tag != SEQUENCE && item.tag != SET && \
+				item.tag != EXTERNAL && item.tag != EMBEDDED_PDV )
+				{
+				derComplain( state, data, TRUE,
+							 "%s has constructed encoding",
+							 idstr( item.tag ) );
+				}
+			if( !checkDERitems( state, content, contentLength,
+								( ( item.id & CLASS_MASK ) == UNIVERSAL ) ? \
+								item.tag : -1, level + 1 ) )
+				return( FALSE );
+			}
+		else
+			{
+			if( ( item.id & CLASS_MASK ) == UNIVERSAL )
+				checkDERprimitive( state, data, content, &item, parentTag );
+			if( item.id == UNIVERSAL && \
+				( item.tag == OCTETSTRING || item.tag == BITSTRING ) )
+				{
+				encapsulated = getMemEncapsulated( content, &contentLength,
+												   &item, level );
+				if( encapsulated != NULL && \
+					!checkDERitems( state, encapsulated, contentLength, -1,
+									level + 1 ) )
+					return( FALSE );
+				}
+			}
+
+		/* If we're inside a SET, check the ordering against the previous
+		   element.  We don't know yet whether it's a SET or a SET OF, so we
+		   check both orderings and decide which one applies at the end */
+		if( parentTag == SET && prevData != NULL )
+			{
+			const int tagOrder = compareTags( &prevItem, &item );
+
+			if( tagOrder != 0 )
+				isSetOf = FALSE;
+			if( tagOrder >= 0 && tagOrderError == NULL )
+				tagOrderError = data;
+			if( encodingOrderError == NULL && \
+				compareEncodings( prevData, prevSize, data, size ) > 0 )
+				encodingOrderError = data;
+			}
+		prevItem.id = item.id;
+		prevItem.tag = item.tag;
+		prevData = data;
+		prevSize = size;
+		data += size;
+		length -= size;
+		}
+	if( parentTag != SET )
+		return( TRUE );
+	if( isSetOf && encodingOrderError != NULL )
+		{
+		derComplain( state, encodingOrderError, TRUE,
+					 "SET OF elements aren't sorted by encoding" );
+		}
+	if( !isSetOf && tagOrderError != NULL )
+		{
+		derComplain( state, tagOrderError, TRUE,
+					 "SET elements aren't sorted by tag" );
+		}
+
+	return( TRUE );
+	}
+
+/* Check that each file, or each file in a directory tree, contains only
+   DER-encoded data */
+
+static int doCheckDER( char *paths[], const int noPaths )
+	{
+	FILE_LIST fileList;
+	FILE_READER reader;
+	DER_CHECK state;
+	long totalErrors = 0, totalWarnings = 0;
+	int noFailed = 0, i;
+
+	/* Build the list of files, sorted so that the output order is stable */
+	memset( &fileList, 0, sizeof( FILE_LIST ) );
+	for( i = 0; i < noPaths; i++ )
+		{
+		if( !addInventoryPath( &fileList, paths[ i ] ) )
+			{
+			puts( "Out of memory." );
+			return( EXIT_FAILURE );
+			}
+		}
+	if( fileList.noNames > 1 )
+		qsort( fileList.names, fileList.noNames, sizeof( char * ),
+			   compareFileNames );
+
+	openFileReader( &reader, fileList.names, fileList.noNames );
+	for( i = 0; i < fileList.noNames; i++ )
+		{
+		COMPRESSION_TYPE type;
+		const BYTE *data;
+		long dataLength;
+
+		if( ( data = readNextFile( &reader, &dataLength ) ) == NULL )
+			{
+			reportReadError( fileList.names[ i ] );
+			noFailed++;
+			continue;
+			}
+		type = getMemCompressionType( data, dataLength );
+		if( type != COMPRESSION_NONE )
+			{
+			complainCompressed( fileList.names[ i ], type );
+			noFailed++;
+			continue;
+			}
+		memset( &state, 0, sizeof( DER_CHECK ) );
+		state.fileName = fileList.names[ i ];
+		state.data = data;
+		if( dataLength <= 0 )
+			derComplain( &state, data, TRUE, "File contains no data" );
+		else
+			{
+			if( dataLength > 11 && !memcmp( data, "-----BEGIN ", 11 ) )
+				{
+				derComplain( &state, data, TRUE,
+							 "File contains PEM text, not binary data" );
+				}
+			else
+				checkDERitems( &state, data, dataLength, -1, 0 );
+			}
+		if( state.noErrors > 0 )
+			noFailed++;
+		totalErrors += state.noErrors;
+		totalWarnings += state.noWarnings;
+		}
+	closeFileReader( &reader );
+	fflush( output );
+	fprintf( stderr, "%ld error%s, %ld warning%s, %d of %d file%s failed.\n",
+			 totalErrors, ( totalErrors != 1 ) ? "s" : "",
+			 totalWarnings, ( totalWarnings != 1 ) ? "s" : "",
+			 noFailed, fileList.noNames,
+			 ( fileList.noNames != 1 ) ? "s" : "" );
+
+	/* Clean up */
+	for( i = 0; i < fileList.noNames; i++ )
+		free( fileList.names[ i ] );
+	if( fileList.names != NULL )
+		free( fileList.names );
+
+	return( ( noFailed > 0 ) ? EXIT_FAILURE : EXIT_SUCCESS );
+	}
+
+/****************************************************************************
+*																			*
+*								OID Index Routines							*
+*																			*
+****************************************************************************/
+
+/* Finding out which of a large collection of objects use a particular OID,
+   for example which certificates have SHA-1 signatures or contain a given
+   policy, would otherwise require dumping every object and grepping the
+   output.  Instead, we can build an inverted index that records each
+   occurrence of each OID, keyed by the encoded OID value as used by
+   getOIDinfo(), along with the file that it's in, its offset, and the
+   tags of the items that enclose it.  The index looks like:
+
+	Header: magic, no.files, no.keys, no.paths, offsets of sections
+	Keys: Fixed-size entries sorted by encoded OID, each giving the number
+		  of occurrences and the position of the occurrence list
+	Occurrences: For each key, the occurrences in file order as varints
+		  for the file ID delta, object number, offset, and path ID
+	Paths: The distinct tag paths, stored once and referred to by ID
+	Files: The name, size, and modification time of each file
+	File index: The position of each file entry
+
+   so that a query is a binary search of the keys followed by a read of the
+   occurrence list, without having to read anything else.  Offsets are for
+   the file for DER data, and for the decoded object for each PEM object,
+   with the objects numbered from 1.
+
+   When an existing index is updated, files whose size and modification
+   time haven't changed keep their occurrences from the old index, and only
+   new or changed files are scanned, in parallel if possible.  Kept files
+   retain their order and new files are added after them, so that the
+   occurrence lists remain in file order without having to be sorted */
+
+#define INDEX_MAGIC			"DA1INDX1"
+#define INDEX_MAGIC_SIZE	8
+#define INDEX_HEADER_SIZE	48
+#define INDEX_KEY_SIZE		56		/* Length + key + count + pos.+ length */
+#define INDEX_MAX_KEY		( MAX_OID_SIZE - 1 )
+#define INDEX_MAX_PATH		( ( MAX_NESTING_LEVEL + 2 ) * 4 )
+
+/* A table of distinct byte strings, identified by the order in which they
+   were added.  The strings are stored one after the other in a buffer and
+   located through an open-addressed hash table */
+
+typedef struct {
+	long offset;				/* Position of value in data */
+	int length;					/* Length of value */
+	} INDEX_VALUE;
+
+typedef struct {
+	TEXT_BUFFER data;			/* Values */
+	INDEX_VALUE *values;		/* Position of each value */
+	int noValues, maxValues;
+	int *slots;					/* Hash slots, -1 = empty */
+	int noSlots;
+	} INDEX_TABLE;
+
+/* The occurrences of a key, and the files being indexed */
+
+typedef struct {
+	TEXT_BUFFER data;			/* Encoded occurrences */
+	long noOccurrences;
+	int lastFileID;				/* File ID of last occurrence */
+	} INDEX_OCCURRENCES;
+
+typedef struct {
+	char *name;					/* File name */
+	long size, mtime;			/* Size and modification time */
+	int oldID;					/* ID in old index, -1 if not present */
+	TEXT_BUFFER records;		/* OIDs found when scanned */
+	} INDEX_FILE;
+
+/* The state for a scan of a file and for the threads scanning files */
+
+typedef struct {
+	TEXT_BUFFER *records;		/* OIDs found */
+	const BYTE *data;			/* Start of data */
+	int isPEM;					/* Whether objects are PEM-encoded */
+	int objectNo;				/* Object number for PEM, 0 for DER */
+	BYTE path[ INDEX_MAX_PATH ];/* Tags of enclosing items */
+	int pathLength;
+	} INDEX_SCAN;
+
+typedef struct {
+	INDEX_FILE *files;			/* Files being indexed */
+	const int *scanList;		/* Files to scan */
+	int noScan;
+	int checkEncaps;			/* Whether to look inside encaps.data */
+	} INDEX_JOB;
+
+#ifdef USE_THREADS
+static pthread_mutex_t indexMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif /* USE_THREADS */
+static int indexNextFile = 0;
+
+/* Read and write the integer values in the index.  Fixed-size values are
+   big-endian, and variable-length ones are stored as little-endian 7-bit
+   groups with the high bit set on all but the last */
+
+static void putIndexInt( BYTE *buffer, unsigned long value, int length )
+	{
+	while( length-- > 0 )
+		{
+		buffer[ length ] = ( BYTE ) ( value & 0xFF );
+		value >>= 8;
+		}
+	}
+
+static unsigned long getIndexInt( const BYTE *buffer, int length )
+	{
+	unsigned long value = 0;
+	int i;
+
+	for( i = 0; i < length; i++ )
+		value = ( value << 8 ) | buffer[ i ];
+
+	return( value );
+	}
+
+static int appendVarint( TEXT_BUFFER *textBuffer, unsigned long value )
+	{
+	char buffer[ 16 ];
+	int length = 0;
+
+	while( value >= 0x80 )
+		{
+		buffer[ length++ ] = ( char ) ( 0x80 | ( value & 0x7F ) );
+		value >>= 7;
+		}
+	buffer[ length++ ] = ( char ) value;
+
+	return( appendText( textBuffer, buffer, length ) );
+	}
+
+static int getVarint( const BYTE **dataPtr, const BYTE *dataEnd,
+					  unsigned long *value )
+	{
+	const BYTE *data = *dataPtr;
+	int shift = 0;
+
+	*value = 0;
+	while( data < dataEnd && shift < 63 )
+		{
+		const int ch = *data++;
+
+		*value |= ( unsigned long ) ( ch & 0x7F ) << shift;
+		if( !( ch & 0x80 ) )
+			{
+			*dataPtr = data;
+			return( TRUE );
+			}
+		shift += 7;
+		}
+
+	return( FALSE );
+	}
+
+/* Add a value to a table of distinct values, returning its ID, or -1 if
+   we run out of memory */
+
+static int addIndexValue( INDEX_TABLE *table, const BYTE *value,
+						  const int length )
+	{
+	int slot, i;
+
+	/* Expand the hash table once it's half full */
+	if( table->noValues * 2 >= table->noSlots )
+		{
+		const int newNoSlots = table->noSlots ? table->noSlots * 2 : 1024;
+		int *newSlots = ( int * ) malloc( newNoSlots * sizeof( int ) );
+
+		if( newSlots == NULL )
+			return( -1 );
+		for( i = 0; i < newNoSlots; i++ )
+			newSlots[ i ] = -1;
+		for( i = 0; i < table->noValues; i++ )
+			{
+			const INDEX_VALUE *indexValue = &table->values[ i ];
+
+			slot = hashOID( ( const BYTE * ) table->data.buffer + \
+								indexValue->offset, indexValue->length, 0 ) & \
+				   ( newNoSlots - 1 );
+			while( newSlots[ slot ] >= 0 )
+				slot = ( slot + 1 ) & ( newNoSlots - 1 );
+			newSlots[ slot ] = i;
+			}
+		if( table->slots != NULL )
+			free( table->slots );
+		table->slots = newSlots;
+		table->noSlots = newNoSlots;
+		}
+
+	/* Look for the value, adding it if it's not present */
+	slot = hashOID( value, length, 0 ) & ( table->noSlots - 1 );
+	while( table->slots[ slot ] >= 0 )
+		{
+		const INDEX_VALUE *indexValue = &table->values[ table->slots[ slot ] ];
+
+		if( indexValue->length == length && \
+			!memcmp( table->data.buffer + indexValue->offset, value, length ) )
+			return( table->slots[ slot ] );
+		slot = ( slot + 1 ) & ( table->noSlots - 1 );
+		}
+	if( table->noValues >= table->maxValues )
+		{
+		const int newMaxValues = table->maxValues ? \
+								 table->maxValues * 2 : 256;
+		INDEX_VALUE *newValues = ( INDEX_VALUE * ) \
+					realloc( table->values, newMaxValues * sizeof( INDEX_VALUE ) );
+
+		if( newValues == NULL )
+			return( -1 );
+		table->values = newValues;
+		table->maxValues = newMaxValues;
+		}
+	table->values[ table->noValues ].offset = table->data.length;
+	table->values[ table->noValues ].length = length;
+	if( !appendText( &table->data, ( const char * ) value, length ) )
+		return( -1 );
+	table->slots[ slot ] = table->noValues;
+
+	return( table->noValues++ );
+	}
+
+static void freeIndexTable( INDEX_TABLE *table )
+	{
+	if( table->data.buffer != NULL )
+		free( table->data.buffer );
+	if( table->values != NULL )
+		free( table->values );
+	if( table->slots != NULL )
+		free( table->slots );
+	}
+
+/* Record the OIDs in an object, along with the tags of the items that
+   enclose them */
+
+static int indexItems( INDEX_SCAN *scan, const BYTE *data, long dataLength,
+					   const int level )
+	{
+	while( dataLength > 0 )
+		{
+		const int pathLength = scan->pathLength;
+		const BYTE *content;
+		ASN1_ITEM item;
+		long size, contentLength;
+
+		if( ( size = getMemObjectSize( data, dataLength, &item, level ) ) <= 0 )
+			break;
+		content = data + item.headerSize;
+		contentLength = size - item.headerSize - ( item.indefinite ? 2 : 0 );
+
+		/* If it's an OID, record it */
+		if( item.id == UNIVERSAL && item.tag == OID )
+			{
+			if( item.length > 0 && item.length <= INDEX_MAX_KEY )
+				{
+				char length = ( char ) item.length;
+
+				if( !appendText( scan->records, &length, 1 ) || \
+					!appendText( scan->records, ( const char * ) content,
+								 ( int ) item.length ) || \
+					!appendVarint( scan->records, scan->objectNo ) || \
+					!appendVarint( scan->records, data - scan->data ) || \
+					!appendVarint( scan->records, scan->pathLength ) || \
+					!appendText( scan->records, ( const char * ) scan->path,
+								 scan->pathLength ) )
+					return( FALSE );
+				}
+			data += size;
+			dataLength -= size;
+			continue;
+			}
+
+		/* If it's a constructed or encapsulating item, add it to the path
+		   and record the OIDs inside it */
+		if( ( item.id & FORM_MASK ) != CONSTRUCTED )
+			content = getMemEncapsulated( content, &contentLength, &item,
+										  level );
+		if( content != NULL && scan->pathLength < INDEX_MAX_PATH - 8 )
+			{
+			if( item.tag < TAG_MASK )
+				scan->path[ scan->pathLength++ ] = item.id | item.tag;
+			else
+				{
+				int tag = item.tag;
+
+				scan->path[ scan->pathLength++ ] = item.id | TAG_MASK;
+				while( tag >= 0x80 )
+					{
+					scan->path[ scan->pathLength++ ] = 0x80 | ( tag & 0x7F );
+					tag >>= 7;
+					}
+				scan->path[ scan->pathLength++ ] = tag;
+				}
+			if( !indexItems( scan, content, contentLength, level + 1 ) )
+				return( FALSE );
+			scan->pathLength = pathLength;
+			}
+		data += size;
+		dataLength -= size;
+		}
+
+	return( TRUE );
+	}
+
+static int indexObject( void *arg, const BYTE *data, const long dataLength )
+	{
+	INDEX_SCAN *scan = ( INDEX_SCAN * ) arg;
+
+	/* PEM objects are numbered, with offsets relative to the decoded
+	   object, DER objects have offsets relative to the file */
+	if( scan->isPEM )
+		{
+		scan->objectNo++;
+		scan->data = data;
+		}
+	scan->pathLength = 0;
+	return( indexItems( scan, data, dataLength, 0 ) );
+	}
+
+/* Scan files from the list until there are none left */
+
+static void *indexWorker( void *arg )
+	{
+	const INDEX_JOB *job = ( const INDEX_JOB * ) arg;
+
+	checkEncaps = job->checkEncaps;
+	while( TRUE )
+		{
+		INDEX_FILE *file;
+		INDEX_SCAN scan;
+		const BYTE *data;
+		long dataLength;
+		int isMapped;
+
+		/* Get the next file to scan */
+#ifdef USE_THREADS
+		pthread_mutex_lock( &indexMutex );
+#endif /* USE_THREADS */
+		file = ( indexNextFile < job->noScan ) ? \
+			   &job->files[ job->scanList[ indexNextFile++ ] ] : NULL;
+#ifdef USE_THREADS
+		pthread_mutex_unlock( &indexMutex );
+#endif /* USE_THREADS */
+		if( file == NULL )
+			break;
+
+		/* Record the OIDs in each object in the file */
+		if( ( data = getFileData( file->name, &dataLength,
+								  &isMapped ) ) == NULL )
+			continue;
+		memset( &scan, 0, sizeof( INDEX_SCAN ) );
+		scan.records = &file->records;
+		scan.data = data;
+		scan.isPEM = findMemString( data, dataLength, "-----BEGIN " ) != NULL;
+		processObjects( data, dataLength, FALSE, indexObject, &scan );
+		freeFileData( data, dataLength, isMapped );
+		}
+
+	return( NULL );
+	}
+
+/* Get the size and modification time of a file, returning FALSE if we
+   can't tell whether it's changed */
+
+static int getIndexFileInfo( INDEX_FILE *file )
+	{
+#ifdef __UNIX__
+	struct stat statInfo;
+
+	if( stat( file->name, &statInfo ) < 0 )
+		return( FALSE );
+	file->size = ( long ) statInfo.st_size;
+	file->mtime = ( long ) statInfo.st_mtime;
+
+	return( TRUE );
+#else
+	return( FALSE );
+#endif /* __UNIX__ */
+	}
+
+static int compareIndexFiles( const void *file1, const void *file2 )
+	{
+	return( strcmp( ( ( const INDEX_FILE * ) file1 )->name,
+					( ( const INDEX_FILE * ) file2 )->name ) );
+	}
+
+/* Check an index and get the positions of its sections */
+
+typedef struct {
+	const BYTE *data;			/* Index data */
+	long dataLength;
+	int noFiles, noKeys, noPaths;
+	const BYTE *keys, *paths, *files, *fileIndex;	/* Sections */
+	const BYTE **pathData;		/* Position of each path */
+	} INDEX_INFO;
+
+static int getIndexInfo( INDEX_INFO *indexInfo, const BYTE *data,
+						 const long dataLength )
+	{
+	unsigned long pathsOffset, filesOffset, fileIndexOffset;
+	const BYTE *pathPtr;
+	int i;
+
+	memset( indexInfo, 0, sizeof( INDEX_INFO ) );
+	if( dataLength < INDEX_HEADER_SIZE || \
+		memcmp( data, INDEX_MAGIC, INDEX_MAGIC_SIZE ) )
+		return( FALSE );
+	indexInfo->data = data;
+	indexInfo->dataLength = dataLength;
+	indexInfo->noFiles = ( int ) getIndexInt( data + 8, 4 );
+	indexInfo->noKeys = ( int ) getIndexInt( data + 12, 4 );
+	indexInfo->noPaths = ( int ) getIndexInt( data + 16, 4 );
+	pathsOffset = getIndexInt( data + 24, 8 );
+	filesOffset = getIndexInt( data + 32, 8 );
+	fileIndexOffset = getIndexInt( data + 40, 8 );
+	if( indexInfo->noFiles < 0 || indexInfo->noKeys < 0 || \
+		indexInfo->noPaths < 0 || \
+		indexInfo->noKeys > ( dataLength - INDEX_HEADER_SIZE ) / INDEX_KEY_SIZE || \
+		pathsOffset < INDEX_HEADER_SIZE + \
+					  ( unsigned long ) indexInfo->noKeys * INDEX_KEY_SIZE || \
+		filesOffset < pathsOffset || fileIndexOffset < filesOffset || \
+		fileIndexOffset > ( unsigned long ) dataLength || \
+		indexInfo->noFiles > ( dataLength - ( long ) fileIndexOffset ) / 8 )
+		return( FALSE );
+	indexInfo->keys = data + INDEX_HEADER_SIZE;
+	indexInfo->paths = data + pathsOffset;
+	indexInfo->files = data + filesOffset;
+	indexInfo->fileIndex = data + fileIndexOffset;
+
+	/* Locate the paths, which are referred to by ID */
+	if( indexInfo->noPaths > 0 )
+		{
+		if( indexInfo->noPaths > indexInfo->files - indexInfo->paths || \
+			( indexInfo->pathData = ( const BYTE ** ) \
+					malloc( indexInfo->noPaths * sizeof( BYTE * ) ) ) == NULL )
+			return( FALSE );
+		}
+	for( pathPtr = indexInfo->paths, i = 0; i < indexInfo->noPaths; i++ )
+		{
+		unsigned long length;
+
+		indexInfo->pathData[ i ] = pathPtr;
+		if( !getVarint( &pathPtr, indexInfo->files, &length ) || \
+			length > ( unsigned long ) ( indexInfo->files - pathPtr ) )
+			{
+			free( indexInfo->pathData );
+			return( FALSE );
+			}
+		pathPtr += length;
+		}
+
+	return( TRUE );
+	}
+
+/* Get the information for a file in an index */
+
+static int getIndexFile( const INDEX_INFO *indexInfo, const int fileID,
+						 INDEX_FILE *file, int *nameLength )
+	{
+	const BYTE *fileEnd = indexInfo->fileIndex;
+	const BYTE *filePtr;
+	unsigned long offset, size, mtime, length;
+
+	if( fileID < 0 || fileID >= indexInfo->noFiles )
+		return( FALSE );
+	offset = getIndexInt( indexInfo->fileIndex + fileID * 8, 8 );
+	if( offset >= ( unsigned long ) ( fileEnd - indexInfo->files ) )
+		return( FALSE );
+	filePtr = indexInfo->files + offset;
+	if( !getVarint( &filePtr, fileEnd, &size ) || \
+		!getVarint( &filePtr, fileEnd, &mtime ) || \
+		!getVarint( &filePtr, fileEnd, &length ) || \
+		length > ( unsigned long ) ( fileEnd - filePtr ) )
+		return( FALSE );
+	file->name = ( char * ) filePtr;
+	file->size = ( long ) size;
+	file->mtime = ( long ) mtime;
+	*nameLength = ( int ) length;
+
+	return( TRUE );
+	}
+
+/* Get the occurrence list for a key in an index */
+
+static const BYTE *getIndexKey( const INDEX_INFO *indexInfo,
+								const int keyIndex, const BYTE **key,
+								int *keyLength, long *noOccurrences,
+								const BYTE **occurrencesEnd )
+	{
+	const BYTE *keyPtr = indexInfo->keys + keyIndex * INDEX_KEY_SIZE;
+	const unsigned long offset = getIndexInt( keyPtr + 44, 8 );
+	const unsigned long length = getIndexInt( keyPtr + 52, 4 );
+
+	*key = keyPtr + 1;
+	*keyLength = min( keyPtr[ 0 ], INDEX_MAX_KEY );
+	*noOccurrences = ( long ) getIndexInt( keyPtr + 40, 4 );
+	if( offset > ( unsigned long ) ( indexInfo->paths - indexInfo->data ) || \
+		length > ( unsigned long ) ( indexInfo->paths - indexInfo->data ) - offset )
+		return( NULL );
+	*occurrencesEnd = indexInfo->data + offset + length;
+
+	return( indexInfo->data + offset );
+	}
+
+/* Add an occurrence of a key to the index being built */
+
+static int addOccurrence( INDEX_OCCURRENCES *occurrences, const int fileID,
+						  const unsigned long objectNo,
+						  const unsigned long offset, const int pathID )
+	{
+	if( !appendVarint( &occurrences->data, \
+					   fileID - occurrences->lastFileID ) || \
+		!appendVarint( &occurrences->data, objectNo ) || \
+		!appendVarint( &occurrences->data, offset ) || \
+		!appendVarint( &occurrences->data, pathID ) )
+		return( FALSE );
+	occurrences->lastFileID = fileID;
+	occurrences->noOccurrences++;
+
+	return( TRUE );
+	}
+
+static int addKeyOccurrence( INDEX_TABLE *keys, INDEX_OCCURRENCES **occurrences,
+							 int *maxKeys, const BYTE *key,
+							 const int keyLength, const int fileID,
+							 const unsigned long objectNo,
+							 const unsigned long offset, const int pathID )
+	{
+	const int keyID = addIndexValue( keys, key, keyLength );
+
+	if( keyID < 0 || pathID < 0 )
+		return( FALSE );
+	if( keyID >= *maxKeys )
+		{
+		const int newMaxKeys = *maxKeys ? *maxKeys * 2 : 256;
+		INDEX_OCCURRENCES *newOccurrences = ( INDEX_OCCURRENCES * ) \
+			realloc( *occurrences, newMaxKeys * sizeof( INDEX_OCCURRENCES ) );
+
+		if( newOccurrences == NULL )
+			return( FALSE );
+		memset( newOccurrences + *maxKeys, 0,
+				( newMaxKeys - *maxKeys ) * sizeof( INDEX_OCCURRENCES ) );
+		*occurrences = newOccurrences;
+		*maxKeys = newMaxKeys;
+		}
+
+	return( addOccurrence( &( *occurrences )[ keyID ], fileID, objectNo,
+						   offset, pathID ) );
+	}
+
+/* Sort the keys into encoded-OID order */
+
+typedef struct {
+	const BYTE *key;
+	int keyLength, keyID;
+	} INDEX_SORT_KEY;
+
+static int compareIndexKeys( const BYTE *key1, const int key1Length,
+							 const BYTE *key2, const int key2Length )
+	{
+	const int result = memcmp( key1, key2, min( key1Length, key2Length ) );
+
+	if( result != 0 )
+		return( result );
+	return( key1Length - key2Length );
+	}
+
+static int compareSortKeys( const void *key1Ptr, const void *key2Ptr )
+	{
+	const INDEX_SORT_KEY *key1 = ( const INDEX_SORT_KEY * ) key1Ptr;
+	const INDEX_SORT_KEY *key2 = ( const INDEX_SORT_KEY * ) key2Ptr;
+
+	return( compareIndexKeys( key1->key, key1->keyLength, key2->key,
+							  key2->keyLength ) );
+	}
+
+/* Write the index */
+
+static int writeIndex( FILE *outFile, const INDEX_FILE *files,
+					   const int *fileOrder, const int noFiles,
+					   const INDEX_TABLE *keys,
+					   const INDEX_OCCURRENCES *occurrences,
+					   const INDEX_TABLE *paths )
+	{
+	INDEX_SORT_KEY *sortKeys = NULL;
+	TEXT_BUFFER fileData, fileIndex;
+	BYTE buffer[ INDEX_HEADER_SIZE ];
+	long position, filesOffset;
+	int i;
+
+	/* Sort the keys and write their entries */
+	if( keys->noValues > 0 && \
+		( sortKeys = ( INDEX_SORT_KEY * ) \
+				malloc( keys->noValues * sizeof( INDEX_SORT_KEY ) ) ) == NULL )
+		return( FALSE );
+	for( i = 0; i < keys->noValues; i++ )
+		{
+		sortKeys[ i ].key = ( const BYTE * ) keys->data.buffer + \
+							keys->values[ i ].offset;
+		sortKeys[ i ].keyLength = keys->values[ i ].length;
+		sortKeys[ i ].keyID = i;
+		}
+	if( keys->noValues > 1 )
+		qsort( sortKeys, keys->noValues, sizeof( INDEX_SORT_KEY ),
+			   compareSortKeys );
+	memset( buffer, 0, INDEX_HEADER_SIZE );
+	fwrite( buffer, 1, INDEX_HEADER_SIZE, outFile );
+	position = INDEX_HEADER_SIZE + ( long ) keys->noValues * INDEX_KEY_SIZE;
+	for( i = 0; i < keys->noValues; i++ )
+		{
+		const INDEX_OCCURRENCES *keyOccurrences = \
+								&occurrences[ sortKeys[ i ].keyID ];
+		BYTE keyBuffer[ INDEX_KEY_SIZE ];
+
+		memset( keyBuffer, 0, INDEX_KEY_SIZE );
+		keyBuffer[ 0 ] = ( BYTE ) sortKeys[ i ].keyLength;
+		memcpy( keyBuffer + 1, sortKeys[ i ].key, sortKeys[ i ].keyLength );
+		putIndexInt( keyBuffer + 40, keyOccurrences->noOccurrences, 4 );
+		putIndexInt( keyBuffer + 44, position, 8 );
+		putIndexInt( keyBuffer + 52, keyOccurrences->data.length, 4 );
+		fwrite( keyBuffer, 1, INDEX_KEY_SIZE, outFile );
+		position += keyOccurrences->data.length;
+		}
+
+	/* Write the occurrences and paths */
+	for( i = 0; i < keys->noValues; i++ )
+		{
+		const INDEX_OCCURRENCES *keyOccurrences = \
+								&occurrences[ sortKeys[ i ].keyID ];
+
+		fwrite( keyOccurrences->data.buffer, 1, keyOccurrences->data.length,
+				outFile );
+		}
+	if( sortKeys != NULL )
+		free( sortKeys );
+	putIndexInt( buffer + 24, position, 8 );
+	for( i = 0; i < paths->noValues; i++ )
+		{
+		const INDEX_VALUE *path = &paths->values[ i ];
+		TEXT_BUFFER lengthBuffer;
+
+		memset( &lengthBuffer, 0, sizeof( TEXT_BUFFER ) );
+		if( !appendVarint( &lengthBuffer, path->length ) )
+			return( FALSE );
+		fwrite( lengthBuffer.buffer, 1, lengthBuffer.length, outFile );
+		fwrite( paths->data.buffer + path->offset, 1, path->length, outFile );
+		position += lengthBuffer.length + path->length;
+		free( lengthBuffer.buffer );
+		}
+
+	/* Write the files and the file index */
+	filesOffset = position;
+	memset( &fileData, 0, sizeof( TEXT_BUFFER ) );
+	memset( &fileIndex, 0, sizeof( TEXT_BUFFER ) );
+	for( i = 0; i < noFiles; i++ )
+		{
+		const INDEX_FILE *file = &files[ fileOrder[ i ] ];
+		const int nameLength = strlen( file->name );
+		char offsetBuffer[ 8 ];
+
+		putIndexInt( ( BYTE * ) offsetBuffer, fileData.length, 8 );
+		if( !appendText( &fileIndex, offsetBuffer, 8 ) || \
+			!appendVarint( &fileData, file->size ) || \
+			!appendVarint( &fileData, file->mtime ) || \
+			!appendVarint( &fileData, nameLength ) || \
+			!appendText( &fileData, file->name, nameLength ) )
+			{
+			if( fileData.buffer != NULL )
+				free( fileData.buffer );
+			if( fileIndex.buffer != NULL )
+				free( fileIndex.buffer );
+			return( FALSE );
+			}
+		}
+	fwrite( fileData.buffer, 1, fileData.length, outFile );
+	fwrite( fileIndex.buffer, 1, fileIndex.length, outFile );
+	putIndexInt( buffer + 32, filesOffset, 8 );
+	putIndexInt( buffer + 40, filesOffset + fileData.length, 8 );
+	if( fileData.buffer != NULL )
+		free( fileData.buffer );
+	if( fileIndex.buffer != NULL )
+		free( fileIndex.buffer );
+
+	/* Go back and fill in the header */
+	memcpy( buffer, INDEX_MAGIC, INDEX_MAGIC_SIZE );
+	putIndexInt( buffer + 8, noFiles, 4 );
+	putIndexInt( buffer + 12, keys->noValues, 4 );
+	putIndexInt( buffer + 16, paths->noValues, 4 );
+	if( fseek( outFile, 0, SEEK_SET ) || \
+		fwrite( buffer, 1, INDEX_HEADER_SIZE, outFile ) != INDEX_HEADER_SIZE )
+		return( FALSE );
+
+	return( TRUE );
+	}
+
+/* Create or update an index of the OIDs in the given files and
+   directories */
+
+static int makeIndex( const char *indexName, char *paths[],
+					  const int noPaths )
+	{
+	FILE_LIST fileList;
+	INDEX_FILE *files = NULL;
+	INDEX_INFO oldIndex;
+	INDEX_TABLE keys, indexPaths;
+	INDEX_OCCURRENCES *occurrences = NULL;
+	INDEX_JOB job;
+	FILE *outFile;
+	char *tempName;
+	const BYTE *oldData = NULL;
+	long oldDataLength = 0, noOccurrences = 0;
+	int *fileOrder = NULL, *scanList = NULL, *oldFileMap = NULL;
+	int noFiles = 0, noKept = 0, noScan = 0, maxKeys = 0;
+	int isMapped = FALSE, status = FALSE, i;
+
+	memset( &fileList, 0, sizeof( FILE_LIST ) );
+	memset( &oldIndex, 0, sizeof( INDEX_INFO ) );
+	memset( &keys, 0, sizeof( INDEX_TABLE ) );
+	memset( &indexPaths, 0, sizeof( INDEX_TABLE ) );
+
+	/* Build the list of files, sorted so that the file IDs are stable */
+	for( i = 0; i < noPaths; i++ )
+		{
+		if( !addInventoryPath( &fileList, paths[ i ] ) )
+			{
+			puts( "Out of memory." );
+			return( EXIT_FAILURE );
+			}
+		}
+	if( fileList.noNames > 0 && \
+		( ( files = ( INDEX_FILE * ) \
+				calloc( fileList.noNames, sizeof( INDEX_FILE ) ) ) == NULL || \
+		  ( fileOrder = ( int * ) \
+				malloc( fileList.noNames * sizeof( int ) ) ) == NULL || \
+		  ( scanList = ( int * ) \
+				malloc( fileList.noNames * sizeof( int ) ) ) == NULL ) )
+		{
+		puts( "Out of memory." );
+		goto cleanup;
+		}
+	for( i = 0; i < fileList.noNames; i++ )
+		{
+		/* Don't index the index */
+		if( !strcmp( fileList.names[ i ], indexName ) )
+			continue;
+		files[ noFiles ].name = fileList.names[ i ];
+		files[ noFiles ].oldID = -1;
+		if( !getIndexFileInfo( &files[ noFiles ] ) )
+			files[ noFiles ].size = -1;
+		noFiles++;
+		}
+	if( noFiles > 1 )
+		qsort( files, noFiles, sizeof( INDEX_FILE ), compareIndexFiles );
+
+	/* If there's an existing index, find the files in it that haven't
+	   changed */
+	if( ( oldData = getFileData( indexName, &oldDataLength,
+								 &isMapped ) ) != NULL )
+		{
+		if( !getIndexInfo( &oldIndex, oldData, oldDataLength ) )
+			{
+			printf( "'%s' isn't a valid index.\n", indexName );
+			goto cleanup;
+			}
+		if( oldIndex.noFiles > 0 && \
+			( oldFileMap = ( int * ) \
+					malloc( oldIndex.noFiles * sizeof( int ) ) ) == NULL )
+			{
+			puts( "Out of memory." );
+			goto cleanup;
+			}
+		for( i = 0; i < oldIndex.noFiles; i++ )
+			{
+			INDEX_FILE oldFile, *file = NULL;
+			char name[ FILENAME_MAX ];
+			int nameLength;
+
+			oldFileMap[ i ] = -1;
+			if( !getIndexFile( &oldIndex, i, &oldFile, &nameLength ) )
+				{
+				printf( "'%s' isn't a valid index.\n", indexName );
+				goto cleanup;
+				}
+			if( nameLength >= FILENAME_MAX )
+				continue;
+			memcpy( name, oldFile.name, nameLength );
+			name[ nameLength ] = '\0';
+			oldFile.name = name;
+			if( noFiles > 0 )
+				file = bsearch( &oldFile, files, noFiles, sizeof( INDEX_FILE ),
+								compareIndexFiles );
+			if( file == NULL || file->size < 0 || file->oldID >= 0 || \
+				file->size != oldFile.size || file->mtime != oldFile.mtime )
+				continue;
+			file->oldID = i;
+			oldFileMap[ i ] = noKept;
+			fileOrder[ noKept++ ] = file - files;
+			}
+		}
+
+	/* Scan the new and changed files */
+	for( i = 0; i < noFiles; i++ )
+		{
+		if( files[ i ].oldID < 0 )
+			scanList[ noScan++ ] = i;
+		}
+	memset( &job, 0, sizeof( INDEX_JOB ) );
+	job.files = files;
+	job.scanList = scanList;
+	job.noScan = noScan;
+	job.checkEncaps = checkEncaps;
+	indexNextFile = 0;
+#ifdef USE_THREADS
+	if( parallelThreads > 1 && noScan > 1 )
+		{
+		pthread_t threads[ MAX_THREADS ];
+		const int noThreads = min( parallelThreads, noScan );
+		int noStarted;
+
+		for( noStarted = 0; noStarted < noThreads; noStarted++ )
+			{
+			if( pthread_create( &threads[ noStarted ], NULL, indexWorker,
+								&job ) )
+				break;
+			}
+		if( noStarted <= 0 )
+			indexWorker( &job );
+		for( i = 0; i < noStarted; i++ )
+			pthread_join( threads[ i ], NULL );
+		}
+	else
+#endif /* USE_THREADS */
+	indexWorker( &job );
+
+	/* Add the occurrences for the unchanged files from the old index,
+	   followed by the ones for the files that we've scanned */
+	for( i = 0; i < oldIndex.noKeys && noKept > 0; i++ )
+		{
+		const BYTE *key, *occurrence, *occurrencesEnd;
+		long noKeyOccurrences;
+		int keyLength, fileID = 0;
+
+		occurrence = getIndexKey( &oldIndex, i, &key, &keyLength,
+								  &noKeyOccurrences, &occurrencesEnd );
+		while( occurrence != NULL && occurrence < occurrencesEnd )
+			{
+			unsigned long fileDelta, objectNo, offset, pathID, pathLength;
+			const BYTE *path;
+
+			if( !getVarint( &occurrence, occurrencesEnd, &fileDelta ) || \
+				!getVarint( &occurrence, occurrencesEnd, &objectNo ) || \
+				!getVarint( &occurrence, occurrencesEnd, &offset ) || \
+				!getVarint( &occurrence, occurrencesEnd, &pathID ) || \
+				pathID >= ( unsigned long ) oldIndex.noPaths )
+				break;
+			fileID += ( int ) fileDelta;
+			if( fileID < 0 || fileID >= oldIndex.noFiles || \
+				oldFileMap[ fileID ] < 0 )
+				continue;
+			path = oldIndex.pathData[ pathID ];
+			getVarint( &path, oldIndex.files, &pathLength );
+			if( !addKeyOccurrence( &keys, &occurrences, &maxKeys, key,
+								   keyLength, oldFileMap[ fileID ], objectNo,
+								   offset, addIndexValue( &indexPaths, path,
+														  ( int ) pathLength ) ) )
+				{
+				puts( "Out of memory." );
+				goto cleanup;
+				}
+			}
+		}
+	for( i = 0; i < noScan; i++ )
+		{
+		const INDEX_FILE *file = &files[ scanList[ i ] ];
+		const BYTE *record = ( const BYTE * ) file->records.buffer;
+		const BYTE *recordsEnd = record + file->records.length;
+
+		fileOrder[ noKept + i ] = scanList[ i ];
+		while( record != NULL && record < recordsEnd )
+			{
+			const BYTE *key = record + 1;
+			const int keyLength = *record;
+			unsigned long objectNo, offset, pathLength;
+
+			record = key + keyLength;
+			getVarint( &record, recordsEnd, &objectNo );
+			getVarint( &record, recordsEnd, &offset );
+			getVarint( &record, recordsEnd, &pathLength );
+			if( !addKeyOccurrence( &keys, &occurrences, &maxKeys, key,
+								   keyLength, noKept + i, objectNo, offset,
+								   addIndexValue( &indexPaths, record,
+												  ( int ) pathLength ) ) )
+				{
+				puts( "Out of memory." );
+				goto cleanup;
+				}
+			record += pathLength;
+			}
+		}
+	if( oldData != NULL )
+		{
+		freeFileData( oldData, oldDataLength, isMapped );
+		oldData = NULL;
+		}
+
+	/* Write the new index to a temporary file and replace the old one with
+	   it */
+	if( ( tempName = ( char * ) malloc( strlen( indexName ) + 5 ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		goto cleanup;
+		}
+	sprintf( tempName, "%s.new", indexName );
+	if( ( outFile = fopen( tempName, "wb" ) ) == NULL )
+		{
+		perror( tempName );
+		free( tempName );
+		goto cleanup;
+		}
+	status = writeIndex( outFile, files, fileOrder, noFiles, &keys,
+						 occurrences, &indexPaths );
+	if( fclose( outFile ) )
+		status = FALSE;
+	if( !status || rename( tempName, indexName ) )
+		{
+		perror( indexName );
+		remove( tempName );
+		status = FALSE;
+		}
+	free( tempName );
+	for( i = 0; i < keys.noValues; i++ )
+		noOccurrences += occurrences[ i ].noOccurrences;
+	if( status )
+		{
+		fprintf( stderr, "%d file%s indexed, %d scanned, %ld OID "
+				 "occurrence%s.\n", noFiles, ( noFiles != 1 ) ? "s" : "",
+				 noScan, noOccurrences, ( noOccurrences != 1 ) ? "s" : "" );
+		}
+
+	/* Clean up */
+cleanup:
+	if( oldData != NULL )
+		freeFileData( oldData, oldDataLength, isMapped );
+	if( oldIndex.pathData != NULL )
+		free( oldIndex.pathData );
+	for( i = 0; i < maxKeys; i++ )
+		{
+		if( occurrences[ i ].data.buffer != NULL )
+			free( occurrences[ i ].data.buffer );
+		}
+	if( occurrences != NULL )
+		free( occurrences );
+	freeIndexTable( &keys );
+	freeIndexTable( &indexPaths );
+	for( i = 0; i < noFiles; i++ )
+		{
+		if( files[ i ].records.buffer != NULL )
+			free( files[ i ].records.buffer );
+		}
+	if( files != NULL )
+		free( files );
+	if( fileOrder != NULL )
+		free( fileOrder );
+	if( scanList != NULL )
+		free( scanList );
+	if( oldFileMap != NULL )
+		free( oldFileMap );
+	for( i = 0; i < fileList.noNames; i++ )
+		free( fileList.names[ i ] );
+	if( fileList.names != NULL )
+		free( fileList.names );
+
+	return( status ? EXIT_SUCCESS : EXIT_FAILURE );
+	}
+
+/* Convert an OID given as a dotted or space-separated value to its encoded
+   form, returning the length of the encoded form or 0 if it's invalid */
+
+static int encodeQueryOID( BYTE *oid, const char *string )
+	{
+	unsigned long value, firstValue = 0;
+	int length = 0, valueIndex = 0;
+
+	/* Encode each arc as a sequence of 7-bit values */
+	while( *string )
+		{
+		BYTE buffer[ 8 ];
+		int bufPos = 0;
+
+		if( !isdigit( byteToInt( *string ) ) )
+			return( 0 );
+		value = strtoul( string, ( char ** ) &string, 10 );
+		if( *string == '.' || *string == ' ' )
+			string++;
+		if( valueIndex++ == 0 )
+			{
+			if( value > 2 )
+				return( 0 );
+			firstValue = value;
+			continue;
+			}
+		if( valueIndex == 2 )
+			{
+			if( firstValue < 2 && value > 39 )
+				return( 0 );
+			value += firstValue * 40;
+			}
+		do
+			{
+			buffer[ bufPos++ ] = ( BYTE ) ( value & 0x7F );
+			value >>= 7;
+			}
+		while( value > 0 && bufPos < 8 );
+		if( length + bufPos > INDEX_MAX_KEY )
+			return( 0 );
+		while( bufPos-- > 0 )
+			oid[ length++ ] = buffer[ bufPos ] | ( bufPos ? 0x80 : 0 );
+		}
+
+	return( ( valueIndex >= 2 ) ? length : 0 );
+	}
+
+/* Print the tags of the items that enclose an occurrence */
+
+static void printIndexPath( const BYTE *path, const BYTE *pathEnd )
+	{
+	unsigned long pathLength;
+	char buffer[ 32 ];
+	int isFirst = TRUE;
+
+	if( !getVarint( &path, pathEnd, &pathLength ) )
+		return;
+	pathEnd = path + pathLength;
+	fputs( " (", output );
+	while( path < pathEnd )
+		{
+		ASN1_ITEM item;
+
+		memset( &item, 0, sizeof( ASN1_ITEM ) );
+		item.id = *path & ~TAG_MASK;
+		item.tag = *path++ & TAG_MASK;
+		if( item.tag == TAG_MASK )
+			{
+			int shift = 0;
+
+			item.tag = 0;
+			while( path < pathEnd && shift < 28 )
+				{
+				const int ch = *path++;
+
+				item.tag |= ( ch & 0x7F ) << shift;
+				if( !( ch & 0x80 ) )
+					break;
+				shift += 7;
+				}
+			}
+		fprintf( output, "%s%s", isFirst ? "" : " > ",
+				 getItemName( buffer, &item ) );
+		isFirst = FALSE;
+		}
+	fputs( ")\n", output );
+	}
+
+/* Print the occurrences of an OID in an index, returning the number of
+   occurrences */
+
+static long searchIndexOID( const INDEX_INFO *indexInfo, const BYTE *oid,
+							const int oidLength, const char *name,
+							int *noFiles )
+	{
+	const BYTE *occurrence = NULL, *occurrencesEnd = NULL;
+	long noOccurrences = 0;
+	int low = 0, high = indexInfo->noKeys, fileID = 0, lastFileID = -1;
+
+	/* Find the key for the OID */
+	while( low < high )
+		{
+		const int mid = ( low + high ) / 2;
+		const BYTE *key;
+		long keyOccurrences;
+		int keyLength, result;
+
+		occurrence = getIndexKey( indexInfo, mid, &key, &keyLength,
+								  &keyOccurrences, &occurrencesEnd );
+		result = compareIndexKeys( key, keyLength, oid, oidLength );
+		if( result == 0 )
+			break;
+		occurrence = NULL;
+		if( result < 0 )
+			low = mid + 1;
+		else
+			high = mid;
+		}
+
+	/* Print each occurrence */
+	while( occurrence != NULL && occurrence < occurrencesEnd )
+		{
+		INDEX_FILE file;
+		unsigned long fileDelta, objectNo, offset, pathID;
+		int nameLength;
+
+		if( !getVarint( &occurrence, occurrencesEnd, &fileDelta ) || \
+			!getVarint( &occurrence, occurrencesEnd, &objectNo ) || \
+			!getVarint( &occurrence, occurrencesEnd, &offset ) || \
+			!getVarint( &occurrence, occurrencesEnd, &pathID ) )
+			break;
+		fileID += ( int ) fileDelta;
+		if( !getIndexFile( indexInfo, fileID, &file, &nameLength ) )
+			break;
+		fprintf( output, "%.*s: ", nameLength, file.name );
+		if( objectNo > 0 )
+			fprintf( output, "%lu:", objectNo );
+		fprintf( output, "%lu %s", offset, name );
+		if( pathID < ( unsigned long ) indexInfo->noPaths )
+			printIndexPath( indexInfo->pathData[ pathID ], indexInfo->files );
+		else
+			fputc( '\n', output );
+		noOccurrences++;
+		if( fileID != lastFileID )
+			( *noFiles )++;
+		lastFileID = fileID;
+		}
+
+	return( noOccurrences );
+	}
+
+/* Find the occurrences of the given OIDs in an index.  OIDs can be given
+   either by value or by their name in the config file, in which case all
+   of the OIDs with that name are searched for, since some names such as
+   basicConstraints are used for both an obsolete and a current OID */
+
+static int searchIndex( const char *indexName, char *oids[],
+						const int noOIDs )
+	{
+	INDEX_INFO indexInfo;
+	const BYTE *data;
+	long dataLength, noOccurrences = 0;
+	int noFiles = 0, isMapped, i;
+
+	if( ( data = getFileData( indexName, &dataLength, &isMapped ) ) == NULL )
+		{
+		perror( indexName );
+		return( EXIT_FAILURE );
+		}
+	if( !getIndexInfo( &indexInfo, data, dataLength ) )
+		{
+		printf( "'%s' isn't a valid index.\n", indexName );
+		freeFileData( data, dataLength, isMapped );
+		return( EXIT_FAILURE );
+		}
+	for( i = 0; i < noOIDs; i++ )
+		{
+		const OIDINFO *oidInfo;
+		BYTE oid[ MAX_OID_SIZE ];
+		int oidLength, found = FALSE;
+
+		/* If it's a name, search for each OID with that name.  The same
+		   OID may be present more than once in the config file, so we only
+		   search for the entry that getOIDinfo() finds */
+		if( !isdigit( byteToInt( *oids[ i ] ) ) )
+			{
+			for( oidInfo = oidList; oidInfo != NULL; oidInfo = oidInfo->next )
+				{
+				if( strcmp( oidInfo->description, oids[ i ] ) || \
+					oidInfo->oidLength - 2 > INDEX_MAX_KEY || \
+					getOIDinfo( oidInfo->oid + 2,
+								oidInfo->oidLength - 2 ) != oidInfo )
+					continue;
+				noOccurrences += searchIndexOID( &indexInfo, oidInfo->oid + 2,
+												 oidInfo->oidLength - 2,
+												 oidInfo->description,
+												 &noFiles );
+				found = TRUE;
+				}
+			if( !found )
+				printf( "Unknown OID name '%s'.\n", oids[ i ] );
+			continue;
+			}
+
+		/* It's an OID value, search for it */
+		if( ( oidLength = encodeQueryOID( oid, oids[ i ] ) ) <= 0 )
+			{
+			printf( "Invalid OID '%s'.\n", oids[ i ] );
+			continue;
+			}
+		oidInfo = getOIDinfo( oid, oidLength );
+		noOccurrences += searchIndexOID( &indexInfo, oid, oidLength,
+										 ( oidInfo != NULL ) ? \
+											oidInfo->description : oids[ i ],
+										 &noFiles );
+		}
+	fflush( output );
+	fprintf( stderr, "%ld occurrence%s in %d file%s.\n", noOccurrences,
+			 ( noOccurrences != 1 ) ? "s" : "", noFiles,
+			 ( noFiles != 1 ) ? "s" : "" );
+	if( indexInfo.pathData != NULL )
+		free( indexInfo.pathData );
+	freeFileData( data, dataLength, isMapped );
+
+	return( ( noOccurrences > 0 ) ? EXIT_SUCCESS : EXIT_FAILURE );
+	}
+
+/****************************************************************************
+*																			*
+*								Search Routines								*
+*																			*
+****************************************************************************/
+
+/* Finding the items in a large file that match some condition, for
+   example all occurrences of an OID or all times before a given date,
+   would otherwise require dumping the entire file and searching the
+   output.  Instead, we walk the encoded data reading only the tag and
+   length of each item, descending into constructed and encapsulating
+   items and skipping the contents of primitive ones unless they're a
+   candidate for a match, so that only the items that the query is
+   interested in are decoded.  The query is a comma-separated list of
+   conditions that all have to be true:
+
+	tag=<name|number|[number]>	Tag, e.g. tag=UTCTime, tag=[3]
+	class=universal|application|context|private
+	oid=<name|value>			OID given by name or dotted value
+	time<op><date>				UTCTime or GeneralizedTime, date as
+								YYYY[MM[DD[hh[mm[ss]]]]]
+	int<op><value>				INTEGER or ENUMERATED
+	length<op><value>			Length of the contents
+
+   where <op> is one of =, !=, <, <=, >, >= */
+
+#define FIND_MAX_CONDITIONS	16
+#define FIND_MAX_OIDS		8		/* Max.OIDs with the same name */
+#define FIND_TIME_SIZE		14		/* YYYYMMDDhhmmss */
+#define FIND_MAX_VALUE		256		/* Max.size of value that's read */
+#define FIND_BUFFER_SIZE	1048576	/* Input buffer size */
+
+typedef enum { FIND_TAG, FIND_CLASS, FIND_OID, FIND_TIME, FIND_INT,
+			   FIND_LENGTH } FIND_TYPE;
+
+typedef enum { FIND_EQ, FIND_NE, FIND_LT, FIND_LE, FIND_GT,
+			   FIND_GE } FIND_OP;
+
+typedef struct {
+	FIND_TYPE type;				/* Type of condition */
+	FIND_OP op;					/* Comparison */
+	long value;					/* Tag, class, integer, or length */
+	int tagClass;				/* Class for tag, -1 = any class */
+	char time[ FIND_TIME_SIZE + 1 ];	/* Normalised time */
+	BYTE oid[ FIND_MAX_OIDS ][ MAX_OID_SIZE ];	/* OIDs to match */
+	int oidLength[ FIND_MAX_OIDS ], noOIDs;
+	} FIND_CONDITION;
+
+typedef struct {
+	FIND_CONDITION conditions[ FIND_MAX_CONDITIONS ];
+	int noConditions;
+	int valueType;				/* Universal type needed for values, or -1 */
+	ASN1_ITEM path[ MAX_NESTING_LEVEL + 2 ];	/* Enclosing items */
+	long position;				/* Position in the data */
+	long noMatches;				/* Number of matches found */
+	} FIND_STATE;
+
+/* Parse a comparison operator */
+
+static const char *getFindOp( const char *string, FIND_OP *op )
+	{
+	if( string[ 0 ] == '!' && string[ 1 ] == '=' )
+		{
+		*op = FIND_NE;
+		return( string + 2 );
+		}
+	if( string[ 0 ] == '<' || string[ 0 ] == '>' )
+		{
+		const int isLess = ( string[ 0 ] == '<' ) ? TRUE : FALSE;
+
+		if( string[ 1 ] == '=' )
+			{
+			*op = isLess ? FIND_LE : FIND_GE;
+			return( string + 2 );
+			}
+		*op = isLess ? FIND_LT : FIND_GT;
+		return( string + 1 );
+		}
+	if( string[ 0 ] == '=' )
+		{
+		*op = FIND_EQ;
+		return( string + 1 );
+		}
+
+	return( NULL );
+	}
+
+/* Get the normalised YYYYMMDDhhmmss form of a time value, returning FALSE
+   if it isn't a valid time */
+
+static int getFindTime( char *time, const BYTE *value, const int length,
+						const int isUTCTime )
+	{
+	int digits = 0, i;
+
+	if( isUTCTime )
+		{
+		/* Two-digit years are interpreted as per RFC 5280 */
+		if( length < 10 || !isdigit( value[ 0 ] ) || !isdigit( value[ 1 ] ) )
+			return( FALSE );
+		memcpy( time, ( value[ 0 ] >= '5' ) ? "19" : "20", 2 );
+		digits = 2;
+		}
+	for( i = 0; i < length && digits < FIND_TIME_SIZE; i++ )
+		{
+		if( !isdigit( value[ i ] ) )
+			break;
+		time[ digits++ ] = value[ i ];
+		}
+	if( digits < ( isUTCTime ? 12 : 10 ) )
+		return( FALSE );
+	while( digits < FIND_TIME_SIZE )
+		time[ digits++ ] = '0';
+	time[ FIND_TIME_SIZE ] = '\0';
+
+	return( TRUE );
+	}
+
+/* Parse a tag given by universal type name or number */
+
+static int getFindTag( FIND_CONDITION *condition, const char *string )
+	{
+	int i;
+
+	condition->tagClass = UNIVERSAL;
+	if( *string == '[' )
+		{
+		condition->tagClass = CONTEXT;
+		string++;
+		}
+	if( isdigit( byteToInt( *string ) ) )
+		{
+		/* A bare tag number can be in any class, with class= used to
+		   narrow it down if required */
+		condition->value = atol( string );
+		if( condition->tagClass == UNIVERSAL )
+			condition->tagClass = -1;
+		return( TRUE );
+		}
+	if( condition->tagClass == CONTEXT )
+		return( FALSE );
+	if( !strcmp( string, "OID" ) )
+		{
+		condition->value = OID;
+		return( TRUE );
+		}
+	for( i = 0; i < TAG_MASK; i++ )
+		{
+		const char *name = idstr( i );
+		const char *stringPtr = string;
+
+		/* Compare the names ignoring spaces and case */
+		while( *name && *stringPtr )
+			{
+			if( *name == ' ' )
+				{
+				name++;
+				continue;
+				}
+			if( toupper( byteToInt( *name ) ) != \
+				toupper( byteToInt( *stringPtr ) ) )
+				break;
+			name++;
+			stringPtr++;
+			}
+		if( !*name && !*stringPtr )
+			{
+			condition->value = i;
+			return( TRUE );
+			}
+		}
+
+	return( FALSE );
+	}
+
+/* Parse the query, returning FALSE if it's invalid */
+
+static int parseFindQuery( FIND_STATE *state, const char *query )
+	{
+	memset( state, 0, sizeof( FIND_STATE ) );
+	state->valueType = -1;
+	while( *query )
+		{
+		FIND_CONDITION *condition = &state->conditions[ state->noConditions ];
+		char buffer[ 128 ];
+		const char *value;
+		const char *queryEnd = strchr( query, ',' );
+		int length;
+
+		if( queryEnd == NULL )
+			queryEnd = query + strlen( query );
+		if( state->noConditions >= FIND_MAX_CONDITIONS || \
+			queryEnd <= query || queryEnd - query >= 128 )
+			return( FALSE );
+		length = ( int ) ( queryEnd - query );
+		memcpy( buffer, query, length );
+		buffer[ length ] = '\0';
+		query += length;
+		if( *query == ',' )
+			query++;
+
+		/* Get the condition type and comparison */
+		for( value = buffer; isalpha( byteToInt( *value ) ); value++ );
+		length = value - buffer;
+		if( length == 3 && !strncmp( buffer, "tag", 3 ) )
+			condition->type = FIND_TAG;
+		else
+		if( length == 5 && !strncmp( buffer, "class", 5 ) )
+			condition->type = FIND_CLASS;
+		else
+		if( length == 3 && !strncmp( buffer, "oid", 3 ) )
+			condition->type = FIND_OID;
+		else
+		if( length == 4 && !strncmp( buffer, "time", 4 ) )
+			condition->type = FIND_TIME;
+		else
+		if( length == 3 && !strncmp( buffer, "int", 3 ) )
+			condition->type = FIND_INT;
+		else
+		if( length == 6 && !strncmp( buffer, "length", 6 ) )
+			condition->type = FIND_LENGTH;
+		else
+			return( FALSE );
+		if( ( value = getFindOp( value, &condition->op ) ) == NULL || \
+			!*value )
+			return( FALSE );
+		if( condition->op != FIND_EQ && condition->op != FIND_NE && \
+			condition->type != FIND_TIME && condition->type != FIND_INT && \
+			condition->type != FIND_LENGTH )
+			return( FALSE );
+
+		/* Get the value to compare against */
+		switch( condition->type )
+			{
+			case FIND_TAG:
+				if( !getFindTag( condition, value ) )
+					return( FALSE );
+				break;
+
+			case FIND_CLASS:
+				if( !strcmp( value, "universal" ) )
+					condition->value = UNIVERSAL;
+				else
+				if( !strcmp( value, "application" ) )
+					condition->value = APPLICATION;
+				else
+				if( !strcmp( value, "context" ) )
+					condition->value = CONTEXT;
+				else
+				if( !strcmp( value, "private" ) )
+					condition->value = PRIVATE;
+				else
+					return( FALSE );
+				break;
+
+			case FIND_OID:
+				/* If it's a name, match any of the OIDs with that name */
+				if( !isdigit( byteToInt( *value ) ) )
+					{
+					const OIDINFO *oidInfo;
+
+					for( oidInfo = oidList; oidInfo != NULL && \
+							condition->noOIDs < FIND_MAX_OIDS;
+						 oidInfo = oidInfo->next )
+						{
+						if( strcmp( oidInfo->description, value ) || \
+							oidInfo->oidLength - 2 > INDEX_MAX_KEY )
+							continue;
+						memcpy( condition->oid[ condition->noOIDs ],
+								oidInfo->oid + 2, oidInfo->oidLength - 2 );
+						condition->oidLength[ condition->noOIDs++ ] = \
+								oidInfo->oidLength - 2;
+						}
+					}
+				else
+					{
+					condition->oidLength[ 0 ] = \
+						encodeQueryOID( condition->oid[ 0 ], value );
+					if( condition->oidLength[ 0 ] > 0 )
+						condition->noOIDs = 1;
+					}
+				if( condition->noOIDs <= 0 )
+					return( FALSE );
+				state->valueType = OID;
+				break;
+
+			case FIND_TIME:
+				{
+				char digits[ FIND_TIME_SIZE ];
+				int noDigits = 0;
+
+				for( ; *value && noDigits < FIND_TIME_SIZE; value++ )
+					{
+					if( isdigit( byteToInt( *value ) ) )
+						digits[ noDigits++ ] = *value;
+					else
+					if( !strchr( "-:T ", *value ) )
+						return( FALSE );
+					}
+				if( noDigits < 4 )
+					return( FALSE );
+				memset( condition->time, '0', FIND_TIME_SIZE );
+				memcpy( condition->time, digits, noDigits );
+				state->valueType = UTCTIME;
+				break;
+				}
+
+			case FIND_INT:
+			case FIND_LENGTH:
+				{
+				char *valueEnd;
+
+				condition->value = strtol( value, &valueEnd, 10 );
+				if( *valueEnd || ( condition->type == FIND_LENGTH && \
+								   condition->value < 0 ) )
+					return( FALSE );
+				if( condition->type == FIND_INT )
+					state->valueType = INTEGER;
+				break;
+				}
+			}
+		state->noConditions++;
+		}
+
+	/* Conditions on values of different types can never all be true */
+	if( state->valueType >= 0 )
+		{
+		int i;
+
+		for( i = 0; i < state->noConditions; i++ )
+			{
+			const FIND_CONDITION *condition = &state->conditions[ i ];
+
+			if( ( condition->type == FIND_OID && state->valueType != OID ) || \
+				( condition->type == FIND_TIME && \
+				  state->valueType != UTCTIME ) || \
+				( condition->type == FIND_INT && \
+				  state->valueType != INTEGER ) )
+				return( FALSE );
+			}
+		}
+
+	return( state->noConditions > 0 );
+	}
+
+/* Compare a value against a condition */
+
+static int compareFindValue( const FIND_OP op, const int result )
+	{
+	switch( op )
+		{
+		case FIND_EQ:
+			return( result == 0 );
+		case FIND_NE:
+			return( result != 0 );
+		case FIND_LT:
+			return( result < 0 );
+		case FIND_LE:
+			return( result <= 0 );
+		case FIND_GT:
+			return( result > 0 );
+		case FIND_GE:
+			return( result >= 0 );
+		}
+
+	return( FALSE );
+	}
+
+/* Check whether an item is a candidate for a match based on its tag and
+   length, without looking at its contents */
+
+static int isFindCandidate( const FIND_STATE *state, const ASN1_ITEM *item )
+	{
+	int i;
+
+	/* If the query is on values, only items of the right type can match */
+	if( state->valueType >= 0 )
+		{
+		if( item->id != UNIVERSAL )
+			return( FALSE );
+		if( state->valueType == UTCTIME )
+			{
+			if( item->tag != UTCTIME && item->tag != GENERALIZEDTIME )
+				return( FALSE );
+			}
+		else
+		if( state->valueType == INTEGER )
+			{
+			if( item->tag != INTEGER && item->tag != ENUMERATED )
+				return( FALSE );
+			}
+		else
+			{
+			if( item->tag != state->valueType )
+				return( FALSE );
+			}
+		}
+
+	for( i = 0; i < state->noConditions; i++ )
+		{
+		const FIND_CONDITION *condition = &state->conditions[ i ];
+		int result;
+
+		switch( condition->type )
+			{
+			case FIND_TAG:
+				result = ( item->tag == condition->value && \
+						   ( condition->tagClass < 0 || \
+							 ( item->id & CLASS_MASK ) == \
+												condition->tagClass ) );
+				if( condition->op == FIND_NE )
+					result = !result;
+				if( !result )
+					return( FALSE );
+				break;
+
+			case FIND_CLASS:
+				result = ( ( item->id & CLASS_MASK ) == condition->value );
+				if( condition->op == FIND_NE )
+					result = !result;
+				if( !result )
+					return( FALSE );
+				break;
+
+			case FIND_LENGTH:
+				if( item->indefinite || \
+					!compareFindValue( condition->op,
+								( item->length < condition->value ) ? -1 : \
+								( item->length > condition->value ) ? 1 : 0 ) )
+					return( FALSE );
+				break;
+
+			default:
+				break;
+			}
+		}
+
+	return( TRUE );
+	}
+
+/* Check whether a candidate item's value matches the query */
+
+static int isFindMatch( const FIND_STATE *state, const ASN1_ITEM *item,
+						const BYTE *value, const int length )
+	{
+	char time[ FIND_TIME_SIZE + 1 ];
+	long intValue = 0;
+	int intSign = 0, i;
+
+	/* Decode the value if necessary.  Integers that are too large for a
+	   long are compared by sign */
+	if( state->valueType == UTCTIME && \
+		!getFindTime( time, value, length, ( item->tag == UTCTIME ) ) )
+		return( FALSE );
+	if( state->valueType == INTEGER )
+		{
+		if( length <= 0 )
+			return( FALSE );
+		if( length > ( int ) sizeof( long ) )
+			intSign = ( value[ 0 ] & 0x80 ) ? -1 : 1;
+		else
+			{
+			intValue = ( value[ 0 ] & 0x80 ) ? -1 : 0;
+			for( i = 0; i < length; i++ )
+				intValue = ( long ) ( ( ( unsigned long ) intValue << 8 ) | \
+									  value[ i ] );
+			}
+		}
+
+	for( i = 0; i < state->noConditions; i++ )
+		{
+		const FIND_CONDITION *condition = &state->conditions[ i ];
+		int result = FALSE, j;
+
+		switch( condition->type )
+			{
+			case FIND_OID:
+				for( j = 0; j < condition->noOIDs && !result; j++ )
+					{
+					result = ( length == condition->oidLength[ j ] && \
+							   !memcmp( value, condition->oid[ j ], length ) );
+					}
+				if( condition->op == FIND_NE )
+					result = !result;
+				break;
+
+			case FIND_TIME:
+				result = compareFindValue( condition->op,
+										   strcmp( time, condition->time ) );
+				break;
+
+			case FIND_INT:
+				if( intSign != 0 )
+					result = compareFindValue( condition->op, intSign );
+				else
+					result = compareFindValue( condition->op,
+								( intValue < condition->value ) ? -1 : \
+								( intValue > condition->value ) ? 1 : 0 );
+				break;
+
+			default:
+				result = TRUE;
+			}
+		if( !result )
+			return( FALSE );
+		}
+
+	return( TRUE );
+	}
+
+/* Print a match */
+
+static void printFindMatch( const FIND_STATE *state, const ASN1_ITEM *item,
+							const long position, const BYTE *value,
+							const int length, const int level )
+	{
+	char buffer[ 128 ];
+	int i;
+
+	fprintf( output, "%ld %s", position, getItemName( buffer, item ) );
+	if( state->valueType == OID )
+		{
+		const OIDINFO *oidInfo = getOIDinfo( value, length );
+		int textLength;
+
+		if( oidInfo != NULL )
+			fprintf( output, " %s", oidInfo->description );
+		else
+		if( oidToString( buffer, &textLength, value, length ) )
+			fprintf( output, " (%s)", buffer );
+		}
+	if( state->valueType == UTCTIME )
+		fprintf( output, " '%.*s'", length, value );
+	if( state->valueType == INTEGER )
+		{
+		if( length > ( int ) sizeof( long ) )
+			fprintf( output, " (%d bytes)", length );
+		else
+			{
+			long intValue = ( value[ 0 ] & 0x80 ) ? -1 : 0;
+
+			for( i = 0; i < length; i++ )
+				intValue = ( long ) ( ( ( unsigned long ) intValue << 8 ) | \
+									  value[ i ] );
+			fprintf( output, " %ld", intValue );
+			}
+		}
+	if( level > 0 )
+		{
+		fputs( " (", output );
+		for( i = 0; i < level; i++ )
+			{
+			fprintf( output, "%s%s", ( i > 0 ) ? " > " : "",
+					 getItemName( buffer, &state->path[ i ] ) );
+			}
+		fputc( ')', output );
+		}
+	fputc( '\n', output );
+	}
+
+/* The data is read through a large buffer and the headers decoded from
+   memory, since going through stdio for each byte of each header and for
+   each skipped item costs more than the search itself.  Skipped data that
+   isn't in the buffer is seeked past if possible */
+
+typedef struct {
+	FILE *inFile;				/* Input stream */
+	BYTE *buffer;				/* Data read from the stream */
+	int bufPos, bufEnd;			/* Current position and end of data */
+	} FIND_READER;
+
+/* Make sure that at least the given amount of data is in the buffer,
+   returning FALSE if it's not available */
+
+static int getFindData( FIND_READER *reader, const int length )
+	{
+	int count;
+
+	if( reader->bufEnd - reader->bufPos >= length )
+		return( TRUE );
+	memmove( reader->buffer, reader->buffer + reader->bufPos,
+			 reader->bufEnd - reader->bufPos );
+	reader->bufEnd -= reader->bufPos;
+	reader->bufPos = 0;
+	count = fread( reader->buffer + reader->bufEnd, 1,
+				   FIND_BUFFER_SIZE - reader->bufEnd, reader->inFile );
+	if( count > 0 )
+		reader->bufEnd += count;
+
+	return( ( reader->bufEnd >= length ) ? TRUE : FALSE );
+	}
+
+static int skipFindData( FIND_READER *reader, long length )
+	{
+	const int available = reader->bufEnd - reader->bufPos;
+
+	if( length <= available )
+		{
+		reader->bufPos += ( int ) length;
+		return( TRUE );
+		}
+	length -= available;
+	reader->bufPos = reader->bufEnd = 0;
+	if( length >= FIND_BUFFER_SIZE && \
+		!fseek( reader->inFile, length, SEEK_CUR ) )
+		return( TRUE );
+	while( length > 0 )
+		{
+		const int count = ( int ) min( length, FIND_BUFFER_SIZE );
+
+		if( fread( reader->buffer, 1, count, reader->inFile ) != \
+														( size_t ) count )
+			return( FALSE );
+		length -= count;
+		}
+
+	return( TRUE );
+	}
+
+/* Find the matching items in the data, which has the given length or ends
+   with an EOC if the length is -1.  Returns FALSE if the data can't be
+   decoded */
+
+static int findItems( FIND_STATE *state, FIND_READER *reader, long length,
+					  const int level )
+	{
+	if( level > MAX_NESTING_LEVEL )
+		return( FALSE );
+	while( length > 0 || length == -1 )
+		{
+		ASN1_ITEM *item = &state->path[ level ];
+		const long itemPosition = state->position;
+		long contentLength;
+
+		/* Get the next item.  Running out of data is OK at the top level */
+		if( !getFindData( reader, 16 ) && \
+			reader->bufPos >= reader->bufEnd && length == -1 && level <= 0 )
+			return( TRUE );
+		if( getMemItem( reader->buffer + reader->bufPos,
+						reader->bufEnd - reader->bufPos, item ) <= 0 )
+			return( FALSE );
+		reader->bufPos += item->headerSize;
+		state->position += item->headerSize;
+		if( length != -1 )
+			{
+			if( item->headerSize > length )
+				return( FALSE );
+			length -= item->headerSize;
+			}
+		if( item->indefinite )
+			{
+			if( ( item->id & FORM_MASK ) != CONSTRUCTED )
+				return( FALSE );
+			contentLength = -1;
+			}
+		else
+			{
+			contentLength = item->length;
+			if( length != -1 )
+				{
+				if( contentLength > length )
+					return( FALSE );
+				length -= contentLength;
+				}
+			}
+
+		/* If it's an EOC, we've reached the end of an indefinite-length
+		   item */
+		if( item->id == UNIVERSAL && item->tag == EOC && \
+			item->headerSize == 2 && item->length == 0 )
+			{
+			if( length == -1 && level > 0 )
+				return( TRUE );
+			continue;
+			}
+
+		/* If it's a candidate, check whether it matches.  Only primitive
+		   items of the type that the query is interested in have their
+		   contents looked at, and for integers only enough to tell their
+		   sign if they're too large to compare */
+		if( isFindCandidate( state, item ) )
+			{
+			if( state->valueType < 0 )
+				{
+				printFindMatch( state, item, itemPosition, NULL, 0, level );
+				state->noMatches++;
+				}
+			else
+			if( !item->indefinite && \
+				( item->id & FORM_MASK ) != CONSTRUCTED )
+				{
+				const int valueLength = ( int ) min( contentLength,
+													 FIND_MAX_VALUE );
+				const BYTE *value;
+
+				if( !getFindData( reader, valueLength ) )
+					return( FALSE );
+				value = reader->buffer + reader->bufPos;
+				if( ( valueLength == contentLength || \
+					  state->valueType == INTEGER ) && \
+					isFindMatch( state, item, value, ( int ) item->length ) )
+					{
+					printFindMatch( state, item, itemPosition, value,
+									( int ) item->length, level );
+					state->noMatches++;
+					}
+				if( !skipFindData( reader, contentLength ) )
+					return( FALSE );
+				state->position += contentLength;
+				continue;
+				}
+			}
+
+		/* If it's constructed, look for matches inside it */
+		if( ( item->id & FORM_MASK ) == CONSTRUCTED )
+			{
+			if( !findItems( state, reader, contentLength, level + 1 ) )
+				return( FALSE );
+			continue;
+			}
+
+		/* If it's a BIT STRING or OCTET STRING that encapsulates a
+		   constructed item, look for matches inside that.  We only check
+		   the header of the encapsulated item, which is enough to tell
+		   whether it spans the rest of the string */
+		if( checkEncaps && item->id == UNIVERSAL && contentLength > 2 && \
+			( item->tag == OCTETSTRING || item->tag == BITSTRING ) && \
+			level < MAX_NESTING_LEVEL )
+			{
+			ASN1_ITEM *nestedItem = &state->path[ level + 1 ];
+			const int unusedBitsSize = ( item->tag == BITSTRING ) ? 1 : 0;
+			const long encapsLength = contentLength - unusedBitsSize;
+			const BYTE *encaps;
+			int available;
+
+			getFindData( reader, ( int ) min( contentLength, 16 ) );
+			encaps = reader->buffer + reader->bufPos;
+			available = reader->bufEnd - reader->bufPos - unusedBitsSize;
+			if( available > 0 && ( !unusedBitsSize || encaps[ 0 ] == 0 ) && \
+				getMemItem( encaps + unusedBitsSize,
+							min( encapsLength, available ),
+							nestedItem ) > 0 && \
+				( nestedItem->id & FORM_MASK ) == CONSTRUCTED && \
+				!nestedItem->indefinite && \
+				nestedItem->headerSize + nestedItem->length == encapsLength )
+				{
+				reader->bufPos += unusedBitsSize;
+				state->position += unusedBitsSize;
+				if( !findItems( state, reader, encapsLength, level + 1 ) )
+					return( FALSE );
+				continue;
+				}
+			}
+
+		/* It's a primitive item that can't contain any matches, skip it */
+		if( !skipFindData( reader, contentLength ) )
+			return( FALSE );
+		state->position += contentLength;
+		}
+
+	return( TRUE );
+	}
+
+static int doFind( FILE *inFile, const char *query, const long offset )
+	{
+	FIND_STATE state;
+	FIND_READER reader;
+
+	if( !parseFindQuery( &state, query ) )
+		{
+		puts( "Invalid search query." );
+		return( EXIT_FAILURE );
+		}
+	memset( &reader, 0, sizeof( FIND_READER ) );
+	reader.inFile = inFile;
+	if( ( reader.buffer = ( BYTE * ) malloc( FIND_BUFFER_SIZE ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return( EXIT_FAILURE );
+		}
+	state.position = offset;
+	if( !findItems( &state, &reader, -1, 0 ) )
+		{
+		fflush( output );
+		fprintf( stderr, "Error: Search stopped due to invalid data at "
+				 "position %ld.\n", state.position );
+		}
+	free( reader.buffer );
+	fflush( output );
+	fprintf( stderr, "%ld match%s.\n", state.noMatches,
+			 ( state.noMatches != 1 ) ? "es" : "" );
+
+	return( ( state.noMatches > 0 ) ? EXIT_SUCCESS : EXIT_FAILURE );
+	}
+
+/****************************************************************************
+*																			*
+*								Batch Dump Routines							*
+*																			*
+****************************************************************************/
+
+#ifdef USE_THREADS
+
+/* When a large collection of objects is dumped, the same objects,
+   typically roots and intermediates, turn up over and over again.  Rather
+   than decoding each of these again, we keep the rendered output and the
+   error and warning counts for recently-dumped objects in an LRU cache
+   indexed by the object's fingerprint and emit the cached output when the
+   object turns up again.
+
+   Repeated subtrees like AlgorithmIdentifiers and Names are far more
+   common than repeated objects, but their rendered output depends on their
+   position in the data, their nesting level, and the decoding state built
+   up by the items that precede them, so it can't be reused in the same
+   way.  Instead, we fingerprint every constructed item in each object that
+   we decode and report how much of the data consists of repeats of
+   earlier subtrees, with the contents of a repeated subtree not being
+   fingerprinted again */
+
+/* A fast 128-bit fingerprint of a block of data, used to recognise objects
+   and subtrees that have been seen before.  This is MurmurHash3's 32-bit
+   x86 128-bit variant, seeded with the data length, which isn't
+   cryptographically strong but is several times faster than SHA-256 and
+   is more than enough to tell apart the objects in a corpus */
+
+#define ROTL32( x, n )	MASK32( ( ( x ) << ( n ) ) | ( MASK32( x ) >> ( 32 - ( n ) ) ) )
+
+static UINT32 fingerprintMix( UINT32 hash )
+	{
+	hash = MASK32( hash );
+	hash ^= hash >> 16;
+	hash = MASK32( hash * 0x85EBCA6BUL );
+	hash ^= hash >> 13;
+	hash = MASK32( hash * 0xC2B2AE35UL );
+
+	return( hash ^ ( hash >> 16 ) );
+	}
+
+static void fingerprint( const BYTE *data, const long length,
+						 UINT32 *hash )
+	{
+	static const UINT32 c[ 4 ] = { 0x239B961BUL, 0xAB0E9789UL,
+								   0x38B34AE5UL, 0xA1E38B93UL };
+	static const UINT32 add[ 4 ] = { 0x561CCD1BUL, 0x0BCAA747UL,
+									 0x96CD1C35UL, 0x32AC3B17UL };
+	static const int rot[ 4 ] = { 15, 16, 17, 18 }, rotH[ 4 ] = { 19, 17, 15, 13 };
+	BYTE tail[ 16 ];
+	long position;
+	int i;
+
+	hash[ 0 ] = hash[ 1 ] = hash[ 2 ] = hash[ 3 ] = MASK32( length );
+	for( position = 0; position + 16 <= length; position += 16 )
+		{
+		for( i = 0; i < 4; i++ )
+			{
+			const BYTE *block = data + position + ( i * 4 );
+			UINT32 k = ( UINT32 ) block[ 0 ] | ( ( UINT32 ) block[ 1 ] << 8 ) | \
+					   ( ( UINT32 ) block[ 2 ] << 16 ) | \
+					   ( ( UINT32 ) block[ 3 ] << 24 );
+
+			k = MASK32( k * c[ i ] );
+			k = ROTL32( k, rot[ i ] );
+			hash[ i ] ^= MASK32( k * c[ ( i + 1 ) & 3 ] );
+			hash[ i ] = ROTL32( hash[ i ], rotH[ i ] );
+			hash[ i ] = MASK32( hash[ i ] + hash[ ( i + 1 ) & 3 ] );
+			hash[ i ] = MASK32( ( hash[ i ] * 5 ) + add[ i ] );
+			}
+		}
+
+	/* Process any remaining data as a zero-padded block, without the
+	   additive step */
+	if( position < length )
+		{
+		memset( tail, 0, 16 );
+		memcpy( tail, data + position, length - position );
+		for( i = 0; i < 4; i++ )
+			{
+			UINT32 k = ( UINT32 ) tail[ i * 4 ] | \
+					   ( ( UINT32 ) tail[ ( i * 4 ) + 1 ] << 8 ) | \
+					   ( ( UINT32 ) tail[ ( i * 4 ) + 2 ] << 16 ) | \
+					   ( ( UINT32 ) tail[ ( i * 4 ) + 3 ] << 24 );
+
+			k = MASK32( k * c[ i ] );
+			k = ROTL32( k, rot[ i ] );
+			hash[ i ] ^= MASK32( k * c[ ( i + 1 ) & 3 ] );
+			}
+		}
+
+	/* Finalise the hash */
+	for( i = 1; i < 4; i++ )
+		hash[ 0 ] = MASK32( hash[ 0 ] + hash[ i ] );
+	for( i = 1; i < 4; i++ )
+		hash[ i ] = MASK32( hash[ i ] + hash[ 0 ] );
+	for( i = 0; i < 4; i++ )
+		hash[ i ] = fingerprintMix( hash[ i ] );
+	for( i = 1; i < 4; i++ )
+		hash[ 0 ] = MASK32( hash[ 0 ] + hash[ i ] );
+	for( i = 1; i < 4; i++ )
+		hash[ i ] = MASK32( hash[ i ] + hash[ 0 ] );
+	}
+
+#define BATCH_CACHE_SIZE	1024	/* Default no.objects cached */
+#define SUBTREE_TABLE_SIZE	262144	/* No.subtree fingerprints stored */
+#define SUBTREE_MIN_SIZE	8		/* Min.size of subtree to fingerprint */
+
+typedef struct {
+	UINT32 hash[ 4 ];			/* Object fingerprint */
+	long dataLength;			/* Object size */
+	char *text;					/* Rendered output */
+	size_t textLength;
+	int noErrors, noWarnings;	/* Errors and warnings from decoding */
+	int prev, next;				/* LRU list, most recently used first */
+	int hashNext;				/* Next entry in hash chain */
+	} BATCH_CACHE_ENTRY;
+
+typedef struct {
+	BATCH_CACHE_ENTRY *entries;	/* Cached objects */
+	int noEntries, maxEntries;
+	int *buckets;				/* Hash chains, -1 = empty */
+	int noBuckets;
+	int first, last;			/* Most and least recently used entry */
+	long noHits, noMisses;		/* Cache statistics */
+	long bytesSaved, bytesDecoded;
+	} BATCH_CACHE;
+
+typedef struct {
+	UINT32 *hashes;				/* Subtree fingerprints, 4 words each */
+	int noHashes;
+	long noSubtrees, noRepeats;	/* Subtree statistics */
+	long repeatBytes;
+	} SUBTREE_STATS;
+
+static int batchCacheSize = BATCH_CACHE_SIZE;	/* No.objects cached */
+
+/* Look up an object in the cache, returning the entry for it or -1 if
+   it's not present */
+
+static int findCacheEntry( const BATCH_CACHE *cache, const UINT32 *hash,
+						   const long dataLength )
+	{
+	int index;
+
+	if( cache->noBuckets <= 0 )
+		return( -1 );
+	for( index = cache->buckets[ hash[ 0 ] & ( cache->noBuckets - 1 ) ];
+		 index >= 0; index = cache->entries[ index ].hashNext )
+		{
+		const BATCH_CACHE_ENTRY *entry = &cache->entries[ index ];
+
+		if( entry->dataLength == dataLength && \
+			!memcmp( entry->hash, hash, 4 * sizeof( UINT32 ) ) )
+			return( index );
+		}
+
+	return( -1 );
+	}
+
+/* Move an entry to the front of the LRU list, or remove it from the
+   list */
+
+static void unlinkCacheEntry( BATCH_CACHE *cache, const int index )
+	{
+	BATCH_CACHE_ENTRY *entry = &cache->entries[ index ];
+
+	if( entry->prev >= 0 )
+		cache->entries[ entry->prev ].next = entry->next;
+	else
+		cache->first = entry->next;
+	if( entry->next >= 0 )
+		cache->entries[ entry->next ].prev = entry->prev;
+	else
+		cache->last = entry->prev;
+	entry->prev = entry->next = -1;
+	}
+
+static void touchCacheEntry( BATCH_CACHE *cache, const int index )
+	{
+	BATCH_CACHE_ENTRY *entry = &cache->entries[ index ];
+
+	if( cache->first == index )
+		return;
+	unlinkCacheEntry( cache, index );
+	entry->next = cache->first;
+	if( cache->first >= 0 )
+		cache->entries[ cache->first ].prev = index;
+	cache->first = index;
+	if( cache->last < 0 )
+		cache->last = index;
+	}
+
+/* Add an object's rendered output to the cache, replacing the least
+   recently used object if the cache is full.  The cache takes ownership
+   of the text */
+
+static void addCacheEntry( BATCH_CACHE *cache, const UINT32 *hash,
+						   const long dataLength, char *text,
+						   const size_t textLength, const int noErrors,
+						   const int noWarnings )
+	{
+	BATCH_CACHE_ENTRY *entry;
+	int index, *bucket;
+
+	if( cache->maxEntries <= 0 )
+		{
+		free( text );
+		return;
+		}
+	if( cache->noEntries < cache->maxEntries )
+		index = cache->noEntries++;
+	else
+		{
+		/* Evict the least recently used object */
+		index = cache->last;
+		entry = &cache->entries[ index ];
+		unlinkCacheEntry( cache, index );
+		for( bucket = &cache->buckets[ entry->hash[ 0 ] & \
+									   ( cache->noBuckets - 1 ) ];
+			 *bucket != index; bucket = &cache->entries[ *bucket ].hashNext );
+		*bucket = entry->hashNext;
+		free( entry->text );
+		}
+	entry = &cache->entries[ index ];
+	memcpy( entry->hash, hash, 4 * sizeof( UINT32 ) );
+	entry->dataLength = dataLength;
+	entry->text = text;
+	entry->textLength = textLength;
+	entry->noErrors = noErrors;
+	entry->noWarnings = noWarnings;
+	entry->prev = entry->next = -1;
+	bucket = &cache->buckets[ hash[ 0 ] & ( cache->noBuckets - 1 ) ];
+	entry->hashNext = *bucket;
+	*bucket = index;
+	touchCacheEntry( cache, index );
+	}
+
+/* Fingerprint the constructed items in an object, recording the ones that
+   repeat earlier ones */
+
+static void fingerprintSubtrees( SUBTREE_STATS *stats, const BYTE *data,
+								 long dataLength, const int level )
+	{
+	while( dataLength > 0 )
+		{
+		const BYTE *content;
+		ASN1_ITEM item;
+		long size, contentLength;
+
+		if( ( size = getMemObjectSize( data, dataLength, &item, level ) ) <= 0 )
+			break;
+		content = data + item.headerSize;
+		contentLength = size - item.headerSize - ( item.indefinite ? 2 : 0 );
+		if( ( item.id & FORM_MASK ) != CONSTRUCTED )
+			content = getMemEncapsulated( content, &contentLength, &item,
+										  level );
+		if( content != NULL && size >= SUBTREE_MIN_SIZE )
+			{
+			UINT32 hash[ 4 ];
+			int slot, isRepeat = FALSE;
+
+			/* Look for the subtree in the table of ones seen so far,
+			   adding it if it's not present and there's room */
+			fingerprint( data, size, hash );
+			stats->noSubtrees++;
+			slot = hash[ 0 ] & ( SUBTREE_TABLE_SIZE - 1 );
+			while( TRUE )
+				{
+				const UINT32 *slotHash = stats->hashes + ( slot * 4 );
+
+				if( !( slotHash[ 0 ] | slotHash[ 1 ] | slotHash[ 2 ] | \
+					   slotHash[ 3 ] ) )
+					{
+					if( stats->noHashes < ( SUBTREE_TABLE_SIZE / 4 ) * 3 )
+						{
+						memcpy( stats->hashes + ( slot * 4 ), hash,
+								4 * sizeof( UINT32 ) );
+						stats->noHashes++;
+						}
+					break;
+					}
+				if( !memcmp( slotHash, hash, 4 * sizeof( UINT32 ) ) )
+					{
+					isRepeat = TRUE;
+					break;
+					}
+				slot = ( slot + 1 ) & ( SUBTREE_TABLE_SIZE - 1 );
+				}
+
+			/* If it's a repeat, there's no need to look inside it */
+			if( isRepeat )
+				{
+				stats->noRepeats++;
+				stats->repeatBytes += size;
+				}
+			else
+				fingerprintSubtrees( stats, content, contentLength,
+									 level + 1 );
+			}
+		data += size;
+		dataLength -= size;
+		}
+	}
+
+/* Decode an object, capturing the output */
+
+static int dumpBatchObject( const BYTE *data, const long dataLength,
+							char **text, size_t *textLength )
+	{
+	FILE *savedOutput = output;
+	FILE *volatile inFile;
+	jmp_buf abortEnv;
+
+	*text = NULL;
+	*textLength = 0;
+	if( ( output = open_memstream( text, textLength ) ) == NULL )
+		{
+		output = savedOutput;
+		return( FALSE );
+		}
+	fPos = 0;
+	infoWidth = 4;
+	noErrors = noWarnings = 0;
+	if( ( inFile = openMemStream( data, dataLength ) ) != NULL )
+		{
+		workerAbort = &abortEnv;
+		if( !setjmp( abortEnv ) )
+			{
+			printAsn1( inFile, 0, LENGTH_MAGIC, 0 );
+			checkTrailingData( inFile );
+			}
+		else
+			{
+			fprintf( output, "\nError: Decoding stopped due to invalid data "
+					 "at position %d.\n", fPos );
+			noErrors++;
+			}
+		workerAbort = NULL;
+		fclose( inFile );
+		}
+	fclose( output );
+	output = savedOutput;
+
+	return( ( inFile != NULL && *text != NULL ) ? TRUE : FALSE );
+	}
+
+/* Dump the objects in a collection of files */
+
+static int doBatch( char *paths[], const int noPaths )
+	{
+	FILE_LIST fileList;
+	FILE_READER reader;
+	BATCH_CACHE cache;
+	SUBTREE_STATS stats;
+	long totalErrors = 0, totalWarnings = 0;
+	int noFailed = 0, i;
+
+	/* Build the list of files, sorted so that the output order is stable */
+	memset( &fileList, 0, sizeof( FILE_LIST ) );
+	for( i = 0; i < noPaths; i++ )
+		{
+		if( !addInventoryPath( &fileList, paths[ i ] ) )
+			{
+			puts( "Out of memory." );
+			return( EXIT_FAILURE );
+			}
+		}
+	if( fileList.noNames > 1 )
+		qsort( fileList.names, fileList.noNames, sizeof( char * ),
+			   compareFileNames );
+
+	/* Set up the cache and the subtree fingerprint table */
+	memset( &cache, 0, sizeof( BATCH_CACHE ) );
+	memset( &stats, 0, sizeof( SUBTREE_STATS ) );
+	cache.first = cache.last = -1;
+	cache.maxEntries = batchCacheSize;
+	if( cache.maxEntries > 0 )
+		{
+		for( cache.noBuckets = 16; cache.noBuckets < cache.maxEntries;
+			 cache.noBuckets <<= 1 );
+		cache.entries = ( BATCH_CACHE_ENTRY * ) \
+					malloc( cache.maxEntries * sizeof( BATCH_CACHE_ENTRY ) );
+		cache.buckets = ( int * ) malloc( cache.noBuckets * sizeof( int ) );
+		}
+	stats.hashes = ( UINT32 * ) \
+					calloc( SUBTREE_TABLE_SIZE, 4 * sizeof( UINT32 ) );
+	if( stats.hashes == NULL || ( cache.maxEntries > 0 && \
+		( cache.entries == NULL || cache.buckets == NULL ) ) )
+		{
+		puts( "Out of memory." );
+		exit( EXIT_FAILURE );
+		}
+	for( i = 0; i < cache.noBuckets; i++ )
+		cache.buckets[ i ] = -1;
+
+	openFileReader( &reader, fileList.names, fileList.noNames );
+	for( i = 0; i < fileList.noNames; i++ )
+		{
+		const char *fileName = fileList.names[ i ];
+		const BYTE *data;
+		UINT32 hash[ 4 ];
+		char *text;
+		size_t textLength;
+		long dataLength;
+		int index, objectErrors, objectWarnings;
+
+		if( ( data = readNextFile( &reader, &dataLength ) ) == NULL )
+			{
+			reportReadError( fileName );
+			noFailed++;
+			continue;
+			}
+		fprintf( output, "%s%s:\n", ( i > 0 ) ? "\n" : "", fileName );
+
+		/* If we've seen the object before, emit the cached output */
+		fingerprint( data, dataLength, hash );
+		if( ( index = findCacheEntry( &cache, hash, dataLength ) ) >= 0 )
+			{
+			const BATCH_CACHE_ENTRY *entry = &cache.entries[ index ];
+
+			fwrite( entry->text, 1, entry->textLength, output );
+			objectErrors = entry->noErrors;
+			objectWarnings = entry->noWarnings;
+			touchCacheEntry( &cache, index );
+			cache.noHits++;
+			cache.bytesSaved += dataLength;
+			}
+		else
+			{
+			/* Decode the object and add the output to the cache */
+			if( !dumpBatchObject( data, dataLength, &text, &textLength ) )
+				{
+				puts( "Out of memory." );
+				exit( EXIT_FAILURE );
+				}
+			fwrite( text, 1, textLength, output );
+			objectErrors = noErrors;
+			objectWarnings = noWarnings;
+			addCacheEntry( &cache, hash, dataLength, text, textLength,
+						   objectErrors, objectWarnings );
+			fingerprintSubtrees( &stats, data, dataLength, 0 );
+			cache.noMisses++;
+			cache.bytesDecoded += dataLength;
+			}
+		fprintf( output, "\n%d warning%s, %d error%s.\n", objectWarnings,
+				 ( objectWarnings != 1 ) ? "s" : "", objectErrors,
+				 ( objectErrors != 1 ) ? "s" : "" );
+		if( objectErrors > 0 )
+			noFailed++;
+		totalErrors += objectErrors;
+		totalWarnings += objectWarnings;
+		}
+	closeFileReader( &reader );
+	fflush( output );
+
+	/* Report the results and how effective the cache was */
+	fprintf( stderr, "%ld error%s, %ld warning%s, %d of %d file%s failed.\n",
+			 totalErrors, ( totalErrors != 1 ) ? "s" : "",
+			 totalWarnings, ( totalWarnings != 1 ) ? "s" : "",
+			 noFailed, fileList.noNames, ( fileList.noNames != 1 ) ? "s" : "" );
+	if( cache.noHits + cache.noMisses > 0 )
+		{
+		fprintf( stderr, "Cache: %ld of %ld object%s (%.1f%%) from cache, "
+				 "%ld bytes not decoded.\n", cache.noHits,
+				 cache.noHits + cache.noMisses,
+				 ( cache.noHits + cache.noMisses != 1 ) ? "s" : "",
+				 ( cache.noHits * 100.0 ) / \
+						( cache.noHits + cache.noMisses ), cache.bytesSaved );
+		}
+	if( cache.bytesDecoded > 0 )
+		{
+		fprintf( stderr, "Subtrees: %ld of %ld constructed items repeat "
+				 "earlier ones, %ld bytes (%.1f%%) of the decoded data.\n",
+				 stats.noRepeats, stats.noSubtrees, stats.repeatBytes,
+				 ( stats.repeatBytes * 100.0 ) / cache.bytesDecoded );
+		}
+
+	/* Clean up */
+	for( i = 0; i < cache.noEntries; i++ )
+		free( cache.entries[ i ].text );
+	if( cache.entries != NULL )
+		free( cache.entries );
+	if( cache.buckets != NULL )
+		free( cache.buckets );
+	free( stats.hashes );
+	for( i = 0; i < fileList.noNames; i++ )
+		free( fileList.names[ i ] );
+	if( fileList.names != NULL )
+		free( fileList.names );
+
+	return( ( noFailed > 0 ) ? EXIT_FAILURE : EXIT_SUCCESS );
+	}
+#endif /* USE_THREADS */
+
+/****************************************************************************
+*																			*
+*						Fuzzing and Benchmark Routines						*
+*																			*
+****************************************************************************/
+
+/* When built with -D FUZZER, dumpasn1 provides a libFuzzer entry point in
+   place of main(), which decodes each input from memory with the output
+   going to the null device.  The first byte of each input selects the
+   display options to use, so that the code for each option gets
+   exercised.  Building with 'clang -g -O1 -fsanitize=fuzzer,address -D
+   FUZZER dumpasn1.c' and running the result with a directory created with
+   --make-corpus as the corpus will fuzz the decoder */
+
+#define FUZZ_OPTION_PURE		0x01
+#define FUZZ_OPTION_TEXT		0x02
+#define FUZZ_OPTION_ALLDATA		0x04
+#define FUZZ_OPTION_NOENCAPS	0x08
+#define FUZZ_OPTION_HEXVALUES	0x10
+#define FUZZ_OPTION_HEADER		0x20
+#define FUZZ_OPTION_SHALLOW		0x40
+#define FUZZ_OPTION_OIDINFO		0x80
+
+#ifdef FUZZER
+
+#ifndef USE_THREADS
+  #error The fuzz target requires memory streams and fatal-error recovery
+#endif /* USE_THREADS */
+
+int LLVMFuzzerInitialize( int *argc, char ***argv )
+	{
+	/* Read the config file from the usual locations so that the OID
+	   handling gets exercised */
+	if( ( nullOutput = fopen( NULL_DEVICE, "w" ) ) == NULL )
+		{
+		perror( NULL_DEVICE );
+		exit( EXIT_FAILURE );
+		}
+	output = nullOutput;
+	if( !readGlobalConfig( ( *argv )[ 0 ] ) || !buildOIDtrie() )
+		exit( EXIT_FAILURE );
+
+	return( 0 );
+	}
+
+int LLVMFuzzerTestOneInput( const BYTE *data, size_t size )
+	{
+	jmp_buf abortEnv;
+	FILE *inFile;
+	int options;
+
+	if( size < 2 || size > INT_MAX )
+		return( 0 );
+	options = *data++;
+	size--;
+
+	/* Set up the display options and parse state for this input */
+	doPure = ( options & FUZZ_OPTION_PURE ) ? TRUE : FALSE;
+	dumpText = ( options & FUZZ_OPTION_TEXT ) ? TRUE : FALSE;
+	printAllData = ( options & FUZZ_OPTION_ALLDATA ) ? TRUE : FALSE;
+	checkEncaps = ( options & FUZZ_OPTION_NOENCAPS ) ? FALSE : TRUE;
+	doHexValues = ( options & FUZZ_OPTION_HEXVALUES ) ? TRUE : FALSE;
+	doDumpHeader = ( options & FUZZ_OPTION_HEADER ) ? 2 : FALSE;
+	shallowIndent = ( options & FUZZ_OPTION_SHALLOW ) ? TRUE : FALSE;
+	extraOIDinfo = ( options & FUZZ_OPTION_OIDINFO ) ? TRUE : FALSE;
+	fPos = 0;
+	infoWidth = 4;
+	noErrors = noWarnings = 0;
+
+	/* Decode the data, returning to here on a fatal error */
+	if( ( inFile = openMemStream( data, size ) ) == NULL )
+		return( 0 );
+	workerAbort = &abortEnv;
+	if( !setjmp( abortEnv ) )
+		{
+		printAsn1( inFile, 0, LENGTH_MAGIC, 0 );
+		checkTrailingData( inFile );
+		}
+	workerAbort = NULL;
+	fclose( inFile );
+
+	return( 0 );
+	}
+#endif /* FUZZER */
+
+/* Create a seed corpus for the fuzzer from the objects in a set of files.
+   Each object and each definite-length constructed item within it is
+   written to a file named after its SHA-256 hash, which weeds out
+   duplicates, preceded by the byte that selects the default display
+   options */
+
+typedef struct {
+	const char *dirName;		/* Corpus directory */
+	int noSeeds;				/* Number of seeds written */
+	} CORPUS_INFO;
+
+static int writeCorpusSeed( CORPUS_INFO *corpusInfo, const BYTE *data,
+							const long dataLength )
+	{
+	static const BYTE options = 0;
+	BYTE hash[ SHA256_DIGEST_SIZE ];
+	char fileName[ FILENAME_MAX ];
+	FILE *seedFile;
+	int length, i;
+
+	sha256( data, dataLength, hash );
+	length = sprintf( fileName, "%.*s/", FILENAME_MAX - 80,
+					  corpusInfo->dirName );
+	for( i = 0; i < SHA256_DIGEST_SIZE; i++ )
+		length += sprintf( fileName + length, "%02x", hash[ i ] );
+	if( ( seedFile = fopen( fileName, "rb" ) ) != NULL )
+		{
+		/* We've already got this one */
+		fclose( seedFile );
+		return( TRUE );
+		}
+	if( ( seedFile = fopen( fileName, "wb" ) ) == NULL )
+		{
+		perror( fileName );
+		return( FALSE );
+		}
+	fwrite( &options, 1, 1, seedFile );
+	fwrite( data, 1, dataLength, seedFile );
+	if( fclose( seedFile ) )
+		{
+		perror( fileName );
+		return( FALSE );
+		}
+	corpusInfo->noSeeds++;
+
+	return( TRUE );
+	}
+
+static int addCorpusItems( CORPUS_INFO *corpusInfo, const BYTE *data,
+						   long dataLength, const int level )
+	{
+	while( dataLength > 0 && level <= MAX_NESTING_LEVEL )
+		{
+		const BYTE *itemStart = data;
+		const BYTE *content;
+		ASN1_ITEM item;
+
+		if( ( content = getNextMemItem( &data, &dataLength, &item ) ) == NULL )
+			break;
+		if( ( item.id & FORM_MASK ) == CONSTRUCTED )
+			{
+			if( !writeCorpusSeed( corpusInfo, itemStart, data - itemStart ) || \
+				!addCorpusItems( corpusInfo, content, item.length, level + 1 ) )
+				return( FALSE );
+			}
+		}
+
+	return( TRUE );
+	}
+
+static int addCorpusObject( void *arg, const BYTE *data,
+							const long dataLength )
+	{
+	CORPUS_INFO *corpusInfo = ( CORPUS_INFO * ) arg;
+
+	/* Add the object as a whole, which may be non-DER or contain trailing
+	   data, and then any constructed items within it */
+	if( !writeCorpusSeed( corpusInfo, data, dataLength ) )
+		return( FALSE );
+	return( addCorpusItems( corpusInfo, data, dataLength, 0 ) );
+	}
+
+static int makeCorpus( const char *dirName, char *paths[],
+					   const int noPaths )
+	{
+	CORPUS_INFO corpusInfo;
+	FILE_LIST fileList;
+	int i;
+
+	memset( &fileList, 0, sizeof( FILE_LIST ) );
+	for( i = 0; i < noPaths; i++ )
+		{
+		if( !addInventoryPath( &fileList, paths[ i ] ) )
+			{
+			perror( paths[ i ] );
+			return( EXIT_FAILURE );
+			}
+		}
+	memset( &corpusInfo, 0, sizeof( CORPUS_INFO ) );
+	corpusInfo.dirName = dirName;
+	for( i = 0; i < fileList.noNames; i++ )
+		{
+		BYTE *data;
+		long dataLength;
+
+		if( ( data = readFileData( fileList.names[ i ], &dataLength ) ) == NULL )
+			continue;
+		processObjects( data, dataLength, FALSE, addCorpusObject,
+						&corpusInfo );
+		free( data );
+		}
+	for( i = 0; i < fileList.noNames; i++ )
+		free( fileList.names[ i ] );
+	if( fileList.names != NULL )
+		free( fileList.names );
+	fprintf( stderr, "%d seed%s written to %s.\n", corpusInfo.noSeeds,
+			 ( corpusInfo.noSeeds != 1 ) ? "s" : "", dirName );
+
+	return( EXIT_SUCCESS );
+	}
+
+/* The benchmark generates synthetic objects that stress different parts of
+   the decoder and times how long it takes to dump them with each of the
+   output modes, with the output going to the null device.  Each object is
+   around benchmarkSize MB in size */
+
+#define BENCH_NESTING_DEPTH		64	/* Depth of nested objects */
+#define BENCH_STRING_LENGTH		32	/* Length of BMPStrings in chars */
+#define BENCH_MIN_TIME			0.25/* Min.time for each measurement */
+
+typedef struct {
+	BYTE *buffer;				/* Encoded data */
+	long length, maxLength;		/* Current and maximum length */
+	long noItems;				/* Number of items encoded */
+	} BENCH_DATA;
+
+typedef struct {
+	const char *name;			/* Name of mode */
+	int doPure, doHexValues, dumpText, printAllData;	/* Options */
+	} BENCH_MODE;
+
+static const BENCH_MODE benchModes[] = {
+	{ "default", FALSE, FALSE, FALSE, FALSE },
+	{ "-p", TRUE, FALSE, FALSE, FALSE },
+	{ "-x", FALSE, TRUE, FALSE, FALSE },
+	{ "-t", FALSE, FALSE, TRUE, FALSE },
+	{ "-a", FALSE, FALSE, FALSE, TRUE },
+	{ NULL, FALSE, FALSE, FALSE, FALSE }
+	};
+
+static int benchmarkSize = 4;		/* Size of each object in MB */
+
+/* Get the current time in seconds */
+
+static double getTime( void )
+	{
+#if defined( __UNIX__ ) && defined( CLOCK_MONOTONIC )
+	struct timespec timeValue;
+
+	clock_gettime( CLOCK_MONOTONIC, &timeValue );
+	return( timeValue.tv_sec + timeValue.tv_nsec / 1000000000.0 );
+#else
+	return( ( double ) clock() / CLOCKS_PER_SEC );
+#endif /* __UNIX__ && CLOCK_MONOTONIC */
+	}
+
+/* Add a tag and length to the encoded data, using the minimal length
+   encoding */
+
+static void addBenchHeader( BENCH_DATA *benchData, const int tag,
+							const long length )
+	{
+	BYTE *bufPtr = benchData->buffer + benchData->length;
+	int lengthSize = 0, i;
+
+	*bufPtr++ = tag;
+	if( length < 128 )
+		*bufPtr++ = ( BYTE ) length;
+	else
+		{
+		for( i = 0; ( length >> ( i * 8 ) ) > 0; i++ )
+			lengthSize++;
+		*bufPtr++ = 0x80 | lengthSize;
+		for( i = lengthSize - 1; i >= 0; i-- )
+			*bufPtr++ = ( BYTE ) ( length >> ( i * 8 ) );
+		}
+	benchData->length = bufPtr - benchData->buffer;
+	benchData->noItems++;
+	}
+
+static void addBenchData( BENCH_DATA *benchData, const BYTE *data,
+						  const long length )
+	{
+	memcpy( benchData->buffer + benchData->length, data, length );
+	benchData->length += length;
+	}
+
+/* Generate each of the synthetic objects.  The objects are written into a
+   buffer with enough room for the largest object, with the length of the
+   outermost item fixed up once the contents are known */
+
+static void beginBenchObject( BENCH_DATA *benchData )
+	{
+	benchData->length = benchData->noItems = 0;
+	addBenchHeader( benchData, SEQUENCE | CONSTRUCTED, 0x7FFFFFFFL );
+	}
+
+static void endBenchObject( BENCH_DATA *benchData )
+	{
+	const long contentLength = benchData->length - 6;
+	int i;
+
+	for( i = 0; i < 4; i++ )
+		benchData->buffer[ 2 + i ] = ( BYTE ) ( contentLength >> ( ( 3 - i ) * 8 ) );
+	}
+
+static void genNested( BENCH_DATA *benchData, const long size )
+	{
+	static const BYTE integer[] = { INTEGER, 1, 0x2A };
+	int i;
+
+	/* Nested SEQUENCEs each with an INTEGER at the innermost level, with
+	   the innermost item at each depth fitting in a single length byte so
+	   that we can encode them from the inside out */
+	beginBenchObject( benchData );
+	while( benchData->length < size )
+		{
+		BYTE nested[ BENCH_NESTING_DEPTH * 2 + 3 ];
+
+		for( i = 0; i < BENCH_NESTING_DEPTH; i++ )
+			{
+			nested[ i * 2 ] = SEQUENCE | CONSTRUCTED;
+			nested[ i * 2 + 1 ] = ( BYTE ) ( ( BENCH_NESTING_DEPTH - i - 1 ) * 2 + 3 );
+			}
+		memcpy( nested + BENCH_NESTING_DEPTH * 2, integer, 3 );
+		addBenchData( benchData, nested, BENCH_NESTING_DEPTH * 2 + 3 );
+		benchData->noItems += BENCH_NESTING_DEPTH + 1;
+		}
+	endBenchObject( benchData );
+	}
+
+static void genSequenceOf( BENCH_DATA *benchData, const long size )
+	{
+	static const BYTE oid[] = { 0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x01, 0x01, 0x0B };
+	static const BYTE string[] = "Test string";
+	long count = 0;
+
+	/* A SEQUENCE OF mixed small items */
+	beginBenchObject( benchData );
+	while( benchData->length < size )
+		{
+		BYTE integer[ 4 ];
+
+		integer[ 0 ] = ( BYTE ) ( ( count >> 16 ) & 0x7F );
+		integer[ 1 ] = ( BYTE ) ( count >> 8 );
+		integer[ 2 ] = ( BYTE ) count;
+		addBenchHeader( benchData, INTEGER, 3 );
+		addBenchData( benchData, integer, 3 );
+		addBenchHeader( benchData, OID, sizeof( oid ) );
+		addBenchData( benchData, oid, sizeof( oid ) );
+		addBenchHeader( benchData, PRINTABLESTRING, sizeof( string ) - 1 );
+		addBenchData( benchData, string, sizeof( string ) - 1 );
+		count++;
+		}
+	endBenchObject( benchData );
+	}
+
+static void genOctetString( BENCH_DATA *benchData, const long size )
+	{
+	UINT32 seed = 1;
+	long i;
+
+	/* A single large OCTET STRING containing pseudorandom data */
+	beginBenchObject( benchData );
+	addBenchHeader( benchData, OCTETSTRING, size );
+	for( i = 0; i < size; i++ )
+		{
+		seed = MASK32( seed * 1103515245UL + 12345 );
+		benchData->buffer[ benchData->length++ ] = ( BYTE ) ( seed >> 16 );
+		}
+	endBenchObject( benchData );
+	}
+
+static void genBMPString( BENCH_DATA *benchData, const long size )
+	{
+	BYTE string[ BENCH_STRING_LENGTH * 2 ];
+	int i;
+
+	/* A SEQUENCE OF BMPStrings, including some non-ASCII chars */
+	for( i = 0; i < BENCH_STRING_LENGTH; i++ )
+		{
+		string[ i * 2 ] = ( i % 8 ) ? 0x00 : 0x04;
+		string[ i * 2 + 1 ] = ( BYTE ) ( 'A' + i );
+		}
+	beginBenchObject( benchData );
+	while( benchData->length < size )
+		{
+		addBenchHeader( benchData, BMPSTRING, BENCH_STRING_LENGTH * 2 );
+		addBenchData( benchData, string, BENCH_STRING_LENGTH * 2 );
+		}
+	endBenchObject( benchData );
+	}
+
+/* Time the dumping of an object with each of the output modes */
+
+static int benchmarkObject( const char *name, const BENCH_DATA *benchData )
+	{
+	const int savedPure = doPure, savedHexValues = doHexValues;
+	const int savedText = dumpText, savedAllData = printAllData;
+	int i;
+
+	for( i = 0; benchModes[ i ].name != NULL; i++ )
+		{
+		const BENCH_MODE *mode = &benchModes[ i ];
+		double startTime, elapsedTime;
+		long noRuns = 0;
+
+		doPure = mode->doPure;
+		doHexValues = mode->doHexValues;
+		dumpText = mode->dumpText;
+		printAllData = mode->printAllData;
+		startTime = getTime();
+		do
+			{
+			FILE *inFile;
+
+			if( ( inFile = openMemStream( benchData->buffer,
+										  benchData->length ) ) == NULL )
+				return( FALSE );
+#ifdef USE_THREADS
+			inputBuffer = benchData->buffer;
+			inputBufferSize = benchData->length;
+#endif /* USE_THREADS */
+			fPos = 0;
+			noErrors = noWarnings = 0;
+			printAsn1( inFile, 0, LENGTH_MAGIC, 0 );
+			fclose( inFile );
+			noRuns++;
+			elapsedTime = getTime() - startTime;
+			}
+		while( elapsedTime < BENCH_MIN_TIME );
+#ifdef USE_THREADS
+		inputBuffer = NULL;
+		inputBufferSize = 0;
+#endif /* USE_THREADS */
+		printf( "%-14s %-8s %10.1f %14.0f\n", name, mode->name,
+				( noRuns * ( benchData->length / 1048576.0 ) ) / elapsedTime,
+				( noRuns * ( double ) benchData->noItems ) / elapsedTime );
+		fflush( stdout );
+		}
+	doPure = savedPure;
+	doHexValues = savedHexValues;
+	dumpText = savedText;
+	printAllData = savedAllData;
+
+	return( TRUE );
+	}
+
+static int doBenchmark( void )
+	{
+	BENCH_DATA benchData;
+	const long size = benchmarkSize * 1048576L;
+
+	/* Allocate room for the largest object, which is the one that
+	   overshoots the size the most */
+	memset( &benchData, 0, sizeof( BENCH_DATA ) );
+	benchData.maxLength = size + BENCH_NESTING_DEPTH * 2 + 64;
+	if( ( benchData.buffer = ( BYTE * ) malloc( benchData.maxLength ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return( EXIT_FAILURE );
+		}
+	if( nullOutput == NULL && \
+		( nullOutput = fopen( NULL_DEVICE, "w" ) ) == NULL )
+		{
+		perror( NULL_DEVICE );
+		free( benchData.buffer );
+		return( EXIT_FAILURE );
+		}
+	output = nullOutput;
+
+	printf( "%-14s %-8s %10s %14s\n", "Object", "Mode", "MB/s", "Items/s" );
+	genNested( &benchData, size );
+	benchmarkObject( "nested", &benchData );
+	genSequenceOf( &benchData, size );
+	benchmarkObject( "sequence-of", &benchData );
+	genOctetString( &benchData, size );
+	benchmarkObject( "octet-string", &benchData );
+	genBMPString( &benchData, size );
+	benchmarkObject( "bmpstring", &benchData );
+	output = stdout;
+	free( benchData.buffer );
+
+	return( EXIT_SUCCESS );
+	}
+
+/****************************************************************************
+*																			*
+*								Follow Routines								*
+*																			*
+****************************************************************************/
+
+/* Following a file that records are continuously appended to, for example
+   an audit log of DER-encoded records.  We remember the position of the
+   last complete top-level item and, each time the file grows, read only
+   the newly-appended data and dump the complete items in it, keeping any
+   partial item at the end until the rest of it arrives.  If a state file
+   is given, the position is saved in it after each batch of items so that
+   a later run can continue from where this one stopped.  Indefinite-length
+   items are dumped once their EOC arrives */
+
+#ifdef USE_THREADS
+
+#define FOLLOW_POLL_INTERVAL	250		/* Poll interval in ms */
+#define FOLLOW_BUFFER_SIZE		65536L	/* Initial read buffer size */
+
+typedef struct {
+	int fd;						/* File being followed */
+	long position;				/* Position of start of buffered data */
+	BYTE *buffer;				/* Buffered data */
+	long bufSize, bufLength;	/* Size and amount of data in buffer */
+	const char *stateFileName;	/* File to record position in */
+	} FOLLOW_STATE;
+
+/* Get the size of the next complete item in the buffered data, returning 0
+   if more data is needed or -1 if it's not ASN.1 data */
+
+static long getFollowItemSize( const BYTE *data, const long dataLength )
+	{
+	ASN1_ITEM item;
+	long size;
+	int status;
+
+	status = getMemItem( data, dataLength, &item );
+	if( status <= 0 )
+		return( status );
+	if( item.indefinite )
+		{
+		size = getMemObjectSize( data, dataLength, &item, 0 );
+		return( ( size > 0 ) ? size : 0 );
+		}
+	if( item.length < 0 )
+		return( -1 );
+	if( item.length > dataLength - item.headerSize )
+		return( 0 );
+
+	return( item.headerSize + item.length );
+	}
+
+/* Dump an item as it would appear in the dump of the whole file.  If
+   there's a fatal error in the data we stop the dump of the item and
+   continue with the next one */
+
+static void dumpFollowItem( const BYTE *data, const long length,
+							const long position )
+	{
+	FILE *inFile;
+	jmp_buf abortEnv;
+	long limit = 9999;
+	int width = 4;
+
+	if( ( inFile = openMemStream( data, length ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		return;
+		}
+
+	/* Widen the informational data column if required as the file grows,
+	   see processObjectStart() */
+	while( width < 8 && position + length > limit )
+		{
+		width++;
+		limit = ( limit * 10 ) + 9;
+		}
+	if( width > infoWidth )
+		infoWidth = width;
+	fPos = ( int ) position;
+	workerAbort = &abortEnv;
+	if( !setjmp( abortEnv ) )
+		printAsn1( inFile, 0, length, FALSE );
+	workerAbort = NULL;
+	fclose( inFile );
+	}
+
+static int saveFollowPosition( const FOLLOW_STATE *state )
+	{
+	FILE *stateFile;
+
+	if( state->stateFileName == NULL )
+		return( TRUE );
+	if( ( stateFile = fopen( state->stateFileName, "w" ) ) == NULL )
+		{
+		perror( state->stateFileName );
+		return( FALSE );
+		}
+	fprintf( stateFile, "%ld\n", state->position );
+	if( fclose( stateFile ) )
+		{
+		perror( state->stateFileName );
+		return( FALSE );
+		}
+
+	return( TRUE );
+	}
+
+/* Read any data appended to the file and dump the complete items in it */
+
+static int processFollowData( FOLLOW_STATE *state )
+	{
+	struct stat statInfo;
+	long dataEnd, offset = 0;
+
+	if( fstat( state->fd, &statInfo ) < 0 )
+		{
+		perror( "fstat" );
+		return( FALSE );
+		}
+	dataEnd = state->position + state->bufLength;
+	if( statInfo.st_size < dataEnd )
+		{
+		/* The file has been truncated, start again from the beginning */
+		fflush( output );
+		fputs( "File truncated, restarting from the beginning.\n", stderr );
+		state->position = state->bufLength = 0;
+		dataEnd = 0;
+		}
+	if( statInfo.st_size == dataEnd )
+		return( TRUE );
+
+	/* Read the new data */
+	if( statInfo.st_size - state->position > state->bufSize )
+		{
+		long newSize = state->bufSize * 2;
+		BYTE *newBuffer;
+
+		if( newSize < statInfo.st_size - state->position )
+			newSize = statInfo.st_size - state->position;
+		newBuffer = realloc( state->buffer, newSize );
+
+		if( newBuffer == NULL )
+			{
+			puts( "Out of memory." );
+			return( FALSE );
+			}
+		state->buffer = newBuffer;
+		state->bufSize = newSize;
+		}
+	while( dataEnd < statInfo.st_size )
+		{
+		const ssize_t count = pread( state->fd,
+									 state->buffer + state->bufLength,
+									 statInfo.st_size - dataEnd, dataEnd );
+
+		if( count < 0 && errno == EINTR )
+			continue;
+		if( count <= 0 )
+			break;
+		state->bufLength += count;
+		dataEnd += count;
+		}
+
+	/* Dump any complete items */
+	while( offset < state->bufLength )
+		{
+		const long size = getFollowItemSize( state->buffer + offset,
+											 state->bufLength - offset );
+
+		if( size == 0 )
+			break;
+		if( size < 0 )
+			{
+			fflush( output );
+			fprintf( stderr, "\nError: Invalid data encountered at position "
+					 "%ld.\n", state->position + offset );
+			return( FALSE );
+			}
+		dumpFollowItem( state->buffer + offset, size,
+						state->position + offset );
+		offset += size;
+		}
+	fflush( output );
+	if( offset <= 0 )
+		return( TRUE );
+
+	/* Move any partial item down to the start of the buffer and remember
+	   where it starts */
+	memmove( state->buffer, state->buffer + offset,
+			 state->bufLength - offset );
+	state->bufLength -= offset;
+	state->position += offset;
+
+	return( saveFollowPosition( state ) );
+	}
+
+/* Wait for the file to change */
+
+static void waitFollowChange( const int notifyFd )
+	{
+#ifdef USE_INOTIFY
+	if( notifyFd >= 0 )
+		{
+		struct pollfd pollInfo;
+		char buffer[ 4096 ];
+
+		/* Wait for a change notification and clear the pending events.  We
+		   wake up periodically in case a change is missed */
+		pollInfo.fd = notifyFd;
+		pollInfo.events = POLLIN;
+		if( poll( &pollInfo, 1, FOLLOW_POLL_INTERVAL * 4 ) > 0 )
+			( void ) read( notifyFd, buffer, sizeof( buffer ) );
+		return;
+		}
+#endif /* USE_INOTIFY */
+	usleep( FOLLOW_POLL_INTERVAL * 1000 );
+	}
+
+static int doFollow( const char *fileName, const long offset )
+	{
+	FOLLOW_STATE state;
+	int notifyFd = -1;
+
+	memset( &state, 0, sizeof( FOLLOW_STATE ) );
+	state.position = offset;
+	state.stateFileName = followStateFileName;
+	if( ( state.fd = open( fileName, O_RDONLY ) ) < 0 )
+		{
+		perror( fileName );
+		return( EXIT_FAILURE );
+		}
+	if( ( state.buffer = malloc( FOLLOW_BUFFER_SIZE ) ) == NULL )
+		{
+		puts( "Out of memory." );
+		close( state.fd );
+		return( EXIT_FAILURE );
+		}
+	state.bufSize = FOLLOW_BUFFER_SIZE;
+
+	/* If there's a saved position from an earlier run, continue from
+	   there */
+	if( state.stateFileName != NULL )
+		{
+		FILE *stateFile = fopen( state.stateFileName, "r" );
+
+		if( stateFile != NULL )
+			{
+			if( fscanf( stateFile, "%ld", &state.position ) != 1 || \
+				state.position < 0 )
+				state.position = 0;
+			fclose( stateFile );
+			}
+		}
+#ifdef USE_INOTIFY
+	if( ( notifyFd = inotify_init() ) >= 0 && \
+		inotify_add_watch( notifyFd, fileName, IN_MODIFY ) < 0 )
+		{
+		close( notifyFd );
+		notifyFd = -1;
+		}
+#endif /* USE_INOTIFY */
+
+	/* Dump the existing items and then any that are added */
+	while( processFollowData( &state ) )
+		waitFollowChange( notifyFd );
+	if( notifyFd >= 0 )
+		close( notifyFd );
+	close( state.fd );
+	free( state.buffer );
+
+	return( EXIT_FAILURE );
+	}
+#endif /* USE_THREADS */
+
+/****************************************************************************
+*																			*
+*								Server Routines								*
+*																			*
+****************************************************************************/
+
+#ifdef USE_THREADS
+
+/* In server mode we read the config file once and then process requests
+   arriving on a UNIX domain socket, which avoids the process creation and
+   config-file read overhead for each object that's dumped.  Each request
+   is a line containing any display options followed by either the length
+   of the data to dump or '@' and the name of a file to dump:
+
+	[<options>] <length>\n<data>
+	[<options>] @<file name>\n
+
+   The options are the same as the command-line display options, for
+   example "-lt -m4 1234".  The response is sent as a series of chunks, each
+   consisting of a line with the chunk length followed by the chunk data,
+   with the final, zero-length chunk also containing the error and warning
+   counts:
+
+	<length>\n<output data>
+	...
+	0 <errors> <warnings>\n
+
+   A client can send any number of requests over a connection, which are
+   processed in order.  While a connection is idle it's watched by the
+   main thread, and once a request arrives it's handed to a pool of worker
+   threads for that request only, so that idle clients don't tie up the
+   workers.  A client that stalls in the middle of a request is
+   disconnected after a timeout.  A SIGHUP causes the config file to be
+   re-read, which is done once all requests currently being processed are
+   complete */
+
+#define SERVER_THREADS		4		/* Default no.worker threads */
+#define SERVER_QUEUE_SIZE	64		/* Max.no.connections waiting for accept */
+#define SERVER_MAX_CONNECTIONS	256	/* Max.no.open connections */
+#define SERVER_READ_SIZE	4096	/* Request read buffer size */
+#define SERVER_BUFFER_SIZE	16384	/* Response chunk size */
+#define SERVER_TIMEOUT		30		/* Read/write timeout within a request */
+#define SERVER_MAX_DATA		( 64L * 1024 * 1024 )	/* Max.request data size */
+#define MAX_CONFIG_FILES	16		/* Max.no.alternate config files */
+
+/* A connection from a client, along with any request data that's been read
+   from it but not processed yet */
+
+typedef struct {
+	int socket;					/* Client socket */
+	BYTE buffer[ SERVER_READ_SIZE ];	/* Data read from the client */
+	int bufPos, bufLength;		/* Position and amount of data in buffer */
+	} SERVER_CONNECTION;
+
+/* The queue of connections with requests waiting to be processed, and the
+   idle connections waiting for the client to send a request.  Idle
+   connections are added by the worker threads once they've processed a
+   request, and removed by the main thread once there's a new request, with
+   the workers waking the main thread through a pipe so that it sees the
+   connections that have been added.  Since the queue can hold every open
+   connection, it can never overflow */
+
+static SERVER_CONNECTION *serverQueue[ SERVER_MAX_CONNECTIONS ];
+static int serverQueueStart = 0, serverQueueCount = 0;
+static SERVER_CONNECTION *serverIdle[ SERVER_MAX_CONNECTIONS ];
+static int serverIdleCount = 0, serverNoConnections = 0;
+static int serverWakeupPipe[ 2 ];
+static pthread_mutex_t serverQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t serverQueueNotEmpty = PTHREAD_COND_INITIALIZER;
+
+/* The lock for the OID information, held for reading while a request is
+   being processed and for writing while the config is being re-read, along
+   with the information that we need in order to re-read the config */
+
+static pthread_rwlock_t serverConfigLock = PTHREAD_RWLOCK_INITIALIZER;
+static volatile sig_atomic_t serverReloadConfig = FALSE;
+static const char *serverConfigPath;
+static const char *serverConfigFiles[ MAX_CONFIG_FILES ];
+static int serverNoConfigFiles = 0;
+
+/* The display options set on the command line, used as the default for
+   each request */
+
+static DUMP_OPTIONS serverOptions;
+
+/* Remember an alternate config file given on the command line so that it
+   can be re-read when the config is reloaded */
+
+static void addServerConfigFile( const char *fileName )
+	{
+	if( serverNoConfigFiles < MAX_CONFIG_FILES )
+		serverConfigFiles[ serverNoConfigFiles++ ] = fileName;
+	}
+
+/* Re-read the config files, keeping the existing config if there's a
+   problem with the new one */
+
+static void reloadServerConfig( void )
+	{
+	OIDINFO *oldOidList;
+	OID_TRIE_NODE *oldOidTrie;
+	int oldOidTrieSize, status = TRUE, i;
+
+	pthread_rwlock_wrlock( &serverConfigLock );
+	oldOidList = oidList;
+	oldOidTrie = oidTrie;
+	oldOidTrieSize = oidTrieSize;
+	oidList = NULL;
+	oidTrie = NULL;
+	for( i = 0; i < serverNoConfigFiles && status; i++ )
+		status = readConfig( serverConfigFiles[ i ], FALSE );
+	if( status )
+		status = readGlobalConfig( serverConfigPath );
+	if( status )
+		status = buildOIDtrie();
+	if( status )
+		{
+		OIDINFO *newOidList = oidList;
+		OID_TRIE_NODE *newOidTrie = oidTrie;
+		const int newOidTrieSize = oidTrieSize;
+
+		oidList = oldOidList;
+		oidTrie = oldOidTrie;
+		freeConfig();
+		oidList = newOidList;
+		oidTrie = newOidTrie;
+		oidTrieSize = newOidTrieSize;
+		}
+	else
+		{
+		freeConfig();
+		oidList = oldOidList;
+		oidTrie = oldOidTrie;
+		oidTrieSize = oldOidTrieSize;
+		}
+	pthread_rwlock_unlock( &serverConfigLock );
+	fprintf( stderr, status ? "Config reloaded.\n" : \
+			 "Config reload failed, continuing with existing config.\n" );
+	}
+
+static void serverSignalHandler( int signalNo )
+	{
+	( void ) signalNo;	/* Unused, we only handle SIGHUP */
+
+	serverReloadConfig = TRUE;
+	}
+
+/* Add a connection to the queue of connections with requests to process.
+   This has to be called with the queue mutex held */
+
+static void queueConnection( SERVER_CONNECTION *connection )
+	{
+	serverQueue[ ( serverQueueStart + serverQueueCount ) % \
+				 SERVER_MAX_CONNECTIONS ] = connection;
+	serverQueueCount++;
+	pthread_cond_signal( &serverQueueNotEmpty );
+	}
+
+/* Close a connection */
+
+static void closeConnection( SERVER_CONNECTION *connection )
+	{
+	close( connection->socket );
+	free( connection );
+	pthread_mutex_lock( &serverQueueMutex );
+	serverNoConnections--;
+	pthread_mutex_unlock( &serverQueueMutex );
+	}
+
+/* Read more request data from a connection.  Returns FALSE if the client
+   has closed the connection or the read has timed out */
+
+static int fillConnection( SERVER_CONNECTION *connection )
+	{
+	ssize_t count;
+
+	do
+		count = read( connection->socket, connection->buffer,
+					  SERVER_READ_SIZE );
+	while( count < 0 && errno == EINTR );
+	if( count <= 0 )
+		return( FALSE );
+	connection->bufPos = 0;
+	connection->bufLength = ( int ) count;
+
+	return( TRUE );
+	}
+
+/* Read a line of request data from a connection in the same way as
+   fgets().  Returns FALSE if there's no more data */
+
+static int readConnectionLine( SERVER_CONNECTION *connection, char *line,
+							   const int maxLength )
+	{
+	int length = 0;
+
+	while( length < maxLength - 1 )
+		{
+		if( connection->bufPos >= connection->bufLength && \
+			!fillConnection( connection ) )
+			break;
+		line[ length ] = connection->buffer[ connection->bufPos++ ];
+		if( line[ length++ ] == '\n' )
+			break;
+		}
+	line[ length ] = '\0';
+
+	return( length > 0 );
+	}
+
+/* Read request data from a connection.  Returns FALSE if the client has
+   closed the connection or the read has timed out before all of the data
+   was read */
+
+static int readConnection( SERVER_CONNECTION *connection, BYTE *data,
+						   long length )
+	{
+	const int bufferedLength = ( int ) \
+				min( connection->bufLength - connection->bufPos, length );
+
+	memcpy( data, connection->buffer + connection->bufPos, bufferedLength );
+	connection->bufPos += bufferedLength;
+	data += bufferedLength;
+	length -= bufferedLength;
+	while( length > 0 )
+		{
+		const ssize_t count = read( connection->socket, data, length );
+
+		if( count < 0 && errno == EINTR )
+			continue;
+		if( count <= 0 )
+			return( FALSE );
+		data += count;
+		length -= count;
+		}
+
+	return( TRUE );
+	}
+
+/* Write data to a socket */
+
+static int writeSocket( const int socket, const char *data, long length )
+	{
+	while( length > 0 )
+		{
+		const ssize_t count = write( socket, data, length );
+
+		if( count < 0 && errno == EINTR )
+			continue;
+		if( count <= 0 )
+			return( FALSE );
+		data += count;
+		length -= count;
+		}
+
+	return( TRUE );
+	}
+
+/* Write a response chunk to a socket.  This is used as the write function
+   for the output stream, so that the output is sent to the client as it's
+   produced */
+
+static int writeChunk( const int socket, const char *data,
+					   const long length )
+	{
+	char header[ 32 ];
+	const int headerLength = sprintf( header, "%ld\n", length );
+
+	return( writeSocket( socket, header, headerLength ) && \
+			writeSocket( socket, data, length ) );
+	}
+
+#if defined( __linux__ )
+
+static ssize_t outputWrite( void *cookie, const char *data, size_t length )
+	{
+	if( length > 0 && !writeChunk( *( int * ) cookie, data, length ) )
+		return( -1 );
+	return( length );
+	}
+
+static FILE *openOutputStream( int *socket )
+	{
+	cookie_io_functions_t ioFunctions = { NULL, outputWrite, NULL, NULL };
+
+	return( fopencookie( socket, "w", ioFunctions ) );
+	}
+#elif defined( __APPLE__ ) || defined( __FreeBSD__ ) || \
+	  defined( __NetBSD__ ) || defined( __OpenBSD__ )
+
+static int outputWrite( void *cookie, const char *data, int length )
+	{
+	if( length > 0 && !writeChunk( *( int * ) cookie, data, length ) )
+		return( -1 );
+	return( length );
+	}
+
+static FILE *openOutputStream( int *socket )
+	{
+	return( funopen( socket, NULL, outputWrite, NULL, NULL ) );
+	}
+#else
+  #define NO_OUTPUT_STREAM
+#endif /* OS-specific custom stream handling */
+
+/* Process a request.  Returns FALSE if the connection should be closed */
+
+static int processRequest( SERVER_CONNECTION *connection )
+	{
+	jmp_buf abortEnv;
+	FILE *inFile, *outStream;
+#ifdef NO_OUTPUT_STREAM
+	char *outBuffer = NULL;
+	size_t outBufSize = 0;
+#endif /* NO_OUTPUT_STREAM */
+	char header[ FILENAME_MAX + 256 ], *headerPtr = header;
+	char trailer[ 64 ];
+	const char *errorString = NULL;
+	BYTE *data = NULL;
+	long dataLength = 0, offset = 0;
+	int clientSocket = connection->socket;
+	int doCheckOnly = FALSE, keepConnection = TRUE, headerLength;
+	int status = TRUE;
+
+	/* Read the request header */
+	if( !readConnectionLine( connection, header, sizeof( header ) ) )
+		return( FALSE );
+	headerLength = strlen( header );
+	if( headerLength <= 0 || header[ headerLength - 1 ] != '\n' )
+		{
+		errorString = "Invalid request header.";
+		status = keepConnection = FALSE;
+		}
+	else
+		header[ --headerLength ] = '\0';
+
+	/* Set up the default options and process the options for the
+	   request */
+	setDumpOptions( &serverOptions );
+	while( status && *headerPtr == '-' )
+		{
+		const char *argPtr = headerPtr + 1;
+		char *argEnd = strchr( headerPtr, ' ' );
+
+		/* Options that take a value consume the rest of the argument, so
+		   we have to terminate each one before we process it */
+		if( argEnd == NULL )
+			{
+			errorString = "Missing request data length.";
+			status = keepConnection = FALSE;
+			break;
+			}
+		*argEnd = '\0';
+		while( *argPtr && status )
+			{
+			if( isdigit( byteToInt( *argPtr ) ) )
+				{
+				offset = atol( argPtr );
+				while( isdigit( byteToInt( argPtr[ 1 ] ) ) )
+					argPtr++;
+				}
+			else
+				{
+				if( toupper( byteToInt( *argPtr ) ) == 'S' )
+					doCheckOnly = TRUE;
+				else
+					{
+					const int optionStatus = \
+						processDisplayOption( &argPtr, &errorString );
+
+					if( optionStatus <= 0 )
+						{
+						if( optionStatus == 0 )
+							errorString = "Invalid request option.";
+						status = keepConnection = FALSE;
+						}
+					}
+				}
+			argPtr++;
+			}
+		headerPtr = argEnd + 1;
+		while( *headerPtr == ' ' )
+			headerPtr++;
+		}
+
+	/* Get the data to dump.  If we can't read the data that follows the
+	   header, we've lost track of the request framing and have to close
+	   the connection */
+	if( status )
+		{
+		if( *headerPtr == '@' )
+			{
+			if( ( data = readFileData( headerPtr + 1, &dataLength ) ) == NULL )
+				{
+				errorString = "Couldn't read data file.";
+				status = FALSE;
+				}
+			}
+		else
+			{
+			dataLength = atol( headerPtr );
+			if( !isdigit( byteToInt( *headerPtr ) ) || dataLength <= 0 || \
+				dataLength > SERVER_MAX_DATA )
+				{
+				errorString = "Invalid request data length.";
+				status = keepConnection = FALSE;
+				}
+			else
+				{
+				if( ( data = ( BYTE * ) malloc( dataLength ) ) == NULL )
+					return( FALSE );
+				if( !readConnection( connection, data, dataLength ) )
+					{
+					free( data );
+					return( FALSE );
+					}
+				}
+			}
+		}
+	if( status && offset >= dataLength )
+		{
+		errorString = "Request offset is past the end of the data.";
+		status = FALSE;
+		}
+
+	/* Set up the output stream */
+	if( doCheckOnly && status )
+		outStream = nullOutput;
+	else
+		{
+#ifdef NO_OUTPUT_STREAM
+		outStream = open_memstream( &outBuffer, &outBufSize );
+#else
+		outStream = openOutputStream( &clientSocket );
+#endif /* NO_OUTPUT_STREAM */
+		if( outStream == NULL )
+			{
+			if( data != NULL )
+				free( data );
+			return( FALSE );
+			}
+		setvbuf( outStream, NULL, _IOFBF, SERVER_BUFFER_SIZE );
+		}
+	if( !status )
+		{
+		fprintf( outStream, "%s\n", errorString );
+		noErrors = 1;
+		noWarnings = 0;
+		}
+	else
+		{
+		/* Dump the data, returning to here if there's a fatal error */
+		useStdin = FALSE;
+		fPos = 0;
+		infoWidth = 4;
+		noErrors = noWarnings = 0;
+		output = outStream;
+		if( ( inFile = fmemopen( data + offset, dataLength - offset,
+								 "rb" ) ) != NULL )
+			{
+			pthread_rwlock_rdlock( &serverConfigLock );
+			workerAbort = &abortEnv;
+			if( !setjmp( abortEnv ) )
+				{
+				printAsn1( inFile, 0, LENGTH_MAGIC, 0 );
+				if( offset == 0 )
+					checkTrailingData( inFile );
+				}
+			else
+				{
+				fprintf( outStream, "\nError: Decoding stopped due to invalid "
+						 "data at position %d.\n", fPos );
+				noErrors++;
+				}
+			workerAbort = NULL;
+			pthread_rwlock_unlock( &serverConfigLock );
+			fclose( inFile );
+			}
+		output = NULL;
+		}
+	if( outStream != nullOutput )
+		fclose( outStream );
+	if( data != NULL )
+		free( data );
+
+	/* Send the final chunk with the error and warning counts */
+#ifdef NO_OUTPUT_STREAM
+	if( outBuffer != NULL )
+		{
+		if( outBufSize > 0 )
+			keepConnection = writeChunk( clientSocket, outBuffer,
+										 outBufSize ) && keepConnection;
+		free( outBuffer );
+		}
+#endif /* NO_OUTPUT_STREAM */
+	sprintf( trailer, "0 %d %d\n", noErrors, noWarnings );
+	if( !writeSocket( clientSocket, trailer, strlen( trailer ) ) )
+		return( FALSE );
+
+	return( keepConnection );
+	}
+
+/* Process requests on connections from the queue */
+
+static void *serverWorker( void *arg )
+	{
+	( void ) arg;		/* Unused, all workers take from the same queue */
+
+	while( TRUE )
+		{
+		SERVER_CONNECTION *connection;
+
+		/* Get the next connection with a request to process */
+		pthread_mutex_lock( &serverQueueMutex );
+		while( serverQueueCount <= 0 )
+			pthread_cond_wait( &serverQueueNotEmpty, &serverQueueMutex );
+		connection = serverQueue[ serverQueueStart ];
+		serverQueueStart = ( serverQueueStart + 1 ) % SERVER_MAX_CONNECTIONS;
+		serverQueueCount--;
+		pthread_mutex_unlock( &serverQueueMutex );
+
+		/* Process the request, and then either close the connection or
+		   hand it back.  If we've already read the start of the next
+		   request then the connection goes to the back of the queue,
+		   otherwise it goes back to the idle connections and we wake the
+		   main thread so that it waits for the next request on it */
+		if( !processRequest( connection ) )
+			{
+			closeConnection( connection );
+			continue;
+			}
+		pthread_mutex_lock( &serverQueueMutex );
+		if( connection->bufPos < connection->bufLength )
+			queueConnection( connection );
+		else
+			{
+			serverIdle[ serverIdleCount++ ] = connection;
+			( void ) write( serverWakeupPipe[ 1 ], "", 1 );
+			}
+		pthread_mutex_unlock( &serverQueueMutex );
+		}
+
+	return( NULL );
+	}
 
-	/* Perform a sanity check */
-	if( ( item->tag != NULLTAG ) && ( item->length < 0 ) )
-		{
-		int i;
+/* Accept a connection, which is idle until the client sends a request.
+   Returns FALSE if there's a problem with the server socket */
 
-		fflush( stdout );
-		fprintf( stderr, "\nError: Object has bad length field, tag = %02X, "
-				 "length = %lX, value =", item->tag, item->length );
-		fprintf( stderr, "<%02X", *item->header );
-		for( i = 1; i < item->headerSize; i++ )
-			fprintf( stderr, " %02X", item->header[ i ] );
-		fputs( ">.\n", stderr );
-		exit( EXIT_FAILURE );
+static int acceptConnection( const int serverSocket )
+	{
+	SERVER_CONNECTION *connection;
+	struct timeval timeout;
+	const int clientSocket = accept( serverSocket, NULL, NULL );
+
+	if( clientSocket < 0 )
+		{
+		if( errno == EINTR || errno == ECONNABORTED )
+			return( TRUE );
+		perror( "accept" );
+		return( FALSE );
 		}
 
-	/* If it's constructed, print the various fields in it */
-	if( ( item->id & FORM_MASK ) == CONSTRUCTED )
+	/* Make sure that a client that stalls in the middle of a request
+	   can't tie up a worker thread indefinitely */
+	memset( &timeout, 0, sizeof( timeout ) );
+	timeout.tv_sec = SERVER_TIMEOUT;
+	setsockopt( clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+				sizeof( timeout ) );
+	setsockopt( clientSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+				sizeof( timeout ) );
+
+	/* Add the connection to the idle connections */
+	if( ( connection = malloc( sizeof( SERVER_CONNECTION ) ) ) == NULL )
 		{
-		markConstructed( level, item );
-		printConstructed( inFile, level, item );
-		return;
+		close( clientSocket );
+		return( TRUE );
+		}
+	connection->socket = clientSocket;
+	connection->bufPos = connection->bufLength = 0;
+	pthread_mutex_lock( &serverQueueMutex );
+	if( serverNoConnections >= SERVER_MAX_CONNECTIONS )
+		{
+		/* We're overloaded, drop the connection */
+		pthread_mutex_unlock( &serverQueueMutex );
+		close( clientSocket );
+		free( connection );
+		return( TRUE );
 		}
+	serverIdle[ serverIdleCount++ ] = connection;
+	serverNoConnections++;
+	pthread_mutex_unlock( &serverQueueMutex );
 
-	/* It's primitive */
-	if( doOutlineOnly )
+	return( TRUE );
+	}
+
+/* Run the server, which only returns if there's an error */
+
+static int runServer( const char *socketName )
+	{
+	struct sockaddr_un address;
+	struct sigaction sigAction;
+	struct stat statInfo;
+	pthread_t thread;
+	sigset_t signalMask;
+	const int noThreads = ( parallelThreads > 1 ) ? \
+						  parallelThreads : SERVER_THREADS;
+	int serverSocket, i;
+
+	/* Set up the socket, removing any leftover socket from an earlier
+	   run */
+	if( strlen( socketName ) >= sizeof( address.sun_path ) )
 		{
-		/* If we're only displaying the ASN.1 in outline form, set an
-		   artificially high nesting level that ensures it won't get output
-		   (this clears the data from the input without displaying it) */
-		level = 1000;
+		puts( "Server socket name is too long." );
+		return( EXIT_FAILURE );
 		}
-	if( !item->length && !zeroLengthOK( item ) )
+	memset( &address, 0, sizeof( address ) );
+	address.sun_family = AF_UNIX;
+	strcpy( address.sun_path, socketName );
+	if( stat( socketName, &statInfo ) == 0 && S_ISSOCK( statInfo.st_mode ) )
+		unlink( socketName );
+	if( ( serverSocket = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 || \
+		bind( serverSocket, ( struct sockaddr * ) &address,
+			  sizeof( address ) ) < 0 || \
+		listen( serverSocket, SERVER_QUEUE_SIZE ) < 0 )
 		{
-		printString( level, "%c", '\n' );
-		complain( "Object has zero length", 0, level );
-		if( item->nonCanonical )
-			complainLengthCanonical( item, level );
-		return;
+		perror( socketName );
+		return( EXIT_FAILURE );
 		}
-	switch( item->tag )
+	if( pipe( serverWakeupPipe ) < 0 || \
+		fcntl( serverWakeupPipe[ 0 ], F_SETFL, O_NONBLOCK ) < 0 || \
+		fcntl( serverWakeupPipe[ 1 ], F_SETFL, O_NONBLOCK ) < 0 )
 		{
-		case BOOLEAN:
-			if( item->length != 1 )
-				complainLength( item, level );
-			ch = getc( inFile );
-			if( ch == EOF )
-				{
-				complainEOF( level, 1 );
-				return;
-				}
-			printString( level, " %s\n", ch ? "TRUE" : "FALSE" );
-			if( ch != 0 && ch != 0xFF )
-				{
-				complain( "BOOLEAN '%02X' has non-DER encoding", ch,
-						  level );
-				}
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
-			fPos++;
+		perror( "pipe" );
+		return( EXIT_FAILURE );
+		}
+
+	/* Set up the signal handling.  The worker threads are started with
+	   SIGHUP blocked so that it's always handled by the main thread,
+	   which interrupts the poll() and reloads the config */
+	getDumpOptions( &serverOptions );
+	if( nullOutput == NULL && \
+		( nullOutput = fopen( NULL_DEVICE, "w" ) ) == NULL )
+		{
+		perror( NULL_DEVICE );
+		return( EXIT_FAILURE );
+		}
+	signal( SIGPIPE, SIG_IGN );
+	memset( &sigAction, 0, sizeof( sigAction ) );
+	sigAction.sa_handler = serverSignalHandler;
+	sigemptyset( &sigAction.sa_mask );
+	sigaction( SIGHUP, &sigAction, NULL );
+	sigemptyset( &signalMask );
+	sigaddset( &signalMask, SIGHUP );
+	pthread_sigmask( SIG_BLOCK, &signalMask, NULL );
+	for( i = 0; i < noThreads; i++ )
+		{
+		if( pthread_create( &thread, NULL, serverWorker, NULL ) )
 			break;
+		pthread_detach( thread );
+		}
+	pthread_sigmask( SIG_UNBLOCK, &signalMask, NULL );
+	if( i <= 0 )
+		{
+		puts( "Couldn't create server threads." );
+		return( EXIT_FAILURE );
+		}
 
-		case INTEGER:
-		case ENUMERATED:
-			if( item->length > 4 )
-				{
-				dumpHex( inFile, item->length, level, DUMPHEX_INTEGER, 0 );
-				if( item->nonCanonical )
-					complainLengthCanonical( item, level );
-				}
-			else
-				{
-				printValue( inFile, item->length, level );
-				if( item->nonCanonical )
-					complainLengthCanonical( item, level );
-				}
+	/* Accept connections and wait for requests on the idle connections,
+	   handing each connection to the worker threads when a request arrives
+	   on it.  The server socket and the wakeup pipe are the first two
+	   entries in the poll list, followed by the idle connections */
+	while( TRUE )
+		{
+		struct pollfd pollFds[ SERVER_MAX_CONNECTIONS + 2 ];
+		SERVER_CONNECTION *pollConnections[ SERVER_MAX_CONNECTIONS ];
+		int noPollConnections, status;
+
+		memset( pollFds, 0, sizeof( pollFds ) );
+		pollFds[ 0 ].fd = serverSocket;
+		pollFds[ 0 ].events = POLLIN;
+		pollFds[ 1 ].fd = serverWakeupPipe[ 0 ];
+		pollFds[ 1 ].events = POLLIN;
+		pthread_mutex_lock( &serverQueueMutex );
+		noPollConnections = serverIdleCount;
+		for( i = 0; i < noPollConnections; i++ )
+			{
+			pollConnections[ i ] = serverIdle[ i ];
+			pollFds[ i + 2 ].fd = serverIdle[ i ]->socket;
+			pollFds[ i + 2 ].events = POLLIN;
+			}
+		pthread_mutex_unlock( &serverQueueMutex );
+		status = poll( pollFds, noPollConnections + 2, -1 );
+		if( status < 0 && errno != EINTR )
+			{
+			perror( "poll" );
 			break;
+			}
+		if( serverReloadConfig )
+			{
+			serverReloadConfig = FALSE;
+			reloadServerConfig();
+			}
+		if( status < 0 )
+			continue;
 
-		case BITSTRING:
-			if( item->length < 1 )
-				{
-				/* A bitstring always has to contain at least one byte, the unused-bits 
-				   count */
-				complainLength( item, level );
-				}
-			if( ( ch = getc( inFile ) ) != 0 )
-				{
-				if( ch == EOF )
-					{
-					complainEOF( level, item->length );
-					return;
-					}
-				printString( level, " %d unused bit%s",
-							 ch, ( ch != 1 ) ? "s" : "" );
-				if( item->length <= 1 )
-					{
-					complain( "Empty BIT STRING has non-zero unused-bits "
-							  "value", 0, level );
-					return;
-					}
-				}
-			item->length--;
-			fPos++;
-			if( item->length <= 0 )
-				{
-				printString( level, " %s\n", "(no bits set)" );
-				if( item->nonCanonical )
-					complainLengthCanonical( item, level );
-				return;
-				}
-			if( item->length <= sizeof( int ) )
-				{
-				/* It's short enough to be a bit flag, dump it as a sequence
-				   of bits */
-				dumpBitString( inFile, ( int ) item->length, ch, level );
-				if( item->nonCanonical )
-					complainLengthCanonical( item, level );
-				break;
-				}
-			/* Fall through to dump it as an octet string */
+		/* Clear any wakeups from the worker threads, which just tell us
+		   that the list of idle connections has changed */
+		if( pollFds[ 1 ].revents )
+			{
+			char buffer[ 64 ];
 
-		case OCTETSTRING:
-			if( checkEncapsulate( inFile, item->length ) )
-				{
-				/* It's something encapsulated inside the string, print it as
-				   a constructed item */
-				printString( level, "%s", ", encapsulates" );
-				printConstructed( inFile, level, item );
-				break;
-				}
-			if( !useStdin && !dumpText && \
-				( stringType = checkForText( inFile, item->length ) ) != STR_NONE )
-				{
-				/* If we'd be doing a straight hex dump and it looks like
-				   encapsulated text, display it as such.  If the user has
-				   overridden character set type checking and it's a string
-				   type for which we normally perform type checking, we reset
-				   its type to none */
-				displayString( inFile, item->length, level, \
-					( !checkCharset && ( stringType == STR_IA5 || \
-										 stringType == STR_PRINTABLE ) ) ? \
-					STR_NONE : stringType );
-				if( item->nonCanonical )
-					complainLengthCanonical( item, level );
-				return;
-				}
-			if( item->tag == BITSTRING )
-				dumpHex( inFile, item->length, level, DUMPHEX_BITSTRING, ch );
-			else
-				dumpHex( inFile, item->length, level, DUMPHEX_NORMAL, 0 );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
-			break;
+			while( read( serverWakeupPipe[ 0 ], buffer,
+						 sizeof( buffer ) ) > 0 );
+			}
 
-		case OID:
+		/* Queue the idle connections that have a request waiting or that
+		   have been closed by the client.  Since only the main thread
+		   removes idle connections, each one that we've polled is still
+		   in the list */
+		pthread_mutex_lock( &serverQueueMutex );
+		for( i = 0; i < noPollConnections; i++ )
 			{
-			char textOID[ 128 ];
-			int length, isValid;
+			int idleIndex;
 
-			/* Hierarchical Object Identifier */
-			if( item->length <= 0 || item->length >= MAX_OID_SIZE )
-				{
-				fflush( stdout );
-				fprintf( stderr, "\nError: Object identifier length %ld too "
-						 "large.\n", item->length );
-				exit( EXIT_FAILURE );
-				}
-			length = fread( buffer, 1, ( size_t ) item->length, inFile );
-			fPos += item->length;
-			if( item->length < 3 )
-				{
-				fputs( ".\n", output );
-				complainLength( item, level );
-				break;
-				}
-			if( length < item->length )
-				{
-				fputs( ".\n", output );
-				complain( "Invalid OID data", 0, level );
-				break;
-				}
-			if( ( oidInfo = getOIDinfo( buffer, ( int ) item->length ) ) != NULL )
-				{
-				/* Convert the binary OID to text form */
-				isValid = oidToString( textOID, &length, buffer,
-									   ( int ) item->length );
+			if( !pollFds[ i + 2 ].revents )
+				continue;
+			for( idleIndex = 0; serverIdle[ idleIndex ] != pollConnections[ i ];
+				 idleIndex++ );
+			serverIdle[ idleIndex ] = serverIdle[ --serverIdleCount ];
+			queueConnection( pollConnections[ i ] );
+			}
+		pthread_mutex_unlock( &serverQueueMutex );
 
-				/* Check if LHS status info + indent + "OID " string + oid
-				   name + "(" + oid value + ")" will wrap */
-				if( ( ( doPure ) ? 0 : INDENT_SIZE ) + ( level * 2 ) + 18 + \
-					strlen( oidInfo->description ) + 2 + length >= outputWidth )
-					{
-					printString( level, "%c", '\n' );
-					if( !doPure )
-						printString( level, "%s", INDENT_STRING );
-					doIndent( level + 1 );
-					}
-				else
-					printString( level, "%c", ' ' );
-				printString( level, "%s (%s)\n", oidInfo->description, textOID );
+		/* Accept any new connection */
+		if( pollFds[ 0 ].revents && !acceptConnection( serverSocket ) )
+			break;
+		}
+	close( serverSocket );
+	unlink( socketName );
 
-				/* Display extra comments about the OID if required */
-				if( extraOIDinfo && oidInfo->comment != NULL )
-					{
-					if( !doPure )
-						printString( level, "%s", INDENT_STRING );
-					doIndent( level + 1 );
-					printString( level, "(%s)\n", oidInfo->comment );
-					}
-				if( !isValid )
-					complain( "OID has invalid encoding", 0, level );
-				if( item->nonCanonical )
-					complainLengthCanonical( item, level );
+	return( EXIT_FAILURE );
+	}
+#endif /* USE_THREADS */
 
-				/* If there's a warning associated with this OID, remember
-				   that there was a problem */
-				if( oidInfo->warn )
-					noWarnings++;
+/* Process a display option, returning TRUE if it was processed, FALSE if
+   it isn't a display option, or -1 with an error message if its value is
+   invalid.  Options that take a value consume the rest of the argument */
 
-				break;
-				}
+static int processDisplayOption( const char **argPtrPtr,
+								 const char **errorString )
+	{
+	const char *argPtr = *argPtrPtr;
 
-			/* Print the OID as a text string */
-			isValid = oidToString( textOID, &length, buffer,
-								   ( int ) item->length );
-			printString( level, " '%s'\n", textOID );
-			if( isValid )
-				{
-				if( item->length > MAX_SANE_OID_SIZE )
-					{
-					/* This typically only occurs with Microsoft's "encode 
-					   random noise and call it an OID" values, so we warn 
-					   about the fact that it's not really an OID */
-					complain( "OID contains random garbage", 0, level );
-					}
-				}			
-			else
-				complain( "OID has invalid encoding", 0, level );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+	switch( toupper( byteToInt( *argPtr ) ) )
+		{
+		case 'A':
+			printAllData = TRUE;
+			break;
+
+		case 'D':
+			printDots = TRUE;
+			break;
+
+		case 'E':
+			checkEncaps = FALSE;
+			break;
+
+		case 'G':
+			doOutlineOnly = TRUE;
 			break;
-			}
 
-		case EOC:
-			printString( level, "<<EOC>> %c", '\n' );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+		case 'H':
+			doDumpHeader++;
 			break;
 
-		case NULLTAG:
-			printString( level, "%c", '\n' );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+		case 'I':
+			shallowIndent = TRUE;
 			break;
 
-		case OBJDESCRIPTOR:
-		case GRAPHICSTRING:
-		case VISIBLESTRING:
-		case GENERALSTRING:
-		case UNIVERSALSTRING:
-		case NUMERICSTRING:
-		case VIDEOTEXSTRING:
-		case PRINTABLESTRING:
-			displayString( inFile, item->length, level, STR_PRINTABLE );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+		case 'L':
+			extraOIDinfo = TRUE;
 			break;
-		case UTF8STRING:
-			displayString( inFile, item->length, level, STR_UTF8 );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+
+		case 'M':
+			maxNestLevel = atoi( argPtr + 1 );
+			if( maxNestLevel < 1 || maxNestLevel > MAX_NESTING_LEVEL )
+				{
+				*errorString = "Invalid maximum nesting level.";
+				return( -1 );
+				}
+			while( argPtr[ 1 ] )
+				argPtr++;	/* Skip rest of arg */
 			break;
-		case BMPSTRING:
-			displayString( inFile, item->length, level, STR_BMP );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+
+		case 'N':
+			maxItems = atol( argPtr + 1 );
+			if( maxItems < 1 )
+				{
+				*errorString = "Invalid maximum number of items.";
+				return( -1 );
+				}
+			while( argPtr[ 1 ] )
+				{
+				argPtr++;	/* Skip rest of arg */
+				if( *argPtr == ',' && \
+					toupper( byteToInt( argPtr[ 1 ] ) ) == 'V' )
+					validateSkipped = TRUE;
+				}
+			if( validateSkipped && nullOutput == NULL && \
+				( nullOutput = fopen( NULL_DEVICE, "w" ) ) == NULL )
+				{
+				*errorString = "Couldn't open " NULL_DEVICE ".";
+				return( -1 );
+				}
 			break;
-		case UTCTIME:
-			displayString( inFile, item->length, level, STR_UTCTIME );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+
+		case 'O':
+			checkCharset = FALSE;
 			break;
-		case GENERALIZEDTIME:
-			displayString( inFile, item->length, level, STR_GENERALIZED );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+
+		case 'P':
+			doPure = TRUE;
 			break;
-		case IA5STRING:
-			displayString( inFile, item->length, level, STR_IA5 );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+
+		case 'R':
+			reverseBitString = !reverseBitString;
 			break;
-		case T61STRING:
-			displayString( inFile, item->length, level, STR_LATIN1 );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
+
+		case 'T':
+			dumpText = TRUE;
 			break;
 
-		case SEQUENCE:
-			printString( level, "%c", '\n' );
-			complain( "SEQUENCE has invalid primitive encoding", 0, level );
+		case 'U':
+			rawTimeString = TRUE;
 			break;
 
-		case SET:
-			printString( level, "%c", '\n' );
-			complain( "SET has invalid primitive encoding", 0, level );
+		case 'V':
+			printAllData = doDumpHeader = TRUE;
+			extraOIDinfo = dumpText = TRUE;
+			break;
+
+		case 'W':
+			outputWidth = atoi( argPtr + 1 );
+			if( outputWidth < 40 || outputWidth > 500 )
+				{
+				*errorString = "Invalid output width.";
+				return( -1 );
+				}
+			while( argPtr[ 1 ] )
+				argPtr++;	/* Skip rest of arg */
+			break;
+
+		case 'X':
+			doHexValues = TRUE;
+			break;
+
+		case 'Z':
+			zeroLengthAllowed = TRUE;
 			break;
 
 		default:
-			printString( level, "%c", '\n' );
-			if( !doPure )
-				printString( level, "%s", INDENT_STRING );
-			doIndent( level + 1 );
-			printString( level, "%s",
-						 "Unrecognised primitive, hex value is:");
-			dumpHex( inFile, item->length, level, DUMPHEX_NORMAL, 0 );
-			if( item->nonCanonical )
-				complainLengthCanonical( item, level );
-			noErrors++;		/* Treat it as an error */
+			return( FALSE );
 		}
+	*argPtrPtr = argPtr;
+
+	return( TRUE );
 	}
 
-/* Print a complex ASN.1 object */
+/* Get a time given in an option as 'now' or YYYY[MM[DD[hh[mm[ss]]]]],
+   with optional '-', ':', 'T', and space separators */
 
-static long processObjectStart( FILE *inFile, const ASN1_ITEM *item )
+static int getOptionTime( const char *value, long long *timeValue )
 	{
-	long length = LENGTH_MAGIC;
+	BYTE timeString[ 16 ];
+	int noDigits = 0;
 
-	/* If the length isn't known and the item has a definite length, set the
-	   length to the item's length */
-	if( !item->indefinite )
+	if( value == NULL )
+		return( FALSE );
+	if( !strcmp( value, "now" ) )
 		{
-		length = item->headerSize + item->length;
-
-		/* We can also adjust the width of the informational data column to
-		   maximise the amount of screen real estate (for lengths less than
-		   the default of four) or get rid of oversized columns (for lengths
-		   greater than four) */
-		if( length < 1000 )
-			infoWidth = 3;
-		else
-		if( length > 9999999 )
-			infoWidth = 8;
-		else
-		if( length > 999999 )
-			infoWidth = 7;
-		else
-		if( length > 99999 )
-			infoWidth = 6;
+		*timeValue = ( long long ) time( NULL );
+		return( TRUE );
+		}
+	memcpy( timeString, "00000101000000Z", 15 );
+	for( ; *value; value++ )
+		{
+		if( isdigit( byteToInt( *value ) ) )
+			{
+			if( noDigits >= 14 )
+				return( FALSE );
+			timeString[ noDigits++ ] = *value;
+			}
 		else
-		if( length > 9999 )
-			infoWidth = 5;
+			{
+			if( !strchr( "-:T ", *value ) )
+				return( FALSE );
+			}
 		}
+	if( noDigits < 4 || ( noDigits & 1 ) )
+		return( FALSE );
 
-	/* If the input isn't seekable, turn off some options that require the
-	   use of fseek().  This check isn't perfect (some streams are slightly
-	   seekable due to buffering) but it's better than nothing.
-	   
-	   This is complicated by a problem under Windows for which running 
-	   things in pipe mode is pretty erratic, in particular using fseek()
-	   below results in all subsequent reads returning EOF.  To try and
-	   ameliorate this we first try other checks to see if we're using 
-	   stdin before trying the fseek() check */
-#ifdef __WIN32__
-	if( useStdin || inFile == stdin || \
-		fseek( inFile, -item->headerSize, SEEK_CUR ) )
-#else
-	if( fseek( inFile, -item->headerSize, SEEK_CUR ) )
-#endif /* __WIN32__ */
+	return( getTimeValue( timeString, 15, FALSE, timeValue ) );
+	}
+
+/* Process a long option of the form "--name[=value]" */
+
+static int processLongOption( const char *option )
+	{
+	const char *value = strchr( option, '=' );
+	const int nameLength = ( value != NULL ) ? \
+						   ( int ) ( value - option ) : ( int ) strlen( option );
+
+	if( value != NULL )
+		value++;
+	if( nameLength == 9 && !strncmp( option, "inventory", 9 ) )
 		{
-		useStdin = TRUE;
-		checkEncaps = FALSE;
-		if( !noWarnStdin )
+		if( value == NULL || !strcmp( value, "csv" ) )
+			inventoryFormat = INVENTORY_CSV;
+		else
 			{
-			puts( "Warning: Input is non-seekable, some functionality has "
-				  "been disabled." );
+			if( !strcmp( value, "json" ) || !strcmp( value, "ndjson" ) )
+				inventoryFormat = INVENTORY_JSON;
+			else
+				{
+				puts( "Invalid inventory format." );
+				exit( EXIT_FAILURE );
+				}
 			}
-
-		return( length );
+		return( TRUE );
 		}
-
-	/* If it looks like we've been given a text file, typically due to the
-	   input being base64-encoded, check whether it is all text */
-	if( ( isalnum( item->header[ 0 ] ) && isalnum( item->header[ 1 ] ) ) || \
-		  ( item->header[ 0 ] == '-' && item->header[ 1 ] == '-' ) )
+	if( ( nameLength == 15 && !strncmp( option, "expiring-before", 15 ) ) || \
+		( nameLength == 8 && !strncmp( option, "valid-at", 8 ) ) )
 		{
-		BYTE buffer[ 4 ];
-		int count, i;
+		const int isExpiry = ( nameLength == 15 ) ? TRUE : FALSE;
 
-		count = fread( buffer, 1, 4, inFile );
-		for( i = 0; i < count; i++ )
+		if( !getOptionTime( value, isExpiry ? &expiryTime : &validAtTime ) )
 			{
-			if( buffer[ i ] != '-' && !isalnum( buffer[ i ] ) )
-				break;
+			puts( "Invalid time, should be 'now' or YYYY[MM[DD[hh[mm[ss]]]]]." );
+			exit( EXIT_FAILURE );
 			}
-		if( i >= 4 && \
-			item->header[ 0 ] == 0x30 || item->header[ 0 ] == 0x31 )
+		if( isExpiry )
+			filterExpiry = TRUE;
+		else
+			filterValidAt = TRUE;
+
+		/* Filtering implies an inventory of the certificates that pass */
+		if( inventoryFormat == INVENTORY_NONE )
+			inventoryFormat = INVENTORY_CSV;
+		return( TRUE );
+		}
+	if( nameLength == 4 && !strncmp( option, "diff", 4 ) )
+		{
+		diffMode = TRUE;
+		return( TRUE );
+		}
+	if( nameLength == 11 && !strncmp( option, "make-corpus", 11 ) )
+		{
+		if( value == NULL || !*value )
 			{
-			/* Special-case handling for situations that would produce a 
-			   false positive, items containing nested SEQUENCE (0x30)/SET 
-			   (0x31) of an appropriate length will look like ASCII since
-			   the encoding is 0x30 0xXX 0x30 0xXX 0x30 0xXX, e.g. "0g0e0c",
-			   so we check for the pattern [0|1] alnum [0|1] alnum ... */
-			if( buffer[ 2 ] == 0x30 || buffer[ 2 ] == 0x31 )
-				{
-				/* It's at least 0x30 0xXX 0x30 0xXX, assume it's binary.
-				   This can lead to a minute number of false negatives, but 
-				   that's OK since (a) it's no any normal encoding format 
-				   for ASN.1 binary data and (b) all it'll do is produce
-				   an attempt to decode text as ASN.1 */
-				i = 0;
-				}
+			puts( "Corpus creation requires a directory name." );
+			exit( EXIT_FAILURE );
 			}
-		if( i >= 4 )
+		corpusDirName = value;
+		return( TRUE );
+		}
+	if( nameLength == 10 && !strncmp( option, "max-errors", 10 ) )
+		{
+		if( value == NULL || !isdigit( byteToInt( *value ) ) )
 			{
-			fputs( "Error: This file appears to be a base64-encoded text "
-				   "file, not binary data.\n", stderr );
-			fputs( "       In order to display it you first need to decode "
-				   "it into its\n", stderr );
-			fputs( "       binary form.\n", stderr );
+			puts( "Invalid maximum number of errors." );
 			exit( EXIT_FAILURE );
 			}
-		fseek( inFile, -4, SEEK_CUR );
+		maxErrors = atoi( value );
+		return( TRUE );
 		}
-
-	/* Undo the fseek() that we used to determine whether the input was
-	   seekable */
-	fseek( inFile, item->headerSize, SEEK_CUR );
-
-	return( length );
-	}
-
-static int printAsn1( FILE *inFile, const int level, long length,
-					  const int isIndefinite )
-	{
-	ASN1_ITEM item;
-	long lastPos = fPos;
-	int seenEOC = FALSE, status;
-
-	/* Bail out on suspiciously complex data */
-	if( level > MAX_NESTING_LEVEL )
+	if( nameLength == 11 && !strncmp( option, "diagnostics", 11 ) )
 		{
-		complain( "Object contains more than %d levels of nesting", 
-				  MAX_NESTING_LEVEL, level );
-		exit( EXIT_FAILURE );
+		if( value != NULL && strcmp( value, "json" ) )
+			{
+			puts( "Invalid diagnostics format." );
+			exit( EXIT_FAILURE );
+			}
+		jsonDiagnostics = TRUE;
+		return( TRUE );
 		}
-
-	/* Special-case for zero-length objects */
-	if( !length && !isIndefinite )
-		return( 0 );
-
-	while( ( status = getItem( inFile, &item ) ) > 0 )
+	if( nameLength == 6 && !strncmp( option, "schema", 6 ) )
 		{
-		int nonOutlineObject = FALSE;
-
-		/* Perform various special checks the first time that we're called */
-		if( length == LENGTH_MAGIC )
-			length = processObjectStart( inFile, &item );
-
-		/* Dump the header as hex data if requested */
-		if( doDumpHeader )
-			dumpHeader( inFile, &item, level );
-
-		/* If we're displaying the ASN.1 outline only and it's not a
-		   constructed object, don't display anything */
-		if( doOutlineOnly && ( item.id & FORM_MASK ) != CONSTRUCTED )
-			nonOutlineObject = TRUE;
-
-		/* Print the offset and length, unless we're in pure ASN.1-only
-		   output mode or we're displaying the outline only and it's not
-		   a constructed object */
-		if( item.header[ 0 ] == EOC )
+		if( value == NULL || !selectSchema( value ) )
+			{
+			puts( "Invalid schema type." );
+			exit( EXIT_FAILURE );
+			}
+		return( TRUE );
+		}
+#ifdef USE_COMPRESSED_OUTPUT
+	if( nameLength == 15 && !strncmp( option, "compress-output", 15 ) )
+		{
+		outputCompression = COMPRESSION_NONE;
+		if( value != NULL && !strcmp( value, "gzip" ) )
+			outputCompression = COMPRESSION_GZIP;
+		if( value != NULL && !strcmp( value, "zstd" ) )
+			outputCompression = COMPRESSION_ZSTD;
+		if( !isCompressionSupported( ( COMPRESSION_TYPE ) outputCompression ) )
+			{
+			puts( "Invalid or unsupported output compression type." );
+			exit( EXIT_FAILURE );
+			}
+		return( TRUE );
+		}
+#endif /* USE_COMPRESSED_OUTPUT */
+	if( nameLength == 7 && !strncmp( option, "decimal", 7 ) )
+		{
+		decimalIntegers = TRUE;
+		return( TRUE );
+		}
+	if( nameLength == 9 && !strncmp( option, "check-der", 9 ) )
+		{
+		derCheckMode = TRUE;
+		return( TRUE );
+		}
+	if( nameLength == 7 && !strncmp( option, "extract", 7 ) )
+		{
+		if( value == NULL || !*value )
 			{
-			seenEOC = TRUE;
-			if( !isIndefinite)
-				complain( "Spurious EOC in definite-length item", 0, level );
+			puts( "Extraction requires a manifest file name." );
+			exit( EXIT_FAILURE );
 			}
-		if( !doPure && !nonOutlineObject )
+		extractManifest = value;
+		return( TRUE );
+		}
+	if( nameLength == 4 && !strncmp( option, "find", 4 ) )
+		{
+		if( value == NULL || !*value )
 			{
-			if( item.indefinite )
-				{
-				printString( level, ( doHexValues ) ? \
-								LEN_HEX_INDEF : LEN_INDEF, lastPos );
-				}
-			else
-				{
-				if( !seenEOC )
-					{
-					printString( level, ( doHexValues ) ? \
-									LEN_HEX : LEN, lastPos, item.length );
-					}
-				}
+			puts( "Searching requires a query." );
+			exit( EXIT_FAILURE );
 			}
-
-		/* Print details on the item */
-		if( !seenEOC )
+		findQuery = value;
+		return( TRUE );
+		}
+	if( nameLength == 10 && !strncmp( option, "make-index", 10 ) )
+		{
+		if( value == NULL || !*value )
 			{
-			if( !nonOutlineObject )
-				doIndent( level );
-			printASN1object( inFile, &item, level );
+			puts( "Indexing requires an index file name." );
+			exit( EXIT_FAILURE );
 			}
-
-		/* If it was an indefinite-length object (no length was ever set) and
-		   we've come back to the top level, exit */
-		if( length == LENGTH_MAGIC )
-			return( 0 );
-
-		length -= fPos - lastPos;
-		lastPos = fPos;
-		if( isIndefinite )
+		makeIndexName = value;
+		return( TRUE );
+		}
+	if( nameLength == 12 && !strncmp( option, "search-index", 12 ) )
+		{
+		if( value == NULL || !*value )
 			{
-			if( seenEOC )
-				return( 0 );
+			puts( "Searching requires an index file name." );
+			exit( EXIT_FAILURE );
 			}
-		else
+		searchIndexName = value;
+		return( TRUE );
+		}
+	if( nameLength == 9 && !strncmp( option, "benchmark", 9 ) )
+		{
+		if( value != NULL )
 			{
-			if( length <= 0 )
+			benchmarkSize = atoi( value );
+			if( benchmarkSize < 1 || benchmarkSize > 1024 )
 				{
-				if( length < 0 )
-					return( ( int ) -length );
-				return( 0 );
+				puts( "Invalid benchmark size." );
+				exit( EXIT_FAILURE );
 				}
-			else
+			}
+		doBenchmarkMode = TRUE;
+		return( TRUE );
+		}
+	if( nameLength == 14 && !strncmp( option, "make-oid-table", 14 ) )
+		{
+		oidTableMode = OIDTABLE_MAKE;
+		return( TRUE );
+		}
+#ifdef BUILTIN_OIDS
+	if( nameLength == 15 && !strncmp( option, "check-oid-table", 15 ) )
+		{
+		oidTableMode = OIDTABLE_CHECK;
+		return( TRUE );
+		}
+#endif /* BUILTIN_OIDS */
+#ifdef USE_THREADS
+	if( nameLength == 5 && !strncmp( option, "batch", 5 ) )
+		{
+		if( value != NULL )
+			{
+			batchCacheSize = atoi( value );
+			if( !isdigit( byteToInt( *value ) ) || batchCacheSize < 0 || \
+				batchCacheSize > 1000000 )
 				{
-				if( length == 1 )
-					{
-					const int ch = fgetc( inFile );
-
-					/* If we've run out of input but there should be more
-					   present, let the caller know */
-					if( ch == EOF )
-						return( 1 );
-
-					/* No object can be one byte long, try and recover.  This
-					   only works sometimes because it can be caused by
-					   spurious data in an OCTET STRING hole or an incorrect
-					   length encoding.  The following workaround tries to
-					   recover from spurious data by skipping the byte if
-					   it's zero or a non-basic-ASN.1 tag, but keeping it if
-					   it could be valid ASN.1 */
-					if( ch > 0 && ch <= 0x31 )
-						ungetc( ch, inFile );
-					else
-						{
-						fPos++;
-						return( 1 );
-						}
-					}
+				puts( "Invalid batch cache size." );
+				exit( EXIT_FAILURE );
 				}
 			}
+		batchMode = TRUE;
+		return( TRUE );
 		}
-	if( status == -1 )
+	if( nameLength == 6 && !strncmp( option, "follow", 6 ) )
 		{
-		int i;
-
-		fflush( stdout );
-		fprintf( stderr, "\nError: Invalid data encountered at position "
-				 "%d:", fPos );
-		for( i = 0; i < item.headerSize; i++ )
-			fprintf( stderr, " %02X", item.header[ i ] );
-		fprintf( stderr, ".\n" );
-		exit( EXIT_FAILURE );
+		if( value != NULL && *value )
+			followStateFileName = value;
+		followMode = TRUE;
+		return( TRUE );
 		}
-
-	/* If we see an EOF and there's supposed to be more data present,
-	   complain */
-	if( length && length != LENGTH_MAGIC )
+	if( nameLength == 6 && !strncmp( option, "server", 6 ) )
 		{
-		fprintf( output, "Error: Inconsistent object length, %ld byte%s "
-				 "difference.\n", length, ( length > 1 ) ? "s" : "" );
-		noErrors++;
+		if( value == NULL || !*value )
+			{
+			puts( "Server mode requires a socket name." );
+			exit( EXIT_FAILURE );
+			}
+		serverSocketName = value;
+		return( TRUE );
 		}
-	return( 0 );
+#endif /* USE_THREADS */
+
+	return( FALSE );
 	}
 
 /* Show usage and exit */
@@ -3358,7 +15334,7 @@ static void usageExit( void )
 	puts( "Copyright Peter Gutmann 1997 - " UPDATE_YEAR ".  Last updated " UPDATE_STRING "." );
 	puts( "" );
 
-	puts( "Usage: dumpasn1 [-acdefghilmopqrstuvwxz] <file>" );
+	puts( "Usage: dumpasn1 [-acdefghijlmnopqrstuvwxz] <file>" );
 	puts( "  Input options:" );
 	puts( "       - = Take input from stdin (some display options will be disabled)" );
 	puts( "       -q = Disable warning about stdin use affecting display options" );
@@ -3366,6 +15342,10 @@ static void usageExit( void )
 	puts( "       -- = End of arg list" );
 	puts( "       -c<file> = Read Object Identifier info from alternate config file" );
 	puts( "            (values will override equivalents in global config file)" );
+#ifdef USE_THREADS
+	puts( "       --follow[=<state file>] = Dump items as they're appended to the file," );
+	puts( "            saving the position reached in the state file if given" );
+#endif /* USE_THREADS */
 	puts( "" );
 
 	puts( "  Output options:" );
@@ -3383,9 +15363,15 @@ static void usageExit( void )
 	puts( "       -i = Use shallow indenting, for deeply-nested objects" );
 	puts( "       -l = Long format, display extra info about Object Identifiers" );
 	puts( "       -m<number>  = Maximum nesting level for which to display content" );
+	puts( "       -n<number>  = Display at most <number> items in each constructed object" );
+	puts( "       -n<number>,v = Same as -n but check the items that aren't displayed" );
 	puts( "       -p = Pure ASN.1 output without encoding information" );
 	puts( "       -t = Display text values next to hex dump of data" );
 	puts( "       -v = Verbose mode, equivalent to -ahlt" );
+	puts( "       --schema=<type> = Label fields with their names from the schema for" );
+	puts( "            <type>, one of cert, crl, cms, pkcs8, or pkcs12" );
+	puts( "       --decimal = Display integers too large for a long in decimal rather" );
+	puts( "            than hex" );
 	puts( "" );
 
 	puts( "  Format options:" );
@@ -3399,6 +15385,87 @@ static void usageExit( void )
 	puts( "       -o = Don't check validity of character strings hidden in octet strings" );
 	puts( "       -s = Syntax check only, don't dump ASN.1 structures" );
 	puts( "       -z = Allow zero-length items" );
+	puts( "       --max-errors=<number> = Stop decoding after more than <number> errors" );
+	puts( "       --diagnostics[=json] = Report the offset, nesting level, and type of" );
+	puts( "            each error and warning as a JSON object on stderr" );
+	puts( "       --check-der <file/dir>... = Check that the files are strictly" );
+	puts( "            DER-encoded, including SET ordering, without dumping them" );
+	puts( "" );
+
+	puts( "  Performance options:" );
+	puts( "       -j<number> = Decode large objects using <number> threads" );
+#ifdef USE_COMPRESSED_OUTPUT
+	puts( "       --compress-output=<type> = Compress the output with <type>, gzip or" );
+	puts( "            zstd, in a separate thread while decoding" );
+#endif /* USE_COMPRESSED_OUTPUT */
+	puts( "" );
+
+#ifdef USE_THREADS
+	puts( "  Server options:" );
+	puts( "       --server=<socket> = Dump objects sent to a UNIX domain socket, using" );
+	puts( "            the display options given as defaults for each request" );
+	puts( "" );
+#endif /* USE_THREADS */
+
+	puts( "  Build options:" );
+	puts( "       --make-oid-table = Write the config file OIDs as a C table for building" );
+	puts( "            with -D BUILTIN_OIDS" );
+#ifdef BUILTIN_OIDS
+	puts( "       --check-oid-table = Check the compiled-in OID table against the config" );
+	puts( "            file" );
+#endif /* BUILTIN_OIDS */
+	puts( "" );
+
+	puts( "  Inventory options:" );
+	puts( "       --inventory[=csv|json] <file/dir>... = Print the names, validity," );
+	puts( "            key algorithm, and SPKI SHA-256 of each certificate found" );
+	puts( "       --expiring-before=<time> = Only include certificates that expire" );
+	puts( "            before <time>, 'now' or YYYY[MM[DD[hh[mm[ss]]]]], implies" );
+	puts( "            --inventory" );
+	puts( "       --valid-at=<time> = Only include certificates valid at <time>," );
+	puts( "            implies --inventory" );
+	puts( "" );
+
+#ifdef USE_THREADS
+	puts( "  Batch options:" );
+	puts( "       --batch[=<entries>] <file/dir>... = Dump each of the given files," );
+	puts( "            emitting the output for objects that have already been dumped" );
+	puts( "            from a cache of <entries> objects, default = 1024" );
+	puts( "" );
+#endif /* USE_THREADS */
+
+	puts( "  Search options:" );
+	puts( "       --find=<condition>[,<condition>...] = List the offsets and enclosing" );
+	puts( "            items of the items that match all of the conditions, which are" );
+	puts( "            tag=<name|[number]>, class=<class>, oid=<name|value>," );
+	puts( "            time<op><YYYYMMDD...>, int<op><value>, length<op><value>, with" );
+	puts( "            <op> = '=', '!=', '<', '<=', '>', '>='" );
+	puts( "" );
+
+	puts( "  Index options:" );
+	puts( "       --make-index=<index> <file/dir>... = Create or update an index of the" );
+	puts( "            OIDs in the given files, rescanning only new or changed files" );
+	puts( "       --search-index=<index> <OID>... = List the files, offsets, and" );
+	puts( "            enclosing items for each occurrence of the OIDs, given by name" );
+	puts( "            or as dotted values" );
+	puts( "" );
+
+	puts( "  Extraction options:" );
+	puts( "       --extract=<manifest> <file> = Write the objects at the offsets or" );
+	puts( "            item paths listed in the manifest to the given files, checking" );
+	puts( "            their SHA-256 if given" );
+	puts( "" );
+
+	puts( "  Diff options:" );
+	puts( "       --diff <file1> <file2> = Compare two objects, displaying only the" );
+	puts( "            items that differ" );
+	puts( "" );
+
+	puts( "  Test options:" );
+	puts( "       --make-corpus=<dir> <file/dir>... = Write the objects in the given" );
+	puts( "            files to a directory as a seed corpus for the fuzz target" );
+	puts( "       --benchmark[=<MB>] = Time the decoding of synthetic objects of the" );
+	puts( "            given size, default = 4MB, with each output mode" );
 	puts( "" );
 
 	puts( "Warnings generated by deprecated OIDs require the use of '-l' to be displayed." );
@@ -3406,6 +15473,26 @@ static void usageExit( void )
 	exit( EXIT_FAILURE );
 	}
 
+#ifndef FUZZER		/* libFuzzer provides its own main() */
+
+/* Dump the object in the input file, setting up an exit point in case
+   decoding is stopped early.  This is kept out of main() so that the
+   longjmp() can't clobber main()'s locals */
+
+static void dumpObject( FILE *inFile, const int checkTrailing )
+	{
+	jmp_buf abortEnv;
+
+	decodeAbort = &abortEnv;
+	if( !setjmp( abortEnv ) )
+		{
+		printAsn1( inFile, 0, LENGTH_MAGIC, 0 );
+		if( checkTrailing )
+			checkTrailingData( inFile );
+		}
+	decodeAbort = NULL;
+	}
+
 int main( int argc, char *argv[] )
 	{
 	FILE *inFile, *outFile = NULL;
@@ -3417,7 +15504,7 @@ int main( int argc, char *argv[] )
 #else
 	char *pathPtr = argv[ 0 ];
 #endif /* __OS390__ */
-	long offset = 0;
+	long offset = 0, findOffset;
 	int moreArgs = TRUE, doCheckOnly = FALSE;
 
 #ifdef __OS390__
@@ -3445,10 +15532,21 @@ int main( int argc, char *argv[] )
 	/* Check for arguments */
 	while( argc && *argv[ 0 ] == '-' && moreArgs )
 		{
-		char *argPtr = argv[ 0 ] + 1;
+		const char *argPtr = argv[ 0 ] + 1;
+		const char *errorString;
+		int status;
 
 		if( !*argPtr )
 			useStdin = TRUE;
+		if( *argPtr == '-' && argPtr[ 1 ] )
+			{
+			if( !processLongOption( argPtr + 1 ) )
+				{
+				printf( "Unknown argument '%s'.\n", argv[ 0 ] );
+				return( EXIT_SUCCESS );
+				}
+			argPtr += strlen( argPtr );	/* Skip rest of arg */
+			}
 		while( *argPtr )
 			{
 			if( isdigit( byteToInt( *argPtr ) ) )
@@ -3462,25 +15560,16 @@ int main( int argc, char *argv[] )
 					moreArgs = FALSE;	/* GNU-style end-of-args flag */
 					break;
 
-				case 'A':
-					printAllData = TRUE;
-					break;
-
 				case 'C':
 					if( !readConfig( argPtr + 1, FALSE ) )
 						exit( EXIT_FAILURE );
+#ifdef USE_THREADS
+					addServerConfigFile( argPtr + 1 );
+#endif /* USE_THREADS */
 					while( argPtr[ 1 ] )
 						argPtr++;	/* Skip rest of arg */
 					break;
 
-				case 'D':
-					printDots = TRUE;
-					break;
-
-				case 'E':
-					checkEncaps = FALSE;
-					break;
-
 				case 'F':
 					if( ( outFile = fopen( argPtr + 1, "wb" ) ) == NULL )
 						{
@@ -3491,49 +15580,21 @@ int main( int argc, char *argv[] )
 						argPtr++;	/* Skip rest of arg */
 					break;
 
-				case 'G':
-					doOutlineOnly = TRUE;
-					break;
-
-				case 'H':
-					doDumpHeader++;
-					break;
-
-				case 'I':
-					shallowIndent = TRUE;
-					break;
-
-				case 'L':
-					extraOIDinfo = TRUE;
-					break;
-
-				case 'M':
-					maxNestLevel = atoi( argPtr + 1 );
-					if( maxNestLevel < 1 || maxNestLevel > MAX_NESTING_LEVEL )
+				case 'J':
+					parallelThreads = atoi( argPtr + 1 );
+					if( parallelThreads < 1 || parallelThreads > MAX_THREADS )
 						{
-						puts( "Invalid maximum nesting level." );
+						puts( "Invalid number of threads." );
 						exit( EXIT_FAILURE );
 						}
 					while( argPtr[ 1 ] )
 						argPtr++;	/* Skip rest of arg */
 					break;
 
-				case 'O':
-					checkCharset = FALSE;
-					break;
-
-				case 'P':
-					doPure = TRUE;
-					break;
-
 				case 'Q':
 					noWarnStdin = TRUE;
 					break;
 
-				case 'R':
-					reverseBitString = !reverseBitString;
-					break;
-
 				case 'S':
 					doCheckOnly = TRUE;
 #if defined( __WIN32__ )
@@ -3553,41 +15614,18 @@ int main( int argc, char *argv[] )
 #endif /* OS-specific bypassing of stdout */
 					break;
 
-				case 'T':
-					dumpText = TRUE;
-					break;
-
-				case 'U':
-					rawTimeString = TRUE;
-					break;
-
-				case 'V':
-					printAllData = doDumpHeader = TRUE;
-					extraOIDinfo = dumpText = TRUE;
-					break;
-
-				case 'W':
-					outputWidth = atoi( argPtr + 1 );
-					if( outputWidth < 40 || outputWidth > 500 )
+				default:
+					status = processDisplayOption( &argPtr, &errorString );
+					if( status < 0 )
 						{
-						puts( "Invalid output width." );
+						puts( errorString );
 						exit( EXIT_FAILURE );
 						}
-					while( argPtr[ 1 ] )
-						argPtr++;	/* Skip rest of arg */
-					break;
-
-				case 'X':
-					doHexValues = TRUE;
-					break;
-
-				case 'Z':
-					zeroLengthAllowed = TRUE;
-					break;
-
-				default:
-					printf( "Unknown argument '%c'.\n", *argPtr );
-					return( EXIT_SUCCESS );
+					if( !status )
+						{
+						printf( "Unknown argument '%c'.\n", *argPtr );
+						return( EXIT_SUCCESS );
+						}
 				}
 			argPtr++;
 			}
@@ -3602,35 +15640,221 @@ int main( int argc, char *argv[] )
 		exit( EXIT_FAILURE );
 		}
 
+	/* If we're labelling fields, compile the schema */
+	if( schemaRoot != SCHEMA_TYPE_NONE && !compileSchema() )
+		{
+		puts( "Couldn't compile the schema for labelling fields." );
+		exit( EXIT_FAILURE );
+		}
+
 	/* Check args and read the config file.  We don't bother weeding out
 	   dups during the read because (a) the linear search would make the
-	   process n^2, (b) during the dump process the search will terminate on
-	   the first match so dups aren't that serious, and (c) there should be
-	   very few if any dups present */
+	   process n^2, (b) they're dropped when the OIDs are indexed, with the
+	   first match taking precedence, and (c) there should be very few if
+	   any dups present */
+	if( oidTableMode != OIDTABLE_NONE )
+		{
+		int status;
+
+		/* We're generating or checking the compiled-in OID table from the
+		   config data */
+		if( argc > 0 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) )
+			exit( EXIT_FAILURE );
+#ifdef BUILTIN_OIDS
+		if( oidTableMode == OIDTABLE_CHECK )
+			status = checkOIDtable();
+		else
+#endif /* BUILTIN_OIDS */
+		status = makeOIDtable( stdout );
+		freeConfig();
+		return( status ? EXIT_SUCCESS : EXIT_FAILURE );
+		}
+	if( inventoryFormat != INVENTORY_NONE )
+		{
+		int status;
+
+		/* We're producing an inventory of the certificates in the given
+		   files rather than dumping a single object */
+		if( argc < 1 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+		status = doInventory( argv, argc );
+		freeConfig();
+		return( status );
+		}
+	if( corpusDirName != NULL )
+		{
+		/* We're creating a fuzzer corpus from the objects in the given
+		   files */
+		if( argc < 1 || useStdin )
+			usageExit();
+		return( makeCorpus( corpusDirName, argv, argc ) );
+		}
+	if( doBenchmarkMode )
+		{
+		int status;
+
+		/* We're timing the decoding of synthetic data */
+		if( argc > 0 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+		status = doBenchmark();
+		freeConfig();
+		return( status );
+		}
+	if( makeIndexName != NULL )
+		{
+		/* We're indexing the OIDs in the given files */
+		if( argc < 1 || useStdin )
+			usageExit();
+		return( makeIndex( makeIndexName, argv, argc ) );
+		}
+	if( searchIndexName != NULL )
+		{
+		int status;
+
+		/* We're looking up OIDs in an index */
+		if( argc < 1 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+		status = searchIndex( searchIndexName, argv, argc );
+		freeConfig();
+		return( status );
+		}
+	if( derCheckMode )
+		{
+		/* We're checking the encoding rather than dumping the file */
+		if( argc < 1 || useStdin )
+			usageExit();
+		return( doCheckDER( argv, argc ) );
+		}
+	if( extractManifest != NULL )
+		{
+		/* We're extracting the objects listed in a manifest rather than
+		   dumping the file */
+		if( argc != 1 || useStdin )
+			usageExit();
+		return( doExtract( extractManifest, argv[ 0 ] ) );
+		}
+	if( diffMode )
+		{
+		int status;
+
+		/* We're comparing two objects rather than dumping one */
+		if( argc != 2 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+		status = doDiff( argv[ 0 ], argv[ 1 ] );
+		freeConfig();
+		return( status );
+		}
+#ifdef USE_THREADS
+	if( batchMode )
+		{
+		int status;
+
+		/* We're dumping a collection of files rather than a single one */
+		if( argc < 1 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+  #ifdef USE_COMPRESSED_OUTPUT
+		if( !beginOutputCompression() )
+			exit( EXIT_FAILURE );
+		status = doBatch( argv, argc );
+		if( !endOutputCompression() )
+			status = EXIT_FAILURE;
+  #else
+		status = doBatch( argv, argc );
+  #endif /* USE_COMPRESSED_OUTPUT */
+		freeConfig();
+		return( status );
+		}
+	if( followMode )
+		{
+		int status;
+
+		/* We're dumping items as they're appended to the file */
+		if( argc != 1 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+		status = doFollow( argv[ 0 ], offset );
+		freeConfig();
+		return( status );
+		}
+	if( serverSocketName != NULL )
+		{
+		int status;
+
+		/* We're running as a server, read the config once and then process
+		   requests until we're stopped */
+		if( argc > 0 || useStdin )
+			usageExit();
+		if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
+			exit( EXIT_FAILURE );
+		serverConfigPath = pathPtr;
+		status = runServer( serverSocketName );
+		freeConfig();
+		return( status );
+		}
+#endif /* USE_THREADS */
 	if( argc != 1 && !useStdin )
 		usageExit();
-	if( !readGlobalConfig( pathPtr ) )
+	if( !readGlobalConfig( pathPtr ) || !buildOIDtrie() )
 		exit( EXIT_FAILURE );
 
+	/* If we're recording diagnostics, the data has to be decoded serially
+	   so that they're recorded in order */
+	if( maxErrors >= 0 || jsonDiagnostics )
+		{
+		parallelThreads = 1;
+		recordDiagnostics = TRUE;
+		}
+
 	/* Dump the given file */
 	if( useStdin )
 		inFile = stdin;
 	else
 		{
-		if( ( inFile = fopen( argv[ 0 ], "rb" ) ) == NULL )
+		if( ( inFile = openInputFile( argv[ 0 ] ) ) == NULL )
 			{
-			perror( argv[ 0 ] );
 			freeConfig();
 			exit( EXIT_FAILURE );
 			}
 		}
+	findOffset = offset;	/* Skipping stdin data consumes the offset */
 	if( useStdin )
 		{
 		while( offset-- )
 			getc( inFile );
 		}
 	else
-		fseek( inFile, offset, SEEK_SET );
+		{
+		/* A memory-mapped stream can't be positioned past the end of the
+		   data, in which case we move to the end */
+		if( fseek( inFile, offset, SEEK_SET ) )
+			fseek( inFile, 0, SEEK_END );
+		}
+	if( findQuery != NULL )
+		{
+		int status;
+
+		/* We're searching for items rather than dumping them */
+		status = doFind( inFile, findQuery, findOffset );
+		fclose( inFile );
+#ifdef USE_THREADS
+		closeMappedFile();
+#endif /* USE_THREADS */
+		freeConfig();
+		return( status );
+		}
 	if( outFile != NULL )
 		{
 		ASN1_ITEM item;
@@ -3668,33 +15892,36 @@ int main( int argc, char *argv[] )
 
 		fseek( inFile, offset, SEEK_SET );
 		}
-	printAsn1( inFile, 0, LENGTH_MAGIC, 0 );
-	if( !useStdin && offset == 0 )
+#ifdef USE_COMPRESSED_OUTPUT
+	if( !doCheckOnly && !beginOutputCompression() )
 		{
-		BYTE buffer[ 16 ];
-		long position = ftell( inFile );
-
-		/* If we're dumping a standalone ASN.1 object and there's further
-		   data appended to it, warn the user of its existence.  This is a
-		   bit hit-and-miss since there may or may not be additional EOCs
-		   present, dumpasn1 always stops once it knows that the data should
-		   end (without trying to read any trailing EOCs) because data from
-		   some sources has the EOCs truncated, and most apps know that they
-		   have to stop at min( data_end, EOCs ).  To avoid false positives,
-		   we skip at least 4 EOCs worth of data and if there's still more
-		   present, we complain */
-		( void ) fread( buffer, 1, 8, inFile );		/* Skip 4 EOCs */
-		if( !feof( inFile ) )
-			{
-			warn( "Further data follows ASN.1 data at position %ld.\n", 
-				  position, 0 );
-			}
+		freeConfig();
+		exit( EXIT_FAILURE );
+		}
+#endif /* USE_COMPRESSED_OUTPUT */
+	dumpObject( inFile, !useStdin && offset == 0 );
+	if( diagStopReason == DIAG_STOP_MAX_ERRORS )
+		{
+		fprintf( output, "\nStopped decoding after %d error%s.\n",
+				 noErrors, ( noErrors != 1 ) ? "s" : "" );
 		}
+#ifdef USE_COMPRESSED_OUTPUT
+	if( !doCheckOnly && !endOutputCompression() )
+		noErrors++;
+#endif /* USE_COMPRESSED_OUTPUT */
 	fclose( inFile );
+#ifdef USE_THREADS
+	closeMappedFile();
+#endif /* USE_THREADS */
 	freeConfig();
 
 	/* Print a summary of warnings/errors if it's required or appropriate */
-	if( !doPure )
+	if( jsonDiagnostics )
+		{
+		fflush( stdout );
+		writeJSONdiagnostics( stderr, useStdin ? "-" : argv[ 0 ] );
+		}
+	if( !doPure && !jsonDiagnostics )
 		{
 		fflush( stdout );
 		if( !doCheckOnly )
@@ -3706,4 +15933,5 @@ int main( int argc, char *argv[] )
 
 	return( ( noErrors ) ? noErrors : EXIT_SUCCESS );
 	}
+#endif /* !FUZZER */
 